@@ -29,6 +29,7 @@
 #define _rmr_h
 
 #include <sys/epoll.h>		// broken on mac
+#include <sys/uio.h>		// struct iovec for rmr_send_iov()
 
 #ifdef __cplusplus
 extern "C" {
@@ -80,6 +81,19 @@ extern "C" {
 #define RMR_NO_COPY			0
 #define RMR_COPY			1
 
+#define RMR_SHARD_MEID		1		// rmr_set_shards() key types: managed element id
+#define RMR_SHARD_XID		2		// transaction id up to the first colon
+#define RMR_SHARD_SUBID		3		// subscription id
+#define RMR_SHARD_MTYPE		4		// message type
+#define RMR_MAX_SHARDS		64		// max number of receive shards
+#define RMR_MAX_FANOUT		32		// max per destination states kept for rmr_get_fanout_status()
+
+#define RMR_CB_CLOSED		0		// endpoint circuit breaker states (rmr_get_send_stats()): connects allowed
+#define RMR_CB_OPEN			1		// peer is down; sends fail without trying to connect
+#define RMR_CB_HALF			2		// a probe is trying to connect
+#define RMR_MAX_IOV			32		// max user buffers which may be passed to rmr_send_iov()
+#define RMR_CALL_AUTO		0		// rmr_mt_call() call id: match the response on the xid; no call id to manage
+
 #define RMR_WH_CONNECTED(a) (a>=0)	// for now whid is integer; it could be pointer at some future date
 
 /*
@@ -121,6 +135,74 @@ typedef struct {
 
 typedef int rmr_whid_t;			// wormhole identifier returned by rmr_wh_open(), passed to rmr_wh_send_msg()
 
+/*
+	Message handler invoked by the dispatcher (rmr_register_handler()). The handler
+	returns the message if it is to be freed by RMR, or nil if it was sent, kept,
+	or freed by the handler.
+*/
+typedef rmr_mbuf_t* (*rmr_handler_t)( void* vctx, rmr_mbuf_t* msg, void* arg );
+
+/*
+	Completion callback for rmr_send_async(). Invoked on the send offload thread
+	with the message, state set, as rmr_send_msg() would have returned it. The
+	callback owns the message.
+*/
+typedef void (*rmr_send_cb_t)( void* vctx, rmr_mbuf_t* msg, void* arg );
+
+/*
+	Completion callback for rmr_call_async(). Invoked on the receive thread with
+	the response (state RMR_OK), or on the RMR timer thread with the call
+	message (state RMR_ERR_TIMEOUT). The callback owns the message and should
+	not block.
+*/
+typedef void (*rmr_call_cb_t)( void* vctx, rmr_mbuf_t* msg, void* arg );
+
+typedef struct {
+	uint64_t count;				// number of messages handled
+	uint64_t total_ns;			// total time spent in the handler
+	uint64_t max_ns;			// longest single invocation
+} rmr_handler_stats_t;
+
+typedef struct {
+	uint64_t allocs;			// message buffers allocated
+	uint64_t hits;				// allocations satisfied from the recycling caches
+	uint64_t frees;				// message buffers freed (and cached)
+	uint64_t released;			// cached buffers returned to the system because the caches were full
+	uint64_t cached;			// buffers currently held in the caches
+} rmr_mbuf_stats_t;
+
+typedef struct {
+	uint64_t slabs;				// huge page arena slabs mapped (RMR_TP_ARENA=1)
+	uint64_t huge_slabs;		// slabs backed by reserved huge pages (others rely on transparent huge pages)
+	uint64_t arena_bytes;		// bytes mapped for the arena
+	uint64_t carved_bytes;		// arena bytes handed out as buffers (the rest is unused slab)
+	uint64_t idle_bytes;		// bytes in pooled buffers not in use by any message
+	uint64_t direct;			// buffers allocated with malloc
+	uint64_t rss_bytes;			// process resident set size
+} rmr_tpbuf_stats_t;
+
+typedef struct {
+	uint64_t blocked;			// times a send waited for the connection to the endpoint to drain
+	uint64_t blocked_ns;		// total time spent waiting
+	uint64_t max_blocked_ns;	// longest single wait
+	uint64_t connect_fails;		// connects to the endpoint which failed
+	uint64_t cb_trips;			// times the endpoint's circuit breaker opened
+	uint64_t cb_fast_fails;		// sends failed without a connect because the breaker was open
+	int		cb_state;			// RMR_CB_ constant
+} rmr_send_stats_t;
+
+/*
+	Payload codec (rmr_set_codec()). Compress returns the number of bytes written
+	to dest, or 0 if the output would not fit in max bytes. Decompress returns the
+	number of bytes written to dest, or -1 if the input is bad or would not fit.
+	Data is passed, untouched, to both functions.
+*/
+typedef struct {
+	int (*compress)( void* data, unsigned char const* src, int len, unsigned char* dest, int max );
+	int (*decompress)( void* data, unsigned char const* src, int len, unsigned char* dest, int max );
+	void* data;
+} rmr_codec_t;
+
 
 // ---- library message specific prototypes ------------------------------------------------------------
 extern rmr_mbuf_t* rmr_alloc_msg( void* vctx, int size );
@@ -132,12 +214,27 @@ extern int rmr_init_trace( void* vctx, int size );
 extern int rmr_payload_size( rmr_mbuf_t* msg );
 extern rmr_mbuf_t* rmr_send_msg( void* vctx, rmr_mbuf_t* msg );
 extern rmr_mbuf_t* rmr_mtosend_msg( void* vctx, rmr_mbuf_t* msg, int max_to );
+extern rmr_mbuf_t* rmr_send_iov( void* vctx, rmr_mbuf_t* msg, const struct iovec* iov, int niov );
+extern int rmr_send_async( void* vctx, rmr_mbuf_t* msg, rmr_send_cb_t cb, void* arg );
+extern rmr_mbuf_t* rmr_send_complete( void* vctx );
+extern int rmr_get_send_cfd( void* vctx );
+extern int rmr_call_async( void* vctx, rmr_mbuf_t* msg, int max_wait, rmr_call_cb_t cb, void* arg );
+extern rmr_mbuf_t* rmr_call_complete( void* vctx );
+extern int rmr_get_call_cfd( void* vctx );
 extern rmr_mbuf_t* rmr_rcv_msg( void* vctx, rmr_mbuf_t* old_msg );
 extern rmr_mbuf_t* rmr_rcv_specific( void* uctx, rmr_mbuf_t* msg, char* expect, int allow2queue );
 extern rmr_mbuf_t*  rmr_rts_msg( void* vctx, rmr_mbuf_t* msg );
 extern int rmr_ready( void* vctx );
 extern int rmr_set_rtimeout( void* vctx, int time );
 extern int rmr_set_stimeout( void* vctx, int time );
+extern int rmr_set_stimeout_us( void* vctx, int usec );
+extern int rmr_get_send_stats( void* vctx, char const* ep_name, rmr_send_stats_t* stats );
+extern int rmr_set_flow_ctl( void* vctx, int window );
+extern int rmr_set_batch( void* vctx, int max_bytes, int max_us );
+extern int rmr_flush( void* vctx );
+extern int rmr_get_fanout_status( void* vctx, int* states, int max_states );
+extern int rmr_set_compress( void* vctx, int mtype, int min_len );
+extern int rmr_set_codec( void* vctx, rmr_codec_t const* codec );
 extern int rmr_get_rcvfd( void* vctx );								// only supported with nng
 extern void rmr_set_low_latency( void* vctx );
 extern rmr_mbuf_t* rmr_torcv_msg( void* vctx, rmr_mbuf_t* old_msg, int ms_to );
@@ -150,7 +247,19 @@ extern void rmr_wh_close( void* vctx, int whid );
 
 // ----- mt call support --------------------------------------------------------------------------------
 extern rmr_mbuf_t* rmr_mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_wait );
+extern int rmr_set_hedge( void* vctx, int pctile );
 extern rmr_mbuf_t* rmr_mt_rcv( void* vctx, rmr_mbuf_t* mbuf, int max_wait );
+extern int rmr_set_shards( void* vctx, int nshards, int key_type );
+extern rmr_mbuf_t* rmr_shard_rcv( void* vctx, int shard, rmr_mbuf_t* mbuf, int max_wait );
+extern int rmr_get_shard_rcvfd( void* vctx, int shard );
+
+// ---- dispatcher ------------------------------------------------------------------------------------
+extern int rmr_register_handler( void* vctx, int mtype, rmr_handler_t fn, void* arg );
+extern int rmr_set_handler_limit( void* vctx, int mtype, int max_concurrent );
+extern int rmr_dispatch_start( void* vctx, int nthreads );
+extern int rmr_get_handler_stats( void* vctx, int mtype, rmr_handler_stats_t* stats );
+extern int rmr_get_mbuf_stats( void* vctx, rmr_mbuf_stats_t* stats );
+extern int rmr_get_tpbuf_stats( void* vctx, rmr_tpbuf_stats_t* stats );
 
 // ----- msg buffer operations (no context needed) ------------------------------------------------------
 extern int rmr_bytes2meid( rmr_mbuf_t* mbuf, unsigned char const* src, int len );
@@ -54,6 +54,7 @@ typedef struct uta_ctx  uta_ctx_t;
 #define RT_ME_SPACE	2		// message id is the key
 
 #define RMR_MSG_VER	3			// message version this code was designed to handle
+#define RMR_CH_VER	4			// compact (wire only) header version; expanded to RMR_MSG_VER on receipt
 
 											// environment variable names we'll suss out
 #define ENV_BIND_IF		"RMR_BIND_IF"		// the interface to bind to for both normal comma and RTG (0.0.0.0 if missing)
@@ -66,6 +67,13 @@ typedef struct uta_ctx  uta_ctx_t;
 #define ENV_VERBOSE_FILE "RMR_VCTL_FILE"	// file where vlevel may be managed for some (non-time critical) functions
 #define ENV_NAME_ONLY	"RMR_SRC_NAMEONLY"	// src in message is name only
 #define ENV_WARNINGS	"RMR_WARNINGS"		// if == 1 then we write some, non-performance impacting, warnings
+#define ENV_RCV_SHARE	"RMR_RCV_SHARE"		// if == 1 small received messages share the receive block rather than being copied
+#define ENV_TP_ARENA	"RMR_TP_ARENA"		// if == 1 pooled transport buffers are carved from huge page backed slabs
+#define ENV_COMPACT_HDR	"RMR_COMPACT_HDR"	// if == 1 compact headers are offered to, and accepted from, peers which support them
+#define ENV_BATCH_BYTES	"RMR_BATCH_BYTES"	// if > 0 messages to an endpoint are batched up to this many bytes
+#define ENV_BATCH_US	"RMR_BATCH_US"		// latency budget (usec) for batched messages (default 50)
+#define ENV_CB_FAILS	"RMR_CB_FAILS"		// consecutive failed connects which open an endpoint's circuit breaker (0 == off)
+#define ENV_HEDGE_PCT	"RMR_HEDGE_PCT"		// if > 0 rmr_mt_call() is hedged after this percentile of the type's response times
 #define ENV_SRC_ID		"RMR_SRC_ID"		// forces this string (adding :port, max 63 ch) into the source field; host name used if not set
 #define ENV_LOG_HR 		"RMR_HR_LOG"		// set to 0 to turn off human readable logging and write using some formatting
 #define ENV_LOG_VLEVEL	"RMR_LOG_VLEVEL"	// set the verbosity level (0 == 0ff; 1 == crit .... 5 == debug )
@@ -95,10 +103,26 @@ typedef struct uta_ctx  uta_ctx_t;
 #define MFL_ADDSRC		0x04		// source must be added on send
 #define MFL_RAW			0x08		// message is 'raw' and not from an RMr based sender (no header)
 #define MFL_HUGE		0x10		// buffer was larger than applications indicated usual max; don't cache
+#define MFL_TPPOOL		0x20		// transport buffer came from the buffer pool (tpb_alloc()) and must be returned there
+#define MFL_TPSHARED	0x40		// transport buffer is a slice of a shared receive block; release drops a block reference
+#define MFL_TPMASK		(MFL_TPPOOL | MFL_TPSHARED)		// all flags which describe where the transport buffer came from
+#define MFL_FANOUT		0x80		// send is one of several in a fan-out; message stays with the caller on success
+#define MFL_FREED		0x100		// mbuf is cached for reuse (freed by the user); a second free is refused
 
 #define MAX_EP_GROUP	32			// max number of endpoints in a group
+
+#define RRG_RR			0			// endpoint group selection policies: next endpoint in turn (default)
+#define RRG_BCAST		1			// every endpoint (%bcast)
+#define RRG_WRR			2			// smooth weighted round robin (%wrr)
+#define RRG_LO			3			// least outstanding; lightest loaded endpoint (%lo)
+#define RRG_P2C			4			// lighter loaded of two picked at random (%p2c)
+#define RRG_HASH		5			// consistent hash of a message key (%hash(key))
+#define RRG_HASH_SLOTS	4093		// maglev lookup table size (prime, well over 100 * MAX_EP_GROUP)
+#define RRG_MAX_WEIGHT	100			// largest endpoint weight (name=weight) accepted
 #define MAX_RTG_MSG_SZ	2048		// max expected message size from route generator
 #define MAX_CALL_ID		255			// largest call ID that is supported
+#define XC_SLOTS		8192		// outstanding automatic (xid matched) calls table size; power of two
+#define XC_PROBES		32			// slots following the xid's hash which a call may use
 
 //#define DEF_RTG_MSGID	""				// default to pick up all messages from rtg
 #define DEF_CTL_PORT	"4561"			// default control port that rtc listens on
@@ -143,6 +167,10 @@ typedef struct uta_ctx  uta_ctx_t;
 
 							// index of things in the d1 data space
 #define D1_CALLID_IDX	0	// the call-id to match on return
+#define D1_XCALL_IDX	1	// marks the message as an automatic call matched on xid (call-id is 0)
+#define D1_XTAG_IDX		2	// two bytes: tag of the context which made the automatic call
+
+#define XCALL_MARK		0x78	// value in the xcall byte of an automatic call
 
 #define	NO_CALL_ID		0	// no call id associated with the message (normal queue)
 
@@ -152,6 +180,11 @@ typedef struct uta_ctx  uta_ctx_t;
 #define HFL_HAS_TRACE	0x01			// Trace data is populated
 #define HFL_SUBID		0x02			// subscription ID is populated
 #define HFL_CALL_MSG	0x04			// msg sent via blocking call
+#define HFL_FC_CAP		0x08			// sender honours flow control credit grants
+#define HFL_CTL			0x10			// transport control frame; never delivered to the application
+#define HFL_CH_CAP		0x20			// sender will use compact (v4) headers if the receiver accepts them
+#define HFL_COMP		0x40			// payload is compressed (original length, then codec output)
+#define HFL_CZ_CAP		0x80			// sender will compress payloads if the receiver accepts them
 
 /*
 	Alarm action constants describe the type (e.g. dropping messages) and whether or not
@@ -203,6 +236,35 @@ typedef struct {
 } uta_mhdr_t;
 
 
+/*
+	Compact (v4) header. This is only ever on the wire; it is used on a connection
+	only after the receiver has accepted it, and the receiver expands it into a
+	full (current version) header before the message is seen by anything else.
+	The first three fields are in the same place as in the full header so that
+	the version can be sussed out. The fixed part is followed by the sender's
+	identity (ident_len bytes; src and srcip, each nil terminated) if present,
+	then the significant bytes of the xid, sid and meid, and then the trace, d1
+	and d2 data and the payload exactly as in the full header. When the identity
+	is present and src_id is not 0 the receiver keeps it and later frames on the
+	connection carry just the id.
+*/
+typedef struct {
+	int32_t	mtype;						// message type (network order, as are all multi-byte fields)
+	int32_t	plen;						// payload length
+	int32_t rmr_ver;					// RMR_CH_VER
+	int32_t	sub_id;						// subscription id
+	uint16_t	flags;					// HFL_* constants
+	uint16_t	src_id;					// connection scoped id of the sender's identity; 0 if not interned
+	uint16_t	len1;					// length of the tracing data
+	uint16_t	len2;					// length of data 1 (d1)
+	uint16_t	len3;					// length of data 2 (d2)
+	uint8_t	ident_len;					// length of identity following this header; 0 if not present
+	uint8_t	xid_len;					// significant bytes of each of the fixed length fields
+	uint8_t	sid_len;
+	uint8_t	meid_len;
+	uint8_t	pad[2];
+} uta_v4mhdr_t;
+
 typedef struct {						// old (inflexible) v1 header
 	int32_t	mtype;						// message type  ("long" network integer)
 	int32_t	plen;						// payload length
@@ -215,13 +277,20 @@ typedef struct {						// old (inflexible) v1 header
 } uta_v1mhdr_t;
 
 /*
-	Round robin group.
+	Round robin group. The policy, set by a marker ahead of the endpoints in the
+	route table (e.g. %bcast), says how an endpoint is selected for each message.
 */
 typedef struct {
-	uint16_t	ep_idx;		// next endpoint to send to
+	uint32_t	ep_idx;		// next endpoint to send to (bumped atomically; also the wrr schedule cursor)
+	int	policy;				// how the endpoint is selected (RRG_ constants)
 	int nused;				// number of endpoints in the list
 	int nendpts;			// number allocated
 	endpoint_t **epts;		// the list of endpoints that we RR over
+	int*	weights;		// weight of each endpoint (wrr only)
+	unsigned char*	sched;	// wrr order of endpoint indexes; nsched (sum of weights) entries
+	int		nsched;
+	int		hash_key;		// message key hashed (RMR_SHARD_ constant; hash only)
+	unsigned char*	lookup;	// maglev table: key hash % RRG_HASH_SLOTS gives the endpoint index
 } rrgroup_t;
 
 /*
@@ -246,9 +315,22 @@ typedef struct {
 	void*	ephash;			// hash for endpoint references
 	int		updates;		// counter of update records received
 	int		mupdates;		// counter of meid update records received
-	int		ref_count;		// num threads currently using
 } route_table_t;
 
+/*
+	A route table reader; one per thread which has used get_rt() on a context.
+	The epoch is the table epoch seen when the thread pinned the table, 0 when
+	it holds no table. Each record is written only by its own thread and is on
+	a cache line of its own, so getting and releasing the table writes nothing
+	that another thread reads often. Records are kept until the context is freed.
+*/
+typedef struct rt_reader {
+	uint64_t	epoch;				// epoch pinned; 0 when not reading
+	int			depth;				// nested get_rt() calls by the owner
+	pthread_t	owner;				// thread the record belongs to
+	struct rt_reader* next;
+} __attribute__((aligned(64))) rt_reader_t;
+
 /*
 	A wormhole is a direct connection between two endpoints that the user app can
 	send to without message type based routing.
@@ -300,8 +382,20 @@ typedef struct chute {
 	rmr_mbuf_t*	mbuf;						// pointer to message buffer received
 	sem_t	barrier;						// semaphore that the thread is waiting on
 	unsigned char	expect[RMR_MAX_XID];	// the expected transaction ID
+	int		state;							// set while a call waits on the chute (SI only; changed with atomics)
 } chute_t;
 
+/*
+	An outstanding automatic call; the response with the xid is delivered to the
+	chute, or completes the asynchronous call request.
+*/
+typedef struct xc_slot {
+	int		state;							// XC_ constant; changed only with atomics
+	unsigned char	xid[RMR_MAX_XID];
+	chute_t*	chute;
+	void*		areq;						// asynchronous call request (nil for a waiting caller)
+} xc_slot_t;
+
 
 // -------------- common static prototypes --------------------------------------
 
@@ -295,6 +295,7 @@ extern int rmr_set_trace( rmr_mbuf_t* msg, unsigned const char* data, int size )
 	int		len;
 	void*	old_tp_buf;		// if we need to realloc, must hold old to free
 	void*	old_hdr;
+	int		pooled;			// tp buffer pool flag of the original message
 
 	if( msg == NULL ) {
 		errno = EINVAL;
@@ -327,6 +328,9 @@ extern int rmr_set_trace( rmr_mbuf_t* msg, unsigned const char* data, int size )
 
 		nm->tp_buf = old_tp_buf;				// set to free; point to the small buffer
 		nm->header = old_hdr;					// nano frees on hdr, so must set both
+		pooled = msg->flags & MFL_TPMASK;		// buffers were swapped, so must the note of where each came from
+		msg->flags = (msg->flags & ~MFL_TPMASK) | (nm->flags & MFL_TPMASK);
+		nm->flags = (nm->flags & ~MFL_TPMASK) | pooled;
 		rmr_free_msg( nm );
 
 		hdr = (uta_mhdr_t *) msg->header;		// header WILL be different
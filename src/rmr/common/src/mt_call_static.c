@@ -64,6 +64,7 @@ static int init_mtcall( uta_ctx_t*	ctx ) {
 	if( chutes == NULL ) {
 		return 0;
 	}
+	memset( chutes, 0, sizeof( chute_t ) * (MAX_CALL_ID+1) );
 
 	for( i = 0; i < MAX_CALL_ID; i++ ) {				// initialise all of the semaphores
 		chutes[i].mbuf = NULL;
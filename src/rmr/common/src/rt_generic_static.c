@@ -46,6 +46,7 @@
 #include <unistd.h>
 #include <netdb.h>
 #include <pthread.h>
+#include <sched.h>
 #include <immintrin.h>
 #include <stdbool.h>
 
@@ -218,7 +219,7 @@ static void  rt_epcounts( route_table_t* rt, char* id ) {
 
 static void dump_tables( uta_ctx_t *ctx ) {
 	if( ctx->old_rtable != NULL ) {
-		rmr_vlog_force( RMR_VL_DEBUG, "old route table: (ref_count=%d)\n", ctx->old_rtable->ref_count );
+		rmr_vlog_force( RMR_VL_DEBUG, "old route table: (retires at epoch %llu)\n", (unsigned long long) ctx->rt_retire );
 		rt_stats( ctx->old_rtable );
 	} else {
 		rmr_vlog_force( RMR_VL_DEBUG, "old route table was empty\n" );
@@ -451,21 +452,22 @@ static char* ensure_nlterm( char* buf ) {
 }
 
 /*
-	Roll the new table into the active and the active into the old table. We
-	must have the lock on the active table to do this. It's possible that there
-	is no active table (first load), so we have to account for that (no locking).
+	Roll the new table into the active and the active into the old table. The
+	lock serialises the writers; readers do not take it (see get_rt()). The new
+	table is published with a single store, then the epoch is bumped; the old
+	table may not be reused until every reader has left the epochs before the
+	bump (see rt_quiesce()). It's possible that there is no active table (first
+	load), so we have to account for that.
 */
 static void roll_tables( uta_ctx_t* ctx ) {
 	pthread_mutex_lock( ctx->rtgate );				// must hold lock to move to active
 	if( ctx->new_rtable == NULL || ctx->new_rtable->error ) {
 		rmr_vlog( RMR_VL_WARN, "new route table NOT rolled in: nil pointer or error indicated\n" );
-		ctx->old_rtable = ctx->new_rtable;
-	}else if( ctx->rtable != NULL ) {							// initially there isn't one, so must check!
-		ctx->old_rtable = ctx->rtable;					// currently active becomes old and allowed to 'drain'
-		ctx->rtable = ctx->new_rtable;					// one we've been adding to becomes active
+		ctx->old_rtable = ctx->new_rtable;			// never published, so no reader can hold it
 	} else {
-		ctx->old_rtable = NULL;						// ensure there isn't an old reference
-		ctx->rtable = ctx->new_rtable;				// make new the active one
+		ctx->old_rtable = ctx->rtable;				// currently active (nil on first load) becomes old and allowed to 'drain'
+		__atomic_store_n( &ctx->rtable, ctx->new_rtable, __ATOMIC_SEQ_CST );		// one we've been adding to becomes active
+		ctx->rt_retire = __atomic_add_fetch( &ctx->rt_epoch, 1, __ATOMIC_SEQ_CST ) + 1;	// readers pin epoch+1 (0 means not reading)
 	}
 	ctx->new_rtable = NULL;
 	pthread_mutex_unlock( ctx->rtgate );
@@ -555,6 +557,145 @@ static rtable_ent_t* uta_add_rte( route_table_t* rt, uint64_t key, int nrrgroups
 	return rte;
 }
 
+/*
+	Return the selection policy named by a marker token which may start an
+	endpoint group, or -1 if the token is not a marker (it is an endpoint).
+	For %hash the key named in parens (meid if not given) is put in *key.
+*/
+static int rrg_policy( char const* tok, int* key ) {
+	if( tok == NULL || *tok != '%' ) {
+		return -1;
+	}
+
+	if( strncmp( tok, "%hash", 5 ) == 0 && (tok[5] == 0 || tok[5] == '(') ) {
+		*key = RMR_SHARD_MEID;
+		if( strcmp( tok + 5, "(xid)" ) == 0 ) {
+			*key = RMR_SHARD_XID;
+		} else {
+			if( strcmp( tok + 5, "(subid)" ) == 0 ) {
+				*key = RMR_SHARD_SUBID;
+			} else {
+				if( tok[5] != 0 && strcmp( tok + 5, "(meid)" ) != 0 ) {
+					rmr_vlog( RMR_VL_WARN, "route table: unknown hash key: %s; meid used\n", tok );
+				}
+			}
+		}
+		return RRG_HASH;
+	}
+
+	if( strcmp( tok, "%bcast" ) == 0 ) {
+		return RRG_BCAST;
+	}
+	if( strcmp( tok, "%wrr" ) == 0 ) {
+		return RRG_WRR;
+	}
+	if( strcmp( tok, "%lo" ) == 0 ) {
+		return RRG_LO;
+	}
+	if( strcmp( tok, "%p2c" ) == 0 ) {
+		return RRG_P2C;
+	}
+
+	return -1;
+}
+
+/*
+	FNV-1a hash of a string, starting from the given basis.
+*/
+static uint32_t rrg_hash_name( char const* s, uint32_t h ) {
+	while( *s ) {
+		h ^= (unsigned char) *(s++);
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/*
+	Build the maglev lookup table for a consistent hash group. Each endpoint has
+	a preferred order of the slots (a permutation derived only from its name);
+	the endpoints take turns claiming the next free slot in their order until
+	all are taken. Every endpoint gets nearly the same share, and because the
+	orders do not depend on the other members, adding or removing one endpoint
+	in a table update moves few keys between the endpoints that remain.
+*/
+static void rrg_build_lookup( rrgroup_t* rrg ) {
+	uint32_t	offset[MAX_EP_GROUP];
+	uint32_t	skip[MAX_EP_GROUP];
+	uint32_t	next[MAX_EP_GROUP];
+	uint32_t	c;
+	int			filled = 0;
+	int			i;
+
+	if( rrg == NULL || rrg->nused <= 0 ) {
+		return;
+	}
+
+	if( (rrg->lookup = (unsigned char *) malloc( RRG_HASH_SLOTS )) == NULL ) {
+		return;												// selection falls back to plain round robin
+	}
+	memset( rrg->lookup, 0xff, RRG_HASH_SLOTS );
+
+	for( i = 0; i < rrg->nused; i++ ) {
+		offset[i] = rrg_hash_name( rrg->epts[i]->name, 2166136261U ) % RRG_HASH_SLOTS;
+		skip[i] = (rrg_hash_name( rrg->epts[i]->name, 0x9747b28cU ) % (RRG_HASH_SLOTS - 1)) + 1;
+		next[i] = 0;
+	}
+
+	while( filled < RRG_HASH_SLOTS ) {
+		for( i = 0; i < rrg->nused && filled < RRG_HASH_SLOTS; i++ ) {
+			do {
+				c = (uint32_t) ((offset[i] + ((uint64_t) next[i] * skip[i])) % RRG_HASH_SLOTS);
+				next[i]++;
+			} while( rrg->lookup[c] != 0xff );
+			rrg->lookup[c] = (unsigned char) i;
+			filled++;
+		}
+	}
+}
+
+/*
+	Build the smooth weighted round robin schedule for a group: each turn every
+	endpoint's current value grows by its weight and the endpoint with the largest
+	value is picked, and reduced by the total. A 3:1 pair gives a a b a rather than
+	a a a b. Senders walk the schedule with an atomic cursor, so selection needs
+	neither a lock nor shared per endpoint state.
+*/
+static void rrg_build_sched( rrgroup_t* rrg ) {
+	int		cur[MAX_EP_GROUP];
+	int		total = 0;
+	int		best;
+	int		i;
+	int		n;
+
+	if( rrg == NULL || rrg->weights == NULL || rrg->nused <= 0 ) {
+		return;
+	}
+
+	for( i = 0; i < rrg->nused; i++ ) {
+		total += rrg->weights[i];
+		cur[i] = 0;
+	}
+	if( (rrg->sched = (unsigned char *) malloc( total )) == NULL ) {
+		return;												// selection falls back to plain round robin
+	}
+
+	for( n = 0; n < total; n++ ) {
+		best = 0;
+		for( i = 0; i < rrg->nused; i++ ) {
+			cur[i] += rrg->weights[i];
+			if( cur[i] > cur[best] ) {
+				best = i;
+			}
+		}
+		cur[best] -= total;
+		rrg->sched[n] = (unsigned char) best;
+	}
+	rrg->nsched = total;
+}
+
+static int is_this_myip( if_addrs_t* l, char* addr );		// tools_static.c is included after this module
+
 /*
 	This accepts partially parsed information from an rte or mse record sent by route manager or read from
 	a file such that:
@@ -581,6 +722,14 @@ static void build_entry( uta_ctx_t* ctx, char* ts_field, uint32_t subid, char* r
 	int		grp;				// index into group list
 	int		cgidx;				// contiguous group index (prevents the addition of a contiguous group without ep)
 	int		has_ep = FALSE;		// indicates if an endpoint was added in a given round robin group
+	int		weight;
+	int		first;				// first endpoint token in the group (past a policy marker)
+	int		policy;				// endpoint selection policy for the group
+	int		hash_key = 0;		// message key for a consistent hash group
+	int		weights[MAX_EP_GROUP];	// weight of each endpoint added to the group
+	char*	wtok;				// weight (name=weight) in an endpoint token
+	rrgroup_t*	rrg;
+	endpoint_t*	ep;
 
 	ts_field = clip( ts_field );				// ditch extra whitespace and trailing comments
 	rr_field = clip( rr_field );
@@ -604,14 +753,44 @@ static void build_entry( uta_ctx_t* ctx, char* ts_field, uint32_t subid, char* r
 				int		i;					// avoid sonar grumbling by defining this here
 
 				if( (ntoks = uta_rmip_tokenise( gtokens[grp], ctx->ip_list, tokens, 64, ',' )) > 0 ) {		// remove any references to our ip addrs
-					for( i = 0; i < ntoks; i++ ) {
-						if( strcmp( tokens[i], ctx->my_name ) != 0 ) {					// don't add if it is us -- cannot send to ourself
+					if( (policy = rrg_policy( tokens[0], &hash_key )) >= 0 ) {						// group has a selection policy other than round robin
+						first = 1;
+					} else {
+						policy = RRG_RR;
+						first = 0;
+					}
+					for( i = first; i < ntoks; i++ ) {
+						weight = 1;
+						if( (wtok = strchr( tokens[i], '=' )) != NULL ) {				// name=weight
+							*(wtok++) = 0;
+							weight = atoi( wtok );
+							if( weight < 1 || weight > RRG_MAX_WEIGHT ) {
+								rmr_vlog( RMR_VL_WARN, "route table entry for mtype=%s: bad weight for %s (%s); using 1\n", ts_field, tokens[i], wtok );
+								weight = 1;
+							}
+						}
+
+						if( strcmp( tokens[i], ctx->my_name ) != 0 &&					// don't add if it is us -- cannot send to ourself
+							(wtok == NULL || ! is_this_myip( ctx->ip_list, tokens[i] )) ) {	// weighted names escaped the ip prune above
 							if( DEBUG > 1  || (vlevel > 1)) rmr_vlog_force( RMR_VL_DEBUG, "add endpoint  ts=%s %s\n", ts_field, tokens[i] );
-							uta_add_ep( ctx->new_rtable, rte, tokens[i], cgidx );
+							if( (ep = uta_add_ep( ctx->new_rtable, rte, tokens[i], cgidx )) != NULL ) {
+								weights[rte->rrgroups[cgidx]->nused - 1] = weight;
+							}
 							has_ep = TRUE;
 						}
 					}
 					if( has_ep ) {
+						if( (rrg = rte->rrgroups[cgidx]) != NULL ) {
+							rrg->policy = policy;
+							if( policy == RRG_WRR && (rrg->weights = (int *) malloc( sizeof( int ) * rrg->nused )) != NULL ) {
+								memcpy( rrg->weights, weights, sizeof( int ) * rrg->nused );
+								rrg_build_sched( rrg );
+							}
+							if( policy == RRG_HASH ) {
+								rrg->hash_key = hash_key;
+								rrg_build_lookup( rrg );
+							}
+						}
 						cgidx++;	// only increment to the next contiguous group if the current one has at least one endpoint
 						has_ep = FALSE;
 					}
@@ -795,7 +974,7 @@ static void meid_parser( uta_ctx_t* ctx, uta_ctx_t* pctx, rmr_mbuf_t* mbuf, char
 
 					if( vlevel > 0 ) {
 						if( ctx->old_rtable != NULL ) {
-							rmr_vlog_force( RMR_VL_DEBUG, "old route table: (ref_count=%d)\n", ctx->old_rtable->ref_count );
+							rmr_vlog_force( RMR_VL_DEBUG, "old route table: (retires at epoch %llu)\n", (unsigned long long) ctx->rt_retire );
 							rt_stats( ctx->old_rtable );
 						} else {
 							rmr_vlog_force( RMR_VL_DEBUG, "old route table was empty\n" );
@@ -928,6 +1107,15 @@ static void cycle_snarfed_rt( uta_ctx_t* ctx ) {
 		mse|<mtype>[,sender]|<sub-id>|<endpoint-grp>[;<endpoint-grp>,...]
 		mse| <mtype>[,sender] | <sub-id> | %meid
 
+	An endpoint group may start with a marker which sets how an endpoint is
+	selected for each message (round robin if there is no marker):
+		%bcast	every endpoint (e.g. %bcast,app1:4560,app2:4560)
+		%wrr	smooth weighted round robin; endpoints may be given as name=weight
+		%lo		least outstanding: the endpoint with the least queued to it
+		%p2c	the less loaded of two endpoints picked at random
+		%hash(key)	consistent hash of the message's meid, xid (up to the first
+				colon) or subid; a key always goes to the same endpoint
+
 
 	For a meid map update we expect:
 		meid_map | start | <table-id>
@@ -1270,6 +1458,9 @@ static void del_rte( void* st, void* entry, char const* name, void* thing, void*
 		for( i = 0; i < rte->nrrgroups; i++ ) {
 			if( rte->rrgroups[i] ) {
 				free( rte->rrgroups[i]->epts );			// ditch list of endpoint pointers (end points are reused; don't trash them)
+				free( rte->rrgroups[i]->weights );
+				free( rte->rrgroups[i]->sched );
+				free( rte->rrgroups[i]->lookup );
 				free( rte->rrgroups[i] );				// but must free the rrg itself too
 			}
 
@@ -1488,9 +1679,11 @@ static route_table_t* uta_rt_clone( uta_ctx_t* ctx, route_table_t* srt, route_ta
 	return drt;
 }
 
+static void rt_quiesce( uta_ctx_t* ctx, uint64_t epoch );		// defined with the reader functions below
+
 /*
 	Prepares the "new" route table for populating. If the old_rtable is not nil, then
-	we wait for it's use count to reach 0. Then the table is cleared, and moved on the
+	we wait for the readers which might hold it to finish. Then the table is cleared, and moved on the
 	context to be referenced by the new pointer; the old pointer is set to nil.
 
 	If the old table doesn't exist, then a new table is created and the new pointer is
@@ -1500,7 +1693,6 @@ static route_table_t* uta_rt_clone( uta_ctx_t* ctx, route_table_t* srt, route_ta
 	do not need to run that portion of the table to deref like we do for the RTEs.
 */
 static route_table_t* prep_new_rt( uta_ctx_t* ctx, int all ) {
-	//int counter = 0;
 	route_table_t*	rt;
 
 	if( ctx == NULL ) {
@@ -1511,17 +1703,7 @@ static route_table_t* prep_new_rt( uta_ctx_t* ctx, int all ) {
 	if( (rt = ctx->old_rtable) != NULL ) {
 		ctx->old_rtable = NULL;
 
-		while(  rt->ref_count > 0 ) {				// wait for all who are using to stop
-			//if( counter++ > 1000 ) {
-			//	rmr_vlog( RMR_VL_WARN, "rt_prep_newrt:  internal mishap, ref count on table seems wedged" );
-			//	break;
-			//}
-
-			pthread_mutex_unlock( ctx->rtgate );
-			usleep( 1000 );						// small sleep to yield the processer if that is needed
-			pthread_mutex_lock( ctx->rtgate );
-
-		}
+		rt_quiesce( ctx, ctx->rt_retire );				// wait for all who might be using it to stop
 
 		if( rt->hash != NULL ) {
 			rmr_sym_foreach_class( rt->hash, 0, del_rte, NULL );		// deref and drop if needed
@@ -1535,9 +1717,7 @@ static route_table_t* prep_new_rt( uta_ctx_t* ctx, int all ) {
 	pthread_mutex_unlock( ctx->rtgate );
 
 	rt = uta_rt_clone( ctx, ctx->rtable, rt, all );		// also sets the ephash pointer
-	if( rt != NULL ) {									// very small chance for nil, but not zero, so test
-		rt->ref_count = 0;								// take no chances; ensure it's 0!
-	} else {
+	if( rt == NULL ) {									// very small chance for nil, but not zero, so test
 		rmr_vlog( RMR_VL_ERR, "route table clone returned nil; marking dummy table as error\n" );
 		rt = uta_rt_init( ctx );						// must hav something, but mark it in error state
 		rt->error = 1;
@@ -1593,13 +1773,13 @@ static endpoint_t* rt_ensure_ep( route_table_t* rt, char const* ep_name ) {
 			errno = ENOMEM;
 			return NULL;
 		}
+		memset( ep, 0, sizeof( *ep ) );				// transport specific fields (e.g. flow control) must start clear
 
 		ep->notify = 1;								// show notification on first connection failure
 		ep->open = 0;								// not connected
 		ep->addr = uta_h2ip( ep_name );
 		ep->name = strdup( ep_name );
 		pthread_mutex_init( &ep->gate, NULL );		// init with default attrs
-		memset( &ep->scounts[0], 0, sizeof( ep->scounts ) );
 
 		rmr_sym_put( rt->ephash, ep_name, 1, ep );
 	}
@@ -1638,51 +1818,131 @@ static inline endpoint_t*  get_meid_owner( route_table_t *rt, char const* meid )
 	return (endpoint_t *) rmr_sym_get( rt->hash, meid, RT_ME_SPACE );
 }
 
+static uint64_t rt_next_id = 0;					// source of context ids for the reader cache
+static __thread rt_reader_t*	rt_me = NULL;		// this thread's reader record for the context...
+static __thread uint64_t		rt_me_id = 0;		// ...with this id
+
 /*
-	This returns a pointer to the currently active route table and ups
-	the reference count so that the route table is not freed while it
-	is being used. The caller MUST call release_rt() when finished
-	with the pointer.
+	Return the calling thread's reader record for the context, adding one if
+	this is the thread's first use of the context's route table. The record
+	last used is cached per thread, so the usual case touches nothing shared
+	(the cache is keyed on an id rather than the context pointer as a freed
+	context's memory may be reused for a new one). Nil is returned if a record
+	cannot be allocated.
+*/
+static rt_reader_t* rt_reader( uta_ctx_t* ctx ) {
+	rt_reader_t*	r;
+	uint64_t		id;
+	uint64_t		expect = 0;
+	pthread_t		me;
+
+	if( (id = __atomic_load_n( &ctx->rt_id, __ATOMIC_ACQUIRE )) == 0 ) {
+		id = __atomic_add_fetch( &rt_next_id, 1, __ATOMIC_RELAXED );
+		if( ! __atomic_compare_exchange_n( &ctx->rt_id, &expect, id, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+			id = expect;										// another thread named it first
+		}
+	}
+	if( rt_me_id == id ) {
+		return rt_me;
+	}
 
-	Care must be taken: the ctx->rtable pointer _could_ change during the time
-	between the release of the lock and the return. Therefore we MUST grab
-	the current pointer when we have the lock so that if it does we don't
-	return a pointer to the wrong table.
+	me = pthread_self();
+	for( r = __atomic_load_n( &ctx->rt_readers, __ATOMIC_ACQUIRE ); r != NULL; r = r->next ) {
+		if( pthread_equal( r->owner, me ) ) {
+			break;
+		}
+	}
+
+	if( r == NULL ) {
+		if( posix_memalign( (void **) &r, sizeof( *r ), sizeof( *r ) ) != 0 ) {
+			return NULL;
+		}
+		memset( r, 0, sizeof( *r ) );
+		r->owner = me;
+		r->next = __atomic_load_n( &ctx->rt_readers, __ATOMIC_ACQUIRE );
+		while( ! __atomic_compare_exchange_n( &ctx->rt_readers, &r->next, r, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE ) );
+	}
+
+	rt_me = r;
+	rt_me_id = id;
+	return r;
+}
+
+/*
+	Wait until no reader is in an epoch before the one given; once this returns
+	a table that was replaced before that epoch began is not referenced by any
+	reader and may be cleared or freed. A reader which pins the table after the
+	wait started sees the newer table and is not waited for.
+*/
+static void rt_quiesce( uta_ctx_t* ctx, uint64_t epoch ) {
+	rt_reader_t*	r;
+	uint64_t		pinned;
+
+	if( ctx == NULL ) {
+		return;
+	}
+
+	__atomic_thread_fence( __ATOMIC_SEQ_CST );				// pairs with the fence in get_rt()
+	for( r = __atomic_load_n( &ctx->rt_readers, __ATOMIC_ACQUIRE ); r != NULL; r = r->next ) {
+		while( (pinned = __atomic_load_n( &r->epoch, __ATOMIC_ACQUIRE )) != 0 && pinned < epoch ) {
+			sched_yield();
+		}
+	}
+}
+
+/*
+	This returns a pointer to the currently active route table and pins it so
+	that the table is not reused or freed while it is being used. The caller
+	MUST call release_rt(), on the same thread, when finished with the pointer.
+
+	No lock is taken: the thread records the current epoch in its own reader
+	record (see rt_reader()), then loads the table pointer. The thread rolling
+	in a new table publishes it, bumps the epoch, and waits for readers of older
+	epochs before it reuses the old table. Calls may nest; the outer call's
+	epoch stands until the outer release.
 
 	This will return NULL if there is no active table.
 */
 static inline route_table_t* get_rt( uta_ctx_t* ctx ) {
-	route_table_t*	rrt;			// return value
+	rt_reader_t*	r;
 
-	if( ctx == NULL || ctx->rtable == NULL ) {
+	if( ctx == NULL || __atomic_load_n( &ctx->rtable, __ATOMIC_ACQUIRE ) == NULL ) {
 		return NULL;
 	}
 
-	pthread_mutex_lock( ctx->rtgate );				// must hold lock to bump use
-	rrt = ctx->rtable;								// must stash the pointer while we hold lock
-	rrt->ref_count++;
-	pthread_mutex_unlock( ctx->rtgate );
+	if( (r = rt_reader( ctx )) == NULL ) {
+		return NULL;
+	}
+
+	if( r->depth++ == 0 ) {
+		__atomic_store_n( &r->epoch, __atomic_load_n( &ctx->rt_epoch, __ATOMIC_ACQUIRE ) + 1, __ATOMIC_RELAXED );
+		__atomic_thread_fence( __ATOMIC_SEQ_CST );					// epoch must be visible before we look at the table
+	}
 
-	return rrt;										// pointer we upped the count with
+	return __atomic_load_n( &ctx->rtable, __ATOMIC_ACQUIRE );
 }
 
 /*
-	This will "release" the route table by reducing the use counter
-	in the table. The table may not be freed until the counter reaches
-	0, so it's imparative that the pointer be "released" when it is
-	fetched by get_rt().  Once the caller has released the table it
-	may not safely use the pointer that it had.
+	This will "release" the route table pinned by get_rt(). The table may not be
+	reused until all readers which might hold it have released it, so it's
+	imparative that the pointer be "released" when it is fetched by get_rt().
+	Once the caller has released the table it may not safely use the pointer
+	that it had.
 */
 static inline void release_rt( uta_ctx_t* ctx, route_table_t* rt ) {
+	rt_reader_t*	r;
+
 	if( ctx == NULL || rt == NULL ) {
 		return;
 	}
 
-	pthread_mutex_lock( ctx->rtgate );				// must hold lock
-	if( rt->ref_count > 0 ) {						// something smells if it's already 0, don't do antyhing if it is
-		rt->ref_count--;
+	if( (r = rt_reader( ctx )) == NULL || r->depth <= 0 ) {		// something smells if not pinned, don't do anything
+		return;
+	}
+
+	if( --r->depth == 0 ) {
+		__atomic_store_n( &r->epoch, 0, __ATOMIC_RELEASE );
 	}
-	pthread_mutex_unlock( ctx->rtgate );
 }
 
 #endif
@@ -33,6 +33,25 @@ Abstract:	Symbol table -- slightly streamlined from it's original 2000 version
 				  incorporated into the RIC msg routing library and will be
 				  available to user applications.
 
+			The table is open addressed in the style of a "Swiss" table.
+			Entries (key, cached hash, value) live in one array; a parallel
+			array holds a control byte per slot: empty, deleted, or the low
+			7 bits of the entry's hash. Slots are probed a group of eight at
+			a time; the group's control bytes are one 64 bit word, so the
+			candidates for a key are found with a few word operations and
+			only those entries are touched. The hash is cached so a string
+			compare is done only when the whole hash matches. The table
+			doubles when it becomes 7/8 full; the size given at allocation
+			is just a hint.
+
+			Readers may run concurrently with a single writer (this was true
+			of the chained table, and some callers count on it). An entry is
+			filled before its control byte is set, and slot arrays replaced
+			when the table grows are not freed until the table is, so a reader
+			never touches freed slots; like before, a reader racing a change
+			may or may not see it. Deleted slots are reclaimed in place (see
+			sym_reclaim()) so that add/delete churn does not retire arrays.
+
 			There is NO logging from this module!  The caller is asusmed to
 			report any failures as it might handle them making any error messages
 			generated here misleading if not incorrect.
@@ -43,6 +62,8 @@ Author:		E. Scott Daniels
 Mod:		2016 23 Feb - converted Symtab refs so that caller need only a
 				void pointer to use and struct does not need to be exposed.
 			2018 30 Nov - Augmented from original form (see above).
+			2026 19 Oct - Chained buckets replaced with an open addressing
+				table (see below).
 ------------------------------------------------------------------------------
 */
 
@@ -51,6 +72,7 @@ Mod:		2016 23 Feb - converted Symtab refs so that caller need only a
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <memory.h>
 #include <netdb.h>
 #include <pthread.h>
@@ -59,117 +81,334 @@ Mod:		2016 23 Feb - converted Symtab refs so that caller need only a
 
 //-----------------------------------------------------------------------------------------------
 
+#define SYM_EMPTY	0x80				// control byte: slot never used since the last resize
+#define SYM_DELETED	0xfe				// control byte: entry deleted; probes must continue past it
+#define SYM_GROUP	8					// slots probed together; one 64 bit word of control bytes
+
+#define SYM_LO		0x0101010101010101ULL
+#define SYM_HI		0x8080808080808080ULL
+
 typedef struct Sym_ele
 {
-	struct Sym_ele *next;   /* pointer at next element in list */
-	struct Sym_ele *prev;   /* larger table, easier deletes */
-	const char *name;		/* symbol name */
-	uint64_t nkey;			// the numeric key
-	void *val;              /* user data associated with name */
-	unsigned long mcount;   /* modificaitons to value */
-	unsigned long rcount;   /* references to symbol */
-	//unsigned int flags;
-	unsigned int class;		/* helps divide things up and allows for duplicate names */
+	uint64_t	hash;			// cached hash of key and class
+	union {
+		const char*	name;		// symbol name (class > 0)
+		uint64_t	nkey;		// the numeric key (class 0)
+	} key;
+	void*		val;			// user data associated with name
+	unsigned int class;			// helps divide things up and allows for duplicate names
+	unsigned int mcount;		// modificaitons to value
 } Sym_ele;
 
+/*
+	A set of slots: the control bytes followed by the entries, in one allocation.
+*/
+typedef struct Sym_slots {
+	long		size;					// number of slots; a power of two
+	uint8_t*	ctrl;					// control byte for each slot
+	Sym_ele*	eles;					// the entries
+	struct Sym_slots* retired;			// smaller slot sets replaced when the table grew; freed with the table
+} Sym_slots;
+
 typedef struct Sym_tab {
-	Sym_ele **symlist;			/* pointer to list of element pointerss */
-	long	inhabitants;		/* number of active residents */
-	long	deaths;				/* number of deletes */
-	long	size;
+	Sym_slots*	slots;			// current slot set
+	long	inhabitants;		// number of active residents
+	long	tombstones;			// deleted slots not yet reclaimed
+	long	deaths;				// number of deletes
 } Sym_tab;
 
 // -------------------- internal ------------------------------------------------------------------
 
-static int sym_hash( const char *n, long size )
-{
-	const char *p;
-	long t = 0;
+/*
+	Final mix (murmur3) so that every bit of the input affects the low bits
+	used to pick a group and the bits kept in the control byte.
+*/
+static inline uint64_t sym_mix( uint64_t h ) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
 
-	for( p = n; *p; p++ )      /* a bit of magic */
-		t = (t * 79 ) + *p;
+/*
+	Hash a string key, eight bytes at a time. The class is folded in so that
+	the same name in different classes lands in different places.
+*/
+static uint64_t sym_hash( const char *n, unsigned int class ) {
+	uint64_t	h;
+	uint64_t	w;
+	size_t		len;
+
+	len = strlen( n );
+	h = 0x9e3779b97f4a7c15ULL ^ ((uint64_t) class << 32) ^ len;
+
+	for( ; len >= 8; len -= 8, n += 8 ) {
+		memcpy( &w, n, 8 );
+		h ^= w * 0x87c37b91114253d5ULL;
+		h = ((h << 31) | (h >> 33)) * 0x9e3779b97f4a7c15ULL;
+	}
+	if( len > 0 ) {
+		w = 0;
+		memcpy( &w, n, len );
+		h ^= w * 0x87c37b91114253d5ULL;
+	}
 
-	if( t < 0 )
-		t = ~t;
+	return sym_mix( h );
+}
 
-	return (int ) (t % size);
+/*
+	Hash a numeric key.
+*/
+static inline uint64_t sym_nhash( uint64_t nkey ) {
+	return sym_mix( nkey + 0x9e3779b97f4a7c15ULL );
 }
 
 /*
-	Delete element pointed to by eptr which is assumed to be
-	a member of the list at symtab[i].
+	Return the control bytes of a group as a word, first slot in the low byte.
 */
-static void del_ele( Sym_tab *table, int hv, Sym_ele *eptr )
-{
-	Sym_ele **sym_tab;
+static inline uint64_t sym_group( Sym_slots* sl, long g ) {
+	uint64_t	w;
 
-	sym_tab = table->symlist;
+	w = __atomic_load_n( (uint64_t *) (sl->ctrl + g * SYM_GROUP), __ATOMIC_ACQUIRE );
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	w = __builtin_bswap64( w );
+#endif
 
-	if( eptr )         /* unchain it */
-	{
-		if( eptr->prev )
-			eptr->prev->next = eptr->next;
-		else
-			sym_tab[hv] = eptr->next;
+	return w;
+}
+
+/*
+	Return a word with the high bit set in each byte of the group word which
+	equals the byte given. A byte just above a match may be falsely flagged
+	(borrow); callers either check the entry or look for bytes which can
+	not be so flagged.
+*/
+static inline uint64_t sym_match( uint64_t w, uint8_t b ) {
+	w ^= SYM_LO * b;
+	return (w - SYM_LO) & ~w & SYM_HI;
+}
+
+/*
+	Return the slot of the first flagged byte in the match word.
+*/
+static inline long sym_first( uint64_t m ) {
+	return __builtin_ctzll( m ) >> 3;
+}
 
-		if( eptr->next )
-			eptr->next->prev = eptr->prev;
+/*
+	Find the slot with the key; returns -1 if it is not in the table. Name is
+	used for string keys (class > 0) and nkey for numeric keys.
+*/
+static long sym_find( Sym_slots* sl, uint64_t hash, const char *name, uint64_t nkey, unsigned int class ) {
+	Sym_ele*	eptr;
+	uint64_t	w;
+	uint64_t	m;
+	long		gmask;
+	long		g;
+	long		step;
+	long		i;
+
+	gmask = (sl->size / SYM_GROUP) - 1;
+	g = (long) (hash >> 7) & gmask;
+	for( step = 1; step <= gmask + 1; step++ ) {				// triangular steps visit every group
+		w = sym_group( sl, g );
+		for( m = sym_match( w, (uint8_t) (hash & 0x7f) ); m; m &= m - 1 ) {
+			i = (g * SYM_GROUP) + sym_first( m );
+			eptr = &sl->eles[i];
+			if( eptr->hash == hash && eptr->class == class ) {
+				if( class ? strcmp( eptr->key.name, name ) == 0 : eptr->key.nkey == nkey ) {
+					return i;
+				}
+			}
+		}
 
-		if( eptr->class && eptr->name ) {				// class 0 entries are numeric, so name is NOT a pointer
-			free( (void *) eptr->name );			// and if free fails, what?  panic?
+		if( sym_match( w, SYM_EMPTY ) ) {						// an empty slot ends the probe; key would have been put there
+			return -1;
 		}
+		g = (g + step) & gmask;
+	}
 
-		free( eptr );
+	return -1;
+}
 
-		table->deaths++;
-		table->inhabitants--;
+/*
+	Return the first slot, empty or deleted, where an entry with the hash can
+	be put. There must be one (the table is never allowed to fill).
+*/
+static long sym_free_slot( Sym_slots* sl, uint64_t hash ) {
+	uint64_t	m;
+	long		gmask;
+	long		g;
+	long		step;
+
+	gmask = (sl->size / SYM_GROUP) - 1;
+	g = (long) (hash >> 7) & gmask;
+	for( step = 1; ; step++ ) {
+		if( (m = sym_group( sl, g ) & SYM_HI) != 0 ) {			// empty and deleted have the high bit; used slots do not
+			return (g * SYM_GROUP) + sym_first( m );
+		}
+		g = (g + step) & gmask;
 	}
 }
 
 /*
-	Delete the head element from table[i]. This isn't really
-	needed, but keeps code analysers from claiming that memory
-	is being used after it is freed.
+	Allocate a set of slots, all empty.
 */
-static void del_head_ele( Sym_tab *table, int hv ) {
-	Sym_ele **sym_tab;
-	Sym_ele *eptr;		// first in list
+static Sym_slots* sym_mk_slots( long size ) {
+	Sym_slots*	sl;
 
+	if( (sl = (Sym_slots *) malloc( sizeof( *sl ) + size + (sizeof( Sym_ele ) * size) )) == NULL ) {
+		return NULL;
+	}
 
-	if( hv < 0 || hv >= table->size ) {
-		return;
+	sl->size = size;
+	sl->ctrl = (uint8_t *) (sl + 1);							// size is a multiple of 8, so entries are aligned
+	sl->eles = (Sym_ele *) (sl->ctrl + size);
+	sl->retired = NULL;
+	memset( sl->ctrl, SYM_EMPTY, size );
+
+	return sl;
+}
+
+/*
+	Return the first free slot on the probe path of the entry in slot i which
+	is in a group before the entry's own group, or -1 if there is none.
+*/
+static long sym_earlier( Sym_slots* sl, long i ) {
+	uint64_t	m;
+	long		gmask;
+	long		g;
+	long		step;
+
+	gmask = (sl->size / SYM_GROUP) - 1;
+	g = (long) (sl->eles[i].hash >> 7) & gmask;
+	for( step = 1; g != i / SYM_GROUP; step++ ) {				// the entry's group is on its path, so this ends
+		if( (m = sym_group( sl, g ) & SYM_HI) != 0 ) {
+			return (g * SYM_GROUP) + sym_first( m );
+		}
+		g = (g + step) & gmask;
 	}
 
-	sym_tab = table->symlist;
-	if( (eptr = sym_tab[hv]) != NULL )					// not an empty element; yank it off
-	{
-		if( (sym_tab[hv] = eptr->next) != NULL ) {		// bump list to next if not the only thing here
-			sym_tab[hv]->prev = NULL;					// new head
+	return -1;
+}
+
+/*
+	Reclaim the deleted slots without replacing the slot set. Entries are
+	moved to the first free slot on their probe path until none can move;
+	then no probe passes a group with a free slot, so every deleted slot
+	can be marked empty. A moved entry is copied before its old slot is
+	released, but a reader probing at that moment may miss it.
+*/
+static void sym_reclaim( Sym_tab *table ) {
+	Sym_slots*	sl;
+	long		moved;
+	long		i;
+	long		j;
+
+	sl = table->slots;
+	do {
+		moved = 0;
+		for( i = 0; i < sl->size; i++ ) {
+			if( sl->ctrl[i] < SYM_EMPTY && (j = sym_earlier( sl, i )) >= 0 ) {
+				sl->eles[j] = sl->eles[i];
+				__atomic_store_n( &sl->ctrl[j], sl->ctrl[i], __ATOMIC_RELEASE );
+				__atomic_store_n( &sl->ctrl[i], SYM_DELETED, __ATOMIC_RELEASE );
+				moved++;
+			}
 		}
-		eptr->next = NULL;								// take no chances
+	} while( moved );							// each move shortens a probe path, so this ends
 
-		if( eptr->class && eptr->name ) {				// class 0 entries are numeric, so name is NOT a pointer
-			free( (void *) eptr->name );
+	for( i = 0; i < sl->size; i++ ) {
+		if( sl->ctrl[i] == SYM_DELETED ) {
+			__atomic_store_n( &sl->ctrl[i], SYM_EMPTY, __ATOMIC_RELEASE );
 		}
+	}
 
-		free( eptr );
+	table->tombstones = 0;
+}
 
-		table->deaths++;
-		table->inhabitants--;
+/*
+	Make room: double the table if it is more than half full, otherwise
+	reclaim the deleted slots in place. When doubled the old set is kept
+	(see the note at the top); as each is half the size of the next, the
+	retired sets never total more than the current one. Returns -1 on failure.
+*/
+static int sym_resize( Sym_tab *table ) {
+	Sym_slots*	old;
+	Sym_slots*	sl;
+	long		size;
+	long		i;
+	long		j;
+
+	old = table->slots;
+	for( size = old->size; (table->inhabitants + 1) * 16 > size * 7; size <<= 1 );
+
+	if( size == old->size ) {
+		sym_reclaim( table );
+		return 0;
+	}
+
+	if( (sl = sym_mk_slots( size )) == NULL ) {
+		return -1;
+	}
+
+	for( i = 0; i < old->size; i++ ) {
+		if( old->ctrl[i] < SYM_EMPTY ) {
+			j = sym_free_slot( sl, old->eles[i].hash );
+			sl->eles[j] = old->eles[i];
+			sl->ctrl[j] = old->ctrl[i];
+		}
 	}
+
+	sl->retired = old;
+	table->tombstones = 0;
+	__atomic_store_n( &table->slots, sl, __ATOMIC_RELEASE );
+
+	return 0;
 }
 
 /*
-	Determine if these are the same.
+	Delete the entry in slot i. The slot can be marked empty only if its
+	group already has an empty slot: a group with one has never been full,
+	so no probe has gone past it. Otherwise it is marked deleted.
 */
-static inline int same( unsigned int c1, unsigned int c2, const char *s1, const char* s2 )
-{
-	if( c1 != c2 )
-		return 0;		/* different class - not the same */
+static void del_ele( Sym_tab *table, long i ) {
+	Sym_slots*	sl;
+	Sym_ele*	eptr;
 
-	if( *s1 == *s2 && strcmp( s1, s2 ) == 0 )
-		return 1;
-	return 0;
+	sl = table->slots;
+	eptr = &sl->eles[i];
+
+	if( sym_match( sym_group( sl, i / SYM_GROUP ), SYM_EMPTY ) ) {
+		__atomic_store_n( &sl->ctrl[i], SYM_EMPTY, __ATOMIC_RELEASE );
+	} else {
+		__atomic_store_n( &sl->ctrl[i], SYM_DELETED, __ATOMIC_RELEASE );
+		table->tombstones++;
+	}
+
+	if( eptr->class && eptr->key.name ) {				// class 0 entries are numeric, so name is NOT a pointer
+		free( (void *) eptr->key.name );
+	}
+	eptr->key.name = NULL;
+
+	table->deaths++;
+	table->inhabitants--;
+}
+
+/*
+	Hash the key. Class 0 keys are numeric and name points at the 64 bit key.
+*/
+static inline uint64_t key_hash( const char *name, unsigned int class, uint64_t* nkey ) {
+	if( class ) {
+		*nkey = 0;
+		return sym_hash( name, class );
+	}
+
+	*nkey = *((uint64_t *) name);
+	return sym_nhash( *nkey );
 }
 
 /*
@@ -178,54 +417,52 @@ static inline int same( unsigned int c1, unsigned int c2, const char *s1, const
 	much the same.
 */
 static int putin( Sym_tab *table, const char *name, unsigned int class, void *val ) {
-	Sym_ele *eptr;			/* pointer into hash table */
-	Sym_ele **sym_tab;		/* pointer into hash table */
-	int hv;                 /* hash value */
-	int rc = 0;             /* assume it existed */
-	uint64_t nkey = 0;		// numeric key if class == 0
-
-	sym_tab = table->symlist;
-
-	if( class ) {								// string key
-		hv = sym_hash( name, table->size );		// hash it
-		for( eptr=sym_tab[hv]; eptr && ! same( class, eptr->class, eptr->name, name); eptr=eptr->next );
-	} else {
-		nkey = *((uint64_t *) name);
-		hv = nkey % table->size;					// just hash the number
-		for( eptr=sym_tab[hv]; eptr && eptr->nkey != nkey; eptr=eptr->next );
+	Sym_slots*	sl;
+	Sym_ele*	eptr;
+	uint64_t	hash;
+	uint64_t	nkey;			// numeric key if class == 0
+	long		i;
+
+	hash = key_hash( name, class, &nkey );
+	sl = table->slots;
+
+	if( (i = sym_find( sl, hash, name, nkey, class )) >= 0 ) {		// existed; just replace the value
+		eptr = &sl->eles[i];
+		eptr->mcount++;
+		eptr->val = val;
+		return 0;
 	}
 
-	if( ! eptr ) {			// not found above, so add
-		rc++;
-		table->inhabitants++;
-
-		eptr = (Sym_ele *) malloc( sizeof( Sym_ele) );
-		if( ! eptr ) {
+	if( (table->inhabitants + table->tombstones + 1) * 8 > sl->size * 7 ) {		// keep at least 1/8 of the slots empty
+		if( sym_resize( table ) < 0 ) {
 			errno = ENOMEM;
 			return -1;
 		}
+		sl = table->slots;
+	}
 
-		eptr->prev = NULL;
-		eptr->class = class;
-		eptr->mcount = eptr->rcount = 0;	/* init counters */
-		eptr->val = NULL;
-		eptr->nkey = nkey;
-		if( class ) {
-			eptr->name = strdup( name );
-		} else {
-			eptr->name = NULL;				// for a numeric key, just save the value
+	i = sym_free_slot( sl, hash );
+	eptr = &sl->eles[i];
+	eptr->hash = hash;
+	eptr->class = class;
+	eptr->mcount = 1;
+	eptr->val = val;
+	if( class ) {
+		if( (eptr->key.name = strdup( name )) == NULL ) {
+			errno = ENOMEM;
+			return -1;
 		}
-		eptr->next = sym_tab[hv];			// add to head of list
-		sym_tab[hv] = eptr;
-		if( eptr->next )
-			eptr->next->prev = eptr;         /* chain back to new one */
+	} else {
+		eptr->key.nkey = nkey;						// for a numeric key, just save the value
 	}
 
-	eptr->mcount++;
-
-	eptr->val = val;
+	if( sl->ctrl[i] == SYM_DELETED ) {
+		table->tombstones--;
+	}
+	__atomic_store_n( &sl->ctrl[i], (uint8_t) (hash & 0x7f), __ATOMIC_RELEASE );		// entry is complete before it can be found
+	table->inhabitants++;
 
-	return rc;
+	return 1;
 }
 
 // -------------------- visible  ------------------------------------------------------------------
@@ -234,17 +471,26 @@ static int putin( Sym_tab *table, const char *name, unsigned int class, void *va
 extern void rmr_sym_clear( void *vtable )
 {
 	Sym_tab *table;
-	Sym_ele **sym_tab;
-	int i;
+	Sym_slots* sl;
+	long	i;
 
-	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
+	if( (table = (Sym_tab *) vtable) == NULL ) {
+		return;
+	}
 
-	for( i = 0; i < table->size; i++ ) {
-		while( sym_tab[i] ) {
-			del_head_ele( table, i );			// delete the head element (and keep bloody sonar from claiming use after free)
+	sl = table->slots;
+	for( i = 0; i < sl->size; i++ ) {
+		if( sl->ctrl[i] < SYM_EMPTY ) {
+			if( sl->eles[i].class ) {
+				free( (void *) sl->eles[i].key.name );
+			}
+			table->deaths++;
 		}
 	}
+
+	memset( sl->ctrl, SYM_EMPTY, sl->size );
+	table->inhabitants = 0;
+	table->tombstones = 0;
 }
 
 /*
@@ -252,6 +498,8 @@ extern void rmr_sym_clear( void *vtable )
 */
 extern void rmr_sym_free( void *vtable ) {
 	Sym_tab *table;
+	Sym_slots* sl;
+	Sym_slots* next;
 
 	table = (Sym_tab *) vtable;
 
@@ -259,44 +507,50 @@ extern void rmr_sym_free( void *vtable ) {
 		return;
 
 	rmr_sym_clear( vtable );
-	free( table->symlist );
+	for( sl = table->slots; sl != NULL; sl = next ) {
+		next = sl->retired;
+		free( sl );
+	}
 	free( table );
 }
 
 extern void rmr_sym_dump( void *vtable )
 {
 	Sym_tab *table;
-	int i;
+	Sym_slots* sl;
 	Sym_ele *eptr;
-	Sym_ele **sym_tab;
+	long	i;
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
-
-	for( i = 0; i < table->size; i++ ) {
-		if( sym_tab[i] ) {
-			for( eptr = sym_tab[i]; eptr; eptr = eptr->next ) {
-				if( eptr->val && eptr->class ) {
-					fprintf( stderr, "symtab dump: key=%s val@=%p\n", eptr->name, eptr->val );
-				} else {
-					fprintf( stderr, "symtab dump: nkey=%lu val@=%p\n", (unsigned long) eptr->nkey, eptr->val );
-				}
+	sl = table->slots;
+
+	for( i = 0; i < sl->size; i++ ) {
+		if( sl->ctrl[i] < SYM_EMPTY ) {
+			eptr = &sl->eles[i];
+			if( eptr->val && eptr->class ) {
+				fprintf( stderr, "symtab dump: key=%s val@=%p\n", eptr->key.name, eptr->val );
+			} else {
+				fprintf( stderr, "symtab dump: nkey=%lu val@=%p\n", (unsigned long) (eptr->class ? 0 : eptr->key.nkey), eptr->val );
 			}
 		}
 	}
 }
 
 /*
-	Allocate a table the size requested - best if size is prime.
+	Allocate a table able to hold the number of entries requested without
+	growing. The table grows as needed, so the size is only a hint.
 	Returns a pointer to the management block (handle) or NULL on failure.
 */
 extern void *rmr_sym_alloc( int size )
 {
 	Sym_tab *table;
+	long	nslots;
 
 	if( size < 11 )     /* provide a bit of sanity */
 		size = 11;
 
+	for( nslots = 16; nslots - (nslots / 8) < size; nslots <<= 1 );
+
 	if( (table = (Sym_tab *) malloc( sizeof( Sym_tab ))) == NULL )
 	{
 		errno = ENOMEM;
@@ -305,18 +559,13 @@ extern void *rmr_sym_alloc( int size )
 
 	memset( table, 0, sizeof( *table ) );
 
-	if((table->symlist = (Sym_ele **) malloc( sizeof( Sym_ele *) * size )))
-	{
-		memset( table->symlist, 0, sizeof( Sym_ele *) * size );
-		table->size = size;
-	}
-	else
-	{
+	if( (table->slots = sym_mk_slots( nslots )) == NULL ) {
+		free( table );
 		errno = ENOMEM;
 		return NULL;
 	}
 
-	return (void *) table;    /* user might want to know what the size is */
+	return (void *) table;
 }
 
 /*
@@ -325,24 +574,18 @@ extern void *rmr_sym_alloc( int size )
 extern void rmr_sym_del( void *vtable, const char *name, unsigned int class )
 {
 	Sym_tab	*table;
-	Sym_ele **sym_tab;
-	Sym_ele *eptr;			/* pointer into hash table */
-	int hv;                 /* hash value */
+	uint64_t	hash;
 	uint64_t	nkey;		// class 0, name points to integer not string
+	long		i;
 
-	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
-
-	if( class ) {
-		hv = sym_hash( name, table->size );
-		for(eptr=sym_tab[hv]; eptr &&  ! same(class, eptr->class, eptr->name, name); eptr=eptr->next );
-	} else {
-		nkey = *((uint64_t *) name);
-		hv = nkey % table->size;			// just hash the number
-		for( eptr=sym_tab[hv]; eptr && eptr->nkey != nkey; eptr=eptr->next );
+	if( (table = (Sym_tab *) vtable) == NULL ) {
+		return;
 	}
 
-	del_ele( table, hv, eptr );    /* ignors null ptr, so safe to always call */
+	hash = key_hash( name, class, &nkey );
+	if( (i = sym_find( table->slots, hash, name, nkey, class )) >= 0 ) {
+		del_ele( table, i );
+	}
 }
 
 /*
@@ -356,30 +599,19 @@ extern void rmr_sym_ndel(  void *vtable, uint64_t key ) {
 extern void *rmr_sym_get( void *vtable, const char *name, unsigned int class )
 {
 	Sym_tab	*table;
-	Sym_ele **sym_tab;
-	Sym_ele *eptr;			// element from table
-	int hv;                 // hash value of key
-	uint64_t nkey;			// numeric key if class 0
+	Sym_slots* sl;
+	uint64_t	hash;
+	uint64_t	nkey;			// numeric key if class 0
+	long		i;
 
 	if( (table = (Sym_tab *) vtable) == NULL ) {
 		return NULL;
 	}
 
-	sym_tab = table->symlist;
-
-	if( class ) {
-		hv = sym_hash( name, table->size );
-		for(eptr=sym_tab[hv]; eptr &&  ! same(class, eptr->class, eptr->name, name); eptr=eptr->next );
-	} else {
-		nkey = *((uint64_t *) name);
-		hv = nkey % table->size;			// just hash the number
-		for( eptr=sym_tab[hv]; eptr && eptr->nkey != nkey; eptr=eptr->next );
-	}
-
-	if( eptr )
-	{
-		eptr->rcount++;
-		return eptr->val;
+	hash = key_hash( name, class, &nkey );
+	sl = __atomic_load_n( &table->slots, __ATOMIC_ACQUIRE );
+	if( (i = sym_find( sl, hash, name, nkey, class )) >= 0 ) {
+		return sl->eles[i].val;
 	}
 
 	return NULL;
@@ -422,98 +654,108 @@ extern int rmr_sym_map( void *vtable, uint64_t key, void *val ) {
 	return putin( table, (const char *) &key, 0, val );
 }
 
+/*
+	Return the number of groups probed, beyond its first, to reach the entry
+	in slot i.
+*/
+static long sym_probes( Sym_slots* sl, long i ) {
+	long	gmask;
+	long	g;
+	long	step;
+
+	gmask = (sl->size / SYM_GROUP) - 1;
+	g = (long) (sl->eles[i].hash >> 7) & gmask;
+	for( step = 1; g != i / SYM_GROUP && step <= gmask; step++ ) {
+		g = (g + step) & gmask;
+	}
+
+	return step - 1;
+}
+
 /*
 	Dump some statistics to stderr dev. Higher level is the more info dumpped
 */
 extern void rmr_sym_stats( void *vtable, int level )
 {
 	Sym_tab	*table;
+	Sym_slots* sl;
 	Sym_ele *eptr;    /* pointer into the elements */
-	Sym_ele **sym_tab;
-	int i;
-	int empty = 0;
-	long ch_count;
-	long max_chain = 0;
-	int maxi = 0;
-	int twoper = 0;
+	long	i;
+	long	probes;
+	long	max_probe = 0;
+	long	maxi = -1;
+	long	displaced = 0;
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
+	sl = table->slots;
 
-	for( i = 0; i < table->size; i++ )
+	for( i = 0; i < sl->size; i++ )
 	{
-		ch_count = 0;
-		if( sym_tab[i] )
-		{
-			for( eptr = sym_tab[i]; eptr; eptr = eptr->next )
-			{
-				ch_count++;
-				if( level > 3 ) {
-					if( eptr->class  ) {					// a string key
-						fprintf( stderr, " symtab stats: sym: (%d) key=%s val@=%p ref=%ld mod=%lu\n", i, eptr->name, eptr->val, eptr->rcount, eptr->mcount );
-					} else {
-						fprintf( stderr, "symtab stats: sym: (%d) key=%lu val@=%p ref=%ld mod=%lu\n", i, (unsigned long) eptr->nkey, eptr->val, eptr->rcount, eptr->mcount );
-					}
-				}
-			}
+		if( sl->ctrl[i] >= SYM_EMPTY ) {
+			continue;
 		}
-		else
-			empty++;
 
-		if( ch_count > max_chain )
-		{
-			max_chain = ch_count;
+		eptr = &sl->eles[i];
+		probes = sym_probes( sl, i );
+		if( probes > 0 ) {
+			displaced++;
+		}
+		if( probes > max_probe || maxi < 0 ) {
+			max_probe = probes;
 			maxi = i;
 		}
-		if( ch_count > 1 )
-			twoper++;
-
-		if( level > 2 )
-			fprintf( stderr, "symtab stats: sym: (%d) chained=%ld\n", i, ch_count );
-	}
 
-	if( level > 1 )
-	{
-		fprintf( stderr, "symtab stats: sym: longest chain: idx=%d has %ld elsements):\n", maxi, max_chain );
-		for( eptr = sym_tab[maxi]; eptr; eptr = eptr->next ) {
-			if( eptr->class ) {
-				fprintf( stderr, "\t%s\n", eptr->name );
+		if( level > 3 ) {
+			if( eptr->class  ) {					// a string key
+				fprintf( stderr, " symtab stats: sym: (%ld) key=%s val@=%p mod=%u probes=%ld\n", i, eptr->key.name, eptr->val, eptr->mcount, probes );
 			} else {
-				fprintf( stderr, "\t%lu (numeric key)\n", (unsigned long) eptr->nkey );
+				fprintf( stderr, "symtab stats: sym: (%ld) key=%lu val@=%p mod=%u probes=%ld\n", i, (unsigned long) eptr->key.nkey, eptr->val, eptr->mcount, probes );
 			}
 		}
 	}
 
-	fprintf( stderr, "symtab stats: sym:%ld(size)  %ld(inhab) %ld(occupied) %ld(dead) %ld(maxch) %d(>2per)\n",
-			table->size, table->inhabitants, table->size - empty, table->deaths, max_chain, twoper );
+	if( level > 2 ) {
+		for( i = 0; i < sl->size; i += SYM_GROUP ) {
+			fprintf( stderr, "symtab stats: sym: group (%ld) ctrl=%016llx\n", i / SYM_GROUP, (unsigned long long) sym_group( sl, i / SYM_GROUP ) );
+		}
+	}
+
+	if( level > 1 && maxi >= 0 ) {
+		eptr = &sl->eles[maxi];
+		if( eptr->class ) {
+			fprintf( stderr, "symtab stats: sym: longest probe: slot=%ld groups=%ld: %s\n", maxi, max_probe, eptr->key.name );
+		} else {
+			fprintf( stderr, "symtab stats: sym: longest probe: slot=%ld groups=%ld: %lu (numeric key)\n", maxi, max_probe, (unsigned long) eptr->key.nkey );
+		}
+	}
+
+	fprintf( stderr, "symtab stats: sym:%ld(size)  %ld(inhab) %ld(tombs) %ld(dead) %ld(maxprobe) %ld(displaced)\n",
+			sl->size, table->inhabitants, table->tombstones, table->deaths, max_probe, displaced );
 }
 
 /*
 	Drive a user callback function for each entry in a class. It is safe for
-	the user to delete the element as we capture a next pointer before
-	calling their function.
+	the user to delete the element passed (or any other) as deleting does not
+	move entries. If the callback adds entries, a resize may move entries, so
+	some may be missed or visited twice.
 */
 extern void rmr_sym_foreach_class( void *vst, unsigned int class, void (* user_fun)( void*, void*, const char*, void*, void* ), void *user_data )
 {
 	Sym_tab	*st;
-	Sym_ele **list;
+	Sym_slots* sl;
 	Sym_ele *se;
-	Sym_ele *next;		/* allows user to delete the node(s) we return */
-	int		i;
+	long	i;
 
-	if( (st = (Sym_tab *) vst) == NULL ) {
+	if( (st = (Sym_tab *) vst) == NULL || user_fun == NULL ) {
 		return;
 	}
 
-	if( (list = st->symlist) != NULL && user_fun != NULL ) {
-		for( i = 0; i < st->size; i++ ) {
-			se = list[i];
-			while( se ) {
-				next = se->next;			// allow callback to delete from the list w/o borking us
-				if( class == se->class ) {
-					user_fun( st, se, se->name, se->val, user_data );
-				}
-				se = next;
+	sl = st->slots;
+	for( i = 0; i < sl->size; i++ ) {
+		if( __atomic_load_n( &sl->ctrl[i], __ATOMIC_ACQUIRE ) < SYM_EMPTY ) {
+			se = &sl->eles[i];
+			if( class == se->class ) {
+				user_fun( st, se, class ? se->key.name : NULL, se->val, user_data );
 			}
 		}
 	}
@@ -292,6 +292,7 @@ extern rmr_mbuf_t* rmr_wh_send_msg( void* vctx, rmr_whid_t whid, rmr_mbuf_t* msg
 
 	d1 = DATA1_ADDR( msg->header );
 	d1[D1_CALLID_IDX] = NO_CALL_ID;								// must blot out so it doesn't queue on a chute at the other end
+	d1[D1_XCALL_IDX] = 0;
 
 	ep = whm->eps[whid];
 	if( ! ep->open ) {
@@ -50,6 +50,16 @@
 
 #define RF_NOTIFIED	0x01	// notification made about river issue
 #define RF_DROP		0x02	// this message is large and being dropped
+#define RF_FC_ON	0x04	// sender honours credits; grants are being issued on this flow
+#define RF_CH_ON	0x08	// compact headers have been accepted on this flow
+#define RF_CZ_ON	0x10	// compressed payloads have been accepted on this flow
+
+#define CB_CLOSED	RMR_CB_CLOSED	// endpoint circuit breaker states: senders may connect
+#define CB_OPEN		RMR_CB_OPEN		// connects failed; sends fail fast until a probe connects
+#define CB_HALF		RMR_CB_HALF		// probe is trying to connect
+
+#define CH_MAX_IDS	4		// sender identities a receiver keeps per connection
+#define CH_BUF_LEN	(TP_HDR_LEN + sizeof( uta_v4mhdr_t ) + (RMR_MAX_SRC * 2) + RMR_MAX_XID + RMR_MAX_SID + RMR_MAX_MEID)	// max compact header
 
 #define	TP_SZFIELD_LEN	((sizeof(uint32_t)*2)+1)	// number of bytes needed for msg size in transport header
 #define	TP_SZ_MARKER	'$'							// marker indicating net byte order used
@@ -68,6 +78,16 @@ typedef struct {
 	int		ipt;		// insertion point in accumulator
 	int		msg_size;	// size of the message being accumulated
 	int		flags;		// RF_* constants
+
+						// flow control (receiver side); used is bumped by application threads
+	uint32_t	fc_used;	// messages from this flow consumed by the application
+	uint32_t	fc_limit;	// absolute message count last granted to the sender
+
+						// compact headers (receiver side); touched only by the receive thread
+	char*	ch_ids[CH_MAX_IDS];	// sender identities (src and srcip) interned on this connection
+
+						// return to sender; set by application threads, read by the receive thread
+	endpoint_t*	rts_ep;	// endpoint that rmr_rts_msg() resolved for the sender on this connection
 } river_t;
 
 
@@ -82,6 +102,59 @@ typedef struct {
 // ---------------------------- mainline rmr things ----------------
 
 
+/*
+	Timing wheel (see tw_si_static.c). A timer is embedded in whatever it times;
+	the function is called on the wheel's thread when the timer expires.
+*/
+#define TW_BITS		6					// slots per level is 2^bits
+#define TW_SLOTS	(1 << TW_BITS)
+#define TW_LEVELS	4					// 64^4 ticks (about 4.6 hours at 1ms); later timers are clamped
+#define TW_TICK_NS	1000000ULL			// wheel resolution
+
+typedef struct tw_timer {
+	struct tw_timer*	next;
+	struct tw_timer*	prev;
+	uint64_t	tick;					// wheel tick when the timer expires
+	void		(*fn)( struct uta_ctx* ctx, void* data );
+	void*		data;
+	int			armed;					// set while linked into the wheel
+} tw_timer_t;
+
+typedef struct timing_wheel {
+	struct uta_ctx*	ctx;
+	pthread_mutex_t	gate;
+	pthread_cond_t	wake;				// signalled (monotonic clock) when a timer is armed ahead of the thread's wake up
+	uint64_t	base;					// monotonic ns of tick 0
+	uint64_t	cur;					// last tick processed
+	uint64_t	wake_tick;				// tick the thread is sleeping until
+	int			count;					// timers armed
+	tw_timer_t*	running;				// timer whose function is being called
+	tw_timer_t*	slots[TW_LEVELS][TW_SLOTS];
+	pthread_t	th;
+} timing_wheel_t;
+
+/*
+	Sender side batching; frames waiting to be written to an endpoint's session.
+*/
+typedef struct ep_batch {
+	pthread_mutex_t	gate;
+	char*		buf;
+	int			cap;				// allocated size of buf
+	int			len;				// bytes waiting
+	int			nframes;			// messages waiting
+	int			sock;				// session the frames are for
+	uint64_t	first_ns;			// when the oldest waiting frame was added (monotonic)
+	uint64_t	writes;				// buffers written
+} ep_batch_t;
+
+typedef struct {					// batch sweep data passed through symtab foreach
+	struct uta_ctx*	ctx;
+	int			all;				// write every buffer, not just those out of time
+	int			left;				// endpoints still holding frames after the sweep
+	uint64_t	now;
+	uint64_t	budget_ns;
+} bat_sweep_t;
+
 /*
 	Manages an endpoint. Type def for this is defined in agnostic.
 */
@@ -97,6 +170,34 @@ struct endpoint {
 
 							// SI specific things
 	int notify;				// if we fail, we log once until a connection happens; notify if set
+
+							// flow control (sender side); reset when the connection drops
+	int			fc_on;		// peer has granted credits; sends are limited by fc_limit
+	uint32_t	fc_sent;	// messages sent on the current connection
+	uint32_t	fc_limit;	// absolute message count the peer is willing to accept
+
+							// compact headers (sender side); reset when the connection drops
+	int			ch_on;		// peer accepted compact headers on the current connection
+	int			ch_ident;	// our identity has been sent (and interned) on the current connection
+	int			cz_on;		// peer accepted compressed payloads on the current connection
+
+							// time senders spent waiting for the connection to drain (send deadline mode)
+	uint64_t	blocked;	// waits
+	uint64_t	blocked_ns;	// total time waited
+	uint64_t	max_blocked_ns;	// longest single wait
+
+	ep_batch_t*	batch;		// sender side batching (nil until a batched send is made)
+	uint32_t	fail_streak;	// consecutive failed sends; reset by a good one (load aware selection)
+
+							// circuit breaker (see cb_si_static.c)
+	int			cb_state;	// CB_ constant; senders connect only when closed
+	int			cb_nfails;	// consecutive failed connects
+	uint64_t	cb_until;	// monotonic ns when an open breaker is next probed
+	uint64_t	cb_backoff;	// current wait between probes
+	tw_timer_t	cb_timer;	// wakes the probe thread when the probe is due
+	uint64_t	connect_fails;	// connects which failed
+	uint64_t	cb_trips;	// times the breaker opened
+	uint64_t	cb_fast_fails;	// sends refused while the breaker was not closed
 };
 
 /*
@@ -109,6 +210,107 @@ typedef struct epoll_stuff {
 	int poll_fd;								// fd from nng
 } epoll_stuff_t;
 
+/*
+	Dispatcher things. A handler is registered for each message type that the
+	dispatcher delivers; a worker queue is owned by each worker thread.
+*/
+typedef struct handler {
+	int				mtype;
+	rmr_handler_t	fn;				// user function and data to pass to it
+	void*			arg;
+	int				limit;			// max concurrent invocations (0 == no limit)
+	int				active;			// current invocations
+	void*			pending;		// ring of messages waiting because limit was reached
+	pthread_mutex_t	gate;			// protects active and pending
+
+	uint64_t		count;			// stats; updated atomically
+	uint64_t		total_ns;
+	uint64_t		max_ns;
+} handler_t;
+
+typedef struct {
+	uint32_t	head;				// next slot to take (any worker)
+	char		pad[60];			// keep takers and the receive thread off the same cache line
+	uint32_t	tail;				// next slot to fill (receive thread only)
+	void*		slots[1024];		// DQ_SIZE
+} dq_t;
+
+typedef struct dispatcher {
+	struct uta_ctx*	ctx;
+	void*		handlers;			// handlers keyed by message type
+	int			nthreads;
+	int			running;			// set once the workers have been started
+	int			stop;				// workers exit when set
+	uint32_t	next;				// round robin queue selection (receive thread only)
+	dq_t*		queues;				// one per worker
+	sem_t		work;				// count of queued messages
+	pthread_t*	threads;
+	struct disp_worker* workers;
+} dispatcher_t;
+
+typedef struct disp_worker {
+	dispatcher_t*	disp;
+	int				idx;			// index of the worker's own queue
+} disp_worker_t;
+
+/*
+	Asynchronous send. A request block carries a queued message and where its
+	completion is to be delivered.
+*/
+typedef struct as_req {
+	rmr_mbuf_t*		msg;
+	rmr_send_cb_t	cb;				// nil if the completion is queued on the completion ring
+	void*			arg;
+} as_req_t;
+
+typedef struct async_send {
+	struct uta_ctx*	ctx;
+	void*		sq;					// requests waiting to be sent
+	void*		cq;					// requests completed without a callback
+	void*		free;				// request blocks not in use
+	as_req_t*	reqs;				// the request blocks
+	int			running;			// set while the offload thread is running
+	int			started;			// offload thread was created and has not been joined
+	int			stop;				// offload thread exits when set and the queue is empty
+	int			queuing;			// application threads between the stop check and the queue insert
+	uint64_t	sent;				// sends made by the offload thread
+	pthread_t	th;
+} async_send_t;
+
+/*
+	Asynchronous call. A request block holds the call message until the response
+	(or the timeout) completes the call.
+*/
+typedef struct ac_req {
+	int				state;			// AC_ constant; changed only with atomics
+	rmr_mbuf_t*		msg;			// call message; the response once completed
+	rmr_call_cb_t	cb;				// nil if the completion is queued on the completion ring
+	void*			arg;
+	tw_timer_t		timer;			// expires the call (armed only if it has a timeout)
+	xc_slot_t*		slot;			// outstanding call entry
+} ac_req_t;
+
+typedef struct async_call {
+	struct uta_ctx*	ctx;
+	ac_req_t*	reqs;				// the request blocks
+	void*		cq;					// requests completed without a callback
+	void*		free;				// request blocks not in use
+	int			npending;			// calls sent and not yet completed
+} async_call_t;
+
+/*
+	Hedged calls. Response times for a message type are counted in quarter
+	octave buckets (see hg_bucket()); 96 reach past 16 seconds.
+*/
+#define HG_NBUCKETS	96
+
+typedef struct hg_type {
+	int			mtype;				// message type + 1; 0 while the slot is free
+	uint32_t	total;				// samples in the buckets
+	uint32_t	delay_us;			// hedge delay (0 until there are enough samples)
+	uint32_t	buckets[HG_NBUCKETS];
+} hg_type_t;
+
 /*
 	Context describing our world. Should be returned to user programme on
 	call to initialise, and passed as first parm on all calls to other
@@ -125,6 +327,7 @@ struct uta_ctx {
 	int	flags;					// CFL_ constants
 	int nrtele;					// number of elements in the routing table
 	int send_retries;			// number of retries send_msg() should attempt if eagain/timeout indicated by nng
+	int send_tous;				// if > 0, send deadline (usec); blocked sends wait for the session rather than retry
 	int	trace_data_len;			// number of bytes to allocate in header for trace data
 	int d1_len;					// extra header data 1 length
 	int d2_len;					// extra header data 2 length	(future)
@@ -132,6 +335,25 @@ struct uta_ctx {
 	int rtable_ready;			// set to true when rt is received or loaded
 	int snarf_rt_fd;			// the file des where we save the last rt from RM
 	int dcount;					// drop counter when app is slow
+	int	fc_window;				// flow control credit window granted to each sender (0 == off)
+	int	ch_on;					// compact headers are offered and accepted (RMR_COMPACT_HDR)
+	int	bat_bytes;				// sender side batch size (0 == batching off)
+	int	bat_us;					// latency budget for batched messages
+	int	bat_pending;			// endpoints holding batched messages
+	int	bat_running;			// set once the flusher thread has been started
+	sem_t	bat_wake;			// posted when something is batched while nothing was
+	pthread_t	bat_th;
+	int	cb_fails;				// consecutive failed connects which open an endpoint's breaker (0 == off)
+	int	cb_nopen;				// endpoints with a breaker not closed
+	int	cb_running;				// set once the probe thread has been started
+	sem_t	cb_wake;			// posted when a breaker opens while none were
+	pthread_t	cb_th;
+	int	hg_pct;					// percentile of call response times used as the hedge delay (0 == no hedging)
+	hg_type_t*	hg_types;		// response time histograms by message type (nil until hedging is first enabled)
+	xc_slot_t*	xcalls;			// outstanding automatic calls matched on xid (nil until the first)
+	uint16_t	xc_tag;			// marks automatic calls (and so their responses) as ours
+	void*	cz_types;			// message types compressed on send, mapped to their min payload len (nil if none)
+	rmr_codec_t	cz_codec;		// user supplied payload codec (compress nil for the built in codec)
 
 	uint64_t acc_dcount;		// accumulated drop counter when app is slow
 	uint64_t acc_ecount;		// accumulated enqueue counter
@@ -144,6 +366,14 @@ struct uta_ctx {
 	void*	mring;				// ring where msgs are queued while waiting for a call response msg
 	chute_t*	chutes;
 
+	int		nshards;			// number of receive shards (0 when messages are queued on mring)
+	int		shard_key;			// RMR_SHARD_* key used to select the shard
+	void**	shards;				// per shard (single reader/writer) receive rings
+	dispatcher_t*	disp;		// message dispatcher (nil if handlers never registered)
+	async_send_t*	asend;		// send offload (nil until rmr_send_async() or rmr_get_send_cfd() is used)
+	async_call_t*	acall;		// asynchronous calls (nil until rmr_call_async() or rmr_get_call_cfd() is used)
+	timing_wheel_t*	tw;			// timers for call deadlines and other features (nil until the first is armed)
+
 	char*	rtg_addr;			// addr/port of the route table generation publisher
 	int		rtg_port;			// the port that the rtg listens on
 
@@ -163,12 +393,17 @@ struct uta_ctx {
 	river_t*	rivers;			// inbound flows (index is the socket fd)
 	void*		river_hash;		// flows with fd values > nrivers must be mapped through the hash
 	int			max_ibm;		// max size of an inbound message (river accum alloc size)
+	char*		rblock;			// shared receive block SI reads into (nil unless enabled with RMR_RCV_SHARE)
 	void*		zcb_mring;		// zero copy buffer mbuf ring
 	void*		fd2ep;				// the symtab mapping file des to endpoints for cleanup on disconnect
 	void*		ephash;				// hash  host:port or ip:port to endpoint struct
 
 	pthread_mutex_t	*fd2ep_gate;	// we must gate add/deletes to the fd2 symtab
-	pthread_mutex_t	*rtgate;		// master gate for accessing/moving route tables
+	pthread_mutex_t	*rtgate;		// gate for moving route tables (writers only; readers pin an epoch)
+	uint64_t	rt_epoch;			// bumped each time a table is rolled in
+	uint64_t	rt_retire;			// epoch readers must reach before the old table may be reused
+	uint64_t	rt_id;				// identifies the context to the per thread reader cache
+	rt_reader_t* rt_readers;		// route table readers (see get_rt())
 };
 
 typedef uta_ctx_t uta_ctx;
@@ -195,6 +430,8 @@ static inline int xlate_si_state( int state, int def_state );
 static int uta_epsock_byname( uta_ctx_t* ctx, char* ep_name, int* nn_sock, endpoint_t** uepp );
 //static int uta_epsock_rr( rtable_ent_t *rte, int group, int* more, int* nn_sock, endpoint_t** uepp, si_ctx_t* si_ctx );
 static int uta_epsock_rr( uta_ctx_t* ctx, rtable_ent_t *rte, int group, int* more, int* nn_sock, endpoint_t** uepp );
+static int uta_epsock_rr_msg( uta_ctx_t* ctx, rtable_ent_t *rte, int group, int* more, int* nn_sock, endpoint_t** uepp, rmr_mbuf_t* msg );
+static int uta_epsock_ep( uta_ctx_t* ctx, endpoint_t* ep, int* nn_sock );
 
 
 // --- msg ---------------------------------------
@@ -206,7 +443,9 @@ static rmr_mbuf_t* rcv_msg( uta_ctx_t* ctx, rmr_mbuf_t* old_msg );
 static inline rmr_mbuf_t* realloc_msg( rmr_mbuf_t* old_msg, int tr_len  );
 static rmr_mbuf_t* send2ep( uta_ctx_t* ctx, endpoint_t* ep, rmr_mbuf_t* msg );
 
-static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int retries );
+static rmr_mbuf_t* send_msgv( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int retries, endpoint_t* ep, struct iovec const* iov, int niov );
+static inline rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int retries, endpoint_t* ep );
+static rmr_mbuf_t* bcast_msgv( uta_ctx_t* ctx, rmr_mbuf_t* msg, rrgroup_t* rrg, int retries, struct iovec const* iov, int niov, int* nok );
 
 // ---- fd to endpoint translation ------------------------------
 static endpoint_t*  fd2ep_del( uta_ctx_t* ctx, int fd );
@@ -214,6 +453,146 @@ static endpoint_t*  fd2ep_get( uta_ctx_t* ctx, int fd );
 static void fd2ep_init( uta_ctx_t* ctx );
 static void fd2ep_add( uta_ctx_t* ctx, int fd, endpoint_t* ep );
 
+// ---- flow control --------------------------------------------
+static inline int fc_take( endpoint_t* ep );
+static inline void fc_untake( endpoint_t* ep );
+static void fc_reset_ep( endpoint_t* ep );
+static void fc_ctl_frame( uta_ctx_t* ctx, uta_mhdr_t* hdr, int fd );
+static void fc_open_flow( uta_ctx_t* ctx, int fd );
+static inline void fc_consumed( uta_ctx_t* ctx, rmr_mbuf_t* msg );
+
+// ---- compact headers -----------------------------------------
+static int ch_encode( uta_ctx_t* ctx, endpoint_t* ep, uta_mhdr_t* hdr, char* buf, int* ident );
+static char* ch_expand( uta_ctx_t* ctx, char* raw, int* msg_size, int fd, int* tpflags );
+static void ch_open_flow( uta_ctx_t* ctx, int fd );
+static void ch_ctl_frame( uta_ctx_t* ctx, int fd );
+static void ch_reset_ep( endpoint_t* ep );
+static void ch_reset_river( river_t* river );
+
+// ---- payload compression -------------------------------------
+static int cz_lz_compress( void* data, unsigned char const* src, int len, unsigned char* dest, int max );
+static int cz_lz_decompress( void* data, unsigned char const* src, int len, unsigned char* dest, int max );
+static inline int cz_accepted( endpoint_t* ep );
+static unsigned char* cz_compress( uta_ctx_t* ctx, rmr_mbuf_t* msg, struct iovec* iov );
+static char* cz_expand( uta_ctx_t* ctx, char* raw, int* msg_size, int* tpflags );
+static void cz_open_flow( uta_ctx_t* ctx, int fd );
+static void cz_ctl_frame( uta_ctx_t* ctx, int fd );
+static void cz_reset_ep( endpoint_t* ep );
+
+// ---- transport buffer pools ----------------------------------
+static void* tpb_alloc( size_t size );
+static void tpb_free( void* buf );
+static inline size_t tpb_size( void* buf );
+static inline void tpb_release( rmr_mbuf_t* msg );
+static inline void* tpb_attach( rmr_mbuf_t* msg, size_t size );
+static inline void tpb_put( void* buf, int flags );
+static void tpb_stats( rmr_tpbuf_stats_t* stats );
+static char* rblk_alloc( void );
+static inline void rblk_ref( void* ptr );
+static void rblk_unref( void* ptr );
+
+// ---- mbuf recycling ------------------------------------------
+static inline rmr_mbuf_t* mbp_get( void );
+static inline void mbp_put( rmr_mbuf_t* mbuf );
+static void mbp_stats( rmr_mbuf_stats_t* stats );
+
+// ---- receive sharding ----------------------------------------
+static inline uint32_t shard_hash( unsigned char const* key, int len, int stop );
+static inline uint32_t shard_key_hash( int key, rmr_mbuf_t* mbuf );
+static inline int shard_idx( uta_ctx_t* ctx, rmr_mbuf_t* mbuf, int nshards );
+static int mk_shards( uta_ctx_t* ctx, int nshards );
+static void free_shards( uta_ctx_t* ctx );
+
+// ---- dispatcher ----------------------------------------------
+static inline int dq_push( dq_t* q, void* data );
+static inline void* dq_take( dq_t* q );
+static inline handler_t* disp_get_handler( dispatcher_t* disp, int mtype );
+static dispatcher_t* disp_ensure( uta_ctx_t* ctx );
+static void disp_run( uta_ctx_t* ctx, handler_t* h, rmr_mbuf_t* mbuf );
+static void* disp_worker( void* data );
+static inline int disp_queue( uta_ctx_t* ctx, rmr_mbuf_t* mbuf );
+static void disp_stop( uta_ctx_t* ctx );
+
+// ---- sender side batching ------------------------------------
+static ep_batch_t* bat_ensure( endpoint_t* ep, int cap );
+static int bat_write( uta_ctx_t* ctx, endpoint_t* ep, ep_batch_t* b );
+static int bat_add( uta_ctx_t* ctx, endpoint_t* ep, int sock, struct iovec const* vec, int nvec, int tot_len, int flush );
+static int bat_flush( uta_ctx_t* ctx, endpoint_t* ep );
+static void bat_drop( uta_ctx_t* ctx, endpoint_t* ep );
+static void bat_sweep_ep( void* st, void* entry, char const* name, void* thing, void* vdata );
+static int bat_sweep( uta_ctx_t* ctx, int all );
+static int bat_drain( uta_ctx_t* ctx );
+static void* bat_flusher( void* data );
+static int bat_config( uta_ctx_t* ctx, int max_bytes, int max_us );
+
+// ---- timing wheel --------------------------------------------
+static timing_wheel_t* tw_ensure( uta_ctx_t* ctx );
+static inline uint64_t tw_tick( timing_wheel_t* tw, uint64_t ns );
+static void tw_link( timing_wheel_t* tw, tw_timer_t* t );
+static void tw_unlink( timing_wheel_t* tw, tw_timer_t* t );
+static void tw_cascade( timing_wheel_t* tw, int level, int idx );
+static void tw_advance( timing_wheel_t* tw, uint64_t now_tick );
+static uint64_t tw_next( timing_wheel_t* tw );
+static void* tw_runner( void* data );
+static int tw_arm( uta_ctx_t* ctx, tw_timer_t* t, uint64_t when, void (*fn)( uta_ctx_t* ctx, void* data ), void* data );
+static int tw_cancel( uta_ctx_t* ctx, tw_timer_t* t );
+static void tw_post( uta_ctx_t* ctx, void* data );
+
+// ---- circuit breaker -----------------------------------------
+static inline int cb_closed( endpoint_t* ep );
+static int cb_allow( endpoint_t* ep );
+static void cb_failed( uta_ctx_t* ctx, endpoint_t* ep );
+static inline void cb_connected( endpoint_t* ep );
+static void cb_probe( uta_ctx_t* ctx, endpoint_t* ep );
+static void cb_sweep_ep( void* st, void* entry, char const* name, void* thing, void* vdata );
+static void cb_sweep( uta_ctx_t* ctx );
+static void* cb_prober( void* data );
+static int cb_start( uta_ctx_t* ctx );
+
+// ---- endpoint selection --------------------------------------
+static inline uint32_t lb_rand( void );
+static long lb_load( endpoint_t* ep );
+static int lb_select( rrgroup_t* rrg, rmr_mbuf_t* msg );
+
+// ---- hedged calls --------------------------------------------
+static inline int hg_bucket( uint64_t us );
+static inline uint64_t hg_bucket_us( int b );
+static hg_type_t* hg_find( uta_ctx_t* ctx, int mtype, int create );
+static void hg_record( uta_ctx_t* ctx, int mtype, uint64_t us );
+static inline uint32_t hg_delay( uta_ctx_t* ctx, int mtype );
+static rmr_mbuf_t* hg_send( uta_ctx_t* ctx, rmr_mbuf_t* mbuf, endpoint_t** alt );
+static int hg_resend( uta_ctx_t* ctx, rmr_mbuf_t* mbuf, endpoint_t* alt );
+static int hg_config( uta_ctx_t* ctx, int pct );
+
+// ---- calls matched on xid ------------------------------------
+static void xc_chute_free( void* data );
+static void xc_key_init( void );
+static chute_t* xc_chute( void );
+static xc_slot_t* xc_table( uta_ctx_t* ctx );
+static void xc_set_xid( rmr_mbuf_t* mbuf );
+static inline void xc_mark( uta_ctx_t* ctx, unsigned char* d1 );
+static inline int xc_marked( uta_ctx_t* ctx, uta_mhdr_t* hdr );
+static xc_slot_t* xc_add( uta_ctx_t* ctx, unsigned char const* xid, chute_t* chute, void* areq );
+static int xc_deliver( uta_ctx_t* ctx, rmr_mbuf_t* mbuf );
+static void xc_release( int* state );
+static void xc_drop( xc_slot_t* s );
+
+// ---- asynchronous calls --------------------------------------
+static async_call_t* ac_ensure( uta_ctx_t* ctx );
+static void ac_free( async_call_t* ac );
+static void ac_finish( async_call_t* ac, ac_req_t* req );
+static int ac_claim( ac_req_t* req );
+static void ac_done( uta_ctx_t* ctx, ac_req_t* req, rmr_mbuf_t* mbuf );
+static void ac_expire( uta_ctx_t* ctx, void* data );
+static int ac_call( uta_ctx_t* ctx, rmr_mbuf_t* msg, int max_wait, rmr_call_cb_t cb, void* arg );
+
+// ---- asynchronous send ---------------------------------------
+static async_send_t* as_ensure( uta_ctx_t* ctx );
+static void as_free( async_send_t* as );
+static void as_send( async_send_t* as, as_req_t* req );
+static void* as_worker( void* data );
+static void as_stop( uta_ctx_t* ctx );
+
 // ------ misc ---------------------------------------------------
 static inline void incr_ep_counts( int state, endpoint_t* ep );		// must declare for static includes, but after headers
 
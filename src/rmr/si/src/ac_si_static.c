@@ -0,0 +1,267 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	ac_si_static.c
+	Abstract:	Asynchronous calls. rmr_call_async() sends the call message from
+				the application's thread and returns; the call is added to the
+				table of outstanding calls (xc_si_static.c) with a request block
+				rather than a chute. When the response arrives the receive
+				thread matches it on the xid and completes the request: the
+				response is given to the callback supplied with the call, or,
+				without a callback, queued on the completion ring, whose
+				pollable fd can be added to an application's event loop; the
+				completions are collected with rmr_call_complete().
+
+				The call message is kept until the call completes. If no
+				response arrives by the deadline the request's timer (on the
+				timing wheel, tw_si_static.c) completes the call with the call
+				message itself, its state set to RMR_ERR_TIMEOUT.
+
+				A request is completed exactly once: the receive thread and
+				the timer both claim it (pending -> claimed) with an
+				atomic swap before completing it. The receive thread holds the
+				request's slot while it does so, and the timer waits
+				for the slot, so neither the slot nor the request is reused
+				under the other. A request is sending until the send returns;
+				a response which arrives before that waits for the sender to
+				finish with it.
+
+				Request blocks come from a fixed pool; when it is empty the
+				call fails with a retry state. A block returns to the pool
+				when its completion has been delivered.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _ac_si_static_c
+#define _ac_si_static_c
+
+#define AC_NREQS	4096			// request blocks; the most calls which can be outstanding or uncollected
+
+#define AC_FREE		0				// request states
+#define AC_SENDING	1
+#define AC_PENDING	2
+#define AC_CLAIMED	3
+
+/*
+	Return the context's async call block, creating it if needed. The first of
+	several racing threads to install its block wins. Nil is returned (errno set) on failure.
+*/
+static async_call_t* ac_ensure( uta_ctx_t* ctx ) {
+	async_call_t*	ac;
+	async_call_t*	expect = NULL;
+	int				i;
+
+	if( (ac = __atomic_load_n( &ctx->acall, __ATOMIC_ACQUIRE )) != NULL ) {
+		return ac;
+	}
+
+	if( (ac = (async_call_t *) malloc( sizeof( *ac ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( ac, 0, sizeof( *ac ) );
+	ac->ctx = ctx;
+
+	ac->reqs = (ac_req_t *) calloc( AC_NREQS, sizeof( ac_req_t ) );
+	ac->cq = uta_mk_ring( AC_NREQS + 1 );					// rings hold one less than their size
+	ac->free = uta_mk_ring( AC_NREQS + 1 );
+	if( ac->reqs == NULL || ac->cq == NULL || ac->free == NULL ) {
+		ac_free( ac );
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	uta_ring_config( ac->cq, RING_RLOCK | RING_WLOCK );		// receive and timer threads complete; any thread collects
+	uta_ring_config( ac->free, RING_RLOCK | RING_WLOCK );
+	for( i = 0; i < AC_NREQS; i++ ) {
+		uta_ring_insert( ac->free, &ac->reqs[i] );
+	}
+
+	if( ! __atomic_compare_exchange_n( &ctx->acall, &expect, ac, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		ac_free( ac );												// another thread beat us to it
+		return expect;
+	}
+
+	return ac;
+}
+
+/*
+	Release an async call block which was never installed in the context.
+*/
+static void ac_free( async_call_t* ac ) {
+	if( ac == NULL ) {
+		return;
+	}
+
+	if( ac->cq != NULL ) {
+		uta_ring_free( ac->cq );
+	}
+	if( ac->free != NULL ) {
+		uta_ring_free( ac->free );
+	}
+	free( ac->reqs );
+	free( ac );
+}
+
+/*
+	Deliver the completion of a claimed request: to its callback, after which the
+	block is returned to the pool, or to the completion ring.
+*/
+static void ac_finish( async_call_t* ac, ac_req_t* req ) {
+	rmr_mbuf_t*	msg;
+
+	__atomic_sub_fetch( &ac->npending, 1, __ATOMIC_RELAXED );
+
+	if( req->cb != NULL ) {
+		msg = req->msg;
+		req->msg = NULL;
+		req->cb( ac->ctx, msg, req->arg );
+		__atomic_store_n( &req->state, AC_FREE, __ATOMIC_RELEASE );
+		uta_ring_insert( ac->free, req );
+		return;
+	}
+
+	uta_ring_insert( ac->cq, req );							// cannot be full; it is as large as the pool
+}
+
+/*
+	Called by the receive thread (xc_deliver()), holding the request's slot, when
+	a response matches the request's xid. Returns true if the caller has claimed
+	the request and must complete it with ac_done(); false if it was already
+	completed (timed out) or is being abandoned after a failed send. A response
+	which arrives before the send has returned waits for it.
+*/
+static int ac_claim( ac_req_t* req ) {
+	int		expect;
+
+	while( (expect = __atomic_load_n( &req->state, __ATOMIC_ACQUIRE )) == AC_SENDING ) {
+		sched_yield( );
+	}
+
+	return expect == AC_PENDING && __atomic_compare_exchange_n( &req->state, &expect, AC_CLAIMED, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED );
+}
+
+/*
+	Complete a claimed request with its response. The call message is no longer
+	needed and is freed.
+*/
+static void ac_done( uta_ctx_t* ctx, ac_req_t* req, rmr_mbuf_t* mbuf ) {
+	tw_cancel( ctx, &req->timer );						// claimed; if the timer is firing it gives up at once
+	rmr_free_msg( req->msg );
+	mbuf->state = RMR_OK;
+	mbuf->tp_state = 0;
+	req->msg = mbuf;
+	ac_finish( __atomic_load_n( &ctx->acall, __ATOMIC_ACQUIRE ), req );
+}
+
+/*
+	Timer function: the call's deadline has passed. If the response has not
+	completed the call it is completed with a timeout. The slot is released
+	before the completion; if a response is being matched to it at this moment
+	we wait (xc_drop()) for the receive thread to let go, and that response is
+	then reclaimed as any late response is.
+*/
+static void ac_expire( uta_ctx_t* ctx, void* data ) {
+	ac_req_t*	req;
+
+	if( (req = (ac_req_t *) data) == NULL || ! ac_claim( req ) ) {
+		return;
+	}
+
+	xc_drop( req->slot );
+	req->msg->state = RMR_ERR_TIMEOUT;
+	req->msg->tp_state = ETIMEDOUT;
+	ac_finish( __atomic_load_n( &ctx->acall, __ATOMIC_ACQUIRE ), req );
+}
+
+/*
+	Make an asynchronous call. Returns RMR_OK once the message is sent; RMR then
+	owns it until the completion. On failure the message is not sent, remains the
+	caller's, and its state gives the reason.
+*/
+static int ac_call( uta_ctx_t* ctx, rmr_mbuf_t* msg, int max_wait, rmr_call_cb_t cb, void* arg ) {
+	async_call_t*	ac;
+	ac_req_t*		req;
+	unsigned char*	d1;
+	int				state;
+
+	if( (ac = ac_ensure( ctx )) == NULL ) {
+		msg->state = RMR_ERR_INITFAILED;
+		msg->tp_state = errno;
+		return msg->state;
+	}
+
+	if( (req = (ac_req_t *) uta_ring_extract( ac->free )) == NULL ) {
+		errno = EAGAIN;
+		msg->state = RMR_ERR_RETRY;
+		msg->tp_state = errno;
+		return msg->state;
+	}
+
+	xc_set_xid( msg );
+	req->msg = msg;
+	req->cb = cb;
+	req->arg = arg;
+	__atomic_store_n( &req->state, AC_SENDING, __ATOMIC_RELEASE );
+
+	if( (req->slot = xc_add( ctx, msg->xaction, NULL, req )) == NULL ) {		// too many calls in flight
+		__atomic_store_n( &req->state, AC_FREE, __ATOMIC_RELEASE );
+		uta_ring_insert( ac->free, req );
+		msg->state = RMR_ERR_RETRY;
+		msg->tp_state = errno;
+		return msg->state;
+	}
+
+	((uta_mhdr_t *) msg->header)->flags |= HFL_CALL_MSG;
+	d1 = DATA1_ADDR( msg->header );
+	xc_mark( ctx, d1 );
+
+	if( max_wait > 0 && ! tw_arm( ctx, &req->timer, sr_now_ns( ) + (uint64_t) max_wait * 1000000, ac_expire, req ) ) {
+		xc_drop( req->slot );
+		__atomic_store_n( &req->state, AC_FREE, __ATOMIC_RELEASE );
+		uta_ring_insert( ac->free, req );
+		msg->state = RMR_ERR_INITFAILED;
+		msg->tp_state = errno;
+		return msg->state;
+	}
+
+	msg->flags |= MFL_NOALLOC | MFL_FANOUT;						// message comes back; it is kept until the completion
+	msg = mtosend_msg( ctx, msg, 0 );							// internal send does not strip the call marks
+	msg->flags &= ~(MFL_NOALLOC | MFL_FANOUT);
+	if( (state = msg->state) != RMR_OK ) {
+		msg->tp_state = errno;
+		__atomic_store_n( &req->state, AC_CLAIMED, __ATOMIC_RELEASE );		// a stray response, or the timer, must not complete it
+		tw_cancel( ctx, &req->timer );
+		xc_drop( req->slot );
+		req->msg = NULL;
+		__atomic_store_n( &req->state, AC_FREE, __ATOMIC_RELEASE );
+		uta_ring_insert( ac->free, req );
+		return state;
+	}
+
+	__atomic_add_fetch( &ac->npending, 1, __ATOMIC_RELAXED );
+	__atomic_store_n( &req->state, AC_PENDING, __ATOMIC_RELEASE );	// from here the request is not ours to touch
+
+	return RMR_OK;
+}
+
+#endif
@@ -0,0 +1,216 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	as_si_static.c
+	Abstract:	Asynchronous send. Messages passed to rmr_send_async() are put
+				on a queue and the application thread returns at once; a send
+				offload thread takes them from the queue and does the route
+				lookup, any connect, and the send (with the context's retry or
+				deadline settings). The application therefore never waits in
+				the send retry loop or for a session to be connected.
+
+				Each queued message is tracked by a request block from a fixed
+				pool; when the pool is empty rmr_send_async() returns a retry
+				state so the application sees back pressure rather than an
+				unbounded queue. When the send is finished the message (as
+				rmr_send_msg() would have returned it) is given to the callback
+				supplied with it, or, without a callback, queued on the
+				completion ring. The completion ring has a pollable fd and is
+				drained with rmr_send_complete(). A request block is returned to
+				the pool only when its completion has been delivered, so the
+				completion ring never overflows.
+
+				The offload thread is started on first use.
+
+				There is one queue and one offload thread per context, and
+				sends are made in the order queued. A send which waits (a
+				retry loop, a connect, or a session which is not draining)
+				therefore delays every send queued behind it, whatever its
+				destination.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _as_si_static_c
+#define _as_si_static_c
+
+#include <poll.h>
+
+#define AS_NREQS	4096			// request blocks; the most sends which can be queued or uncollected
+
+/*
+	Return the context's async send block, creating it, and starting the offload
+	thread, if needed. Several application threads may race to create it; the
+	first to install its block wins and the others discard theirs. Nil is returned
+	(errno set) on failure.
+*/
+static async_send_t* as_ensure( uta_ctx_t* ctx ) {
+	async_send_t*	as;
+	async_send_t*	expect = NULL;
+	int				i;
+
+	if( (as = __atomic_load_n( &ctx->asend, __ATOMIC_ACQUIRE )) != NULL ) {
+		return as;
+	}
+
+	if( (as = (async_send_t *) malloc( sizeof( *as ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( as, 0, sizeof( *as ) );
+	as->ctx = ctx;
+
+	as->reqs = (as_req_t *) malloc( sizeof( as_req_t ) * AS_NREQS );
+	as->sq = uta_mk_ring( AS_NREQS + 1 );			// rings hold one less than their size
+	as->cq = uta_mk_ring( AS_NREQS + 1 );
+	as->free = uta_mk_ring( AS_NREQS + 1 );
+	if( as->reqs == NULL || as->sq == NULL || as->cq == NULL || as->free == NULL ) {
+		as_free( as );
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	uta_ring_config( as->sq, RING_WLOCK );						// any application thread queues; only the offload thread takes
+	uta_ring_config( as->cq, RING_RLOCK );						// only the offload thread completes; any thread collects
+	uta_ring_config( as->free, RING_RLOCK | RING_WLOCK );
+	for( i = 0; i < AS_NREQS; i++ ) {
+		uta_ring_insert( as->free, &as->reqs[i] );
+	}
+
+	if( ! __atomic_compare_exchange_n( &ctx->asend, &expect, as, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		as_free( as );												// another thread beat us to it
+		return expect;
+	}
+
+	if( pthread_create( &as->th, NULL, as_worker, (void *) as ) ) {
+		rmr_vlog( RMR_VL_CRIT, "unable to start send offload thread: %s\n", strerror( errno ) );
+		__atomic_store_n( &as->stop, 1, __ATOMIC_RELEASE );		// leave installed; sends will fail rather than queue
+		return as;
+	}
+	as->running = 1;
+	as->started = 1;
+
+	return as;
+}
+
+/*
+	Release an async block which was never installed in the context.
+*/
+static void as_free( async_send_t* as ) {
+	if( as == NULL ) {
+		return;
+	}
+
+	if( as->sq != NULL ) {
+		uta_ring_free( as->sq );
+	}
+	if( as->cq != NULL ) {
+		uta_ring_free( as->cq );
+	}
+	if( as->free != NULL ) {
+		uta_ring_free( as->free );
+	}
+	free( as->reqs );
+	free( as );
+}
+
+/*
+	Send the message in the request and deliver the completion. The send goes
+	through rmr_send_msg() so it is exactly what the application would have got
+	with a synchronous send.
+*/
+static void as_send( async_send_t* as, as_req_t* req ) {
+	rmr_mbuf_t*	msg;
+
+	msg = rmr_send_msg( as->ctx, req->msg );
+	__atomic_add_fetch( &as->sent, 1, __ATOMIC_RELAXED );
+
+	if( req->cb != NULL ) {
+		req->cb( as->ctx, msg, req->arg );
+		uta_ring_insert( as->free, req );
+		return;
+	}
+
+	req->msg = msg;
+	uta_ring_insert( as->cq, req );						// cannot be full; it is as large as the pool
+}
+
+/*
+	The send offload thread. Waits on the send queue's pollable fd and sends
+	everything queued. When told to stop, messages already queued are still sent.
+*/
+static void* as_worker( void* data ) {
+	async_send_t*	as;
+	as_req_t*		req;
+	struct pollfd	pfd;
+
+	if( (as = (async_send_t *) data) == NULL ) {
+		return NULL;
+	}
+
+	pfd.fd = uta_ring_getpfd( as->sq );
+	pfd.events = POLLIN;
+	while( 1 ) {
+		if( (req = (as_req_t *) uta_ring_extract( as->sq )) != NULL ) {
+			as_send( as, req );
+			continue;
+		}
+
+		if( __atomic_load_n( &as->stop, __ATOMIC_ACQUIRE ) ) {
+			break;
+		}
+
+		poll( &pfd, 1, 1000 );				// timeout only so that a stop is noticed
+	}
+
+	as->running = 0;
+	return NULL;
+}
+
+/*
+	Stop the offload thread and wait for it to finish what is queued. An
+	application thread which checked the stop flag before it was set may still be
+	queuing; once those have finished nothing else can be queued, so anything
+	the thread did not see before it exited is sent here.
+*/
+static void as_stop( uta_ctx_t* ctx ) {
+	async_send_t*	as;
+	as_req_t*		req;
+
+	if( ctx == NULL || (as = __atomic_load_n( &ctx->asend, __ATOMIC_ACQUIRE )) == NULL ) {
+		return;
+	}
+
+	__atomic_store_n( &as->stop, 1, __ATOMIC_SEQ_CST );
+	while( __atomic_load_n( &as->queuing, __ATOMIC_SEQ_CST ) > 0 ) {
+		sched_yield( );
+	}
+
+	if( __atomic_exchange_n( &as->started, 0, __ATOMIC_ACQ_REL ) && ! pthread_equal( as->th, pthread_self() ) ) {
+		pthread_join( as->th, NULL );
+	}
+
+	while( (req = (as_req_t *) uta_ring_extract( as->sq )) != NULL ) {
+		as_send( as, req );
+	}
+}
+
+#endif
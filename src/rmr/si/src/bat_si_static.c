@@ -0,0 +1,358 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	bat_si_static.c
+	Abstract:	Sender side micro batching. When enabled (rmr_set_batch() or the
+				RMR_BATCH_BYTES environment variable) a message sent to an
+				endpoint is copied, as the complete frame that would have been
+				written, into a buffer kept for the endpoint rather than being
+				written to the session. The buffer is written with a single
+				send when adding a frame would overflow it, when the oldest
+				frame in it has waited for the latency budget, when a call
+				message is added (the caller is waiting for the response), or
+				when the application invokes rmr_flush().
+
+				A flusher thread enforces the budget when the application stops
+				sending. It sleeps until there is something buffered, then
+				sweeps the endpoints every half budget.
+
+				The message is reported as sent once it is buffered. If the
+				write of a buffer fails with a hard error the frames in it are
+				lost; they are counted as failures against the endpoint. If the
+				session is blocked the frames stay buffered; a send which then
+				finds no room is returned with the usual retry state.
+
+				At close the async sender and the dispatcher are stopped first
+				(both may still send), then every buffer is written, waiting a
+				short time for blocked sessions, before the flusher is stopped.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _bat_si_static_c
+#define _bat_si_static_c
+
+#include <sys/prctl.h>
+
+#define BAT_DEF_US		50					// default latency budget (usec)
+#define BAT_DRAIN_MS	1000				// max wait for blocked sessions to drain at close
+
+/*
+	Return the endpoint's batch block, creating it if needed. A send thread and
+	the flusher may race to create it; the first to install its block wins.
+*/
+static ep_batch_t* bat_ensure( endpoint_t* ep, int cap ) {
+	ep_batch_t*	b;
+	ep_batch_t*	expect = NULL;
+
+	if( (b = __atomic_load_n( &ep->batch, __ATOMIC_ACQUIRE )) != NULL ) {
+		return b;
+	}
+
+	if( (b = (ep_batch_t *) malloc( sizeof( *b ) )) == NULL ) {
+		return NULL;
+	}
+	memset( b, 0, sizeof( *b ) );
+	if( (b->buf = (char *) malloc( cap )) == NULL ) {
+		free( b );
+		return NULL;
+	}
+	b->cap = cap;
+	b->sock = -1;
+	pthread_mutex_init( &b->gate, NULL );
+
+	if( ! __atomic_compare_exchange_n( &ep->batch, &expect, b, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		pthread_mutex_destroy( &b->gate );
+		free( b->buf );
+		free( b );
+		return expect;
+	}
+
+	return b;
+}
+
+/*
+	Write the frames buffered for the endpoint. The caller must hold the batch gate.
+	Returns the SI state of the write; the buffer is empty afterwards unless the
+	session is blocked.
+*/
+static int bat_write( uta_ctx_t* ctx, endpoint_t* ep, ep_batch_t* b ) {
+	int		state;
+
+	if( b->len <= 0 ) {
+		return SI_OK;
+	}
+
+	state = SIsendt( ctx->si_ctx, b->sock, b->buf, b->len );
+	if( state == SI_ERR_BLOCKED ) {
+		return state;
+	}
+
+	if( state == SI_OK ) {
+		b->writes++;
+	} else {
+		rmr_vlog( RMR_VL_WARN, "batched send failed: %d messages to %s were lost: %s\n", b->nframes, ep->name, strerror( errno ) );
+		ep->scounts[EPSC_FAIL] += b->nframes;
+	}
+
+	b->len = 0;
+	b->nframes = 0;
+	__atomic_sub_fetch( &ctx->bat_pending, 1, __ATOMIC_RELAXED );
+	return state;
+}
+
+/*
+	Add a frame (the vectors, tot_len bytes in all) for the endpoint's session to
+	the endpoint's buffer, writing the buffer if the frame does not fit, or if
+	the buffer should go now (full, out of time, or flush is set).
+
+	Returns SI_OK if the frame was buffered (or written). If there was no room and
+	the buffered frames could not be written the state of the write is returned
+	and the frame was not buffered.
+*/
+static int bat_add( uta_ctx_t* ctx, endpoint_t* ep, int sock, struct iovec const* vec, int nvec, int tot_len, int flush ) {
+	ep_batch_t*	b;
+	char*		nbuf;
+	uint64_t	now;
+	int			state = SI_OK;
+	int			i;
+
+	if( (b = bat_ensure( ep, ctx->bat_bytes )) == NULL ) {
+		errno = ENOMEM;
+		return SI_ERROR;
+	}
+
+	pthread_mutex_lock( &b->gate );
+	if( b->len > 0 && (b->sock != sock || b->len + tot_len > b->cap) ) {		// reconnected, or no room; what we have must go first
+		if( (state = bat_write( ctx, ep, b )) != SI_OK ) {
+			pthread_mutex_unlock( &b->gate );
+			return state;
+		}
+	}
+
+	if( tot_len > b->cap ) {												// batch size was raised after the buffer was allocated
+		if( (nbuf = (char *) realloc( b->buf, tot_len > ctx->bat_bytes ? tot_len : ctx->bat_bytes )) == NULL ) {
+			pthread_mutex_unlock( &b->gate );
+			errno = ENOMEM;
+			return SI_ERROR;
+		}
+		b->buf = nbuf;
+		b->cap = tot_len > ctx->bat_bytes ? tot_len : ctx->bat_bytes;
+	}
+
+	now = sr_now_ns( );
+	if( b->len == 0 ) {
+		b->first_ns = now;
+		if( __atomic_add_fetch( &ctx->bat_pending, 1, __ATOMIC_RELAXED ) == 1 ) {
+			sem_post( &ctx->bat_wake );											// flusher may be idle
+		}
+	}
+	for( i = 0; i < nvec; i++ ) {
+		memcpy( b->buf + b->len, vec[i].iov_base, vec[i].iov_len );
+		b->len += vec[i].iov_len;
+	}
+	b->nframes++;
+	b->sock = sock;
+
+	if( flush || b->len >= b->cap || now - b->first_ns >= (uint64_t) ctx->bat_us * 1000 ) {
+		state = bat_write( ctx, ep, b );
+		if( state == SI_ERR_BLOCKED ) {
+			state = SI_OK;														// frame is buffered; goes when the session drains
+		}
+	}
+
+	pthread_mutex_unlock( &b->gate );
+	return state;
+}
+
+/*
+	Write whatever is buffered for the endpoint. Returns the SI state.
+*/
+static int bat_flush( uta_ctx_t* ctx, endpoint_t* ep ) {
+	ep_batch_t*	b;
+	int			state;
+
+	if( ep == NULL || (b = __atomic_load_n( &ep->batch, __ATOMIC_ACQUIRE )) == NULL ) {
+		return SI_OK;
+	}
+
+	pthread_mutex_lock( &b->gate );
+	state = bat_write( ctx, ep, b );
+	pthread_mutex_unlock( &b->gate );
+
+	return state;
+}
+
+/*
+	Discard whatever is buffered for the endpoint; called when its session is
+	lost so that the frames are never written to a reused fd.
+*/
+static void bat_drop( uta_ctx_t* ctx, endpoint_t* ep ) {
+	ep_batch_t*	b;
+
+	if( ep == NULL || (b = __atomic_load_n( &ep->batch, __ATOMIC_ACQUIRE )) == NULL ) {
+		return;
+	}
+
+	pthread_mutex_lock( &b->gate );
+	if( b->len > 0 ) {
+		ep->scounts[EPSC_FAIL] += b->nframes;
+		b->len = 0;
+		b->nframes = 0;
+		__atomic_sub_fetch( &ctx->bat_pending, 1, __ATOMIC_RELAXED );
+	}
+	pthread_mutex_unlock( &b->gate );
+}
+
+/*
+	Symtab foreach callback: write the endpoint's buffer if it is old enough (or
+	if all are to be written) and count the endpoints left holding frames.
+*/
+static void bat_sweep_ep( void* st, void* entry, char const* name, void* thing, void* vdata ) {
+	bat_sweep_t*	sd;
+	endpoint_t*		ep;
+	ep_batch_t*		b;
+
+	if( (ep = (endpoint_t *) thing) == NULL || (sd = (bat_sweep_t *) vdata) == NULL ||
+		(b = __atomic_load_n( &ep->batch, __ATOMIC_ACQUIRE )) == NULL || b->len == 0 ) {
+		return;
+	}
+
+	pthread_mutex_lock( &b->gate );
+	if( b->len > 0 && (sd->all || sd->now - b->first_ns >= sd->budget_ns) ) {
+		bat_write( sd->ctx, ep, b );
+	}
+	if( b->len > 0 ) {
+		sd->left++;
+	}
+	pthread_mutex_unlock( &b->gate );
+}
+
+/*
+	Sweep the endpoints in the active route table, writing buffers whose oldest
+	frame has used the budget, or all buffers if all is set. Returns the number
+	of endpoints still holding frames (sessions blocked).
+*/
+static int bat_sweep( uta_ctx_t* ctx, int all ) {
+	route_table_t*	rt;
+	bat_sweep_t		sd;
+
+	if( (rt = get_rt( ctx )) == NULL ) {
+		return 0;
+	}
+
+	sd.ctx = ctx;
+	sd.all = all;
+	sd.now = sr_now_ns( );
+	sd.budget_ns = (uint64_t) ctx->bat_us * 1000;
+	sd.left = 0;
+	rmr_sym_foreach_class( rt->ephash, 1, bat_sweep_ep, &sd );
+	release_rt( ctx, rt );
+
+	return sd.left;
+}
+
+/*
+	Write every batched frame, waiting (up to BAT_DRAIN_MS) for blocked sessions
+	to drain. Used at close once nothing else can send. Returns the number of
+	endpoints still holding frames when the wait expired.
+*/
+static int bat_drain( uta_ctx_t* ctx ) {
+	int		left;
+	int		i;
+
+	for( i = 0; (left = bat_sweep( ctx, TRUE )) > 0 && i < BAT_DRAIN_MS; i++ ) {
+		usleep( 1000 );
+	}
+
+	if( left > 0 ) {
+		rmr_vlog( RMR_VL_WARN, "close: batched messages for %d endpoints could not be written\n", left );
+	}
+
+	return left;
+}
+
+/*
+	The flusher thread. Sleeps until something is buffered, then sweeps every half
+	budget until nothing is. The sleep is a wait on the wake semaphore so that a
+	change to the budget takes effect at once.
+*/
+static void* bat_flusher( void* data ) {
+	uta_ctx_t*		ctx;
+	struct timespec	ts;
+	long			ns;
+
+	if( (ctx = (uta_ctx_t *) data) == NULL ) {
+		return NULL;
+	}
+
+	prctl( PR_SET_TIMERSLACK, 1UL, 0, 0, 0 );				// default slack (50us) would be the whole budget
+
+	while( ! ctx->shutdown ) {
+		clock_gettime( CLOCK_REALTIME, &ts );
+		if( __atomic_load_n( &ctx->bat_pending, __ATOMIC_RELAXED ) <= 0 ) {
+			ts.tv_sec++;										// wake now and then to notice shutdown
+			sem_timedwait( &ctx->bat_wake, &ts );
+			continue;
+		}
+
+		ns = ts.tv_nsec + ((long) ctx->bat_us * 1000) / 2;
+		ts.tv_sec += ns / 1000000000;
+		ts.tv_nsec = ns % 1000000000;
+		sem_timedwait( &ctx->bat_wake, &ts );
+
+		bat_sweep( ctx, FALSE );
+	}
+
+	return NULL;
+}
+
+/*
+	Set the batch size and budget, starting the flusher the first time batching
+	is turned on. When batching is turned off everything buffered is written.
+*/
+static int bat_config( uta_ctx_t* ctx, int max_bytes, int max_us ) {
+	int		expect = 0;
+
+	if( max_bytes <= 0 ) {
+		__atomic_store_n( &ctx->bat_bytes, 0, __ATOMIC_RELEASE );
+		bat_sweep( ctx, TRUE );
+		return RMR_OK;
+	}
+
+	ctx->bat_us = max_us > 0 ? max_us : BAT_DEF_US;
+	if( ctx->bat_running ) {
+		sem_post( &ctx->bat_wake );								// flusher may be waiting out the old budget
+	}
+	if( __atomic_compare_exchange_n( &ctx->bat_running, &expect, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		sem_init( &ctx->bat_wake, 0, 0 );
+		if( pthread_create( &ctx->bat_th, NULL, bat_flusher, (void *) ctx ) ) {
+			rmr_vlog( RMR_VL_ERR, "unable to start batch flush thread; batching not enabled: %s\n", strerror( errno ) );
+			__atomic_store_n( &ctx->bat_running, 0, __ATOMIC_RELEASE );
+			return RMR_ERR_INITFAILED;
+		}
+	}
+
+	__atomic_store_n( &ctx->bat_bytes, max_bytes, __ATOMIC_RELEASE );
+	return RMR_OK;
+}
+
+#endif
@@ -0,0 +1,232 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	cb_si_static.c
+	Abstract:	Per endpoint circuit breaker. When an endpoint which is not
+				connected is selected, the sending thread tries to connect
+				(uta_link2()), and waits for the connect to time out if the
+				peer is down. After a number of consecutive failed connects
+				(RMR_CB_FAILS) the endpoint's breaker opens: senders no longer
+				try to connect, the send fails at once (or, in a round robin
+				group, goes to another member whose breaker is closed).
+
+				A probe thread, started when the first breaker opens, tries
+				to connect to each endpoint whose breaker is open; a timer on
+				the timing wheel wakes it when the endpoint's probe is due. While the
+				probe is running the breaker is half open (senders still fail
+				fast). If the probe connects the session is used and the
+				breaker closes; if not, it opens again and the wait before
+				the next probe doubles, up to a limit.
+
+				The state changes are logged, and the connects that failed,
+				the times the breaker opened, and the sends refused while it
+				was open are counted for rmr_get_send_stats().
+
+	Date:		18 October 2026
+*/
+
+#ifndef _cb_si_static_c
+#define _cb_si_static_c
+
+#define CB_DEF_FAILS		3						// consecutive failed connects which open the breaker
+#define CB_PROBE_MIN_NS		(100 * 1000000ULL)		// wait before the first probe
+#define CB_PROBE_MAX_NS		(5000 * 1000000ULL)		// longest wait between probes
+
+/*
+	Return true if the endpoint's breaker is closed (a sender may try to connect).
+*/
+static inline int cb_closed( endpoint_t* ep ) {
+	return __atomic_load_n( &ep->cb_state, __ATOMIC_ACQUIRE ) == CB_CLOSED;
+}
+
+/*
+	Called before a sender tries to connect. Returns true if it may; if not the
+	refused send is counted and errno is set.
+*/
+static int cb_allow( endpoint_t* ep ) {
+	if( cb_closed( ep ) ) {
+		return TRUE;
+	}
+
+	__atomic_add_fetch( &ep->cb_fast_fails, 1, __ATOMIC_RELAXED );
+	errno = EHOSTUNREACH;
+	return FALSE;
+}
+
+/*
+	Called when a sender's connect to the endpoint failed. Opens the breaker once
+	enough have failed in a row, and makes sure the probe thread is running.
+*/
+static void cb_failed( uta_ctx_t* ctx, endpoint_t* ep ) {
+	int		expect = CB_CLOSED;
+	int		nfails;
+
+	__atomic_add_fetch( &ep->connect_fails, 1, __ATOMIC_RELAXED );
+	nfails = __atomic_add_fetch( &ep->cb_nfails, 1, __ATOMIC_RELAXED );
+	if( ctx->cb_fails <= 0 || nfails < ctx->cb_fails ) {
+		return;
+	}
+
+	if( ! cb_start( ctx ) ) {
+		return;											// without a probe the breaker could never close
+	}
+
+	if( ! __atomic_compare_exchange_n( &ep->cb_state, &expect, CB_OPEN, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		return;											// another thread opened it
+	}
+
+	ep->cb_backoff = CB_PROBE_MIN_NS;
+	ep->cb_until = sr_now_ns( ) + ep->cb_backoff;
+	__atomic_add_fetch( &ep->cb_trips, 1, __ATOMIC_RELAXED );
+	__atomic_add_fetch( &ctx->cb_nopen, 1, __ATOMIC_RELAXED );
+	rmr_vlog( RMR_VL_WARN, "rmr: circuit opened for %s after %d failed connects; sends will fail until a probe connects\n", ep->name, nfails );
+
+	tw_arm( ctx, &ep->cb_timer, ep->cb_until, tw_post, &ctx->cb_wake );		// wakes the probe thread when the probe is due
+}
+
+/*
+	Called when a sender's connect to the endpoint worked.
+*/
+static inline void cb_connected( endpoint_t* ep ) {
+	if( ep->cb_nfails ) {
+		__atomic_store_n( &ep->cb_nfails, 0, __ATOMIC_RELAXED );
+	}
+}
+
+/*
+	Try to connect to an endpoint whose breaker is open. Only the probe thread
+	does this, so senders never wait for the connect.
+*/
+static void cb_probe( uta_ctx_t* ctx, endpoint_t* ep ) {
+	int		expect = CB_OPEN;
+	int		sock;
+
+	if( ! __atomic_compare_exchange_n( &ep->cb_state, &expect, CB_HALF, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		return;
+	}
+
+	pthread_mutex_lock( &ep->gate );
+	if( ! ep->open ) {
+		if( (sock = SIconnect( ctx->si_ctx, ep->name )) < 0 ) {
+			pthread_mutex_unlock( &ep->gate );
+
+			ep->cb_backoff *= 2;
+			if( ep->cb_backoff > CB_PROBE_MAX_NS ) {
+				ep->cb_backoff = CB_PROBE_MAX_NS;
+			}
+			ep->cb_until = sr_now_ns( ) + ep->cb_backoff;
+			__atomic_add_fetch( &ep->connect_fails, 1, __ATOMIC_RELAXED );
+			__atomic_store_n( &ep->cb_state, CB_OPEN, __ATOMIC_RELEASE );
+			tw_arm( ctx, &ep->cb_timer, ep->cb_until, tw_post, &ctx->cb_wake );
+			return;
+		}
+
+		ep->nn_sock = sock;
+		ep->open = TRUE;
+		fd2ep_add( ctx, ep->nn_sock, ep );
+		ep->notify = 1;
+	}
+	pthread_mutex_unlock( &ep->gate );
+
+	__atomic_store_n( &ep->cb_nfails, 0, __ATOMIC_RELAXED );
+	__atomic_store_n( &ep->cb_state, CB_CLOSED, __ATOMIC_RELEASE );
+	__atomic_sub_fetch( &ctx->cb_nopen, 1, __ATOMIC_RELAXED );
+	rmr_vlog( RMR_VL_INFO, "rmr: circuit closed for %s; probe connected (%llu sends refused while open)\n",
+		ep->name, (unsigned long long) __atomic_load_n( &ep->cb_fast_fails, __ATOMIC_RELAXED ) );
+}
+
+/*
+	Symtab foreach callback: probe the endpoint if its breaker is open and the
+	wait has passed.
+*/
+static void cb_sweep_ep( void* st, void* entry, char const* name, void* thing, void* vdata ) {
+	endpoint_t*	ep;
+	uta_ctx_t*	ctx;
+
+	if( (ep = (endpoint_t *) thing) == NULL || (ctx = (uta_ctx_t *) vdata) == NULL ) {
+		return;
+	}
+
+	if( __atomic_load_n( &ep->cb_state, __ATOMIC_ACQUIRE ) == CB_OPEN && sr_now_ns( ) >= ep->cb_until ) {
+		cb_probe( ctx, ep );
+	}
+}
+
+/*
+	Probe every endpoint in the active route table which is due.
+*/
+static void cb_sweep( uta_ctx_t* ctx ) {
+	route_table_t*	rt;
+
+	if( (rt = get_rt( ctx )) == NULL ) {
+		return;
+	}
+
+	rmr_sym_foreach_class( rt->ephash, 1, cb_sweep_ep, ctx );
+	release_rt( ctx, rt );
+}
+
+/*
+	The probe thread. Each open breaker has a timer on the timing wheel which
+	posts the wake semaphore when its probe is due; the thread then probes the
+	endpoints which are due. The connect is made here rather than on the wheel's
+	thread as it may block.
+*/
+static void* cb_prober( void* data ) {
+	uta_ctx_t*		ctx;
+	struct timespec	ts;
+
+	if( (ctx = (uta_ctx_t *) data) == NULL ) {
+		return NULL;
+	}
+
+	while( ! ctx->shutdown ) {
+		clock_gettime( CLOCK_REALTIME, &ts );
+		ts.tv_sec++;										// wake now and then to notice shutdown
+		if( sem_timedwait( &ctx->cb_wake, &ts ) == 0 && __atomic_load_n( &ctx->cb_nopen, __ATOMIC_RELAXED ) > 0 ) {
+			cb_sweep( ctx );
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Start the probe thread if it is not running. Returns false if it could not
+	be started. The wake semaphore is set up when the context is.
+*/
+static int cb_start( uta_ctx_t* ctx ) {
+	int		expect = 0;
+
+	if( ! __atomic_compare_exchange_n( &ctx->cb_running, &expect, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		return TRUE;
+	}
+
+	if( pthread_create( &ctx->cb_th, NULL, cb_prober, (void *) ctx ) ) {
+		rmr_vlog( RMR_VL_CRIT, "rmr: unable to start circuit breaker probe thread: %s\n", strerror( errno ) );
+		__atomic_store_n( &ctx->cb_running, 0, __ATOMIC_RELEASE );
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+#endif
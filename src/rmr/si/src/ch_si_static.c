@@ -0,0 +1,338 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	ch_si_static.c
+	Abstract:	Compact (v4) wire headers.
+
+				The full header carries fixed length source name, source ip,
+				meid, xid and sid fields; for small messages these are more
+				than half of the bytes sent. When both sides enable compact
+				headers (RMR_COMPACT_HDR=1) a sender offers them (HFL_CH_CAP) on
+				sessions it opened, and a receiver accepts with a header only
+				control frame written back on the same connection (as flow
+				control grants are). Once accepted, the sender writes a compact
+				header in which the fixed length fields carry only their
+				significant bytes, and the sender's identity (src and srcip) is
+				sent only in the first frame on the connection; later frames
+				carry a small connection scoped id which the receiver maps back
+				to the identity.
+
+				The compact header exists only on the wire. The receive thread
+				expands each compact frame into a new buffer with a full header,
+				so ref_tpbuf(), rmr_get_src(), rmr_rts_msg() and everything else
+				see exactly what they would have had the full header been sent.
+				The expansion copies the message, so messages with a large
+				payload (where the header savings do not matter) are always
+				sent with the full header.
+
+				A back level peer never offers or accepts compact headers, so it
+				never sees one. All state is per connection and is dropped when
+				the connection is lost.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _ch_si_static_c
+#define _ch_si_static_c
+
+#define CH_CTL_ACCEPT	(-2)				// mtype of the control frame accepting compact headers
+#define CH_SELF_ID		1					// the id our own identity is interned as
+#define CH_MAX_PLEN		2048				// larger payloads are sent with the full header
+#define CH_MAX_XLEN		0xffff				// max trace, d1 and d2 lengths which can be represented
+
+/*
+	Return the number of significant bytes in a fixed length header field; the
+	field is nil filled, so trailing nils are dropped and restored on receipt.
+*/
+static inline int ch_siglen( unsigned char const* field, int len ) {
+	while( len > 0 && field[len-1] == 0 ) {
+		len--;
+	}
+
+	return len;
+}
+
+/*
+	Build the transport header and compact header for the message whose (full)
+	header is given, into buf which must be at least CH_BUF_LEN bytes. The full
+	header must already have type, length and sub-id set in network byte order.
+	The trace, d1 and d2 data and the payload are not copied; they follow in the
+	send exactly as they sit after the full header.
+
+	Returns the number of bytes in buf, or 0 if the message cannot be compacted
+	(in which case it must be sent with its full header). Ident is set to true if
+	our interned identity was included; once that frame has been sent the caller
+	marks the endpoint so that later frames carry only the id.
+*/
+static int ch_encode( uta_ctx_t* ctx, endpoint_t* ep, uta_mhdr_t* hdr, char* buf, int* ident ) {
+	uta_v4mhdr_t*	chdr;
+	unsigned char*	next;
+	int		slen;			// string lengths, including the nil
+	int		iplen;
+
+	*ident = FALSE;
+	if( ntohl( hdr->plen ) > CH_MAX_PLEN || RMR_TR_LEN( hdr ) > CH_MAX_XLEN || RMR_D1_LEN( hdr ) > CH_MAX_XLEN || RMR_D2_LEN( hdr ) > CH_MAX_XLEN ) {
+		return 0;
+	}
+
+	memset( buf, 0, TP_HDR_LEN + sizeof( *chdr ) );
+	chdr = (uta_v4mhdr_t *) (buf + TP_HDR_LEN);
+	chdr->mtype = hdr->mtype;									// already in network order
+	chdr->plen = hdr->plen;
+	chdr->rmr_ver = htonl( RMR_CH_VER );
+	chdr->sub_id = hdr->sub_id;
+	chdr->flags = htons( (uint16_t) hdr->flags );
+	chdr->len1 = htons( (uint16_t) RMR_TR_LEN( hdr ) );
+	chdr->len2 = htons( (uint16_t) RMR_D1_LEN( hdr ) );
+	chdr->len3 = htons( (uint16_t) RMR_D2_LEN( hdr ) );
+
+	next = (unsigned char *) (chdr + 1);
+	if( strncmp( (char *) hdr->src, ctx->my_name, RMR_MAX_SRC ) == 0 && strncmp( (char *) hdr->srcip, ctx->my_ip, RMR_MAX_SRC ) == 0 ) {
+		chdr->src_id = htons( CH_SELF_ID );
+		*ident = ! __atomic_load_n( &ep->ch_ident, __ATOMIC_ACQUIRE );
+	}																// else not ours; the identity goes in every frame
+
+	if( chdr->src_id == 0 || *ident ) {
+		slen = strnlen( (char *) hdr->src, RMR_MAX_SRC - 1 ) + 1;
+		iplen = strnlen( (char *) hdr->srcip, RMR_MAX_SRC - 1 ) + 1;
+		memcpy( next, hdr->src, slen - 1 );
+		next[slen-1] = 0;
+		memcpy( next + slen, hdr->srcip, iplen - 1 );
+		next[slen+iplen-1] = 0;
+		chdr->ident_len = slen + iplen;
+		next += slen + iplen;
+	}
+
+	chdr->xid_len = ch_siglen( hdr->xid, RMR_MAX_XID );
+	memcpy( next, hdr->xid, chdr->xid_len );
+	next += chdr->xid_len;
+	chdr->sid_len = ch_siglen( hdr->sid, RMR_MAX_SID );
+	memcpy( next, hdr->sid, chdr->sid_len );
+	next += chdr->sid_len;
+	chdr->meid_len = ch_siglen( hdr->meid, RMR_MAX_MEID );
+	memcpy( next, hdr->meid, chdr->meid_len );
+	next += chdr->meid_len;
+
+	return (int) (((char *) next) - buf);
+}
+
+/*
+	Return the river for the fd. Only called on the receive thread, so the hash
+	can be searched.
+*/
+static inline river_t* ch_river( uta_ctx_t* ctx, int fd ) {
+	if( fd >= 0 && fd < ctx->nrivers && ctx->rivers != NULL ) {
+		return &ctx->rivers[fd];
+	}
+
+	if( fd < 0 || ctx->river_hash == NULL ) {
+		return NULL;
+	}
+	return (river_t *) rmr_sym_pull( ctx->river_hash, (uint64_t) fd );
+}
+
+/*
+	Given a raw (transport) buffer holding a compact header frame, build a new
+	buffer with the message expanded to have a full header. The raw buffer is
+	released (it is described by tpflags) and the new buffer is returned with
+	msg_size and tpflags updated to describe it. Nil is returned, and the raw
+	buffer released, if the frame is bad or references an identity that the
+	receiver does not have.
+*/
+static char* ch_expand( uta_ctx_t* ctx, char* raw, int* msg_size, int fd, int* tpflags ) {
+	uta_v4mhdr_t*	chdr;
+	uta_mhdr_t*		hdr;
+	river_t*		river;
+	unsigned char*	next;
+	unsigned char*	end;
+	char*			ident = NULL;		// identity: src, nil, srcip, nil
+	char*			new_buf;
+	int				dlen;				// trace, d1, d2 and payload bytes
+	int				size;
+	int				id;
+
+	if( *msg_size < (int) (TP_HDR_LEN + sizeof( *chdr )) ) {
+		rmr_vlog( RMR_VL_ERR, "compact header frame dropped: too short (%d)\n", *msg_size );
+		tpb_put( raw, *tpflags );
+		return NULL;
+	}
+
+	chdr = (uta_v4mhdr_t *) (raw + TP_HDR_LEN);
+	next = (unsigned char *) (chdr + 1);
+	end = ((unsigned char *) raw) + *msg_size;
+	if( ntohl( chdr->plen ) > (uint32_t) *msg_size ) {
+		dlen = *msg_size;											// force the check below to fail
+	} else {
+		dlen = ntohs( chdr->len1 ) + ntohs( chdr->len2 ) + ntohs( chdr->len3 ) + (int) ntohl( chdr->plen );
+	}
+	if( chdr->xid_len > RMR_MAX_XID || chdr->sid_len > RMR_MAX_SID || chdr->meid_len > RMR_MAX_MEID ||
+		next + chdr->ident_len + chdr->xid_len + chdr->sid_len + chdr->meid_len + dlen > end ) {
+
+		rmr_vlog( RMR_VL_ERR, "compact header frame dropped: lengths exceed frame size (%d)\n", *msg_size );
+		tpb_put( raw, *tpflags );
+		return NULL;
+	}
+
+	river = ch_river( ctx, fd );
+	id = ntohs( chdr->src_id );
+	if( chdr->ident_len > 0 ) {
+		ident = (char *) next;
+		if( ident[chdr->ident_len-1] != 0 || strnlen( ident, chdr->ident_len ) >= chdr->ident_len - 1 ) {		// must be two nil terminated strings
+			rmr_vlog( RMR_VL_ERR, "compact header frame dropped: bad identity\n" );
+			tpb_put( raw, *tpflags );
+			return NULL;
+		}
+
+		if( id > 0 && id < CH_MAX_IDS && river != NULL ) {			// intern for later frames on this connection
+			free( river->ch_ids[id] );
+			if( (river->ch_ids[id] = (char *) malloc( chdr->ident_len )) != NULL ) {
+				memcpy( river->ch_ids[id], ident, chdr->ident_len );
+			}
+		}
+		next += chdr->ident_len;
+	} else {
+		if( id > 0 && id < CH_MAX_IDS && river != NULL ) {
+			ident = river->ch_ids[id];
+		}
+		if( ident == NULL ) {
+			rmr_vlog( RMR_VL_ERR, "compact header frame dropped: sender identity %d not known on fd=%d\n", id, fd );
+			tpb_put( raw, *tpflags );
+			return NULL;
+		}
+	}
+
+	size = TP_HDR_LEN + sizeof( uta_mhdr_t ) + dlen;
+	if( (new_buf = (char *) tpb_alloc( size )) == NULL ) {
+		tpb_put( raw, *tpflags );
+		return NULL;
+	}
+	memset( new_buf, 0, TP_HDR_LEN + sizeof( uta_mhdr_t ) );
+	insert_mlen( (uint32_t) size, new_buf );
+
+	hdr = (uta_mhdr_t *) (new_buf + TP_HDR_LEN);
+	hdr->mtype = chdr->mtype;
+	hdr->plen = chdr->plen;
+	hdr->rmr_ver = htonl( RMR_MSG_VER );
+	hdr->sub_id = chdr->sub_id;
+	hdr->flags = ntohs( chdr->flags );
+	SET_HDR_LEN( hdr );
+	SET_HDR_TR_LEN( hdr, ntohs( chdr->len1 ) );
+	SET_HDR_D1_LEN( hdr, ntohs( chdr->len2 ) );
+	SET_HDR_D2_LEN( hdr, ntohs( chdr->len3 ) );
+	zt_buf_fill( (char *) hdr->src, ident, RMR_MAX_SRC );
+	zt_buf_fill( (char *) hdr->srcip, ident + strlen( ident ) + 1, RMR_MAX_SRC );
+
+	memcpy( hdr->xid, next, chdr->xid_len );
+	next += chdr->xid_len;
+	memcpy( hdr->sid, next, chdr->sid_len );
+	next += chdr->sid_len;
+	memcpy( hdr->meid, next, chdr->meid_len );
+	next += chdr->meid_len;
+
+	memcpy( TRACE_ADDR( hdr ), next, dlen );						// trace, d1, d2 and payload are contiguous in both
+
+	tpb_put( raw, *tpflags );
+	*tpflags = MFL_TPPOOL;
+	*msg_size = size;
+	return new_buf;
+}
+
+/*
+	Write the header only control frame accepting compact headers on the fd.
+*/
+static void ch_send_accept( uta_ctx_t* ctx, int fd ) {
+	char		frame[TP_HDR_LEN + sizeof( uta_mhdr_t )];
+	uta_mhdr_t*	hdr;
+
+	memset( frame, 0, sizeof( frame ) );
+	insert_mlen( (uint32_t) sizeof( frame ), frame );
+
+	hdr = (uta_mhdr_t *) (frame + TP_HDR_LEN);
+	hdr->mtype = htonl( CH_CTL_ACCEPT );
+	hdr->sub_id = htonl( UNSET_SUBID );
+	hdr->rmr_ver = htonl( RMR_MSG_VER );
+	hdr->flags = HFL_CTL;
+	SET_HDR_LEN( hdr );
+
+	if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "compact headers: accepting on fd=%d\n", fd );
+	SIsendt( ctx->si_ctx, fd, frame, sizeof( frame ) );
+}
+
+/*
+	Called by the receive thread for each message which arrives with the compact
+	header offer set. If we accept compact headers, and have not yet done so on
+	this connection, the accept control frame is written back.
+*/
+static void ch_open_flow( uta_ctx_t* ctx, int fd ) {
+	river_t*	river;
+
+	if( ! ctx->ch_on || (river = ch_river( ctx, fd )) == NULL || (river->flags & RF_CH_ON) ) {
+		return;
+	}
+
+	river->flags |= RF_CH_ON;
+	ch_send_accept( ctx, fd );
+}
+
+/*
+	Process an accept control frame which arrived on fd; the endpoint that we
+	connected to on the fd may now be sent compact headers. Frames arriving on a
+	session that we did not open are ignored.
+*/
+static void ch_ctl_frame( uta_ctx_t* ctx, int fd ) {
+	endpoint_t*	ep;
+
+	if( ! ctx->ch_on || (ep = fd2ep_get( ctx, fd )) == NULL ) {
+		return;
+	}
+
+	__atomic_store_n( &ep->ch_on, 1, __ATOMIC_RELEASE );
+}
+
+/*
+	Reset the sender side state when the connection to the endpoint is lost; the
+	next connection must negotiate again and resend the identity.
+*/
+static void ch_reset_ep( endpoint_t* ep ) {
+	if( ep != NULL ) {
+		__atomic_store_n( &ep->ch_on, 0, __ATOMIC_RELEASE );
+		__atomic_store_n( &ep->ch_ident, 0, __ATOMIC_RELEASE );
+	}
+}
+
+/*
+	Drop the identities interned on a connection.
+*/
+static void ch_reset_river( river_t* river ) {
+	int		i;
+
+	if( river == NULL ) {
+		return;
+	}
+
+	for( i = 0; i < CH_MAX_IDS; i++ ) {
+		free( river->ch_ids[i] );
+		river->ch_ids[i] = NULL;
+	}
+	river->flags &= ~RF_CH_ON;
+}
+
+#endif
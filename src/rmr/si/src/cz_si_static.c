@@ -0,0 +1,442 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	cz_si_static.c
+	Abstract:	Per message type payload compression.
+
+				The application enables compression for a message type with
+				rmr_set_compress(), giving the smallest payload worth the CPU.
+				When such a message is sent the payload is compressed into a
+				separate buffer which is sent (gathered) after the headers
+				from the message buffer; the message itself is not changed.
+				The compressed payload is the original length (4 bytes, network
+				order) followed by the codec output, and HFL_COMP is set in the
+				header. If the codec does not make the payload smaller it is
+				sent as is.
+
+				The receive thread decompresses flagged messages into a new
+				buffer before the mbuf is built, so the application (and
+				ref_tpbuf()) never sees a compressed payload. A receiver does
+				not need compression enabled for the type, but it must have
+				the same codec as the sender.
+
+				Compression is negotiated per connection as compact headers
+				are: a sender with compression enabled offers it (HFL_CZ_CAP)
+				on sessions it opened, and the receiver accepts with a header
+				only control frame written back on the same connection. Until
+				the accept arrives, and on sessions the sender did not open
+				(return to sender), payloads are sent uncompressed; a back
+				level peer never accepts, so it never sees a compressed
+				payload. A broadcast is compressed only if every member of
+				the group has accepted.
+
+				The built in codec is a byte oriented LZ77 (the LZ4 block
+				layout: a token with literal and match length nibbles, the
+				literals, and a two byte little endian match offset). It is
+				tuned for speed rather than ratio. A different codec can be
+				installed with rmr_set_codec().
+
+	Date:		18 October 2026
+*/
+
+#ifndef _cz_si_static_c
+#define _cz_si_static_c
+
+#define CZ_CTL_ACCEPT	(-3)				// mtype of the control frame accepting compressed payloads
+#define CZ_HDR_LEN		4					// original payload length ahead of the codec output
+#define CZ_DEF_MIN		256					// default smallest payload compressed
+#define CZ_MAX_OLEN		(64 * 1024 * 1024)	// larger original lengths are assumed to be bad frames
+
+#define CZ_HASH_BITS	12					// hash table size; smaller payloads use fewer bits so that clearing it is cheap
+#define CZ_SMALL_BITS	9
+#define CZ_SMALL_LEN	2048
+#define CZ_SKIP_SHIFT	5					// each 32 bytes without a match increases the search step by one
+#define CZ_MIN_MATCH	4
+#define CZ_LAST_LITS	5					// trailing bytes always sent as literals
+#define CZ_MAX_OFFSET	65535
+
+static inline uint32_t cz_read32( unsigned char const* p ) {
+	uint32_t	v;
+
+	memcpy( &v, p, sizeof( v ) );
+	return v;
+}
+
+/*
+	Write a length extension (the part of a length beyond the nibble) as a run of
+	255s and the remainder.
+*/
+static inline unsigned char* cz_put_len( unsigned char* op, int len ) {
+	while( len >= 255 ) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char) len;
+
+	return op;
+}
+
+/*
+	Built in compressor. Returns the number of bytes written to dest, or 0 if the
+	output would not fit in max bytes.
+*/
+static int cz_lz_compress( void* data, unsigned char const* src, int len, unsigned char* dest, int max ) {
+	uint32_t	htab[1 << CZ_HASH_BITS];	// most recent position (+1) of each hashed 4 byte sequence
+	unsigned char*	op;
+	unsigned char*	oend;
+	unsigned char*	token;
+	uint32_t	seq;
+	uint32_t	h;
+	int			ip = 0;
+	int			anchor = 0;				// start of pending literals
+	int			ref;
+	int			mlen;
+	int			llen;
+	int			mlimit;
+	int			hbits;
+
+	if( len < 0 || max <= 0 ) {
+		return 0;
+	}
+
+	hbits = len < CZ_SMALL_LEN ? CZ_SMALL_BITS : CZ_HASH_BITS;
+	memset( htab, 0, sizeof( uint32_t ) << hbits );
+	op = dest;
+	oend = dest + max;
+	mlimit = len - CZ_LAST_LITS;
+
+	while( ip + CZ_MIN_MATCH <= mlimit ) {
+		seq = cz_read32( src + ip );
+		h = (seq * 2654435761U) >> (32 - hbits);
+		ref = (int) htab[h] - 1;
+		htab[h] = ip + 1;
+		if( ref < 0 || ip - ref > CZ_MAX_OFFSET || cz_read32( src + ref ) != seq ) {
+			ip += 1 + ((ip - anchor) >> CZ_SKIP_SHIFT);		// skip faster through data that is not compressing
+			continue;
+		}
+
+		mlen = CZ_MIN_MATCH;
+		while( ip + mlen < mlimit && src[ref + mlen] == src[ip + mlen] ) {
+			mlen++;
+		}
+
+		llen = ip - anchor;
+		if( op + 1 + (llen / 255) + 1 + llen + 2 + ((mlen - CZ_MIN_MATCH) / 255) + 1 > oend ) {
+			return 0;
+		}
+
+		token = op++;
+		if( llen >= 15 ) {
+			*token = 15 << 4;
+			op = cz_put_len( op, llen - 15 );
+		} else {
+			*token = llen << 4;
+		}
+		memcpy( op, src + anchor, llen );
+		op += llen;
+
+		*op++ = (ip - ref) & 0xff;
+		*op++ = (ip - ref) >> 8;
+		if( mlen - CZ_MIN_MATCH >= 15 ) {
+			*token |= 15;
+			op = cz_put_len( op, mlen - CZ_MIN_MATCH - 15 );
+		} else {
+			*token |= mlen - CZ_MIN_MATCH;
+		}
+
+		ip += mlen;
+		anchor = ip;
+	}
+
+	llen = len - anchor;										// last sequence is literals only
+	if( op + 1 + (llen / 255) + 1 + llen > oend ) {
+		return 0;
+	}
+	token = op++;
+	if( llen >= 15 ) {
+		*token = 15 << 4;
+		op = cz_put_len( op, llen - 15 );
+	} else {
+		*token = llen << 4;
+	}
+	memcpy( op, src + anchor, llen );
+	op += llen;
+
+	return (int) (op - dest);
+}
+
+/*
+	Built in decompressor. Returns the number of bytes written to dest, or -1 if
+	the input is malformed or would overrun dest.
+*/
+static int cz_lz_decompress( void* data, unsigned char const* src, int len, unsigned char* dest, int max ) {
+	int		ip = 0;
+	int		op = 0;
+	int		token;
+	int		llen;
+	int		mlen;
+	int		off;
+	int		b;
+
+	while( ip < len ) {
+		token = src[ip++];
+
+		llen = token >> 4;
+		if( llen == 15 ) {
+			do {
+				if( ip >= len ) {
+					return -1;
+				}
+				b = src[ip++];
+				llen += b;
+			} while( b == 255 );
+		}
+		if( llen > len - ip || llen > max - op ) {
+			return -1;
+		}
+		memcpy( dest + op, src + ip, llen );
+		ip += llen;
+		op += llen;
+
+		if( ip == len ) {										// last sequence has no match
+			break;
+		}
+
+		if( ip + 2 > len ) {
+			return -1;
+		}
+		off = src[ip] | (src[ip+1] << 8);
+		ip += 2;
+		if( off == 0 || off > op ) {
+			return -1;
+		}
+
+		mlen = token & 0x0f;
+		if( mlen == 15 ) {
+			do {
+				if( ip >= len ) {
+					return -1;
+				}
+				b = src[ip++];
+				mlen += b;
+			} while( b == 255 );
+		}
+		mlen += CZ_MIN_MATCH;
+		if( mlen > max - op ) {
+			return -1;
+		}
+
+		if( off >= mlen ) {
+			memcpy( dest + op, dest + op - off, mlen );
+			op += mlen;
+		} else {
+			while( mlen-- > 0 ) {								// overlapping; must go a byte at a time
+				dest[op] = dest[op - off];
+				op++;
+			}
+		}
+	}
+
+	return op;
+}
+
+/*
+	Return the codec for the context; the built in one unless the user set one.
+*/
+static inline void cz_codec( uta_ctx_t* ctx, rmr_codec_t* codec ) {
+	if( ctx->cz_codec.compress != NULL ) {
+		*codec = ctx->cz_codec;
+	} else {
+		codec->compress = cz_lz_compress;
+		codec->decompress = cz_lz_decompress;
+		codec->data = NULL;
+	}
+}
+
+/*
+	Returns true if the endpoint's peer accepted compressed payloads on the
+	current connection.
+*/
+static inline int cz_accepted( endpoint_t* ep ) {
+	return ep != NULL && __atomic_load_n( &ep->cz_on, __ATOMIC_ACQUIRE );
+}
+
+/*
+	If compression is enabled for the message's type, and the payload is at least
+	the type's minimum, compress the payload into a new buffer and fill in iov to
+	reference it. The buffer is returned and must be released (tpb_free()) by the
+	caller once sent. Nil is returned if the payload is not to be (or could not be)
+	compressed; the message is then sent as is.
+*/
+static unsigned char* cz_compress( uta_ctx_t* ctx, rmr_mbuf_t* msg, struct iovec* iov ) {
+	rmr_codec_t		codec;
+	unsigned char*	buf;
+	intptr_t		min_len;
+	uint32_t		olen;
+	int				clen;
+
+	if( ctx->cz_types == NULL ) {
+		return NULL;
+	}
+	min_len = (intptr_t) rmr_sym_pull( ctx->cz_types, (uint64_t) (uint32_t) msg->mtype );
+	if( min_len <= 0 || msg->len < min_len || msg->len <= CZ_HDR_LEN + 1 ) {
+		return NULL;
+	}
+
+	if( (buf = (unsigned char *) tpb_alloc( msg->len )) == NULL ) {
+		return NULL;
+	}
+
+	cz_codec( ctx, &codec );
+	clen = codec.compress( codec.data, msg->payload, msg->len, buf + CZ_HDR_LEN, msg->len - CZ_HDR_LEN - 1 );	// must be smaller to be worth it
+	if( clen <= 0 ) {
+		tpb_free( buf );
+		return NULL;
+	}
+
+	olen = htonl( (uint32_t) msg->len );
+	memcpy( buf, &olen, sizeof( olen ) );
+	iov->iov_base = buf;
+	iov->iov_len = clen + CZ_HDR_LEN;
+	return buf;
+}
+
+/*
+	Given a raw (transport) buffer holding a message with a compressed payload,
+	build a new buffer with the headers and the decompressed payload. The raw
+	buffer is released and the new buffer returned, with msg_size and tpflags
+	updated to describe it. Nil is returned, and the raw buffer released, if the
+	payload cannot be decompressed.
+*/
+static char* cz_expand( uta_ctx_t* ctx, char* raw, int* msg_size, int* tpflags ) {
+	rmr_codec_t	codec;
+	uta_mhdr_t*	hdr;
+	char*		new_buf;
+	uint32_t	olen;
+	int			hlen;				// transport and rmr header, plus trace, d1 and d2
+	int			clen;
+	int			size;
+
+	hdr = (uta_mhdr_t *) (raw + TP_HDR_LEN);
+	hlen = TP_HDR_LEN + RMR_HDR_LEN( hdr );
+	clen = (int) ntohl( hdr->plen ) - CZ_HDR_LEN;
+	if( clen < 0 ) {
+		rmr_vlog( RMR_VL_ERR, "compressed message dropped: payload too short (%d)\n", (int) ntohl( hdr->plen ) );
+		tpb_put( raw, *tpflags );
+		return NULL;
+	}
+
+	memcpy( &olen, PAYLOAD_ADDR( hdr ), sizeof( olen ) );
+	olen = ntohl( olen );
+	if( olen > CZ_MAX_OLEN ) {
+		rmr_vlog( RMR_VL_ERR, "compressed message dropped: bad original length (%u)\n", olen );
+		tpb_put( raw, *tpflags );
+		return NULL;
+	}
+
+	size = hlen + (int) olen;
+	if( (new_buf = (char *) tpb_alloc( size )) == NULL ) {
+		tpb_put( raw, *tpflags );
+		return NULL;
+	}
+
+	cz_codec( ctx, &codec );
+	if( codec.decompress( codec.data, (unsigned char *) PAYLOAD_ADDR( hdr ) + CZ_HDR_LEN, clen, (unsigned char *) new_buf + hlen, olen ) != (int) olen ) {
+		rmr_vlog( RMR_VL_ERR, "compressed message dropped: payload could not be decompressed: mtype=%d\n", (int) ntohl( hdr->mtype ) );
+		tpb_free( new_buf );
+		tpb_put( raw, *tpflags );
+		return NULL;
+	}
+
+	memcpy( new_buf, raw, hlen );
+	insert_mlen( (uint32_t) size, new_buf );
+	hdr = (uta_mhdr_t *) (new_buf + TP_HDR_LEN);
+	hdr->plen = htonl( olen );
+	hdr->flags &= ~HFL_COMP;
+
+	tpb_put( raw, *tpflags );
+	*tpflags = MFL_TPPOOL;
+	*msg_size = size;
+	return new_buf;
+}
+
+/*
+	Write the header only control frame accepting compressed payloads on the fd.
+*/
+static void cz_send_accept( uta_ctx_t* ctx, int fd ) {
+	char		frame[TP_HDR_LEN + sizeof( uta_mhdr_t )];
+	uta_mhdr_t*	hdr;
+
+	memset( frame, 0, sizeof( frame ) );
+	insert_mlen( (uint32_t) sizeof( frame ), frame );
+
+	hdr = (uta_mhdr_t *) (frame + TP_HDR_LEN);
+	hdr->mtype = htonl( CZ_CTL_ACCEPT );
+	hdr->sub_id = htonl( UNSET_SUBID );
+	hdr->rmr_ver = htonl( RMR_MSG_VER );
+	hdr->flags = HFL_CTL;
+	SET_HDR_LEN( hdr );
+
+	if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "compression: accepting on fd=%d\n", fd );
+	SIsendt( ctx->si_ctx, fd, frame, sizeof( frame ) );
+}
+
+/*
+	Called by the receive thread for each message which arrives with the
+	compression offer set. Any receiver can expand a payload, so the offer is
+	always accepted, once per connection.
+*/
+static void cz_open_flow( uta_ctx_t* ctx, int fd ) {
+	river_t*	river;
+
+	if( (river = ch_river( ctx, fd )) == NULL || (river->flags & RF_CZ_ON) ) {
+		return;
+	}
+
+	river->flags |= RF_CZ_ON;
+	cz_send_accept( ctx, fd );
+}
+
+/*
+	Process an accept control frame which arrived on fd; payloads sent to the
+	endpoint that we connected to on the fd may now be compressed.
+*/
+static void cz_ctl_frame( uta_ctx_t* ctx, int fd ) {
+	endpoint_t*	ep;
+
+	if( (ep = fd2ep_get( ctx, fd )) == NULL ) {
+		return;
+	}
+
+	__atomic_store_n( &ep->cz_on, 1, __ATOMIC_RELEASE );
+}
+
+/*
+	Reset the sender side state when the connection to the endpoint is lost; the
+	next connection must negotiate again.
+*/
+static void cz_reset_ep( endpoint_t* ep ) {
+	if( ep != NULL ) {
+		__atomic_store_n( &ep->cz_on, 0, __ATOMIC_RELEASE );
+	}
+}
+
+#endif
@@ -0,0 +1,315 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	dispatch_si_static.c
+	Abstract:	Message dispatcher. The application registers a handler for
+				each message type and starts a pool of worker threads; the
+				receive thread then hands each message with a registered type
+				directly to the pool rather than queuing it on the receive ring.
+				Messages with a type that has no handler are queued as before
+				and can be received with the normal receive functions.
+
+				Each worker owns a bounded queue. The receive thread is the only
+				writer and distributes messages round robin; any worker may take
+				from the head of any queue, so an idle worker steals from the
+				queues of busy ones. A counting semaphore tracks the number of
+				queued messages so that workers sleep only when there is no work
+				anywhere.
+
+				A handler may have a concurrency limit (1 serialises the handler).
+				When the limit is reached, messages are parked on the handler's
+				pending ring and run by the worker finishing the active invocation.
+				Per handler counts and run times are kept for rmr_get_handler_stats().
+
+	Date:		18 October 2026
+*/
+
+#ifndef _dispatch_si_static_c
+#define _dispatch_si_static_c
+
+#include <time.h>
+#include <semaphore.h>
+
+#define DQ_SIZE			1024			// slots in each worker queue (must be a power of 2)
+#define DQ_MASK			(DQ_SIZE - 1)
+#define DISP_PEND_SIZE	4096			// pending (over limit) ring size for a handler
+#define DISP_MAX_THREADS	256
+
+/*
+	Push a message onto a worker queue. Only the receive thread pushes, so the
+	tail needs no compare/exchange. Returns false if the queue is full.
+*/
+static inline int dq_push( dq_t* q, void* data ) {
+	uint32_t	t;
+
+	t = q->tail;
+	if( t - __atomic_load_n( &q->head, __ATOMIC_ACQUIRE ) >= DQ_SIZE ) {
+		return FALSE;
+	}
+
+	q->slots[t & DQ_MASK] = data;
+	__atomic_store_n( &q->tail, t + 1, __ATOMIC_RELEASE );
+	return TRUE;
+}
+
+/*
+	Take the oldest message from the queue; nil if empty. Called by the owner and
+	by thieves alike. The slot is read before the head is advanced; the producer
+	cannot reuse the slot until the head has moved, so a successful exchange
+	guarantees that the pointer read was the one queued.
+*/
+static inline void* dq_take( dq_t* q ) {
+	uint32_t	h;
+	void*		data;
+
+	h = __atomic_load_n( &q->head, __ATOMIC_ACQUIRE );
+	do {
+		if( h == __atomic_load_n( &q->tail, __ATOMIC_ACQUIRE ) ) {
+			return NULL;
+		}
+		data = q->slots[h & DQ_MASK];
+	} while( ! __atomic_compare_exchange_n( &q->head, &h, h + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) );
+
+	return data;
+}
+
+/*
+	Return the handler for the message type, or nil if there isn't one.
+*/
+static inline handler_t* disp_get_handler( dispatcher_t* disp, int mtype ) {
+	if( disp == NULL ) {
+		return NULL;
+	}
+
+	return (handler_t *) rmr_sym_pull( disp->handlers, (uint64_t) (uint32_t) mtype );
+}
+
+/*
+	Allocate the dispatcher on first use. Returns nil on error.
+*/
+static dispatcher_t* disp_ensure( uta_ctx_t* ctx ) {
+	dispatcher_t*	disp;
+
+	if( ctx->disp != NULL ) {
+		return ctx->disp;
+	}
+
+	if( (disp = (dispatcher_t *) malloc( sizeof( *disp ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( disp, 0, sizeof( *disp ) );
+
+	if( (disp->handlers = rmr_sym_alloc( 251 )) == NULL ) {
+		free( disp );
+		errno = ENOMEM;
+		return NULL;
+	}
+	sem_init( &disp->work, 0, 0 );
+	disp->ctx = ctx;
+
+	ctx->disp = disp;
+	return disp;
+}
+
+/*
+	Add elapsed time to the handler's stats.
+*/
+static inline void disp_account( handler_t* h, struct timespec* start ) {
+	struct timespec	end;
+	uint64_t		ns;
+	uint64_t		max;
+
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	ns = ((uint64_t) (end.tv_sec - start->tv_sec) * 1000000000ULL) + end.tv_nsec - start->tv_nsec;
+
+	__atomic_add_fetch( &h->count, 1, __ATOMIC_RELAXED );
+	__atomic_add_fetch( &h->total_ns, ns, __ATOMIC_RELAXED );
+	max = __atomic_load_n( &h->max_ns, __ATOMIC_RELAXED );
+	while( ns > max && ! __atomic_compare_exchange_n( &h->max_ns, &max, ns, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+}
+
+/*
+	Run the handler for a single message. If the handler returns a message
+	(it didn't send/keep the one given) it is freed here.
+*/
+static inline void disp_invoke( uta_ctx_t* ctx, handler_t* h, rmr_mbuf_t* mbuf ) {
+	struct timespec	start;
+
+	mbuf->state = RMR_OK;
+	mbuf->flags |= MFL_ADDSRC;					// turn on so if user app tries to send this buffer we reset src
+
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	if( (mbuf = h->fn( ctx, mbuf, h->arg )) != NULL ) {
+		rmr_free_msg( mbuf );
+	}
+	disp_account( h, &start );
+}
+
+/*
+	Run a message respecting the handler's concurrency limit. When the limit is
+	reached the message is parked and the thread which holds the active slot
+	runs it when its current invocation finishes.
+*/
+static void disp_run( uta_ctx_t* ctx, handler_t* h, rmr_mbuf_t* mbuf ) {
+	if( h->limit <= 0 ) {
+		disp_invoke( ctx, h, mbuf );
+		return;
+	}
+
+	pthread_mutex_lock( &h->gate );
+	if( h->active >= h->limit ) {
+		if( ! uta_ring_insert( h->pending, mbuf ) ) {
+			rmr_vlog( RMR_VL_ERR, "dispatch: pending queue for message type %d is full; message dropped\n", h->mtype );
+			rmr_free_msg( mbuf );
+		}
+		pthread_mutex_unlock( &h->gate );
+		return;
+	}
+	h->active++;
+	pthread_mutex_unlock( &h->gate );
+
+	while( mbuf != NULL ) {
+		disp_invoke( ctx, h, mbuf );
+
+		pthread_mutex_lock( &h->gate );
+		if( (mbuf = (rmr_mbuf_t *) uta_ring_extract( h->pending )) == NULL ) {
+			h->active--;
+		}
+		pthread_mutex_unlock( &h->gate );
+	}
+}
+
+/*
+	Worker thread. Each post to the work semaphore represents one queued message,
+	so once the wait is satisfied there is a message in some queue; start with our
+	own and then steal from the others.
+*/
+static void* disp_worker( void* data ) {
+	disp_worker_t*	me;
+	dispatcher_t*	disp;
+	uta_ctx_t*		ctx;
+	rmr_mbuf_t*		mbuf;
+	handler_t*		h;
+	int				i;
+
+	me = (disp_worker_t *) data;
+	disp = me->disp;
+	ctx = disp->ctx;
+
+	while( 1 ) {
+		while( sem_wait( &disp->work ) < 0 );		// EINTR just means try again
+
+		mbuf = NULL;
+		while( mbuf == NULL ) {
+			for( i = 0; i < disp->nthreads && mbuf == NULL; i++ ) {
+				mbuf = (rmr_mbuf_t *) dq_take( &disp->queues[(me->idx + i) % disp->nthreads] );
+			}
+
+			if( mbuf == NULL && __atomic_load_n( &disp->stop, __ATOMIC_ACQUIRE ) ) {		// woken only to exit
+				return NULL;
+			}
+		}
+
+		if( (h = disp_get_handler( disp, mbuf->mtype )) != NULL ) {		// always found; handlers are never removed
+			disp_run( ctx, h, mbuf );
+		} else {
+			rmr_free_msg( mbuf );
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Called by the receive thread for each message. If the message has a handler
+	and the dispatcher is running it is given to a worker and true is returned.
+	False means the caller must queue the message normally.
+*/
+static inline int disp_queue( uta_ctx_t* ctx, rmr_mbuf_t* mbuf ) {
+	dispatcher_t*	disp;
+	int				i;
+	int				idx;
+
+	if( (disp = ctx->disp) == NULL || ! __atomic_load_n( &disp->running, __ATOMIC_ACQUIRE ) ) {
+		return FALSE;
+	}
+
+	if( disp_get_handler( disp, mbuf->mtype ) == NULL ) {
+		return FALSE;
+	}
+
+	fc_consumed( ctx, mbuf );						// handed to the application as far as the sender is concerned
+	for( i = 0; i < disp->nthreads; i++ ) {
+		idx = disp->next++ % disp->nthreads;
+		if( dq_push( &disp->queues[idx], mbuf ) ) {
+			sem_post( &disp->work );
+			return TRUE;
+		}
+	}
+
+	ctx->dcount++;									// every queue full; drop as the receive ring would
+	ctx->acc_dcount++;
+	rmr_free_msg( mbuf );
+	return TRUE;
+}
+
+/*
+	Stop the worker threads and wait for them to exit. Each worker keeps taking
+	messages until every queue is empty, so all messages queued before the stop
+	are run (a handler may still send). Any message which the receive thread
+	queued as the workers were exiting is run here. If called from a handler
+	the calling worker cannot be waited for; it exits when its handler returns.
+*/
+static void disp_stop( uta_ctx_t* ctx ) {
+	dispatcher_t*	disp;
+	rmr_mbuf_t*		mbuf;
+	handler_t*		h;
+	int				i;
+
+	if( ctx == NULL || (disp = ctx->disp) == NULL || ! disp->running ) {
+		return;
+	}
+
+	__atomic_store_n( &disp->running, 0, __ATOMIC_RELEASE );
+	__atomic_store_n( &disp->stop, 1, __ATOMIC_RELEASE );
+	for( i = 0; i < disp->nthreads; i++ ) {
+		sem_post( &disp->work );
+	}
+
+	for( i = 0; i < disp->nthreads; i++ ) {
+		if( ! pthread_equal( disp->threads[i], pthread_self() ) ) {
+			pthread_join( disp->threads[i], NULL );
+		}
+	}
+
+	for( i = 0; i < disp->nthreads; i++ ) {
+		while( (mbuf = (rmr_mbuf_t *) dq_take( &disp->queues[i] )) != NULL ) {
+			if( (h = disp_get_handler( disp, mbuf->mtype )) != NULL ) {
+				disp_run( ctx, h, mbuf );
+			} else {
+				rmr_free_msg( mbuf );
+			}
+		}
+	}
+}
+
+#endif
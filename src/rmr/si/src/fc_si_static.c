@@ -0,0 +1,218 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	fc_si_static.c
+	Abstract:	Credit based flow control between RMR peers.
+
+				A receiver which has enabled flow control (rmr_set_flow_ctl())
+				grants each sending connection an absolute message limit: the
+				number of messages from that connection which the application has
+				consumed plus the window. The grant is carried in the d2 area of a
+				header only control frame (HFL_CTL) written back on the connection
+				that the messages arrive on, which is the sender's outbound
+				connection, so the sender maps it to the endpoint using the fd2ep
+				hash.
+
+				Senders always advertise (HFL_FC_CAP) that they honour grants, and
+				a receiver only issues grants to flows which carry the flag, so a
+				back level peer on either side never sees a control frame and is
+				never limited.  Until the first grant arrives an endpoint is not
+				limited; after that send_msg() refuses to send beyond the limit and
+				returns RMR_ERR_RETRY without blocking.
+
+				Grants are absolute counts (allowed to wrap) and not deltas, so
+				a lost or duplicated grant does no lasting harm. Limits are per
+				connection only; per message type credits are not supported.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _fc_si_static_c
+#define _fc_si_static_c
+
+#define FC_GRANT_LEN	sizeof( uint32_t )		// bytes of d2 used to carry a grant
+
+/*
+	Attempt to take one credit from the endpoint. Returns true if the message
+	may be sent; false if the peer's limit has been reached. An endpoint that
+	has never received a grant is unlimited.
+*/
+static inline int fc_take( endpoint_t* ep ) {
+	uint32_t	sent;
+
+	if( ep == NULL || ! __atomic_load_n( &ep->fc_on, __ATOMIC_ACQUIRE ) ) {
+		return TRUE;
+	}
+
+	sent = __atomic_load_n( &ep->fc_sent, __ATOMIC_RELAXED );
+	do {
+		if( (int32_t) (__atomic_load_n( &ep->fc_limit, __ATOMIC_ACQUIRE ) - sent) <= 0 ) {
+			return FALSE;
+		}
+	} while( ! __atomic_compare_exchange_n( &ep->fc_sent, &sent, sent + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) );
+
+	return TRUE;
+}
+
+/*
+	Give back a credit taken for a message which was not sent.
+*/
+static inline void fc_untake( endpoint_t* ep ) {
+	if( ep != NULL && __atomic_load_n( &ep->fc_on, __ATOMIC_ACQUIRE ) ) {
+		__atomic_fetch_sub( &ep->fc_sent, 1, __ATOMIC_ACQ_REL );
+	}
+}
+
+/*
+	Reset the sender side state; called when the connection to the endpoint is
+	lost as the counts are relative to a single connection.
+*/
+static void fc_reset_ep( endpoint_t* ep ) {
+	if( ep != NULL ) {
+		__atomic_store_n( &ep->fc_on, 0, __ATOMIC_RELEASE );
+		__atomic_store_n( &ep->fc_sent, 0, __ATOMIC_RELEASE );
+		__atomic_store_n( &ep->fc_limit, 0, __ATOMIC_RELEASE );
+	}
+}
+
+/*
+	Build and write a grant control frame on the fd. The frame is small enough
+	to live on the stack and is written directly; there is nothing to return
+	to the caller if it fails as the next grant carries the (absolute) limit.
+*/
+static void fc_send_grant( uta_ctx_t* ctx, int fd, uint32_t limit ) {
+	char		frame[TP_HDR_LEN + sizeof( uta_mhdr_t ) + FC_GRANT_LEN];
+	uta_mhdr_t*	hdr;
+	uint32_t*	glimit;
+
+	memset( frame, 0, sizeof( frame ) );
+	insert_mlen( (uint32_t) sizeof( frame ), frame );
+
+	hdr = (uta_mhdr_t *) (frame + TP_HDR_LEN);
+	hdr->mtype = htonl( UNSET_MSGTYPE );
+	hdr->sub_id = htonl( UNSET_SUBID );
+	hdr->rmr_ver = htonl( RMR_MSG_VER );
+	hdr->flags = HFL_CTL;
+	SET_HDR_LEN( hdr );
+	SET_HDR_D2_LEN( hdr, FC_GRANT_LEN );
+
+	glimit = (uint32_t *) DATA2_ADDR( hdr );
+	*glimit = htonl( limit );
+
+	if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "flow control: granting limit=%u on fd=%d\n", limit, fd );
+	SIsendt( ctx->si_ctx, fd, frame, sizeof( frame ) );
+}
+
+/*
+	Return the river for the fd if flow control can be applied to it. Application
+	threads account for consumption, so only the directly mapped rivers are used
+	as the river hash cannot be safely searched outside of the receive thread.
+*/
+static inline river_t* fc_river( uta_ctx_t* ctx, int fd ) {
+	if( fd < 0 || fd >= ctx->nrivers || ctx->rivers == NULL ) {
+		return NULL;
+	}
+
+	return &ctx->rivers[fd];
+}
+
+/*
+	Called by the receive thread for each message that arrives with the
+	capability flag set. If this is the first such message on the flow, the
+	initial grant is made and the flow is marked so that consumption results
+	in additional grants.
+*/
+static void fc_open_flow( uta_ctx_t* ctx, int fd ) {
+	river_t*	river;
+	uint32_t	limit;
+
+	if( ctx->fc_window <= 0 || (river = fc_river( ctx, fd )) == NULL ) {
+		return;
+	}
+
+	if( river->flags & RF_FC_ON ) {
+		return;
+	}
+
+	limit = __atomic_load_n( &river->fc_used, __ATOMIC_ACQUIRE ) + ctx->fc_window;
+	__atomic_store_n( &river->fc_limit, limit, __ATOMIC_RELEASE );
+	river->flags |= RF_FC_ON;
+	fc_send_grant( ctx, fd, limit );
+}
+
+/*
+	Called when a message is handed to the application (or dropped). The count
+	of consumed messages is bumped for the flow it arrived on and when a quarter
+	of the window has been used a new grant is issued. The compare/exchange
+	ensures that only one thread sends a grant when several consume concurrently.
+*/
+static inline void fc_consumed( uta_ctx_t* ctx, rmr_mbuf_t* msg ) {
+	river_t*	river;
+	uint32_t	used;
+	uint32_t	limit;
+	int			step;
+
+	if( ctx->fc_window <= 0 || msg == NULL || (river = fc_river( ctx, msg->rts_fd )) == NULL ) {
+		return;
+	}
+
+	if( ! (river->flags & RF_FC_ON) ) {
+		return;
+	}
+
+	step = ctx->fc_window / 4;
+	if( step < 1 ) {
+		step = 1;
+	}
+
+	used = __atomic_add_fetch( &river->fc_used, 1, __ATOMIC_ACQ_REL );
+	limit = __atomic_load_n( &river->fc_limit, __ATOMIC_ACQUIRE );
+	if( (int32_t) ((used + ctx->fc_window) - limit) >= step ) {
+		if( __atomic_compare_exchange_n( &river->fc_limit, &limit, used + ctx->fc_window, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) ) {
+			fc_send_grant( ctx, msg->rts_fd, used + ctx->fc_window );
+		}
+	}
+}
+
+/*
+	Process a control frame which arrived on fd. The only control frame at the
+	moment is a credit grant; the endpoint that the fd is connected to is given
+	the new limit. Frames arriving on a session that we did not open are ignored.
+*/
+static void fc_ctl_frame( uta_ctx_t* ctx, uta_mhdr_t* hdr, int fd ) {
+	endpoint_t*	ep;
+	uint32_t	limit;
+
+	if( RMR_D2_LEN( hdr ) < FC_GRANT_LEN ) {
+		return;
+	}
+
+	if( (ep = fd2ep_get( ctx, fd )) == NULL ) {
+		if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "flow control: grant on fd=%d with no endpoint; ignored\n", fd );
+		return;
+	}
+
+	memcpy( &limit, DATA2_ADDR( hdr ), sizeof( limit ) );
+	__atomic_store_n( &ep->fc_limit, ntohl( limit ), __ATOMIC_RELEASE );
+	__atomic_store_n( &ep->fc_on, 1, __ATOMIC_RELEASE );
+}
+
+#endif
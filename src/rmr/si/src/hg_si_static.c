@@ -0,0 +1,279 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	hg_si_static.c
+	Abstract:	Hedged calls. When enabled (rmr_set_hedge() or RMR_HEDGE_PCT) the
+				time each rmr_mt_call() waits for its response is kept, per
+				message type, in a histogram of quarter octave buckets. The
+				hedge delay for the type is the configured percentile of those
+				times; it is recomputed every few samples, and the histogram is
+				halved now and then so that it follows changes in the peers.
+
+				A call whose route is a single round robin group of two or more
+				endpoints is sent to the endpoint selected as usual, and the
+				message is kept. If no response has arrived when the hedge delay
+				has passed, the same message (same xid) is sent to the next
+				member of the group. The caller takes whichever response comes
+				first; a later one is reclaimed by the receive thread.
+				Broadcast and consistent hash (%hash) groups are never hedged:
+				a hashed key belongs to one member, and sending it to another
+				would break the affinity the group exists to give.
+
+				Until a type has enough samples there is no delay for it and its
+				calls are not hedged.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _hg_si_static_c
+#define _hg_si_static_c
+
+#define HG_NTYPES		128				// message types tracked
+#define HG_PROBES		8				// slots looked at for a type before giving up
+#define HG_MIN_SAMPLES	16				// samples needed before a type's calls are hedged
+#define HG_RECALC		16				// samples between percentile computations
+#define HG_WINDOW		1024			// histogram is halved when it holds this many samples
+
+/*
+	Return the histogram bucket for a time in microseconds. Times below 4 have a
+	bucket each; above that each power of two is split into four.
+*/
+static inline int hg_bucket( uint64_t us ) {
+	int		e;
+	int		b;
+
+	if( us < 4 ) {
+		return (int) us;
+	}
+
+	e = 63 - __builtin_clzll( us );					// us is in [2^e, 2^(e+1))
+	b = 4 * (e - 1) + (int) ((us >> (e - 2)) & 3);
+
+	return b < HG_NBUCKETS ? b : HG_NBUCKETS - 1;
+}
+
+/*
+	Return the upper edge (usec) of a bucket; the times in it are all less.
+*/
+static inline uint64_t hg_bucket_us( int b ) {
+	if( b < 4 ) {
+		return (uint64_t) b + 1;
+	}
+
+	return (uint64_t) (4 + (b % 4) + 1) << (b / 4 - 1);
+}
+
+/*
+	Find the histogram for the message type. If create is set and the type is
+	not tracked a free slot is claimed for it. Nil is returned if the type is
+	not tracked (or the table is full around it).
+*/
+static hg_type_t* hg_find( uta_ctx_t* ctx, int mtype, int create ) {
+	hg_type_t*	types;
+	hg_type_t*	t;
+	uint32_t	h;
+	int			expect;
+	int			i;
+
+	if( (types = __atomic_load_n( &ctx->hg_types, __ATOMIC_ACQUIRE )) == NULL ) {
+		return NULL;
+	}
+
+	h = ((uint32_t) mtype * 2654435761U) >> 25;			// HG_NTYPES (128) slots
+	for( i = 0; i < HG_PROBES; i++ ) {
+		t = &types[(h + i) % HG_NTYPES];
+		expect = __atomic_load_n( &t->mtype, __ATOMIC_ACQUIRE );
+		if( expect == mtype + 1 ) {
+			return t;
+		}
+
+		if( expect == 0 ) {
+			if( ! create ) {
+				return NULL;
+			}
+			if( __atomic_compare_exchange_n( &t->mtype, &expect, mtype + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) || expect == mtype + 1 ) {
+				return t;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Add a call's response time to the type's histogram, and recompute the hedge
+	delay every few samples. Two threads may both halve the histogram, or one may
+	add while it is halved; the result is only a little less accurate.
+*/
+static void hg_record( uta_ctx_t* ctx, int mtype, uint64_t us ) {
+	hg_type_t*	t;
+	uint32_t	n;
+	uint32_t	v;
+	uint32_t	want;
+	uint32_t	sum;
+	int			b;
+
+	if( (t = hg_find( ctx, mtype, TRUE )) == NULL ) {
+		return;
+	}
+
+	__atomic_add_fetch( &t->buckets[hg_bucket( us )], 1, __ATOMIC_RELAXED );
+	n = __atomic_add_fetch( &t->total, 1, __ATOMIC_RELAXED );
+
+	if( n == HG_WINDOW ) {
+		sum = 0;
+		for( b = 0; b < HG_NBUCKETS; b++ ) {
+			v = __atomic_load_n( &t->buckets[b], __ATOMIC_RELAXED ) / 2;
+			__atomic_sub_fetch( &t->buckets[b], v, __ATOMIC_RELAXED );
+			sum += v;
+		}
+		n = __atomic_sub_fetch( &t->total, sum, __ATOMIC_RELAXED );
+	}
+
+	if( n % HG_RECALC != 0 || n < HG_MIN_SAMPLES ) {
+		return;
+	}
+
+	want = (uint32_t) (((uint64_t) n * ctx->hg_pct + 99) / 100);
+	sum = 0;
+	for( b = 0; b < HG_NBUCKETS - 1; b++ ) {
+		if( (sum += __atomic_load_n( &t->buckets[b], __ATOMIC_RELAXED )) >= want ) {
+			break;
+		}
+	}
+	__atomic_store_n( &t->delay_us, (uint32_t) hg_bucket_us( b ), __ATOMIC_RELAXED );
+}
+
+/*
+	Return the hedge delay (usec) for the message type; 0 if it does not yet have one.
+*/
+static inline uint32_t hg_delay( uta_ctx_t* ctx, int mtype ) {
+	hg_type_t*	t;
+
+	if( (t = hg_find( ctx, mtype, FALSE )) == NULL ) {
+		return 0;
+	}
+
+	return __atomic_load_n( &t->delay_us, __ATOMIC_RELAXED );
+}
+
+/*
+	Send a call message which may be hedged. If the route is a single group with
+	another member to hedge to (not a broadcast or hash group), the message is
+	sent to the selected endpoint and,
+	on success, returned (state ok) with *alt set to the member to hedge to; the
+	caller must free it. Otherwise the message is sent as mtosend_msg() would.
+	The message must have MFL_NOALLOC set.
+*/
+static rmr_mbuf_t* hg_send( uta_ctx_t* ctx, rmr_mbuf_t* mbuf, endpoint_t** alt ) {
+	route_table_t*	rt;
+	rtable_ent_t*	rte;
+	rrgroup_t*		rrg;
+	endpoint_t*		ep;
+	endpoint_t*		e;
+	int				nn_sock;
+	int				idx;
+	int				i;
+
+	*alt = NULL;
+
+	rt = get_rt( ctx );
+	if( (rte = uta_get_rte( rt, mbuf->sub_id, mbuf->mtype, TRUE )) == NULL || rte->nrrgroups < 1 ||
+		(rrg = rte->rrgroups[0]) == NULL || (rte->nrrgroups > 1 && rte->rrgroups[1] != NULL) ||
+		rrg->nused < 2 || rrg->policy == RRG_BCAST || rrg->policy == RRG_HASH ) {
+		release_rt( ctx, rt );
+		return mtosend_msg( ctx, mbuf, 0 );					// nothing to hedge to
+	}
+
+	if( ! uta_epsock_rr_msg( ctx, rte, 0, NULL, &nn_sock, &ep, mbuf ) ) {
+		release_rt( ctx, rt );
+		mbuf->flags &= ~MFL_NOALLOC;
+		mbuf->state = RMR_ERR_NOENDPT;
+		errno = ENXIO;
+		return mbuf;
+	}
+
+	for( idx = 0; idx < rrg->nused && rrg->epts[idx] != ep; idx++ );
+	for( i = 1; i < rrg->nused; i++ ) {
+		e = rrg->epts[(idx + i) % rrg->nused];
+		if( e != ep && (e->open || cb_closed( e )) ) {
+			*alt = e;
+			break;
+		}
+	}
+	release_rt( ctx, rt );									// endpoints outlive the table; alt stays valid
+
+	if( *alt != NULL ) {
+		mbuf->flags |= MFL_FANOUT;							// send hands the message back so it can go again
+	}
+	mbuf = send_msg( ctx, mbuf, nn_sock, 0, ep );
+	if( mbuf != NULL ) {
+		incr_ep_counts( mbuf->state, ep );
+		if( mbuf->state != RMR_OK ) {
+			mbuf->flags &= ~(MFL_FANOUT | MFL_NOALLOC);
+			*alt = NULL;
+		}
+	} else {
+		incr_ep_counts( RMR_OK, ep );
+	}
+
+	return mbuf;
+}
+
+/*
+	Send the kept call message to the member to hedge to. Returns true if it was sent.
+*/
+static int hg_resend( uta_ctx_t* ctx, rmr_mbuf_t* mbuf, endpoint_t* alt ) {
+	int		nn_sock;
+
+	if( ! uta_epsock_ep( ctx, alt, &nn_sock ) ) {
+		return FALSE;
+	}
+
+	mbuf = send_msg( ctx, mbuf, nn_sock, 0, alt );			// fanout is set; the message always comes back
+	incr_ep_counts( mbuf->state, alt );
+
+	return mbuf->state == RMR_OK;
+}
+
+/*
+	Set the percentile of response times used as the hedge delay; 0 turns hedging
+	off. The histograms are allocated the first time it is turned on and kept.
+*/
+static int hg_config( uta_ctx_t* ctx, int pct ) {
+	hg_type_t*	types;
+	hg_type_t*	expect = NULL;
+
+	if( pct > 0 && __atomic_load_n( &ctx->hg_types, __ATOMIC_ACQUIRE ) == NULL ) {
+		if( (types = (hg_type_t *) calloc( HG_NTYPES, sizeof( *types ) )) == NULL ) {
+			errno = ENOMEM;
+			return RMR_ERR_INITFAILED;
+		}
+		if( ! __atomic_compare_exchange_n( &ctx->hg_types, &expect, types, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+			free( types );
+		}
+	}
+
+	__atomic_store_n( &ctx->hg_pct, pct, __ATOMIC_RELEASE );
+	return RMR_OK;
+}
+
+#endif
@@ -0,0 +1,169 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	lb_si_static.c
+	Abstract:	Endpoint selection within a round robin group. The group's
+				policy comes from a marker in the route table (see rrg_policy()):
+
+					round robin	  the next endpoint in turn (no marker)
+					%wrr		  smooth weighted round robin; the schedule
+								  is built when the table is loaded
+					%lo			  least outstanding; the endpoint with the
+								  lightest load
+					%p2c		  the lighter loaded of two endpoints picked
+								  at random
+					%hash(key)	  consistent hash of the message's meid, xid
+								  or subid; the maglev lookup table is built
+								  when the table is loaded, so the pick is a
+								  hash of the key and one table index
+
+				The round robin and wrr cursors are bumped atomically, so all
+				sending threads share one sequence without a lock. The random
+				picks use a per thread generator.
+
+				The load of an endpoint is what is queued to it and not yet on
+				the wire: the bytes in the session's kernel send queue and in
+				its batch (if batching), plus a penalty for each consecutive
+				failed send (see incr_ep_counts()) and for having no flow
+				control credit left. An endpoint whose sends keep failing thus
+				gets little traffic until a send to it succeeds. Finding the
+				kernel queue depth is a system call per endpoint looked at, so
+				%p2c (two) is cheaper than %lo (every endpoint) in large groups.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _lb_si_static_c
+#define _lb_si_static_c
+
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
+#define LB_FAIL_COST	(64 * 1024)			// load added for each consecutive failed send; about a full send queue
+#define LB_MAX_STREAK	16					// failures beyond this add nothing more
+
+static __thread uint32_t lb_seed = 0;		// per thread state for random picks
+
+/*
+	Per thread xorshift generator; seeded from the thread and the clock on first use.
+*/
+static inline uint32_t lb_rand( void ) {
+	uint32_t	x;
+
+	if( (x = lb_seed) == 0 ) {
+		x = (uint32_t) ((uintptr_t) &lb_seed ^ (uintptr_t) time( NULL ) ^ (uintptr_t) pthread_self( )) | 1;
+	}
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	lb_seed = x;
+
+	return x;
+}
+
+/*
+	Return the load of an endpoint: bytes queued and not yet sent, plus the
+	penalties described above. An endpoint which is not connected has none
+	queued; it is connected when it is selected.
+*/
+static long lb_load( endpoint_t* ep ) {
+	long		load = 0;
+	int			queued;
+	uint32_t	streak;
+	ep_batch_t*	b;
+
+	if( ep->open && ep->nn_sock >= 0 && ioctl( ep->nn_sock, SIOCOUTQ, &queued ) == 0 ) {
+		load = queued;
+	}
+
+	if( (b = __atomic_load_n( &ep->batch, __ATOMIC_ACQUIRE )) != NULL ) {
+		load += b->len;
+	}
+
+	if( (streak = __atomic_load_n( &ep->fail_streak, __ATOMIC_RELAXED )) > 0 ) {
+		load += (long) (streak > LB_MAX_STREAK ? LB_MAX_STREAK : streak) * LB_FAIL_COST;
+	}
+
+	if( __atomic_load_n( &ep->fc_on, __ATOMIC_ACQUIRE ) &&
+		(int32_t) (__atomic_load_n( &ep->fc_limit, __ATOMIC_ACQUIRE ) - __atomic_load_n( &ep->fc_sent, __ATOMIC_RELAXED )) <= 0 ) {
+		load += LB_FAIL_COST;								// send would be refused for want of credit
+	}
+
+	return load;
+}
+
+/*
+	Select an endpoint in the group (which has more than one) according to the
+	group's policy. Returns the index of the endpoint in the group. The message
+	is needed only for a consistent hash group; without it (or without a lookup
+	table) the pick is round robin.
+*/
+static int lb_select( rrgroup_t* rrg, rmr_mbuf_t* msg ) {
+	long	load;
+	long	min_load;
+	int		start;
+	int		best;
+	int		i;
+	int		j;
+
+	switch( rrg->policy ) {
+		case RRG_WRR:
+			if( rrg->nsched > 0 ) {
+				return rrg->sched[__atomic_fetch_add( &rrg->ep_idx, 1, __ATOMIC_RELAXED ) % rrg->nsched];
+			}
+			break;											// no schedule (alloc failed); plain round robin
+
+		case RRG_LO:
+			start = __atomic_fetch_add( &rrg->ep_idx, 1, __ATOMIC_RELAXED ) % rrg->nused;		// rotate the start so ties are spread
+			best = start;
+			min_load = lb_load( rrg->epts[start] );
+			for( i = 1; i < rrg->nused && min_load > 0; i++ ) {
+				j = (start + i) % rrg->nused;
+				if( (load = lb_load( rrg->epts[j] )) < min_load ) {
+					min_load = load;
+					best = j;
+				}
+			}
+			return best;
+
+		case RRG_P2C:
+			i = lb_rand( ) % rrg->nused;
+			j = lb_rand( ) % (rrg->nused - 1);
+			if( j >= i ) {
+				j++;										// second pick is never the first
+			}
+			return lb_load( rrg->epts[j] ) < lb_load( rrg->epts[i] ) ? j : i;
+
+		case RRG_HASH:
+			if( msg != NULL && rrg->lookup != NULL ) {
+				return rrg->lookup[shard_key_hash( rrg->hash_key, msg ) % RRG_HASH_SLOTS];
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	return __atomic_fetch_add( &rrg->ep_idx, 1, __ATOMIC_RELAXED ) % rrg->nused;
+}
+
+#endif
@@ -0,0 +1,262 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	mbp_si_static.c
+	Abstract:	Message buffer (mbuf) recycling. Each thread has a magazine of
+				free mbufs; rmr_free_msg() puts the mbuf into the magazine of the
+				thread which frees it and the allocation functions take from the
+				magazine of the thread which allocates. Neither needs a lock.
+
+				When a magazine fills, half of it is moved to a global depot, and
+				when one is empty it is refilled from the depot. This lets mbufs
+				freed on one thread (an application worker) be reused on another
+				(the receive thread). The depot is a lock free queue (the same
+				one used by the transport buffer pools); if it is full the mbuf
+				is freed.
+
+				Mbufs are cached in the magazine with their transport buffer
+				attached so that a zero copy buffer can be reused as is by the
+				same thread. Buffers which were not pooled, are large, or which
+				reference a shared receive block are released before the mbuf
+				is cached. Mbufs moved to the depot give up their buffer (to the
+				transport buffer pools) so that the memory held idle is bounded.
+
+				When a thread exits its magazine is emptied into the depot. Per
+				thread counters are kept in the magazine and summed on request
+				by rmr_get_mbuf_stats().
+
+	Date:		18 October 2026
+*/
+
+#ifndef _mbp_si_static_c
+#define _mbp_si_static_c
+
+#include <pthread.h>
+
+#define MBP_MAG_SIZE	64				// mbufs in a thread's magazine
+#define MBP_DEPOT_CELLS	4096			// mbufs the depot can hold (power of 2)
+#define MBP_KEEP_MAX	(16 * 1024)		// transport buffers larger than this are not kept with a cached mbuf
+
+typedef struct mbp_mag {
+	int				n;					// mbufs in the magazine
+	rmr_mbuf_t*		mbufs[MBP_MAG_SIZE];
+	uint64_t		allocs;				// stats; written only by the owning thread
+	uint64_t		hits;
+	uint64_t		frees;
+	uint64_t		released;
+	struct mbp_mag*	next;				// list of all magazines for stats
+	struct mbp_mag*	prev;
+} mbp_mag_t;
+
+static tpb_pool_t mbp_depot;
+static pthread_once_t mbp_once = PTHREAD_ONCE_INIT;
+static pthread_key_t mbp_key;
+static pthread_mutex_t mbp_gate = PTHREAD_MUTEX_INITIALIZER;	// guards the magazine list and the retired counts
+static mbp_mag_t* mbp_mags = NULL;
+static mbp_mag_t mbp_retired;			// counts from magazines of threads which have exited
+static __thread mbp_mag_t* mbp_mine = NULL;
+
+/*
+	Free the mbuf and anything attached to it.
+*/
+static void mbp_release( rmr_mbuf_t* mbuf ) {
+	tpb_release( mbuf );
+	mbuf->cookie = 0;					// should signal a bad mbuf (if not reallocated)
+	free( mbuf );
+}
+
+/*
+	Move the newest count mbufs from the magazine to the depot; those which
+	do not fit are freed. Transport buffers are not kept in the depot.
+*/
+static void mbp_spill( mbp_mag_t* mag, int count ) {
+	rmr_mbuf_t*	mbuf;
+
+	while( count-- > 0 && mag->n > 0 ) {
+		mbuf = mag->mbufs[--mag->n];
+		tpb_release( mbuf );
+		mbuf->alloc_len = 0;
+		if( ! tpb_push( &mbp_depot, mbuf ) ) {
+			mbp_release( mbuf );
+			mag->released++;
+		}
+	}
+}
+
+/*
+	Thread exit destructor; the mbufs go to the depot for other threads and the
+	counts are kept for stats.
+*/
+static void mbp_retire( void* data ) {
+	mbp_mag_t*	mag;
+
+	if( (mag = (mbp_mag_t *) data) == NULL ) {
+		return;
+	}
+
+	mbp_spill( mag, mag->n );
+
+	pthread_mutex_lock( &mbp_gate );
+	mbp_retired.allocs += mag->allocs;
+	mbp_retired.hits += mag->hits;
+	mbp_retired.frees += mag->frees;
+	mbp_retired.released += mag->released;
+	if( mag->prev != NULL ) {
+		mag->prev->next = mag->next;
+	} else {
+		mbp_mags = mag->next;
+	}
+	if( mag->next != NULL ) {
+		mag->next->prev = mag->prev;
+	}
+	pthread_mutex_unlock( &mbp_gate );
+
+	if( mag == mbp_mine ) {
+		mbp_mine = NULL;
+	}
+	free( mag );
+}
+
+static void mbp_init( void ) {
+	tpb_mk_pool( &mbp_depot, sizeof( rmr_mbuf_t ), MBP_DEPOT_CELLS );
+	pthread_key_create( &mbp_key, mbp_retire );
+}
+
+/*
+	Return the calling thread's magazine, creating it on first use. Nil if
+	there is no memory; callers then use malloc/free directly.
+*/
+static inline mbp_mag_t* mbp_mag( void ) {
+	mbp_mag_t*	mag;
+
+	if( (mag = mbp_mine) != NULL ) {
+		return mag;
+	}
+
+	pthread_once( &mbp_once, mbp_init );
+	if( (mag = (mbp_mag_t *) malloc( sizeof( *mag ) )) == NULL ) {
+		return NULL;
+	}
+	memset( mag, 0, sizeof( *mag ) );
+
+	pthread_mutex_lock( &mbp_gate );
+	mag->next = mbp_mags;
+	if( mbp_mags != NULL ) {
+		mbp_mags->prev = mag;
+	}
+	mbp_mags = mag;
+	pthread_mutex_unlock( &mbp_gate );
+
+	pthread_setspecific( mbp_key, mag );				// destructor runs at thread exit
+	mbp_mine = mag;
+	return mag;
+}
+
+/*
+	Get a recycled mbuf. The transport buffer (if any) is still attached, and
+	the caller must reset all other fields. Nil if there are none; the caller
+	must then allocate.
+*/
+static inline rmr_mbuf_t* mbp_get( void ) {
+	mbp_mag_t*	mag;
+	void*		mbuf;
+
+	if( (mag = mbp_mag( )) == NULL ) {
+		return NULL;
+	}
+
+	mag->allocs++;
+	if( mag->n == 0 ) {
+		while( mag->n < MBP_MAG_SIZE / 2 && (mbuf = tpb_pop( &mbp_depot )) != NULL ) {
+			mag->mbufs[mag->n++] = (rmr_mbuf_t *) mbuf;
+		}
+
+		if( mag->n == 0 ) {
+			return NULL;
+		}
+	}
+
+	mag->hits++;
+	mbuf = mag->mbufs[--mag->n];
+	((rmr_mbuf_t *) mbuf)->flags &= ~MFL_FREED;
+	return (rmr_mbuf_t *) mbuf;
+}
+
+/*
+	Recycle an mbuf that the user has freed. The transport buffer is kept only
+	if it can be reused by a later allocation. A cached mbuf is marked; if the
+	user frees it again (while it is still cached) the second free is refused,
+	as caching it twice would hand it to two owners.
+*/
+static inline void mbp_put( rmr_mbuf_t* mbuf ) {
+	mbp_mag_t*	mag;
+
+	if( mbuf->flags & MFL_FREED ) {
+		rmr_vlog( RMR_VL_CRIT, "rmr_free_msg: message buffer %p was already freed; second free ignored\n", mbuf );
+		return;
+	}
+
+	if( (mbuf->flags & (MFL_HUGE | MFL_TPSHARED)) || ! (mbuf->flags & MFL_TPPOOL) || mbuf->alloc_len > MBP_KEEP_MAX ) {
+		tpb_release( mbuf );
+		mbuf->alloc_len = 0;
+	}
+	mbuf->cookie = 0;								// should signal a bad mbuf (if user tries to use after free)
+	mbuf->flags |= MFL_FREED;
+
+	if( (mag = mbp_mag( )) == NULL ) {
+		mbp_release( mbuf );
+		return;
+	}
+
+	mag->frees++;
+	if( mag->n == MBP_MAG_SIZE ) {
+		mbp_spill( mag, MBP_MAG_SIZE / 2 );
+	}
+	mag->mbufs[mag->n++] = mbuf;
+}
+
+/*
+	Sum the counts from every magazine. Counts from other threads are read while
+	they may be changing, so the result is a close approximation.
+*/
+static void mbp_stats( rmr_mbuf_stats_t* stats ) {
+	mbp_mag_t*	mag;
+	uint64_t	cached = 0;
+
+	pthread_mutex_lock( &mbp_gate );
+	stats->allocs = mbp_retired.allocs;
+	stats->hits = mbp_retired.hits;
+	stats->frees = mbp_retired.frees;
+	stats->released = mbp_retired.released;
+	for( mag = mbp_mags; mag != NULL; mag = mag->next ) {
+		stats->allocs += __atomic_load_n( &mag->allocs, __ATOMIC_RELAXED );
+		stats->hits += __atomic_load_n( &mag->hits, __ATOMIC_RELAXED );
+		stats->frees += __atomic_load_n( &mag->frees, __ATOMIC_RELAXED );
+		stats->released += __atomic_load_n( &mag->released, __ATOMIC_RELAXED );
+		cached += __atomic_load_n( &mag->n, __ATOMIC_RELAXED );
+	}
+	pthread_mutex_unlock( &mbp_gate );
+
+	cached += __atomic_load_n( &mbp_depot.enq, __ATOMIC_RELAXED ) - __atomic_load_n( &mbp_depot.deq, __ATOMIC_RELAXED );
+	stats->cached = cached;
+}
+
+#endif
@@ -39,8 +39,20 @@ static inline void queue_normal( uta_ctx_t* ctx, rmr_mbuf_t* mbuf ) {
 	//static	long dcount = 0;
 
 	chute_t*	chute;
+	void*		ring;
+	int			nshards;
 
-	if( ! uta_ring_insert( ctx->mring, mbuf ) ) {
+	if( disp_queue( ctx, mbuf ) ) {								// handed to a registered handler
+		return;
+	}
+
+	ring = ctx->mring;
+	if( (nshards = __atomic_load_n( &ctx->nshards, __ATOMIC_ACQUIRE )) > 0 ) {		// sharded; the worker's ring based on the message key
+		ring = ctx->shards[shard_idx( ctx, mbuf, nshards )];
+	}
+
+	if( ! uta_ring_insert( ring, mbuf ) ) {
+		fc_consumed( ctx, mbuf );							// dropped counts as consumed else the sender stalls
 		rmr_free_msg( mbuf );								// drop if ring is full
 		//dcount++;
 		ctx->dcount++;
@@ -54,21 +66,55 @@ static inline void queue_normal( uta_ctx_t* ctx, rmr_mbuf_t* mbuf ) {
 		return;
 	}
 	ctx->acc_ecount++;
-	chute = &ctx->chutes[0];
-	sem_post( &chute->barrier );								// tickle the ring monitor
+	if( nshards == 0 ) {										// shard readers wait on the ring's fd, not the chute
+		chute = &ctx->chutes[0];
+		sem_post( &chute->barrier );							// tickle the ring monitor
+	}
+}
+
+/*
+	Free a call response which no call is waiting for: it arrived after its call
+	timed out, or it is a second response to a hedged call. It is reclaimed at
+	once rather than left for the application or the next call.
+*/
+static inline void call_reclaim( uta_ctx_t* ctx, rmr_mbuf_t* mbuf ) {
+	fc_consumed( ctx, mbuf );
+	rmr_free_msg( mbuf );
+}
+
+/*
+	Deliver a response to the thread waiting on a numbered call chute. The chute
+	takes it only while the call waits for its xid; otherwise it is reclaimed.
+*/
+static void chute_deliver( uta_ctx_t* ctx, chute_t* chute, rmr_mbuf_t* mbuf ) {
+	int		expect = XC_WAITING;
+
+	if( __atomic_compare_exchange_n( &chute->state, &expect, XC_FILLING, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) ) {
+		if( memcmp( chute->expect, mbuf->xaction, RMR_MAX_XID ) == 0 ) {
+			fc_consumed( ctx, mbuf );								// call response goes straight to the waiting thread
+			chute->mbuf = mbuf;
+			__atomic_store_n( &chute->state, XC_DONE, __ATOMIC_RELEASE );
+			sem_post( &chute->barrier );
+			return;
+		}
+
+		__atomic_store_n( &chute->state, XC_WAITING, __ATOMIC_RELEASE );		// late response to an earlier call
+	}
+
+	call_reclaim( ctx, mbuf );
 }
 
 /*
 	Allocate a message buffer, point it at the accumulated (raw) message,
 	call ref to point to all of the various bits and set real len etc,
 	then we queue it.  Raw_msg is expected to include the transport goo
-	placed in front of the RMR header and payload.
+	placed in front of the RMR header and payload. Tpflags are the MFL_TP*
+	flags which indicate how the raw buffer must be released.
 */
-static void buf2mbuf( uta_ctx_t* ctx, char *raw_msg, int msg_size, int sender_fd ) {
+static void buf2mbuf( uta_ctx_t* ctx, char *raw_msg, int msg_size, int sender_fd, int tpflags ) {
 	rmr_mbuf_t*		mbuf;
 	uta_mhdr_t*		hdr;		// header of the message received
 	unsigned char*	d1;			// pointer at d1 data ([0] is the call_id)
-	chute_t*		chute;
 	unsigned int	call_id;	// the id assigned to the call generated message
 
 	if( PARANOID_CHECKS ) {									// PARANOID mode is slower; off by default
@@ -77,19 +123,52 @@ static void buf2mbuf( uta_ctx_t* ctx, char *raw_msg, int msg_size, int sender_fd
 		}
 	}
 
+	if( msg_size >= TP_HDR_LEN + (int) sizeof( uta_v4mhdr_t ) && HDR_VERSION( &raw_msg[TP_HDR_LEN] ) == RMR_CH_VER ) {
+		if( (raw_msg = ch_expand( ctx, raw_msg, &msg_size, sender_fd, &tpflags )) == NULL ) {		// bad frames are released
+			return;
+		}
+	}
+
 	// cross-check that header length indicators are not longer than actual message
 	uta_mhdr_t* hdr_check = (uta_mhdr_t*)(((char *) raw_msg) + TP_HDR_LEN);
         uint32_t header_len=(uint32_t)RMR_HDR_LEN(hdr_check);
         uint32_t payload_len=(uint32_t)ntohl(hdr_check->plen);
         if (header_len+TP_HDR_LEN+payload_len> msg_size) {
                 rmr_vlog( RMR_VL_ERR, "Message dropped because %u + %u + %u > %u\n", header_len, payload_len, TP_HDR_LEN, msg_size);
-                free (raw_msg);
+                tpb_put( raw_msg, tpflags );
                 return;
         }
 
+	if( hdr_check->flags & HFL_CTL ) {						// control frames are consumed here, never queued
+		if( (int32_t) ntohl( hdr_check->mtype ) == CH_CTL_ACCEPT ) {
+			ch_ctl_frame( ctx, sender_fd );
+		} else if( (int32_t) ntohl( hdr_check->mtype ) == CZ_CTL_ACCEPT ) {
+			cz_ctl_frame( ctx, sender_fd );
+		} else {
+			fc_ctl_frame( ctx, hdr_check, sender_fd );
+		}
+		tpb_put( raw_msg, tpflags );
+		return;
+	}
+	if( hdr_check->flags & HFL_FC_CAP ) {					// sender honours credits; ensure flow has its initial grant
+		fc_open_flow( ctx, sender_fd );
+	}
+	if( hdr_check->flags & HFL_CH_CAP ) {					// sender offers compact headers
+		ch_open_flow( ctx, sender_fd );
+	}
+	if( hdr_check->flags & HFL_CZ_CAP ) {					// sender offers compressed payloads
+		cz_open_flow( ctx, sender_fd );
+	}
+	if( hdr_check->flags & HFL_COMP ) {						// payload must be decompressed before the mbuf references it
+		if( (raw_msg = cz_expand( ctx, raw_msg, &msg_size, &tpflags )) == NULL ) {
+			return;
+		}
+	}
+
 
 	if( (mbuf = alloc_mbuf( ctx, RMR_ERR_UNSET )) != NULL ) {
 		mbuf->tp_buf = raw_msg;
+		mbuf->flags |= tpflags;						// note where the buffer came from so it is released properly
 		mbuf->rts_fd = sender_fd;
 		if( msg_size > ctx->max_ibm + 1024 ) {
 			mbuf->flags |= MFL_HUGE;				// prevent caching of oversized buffers
@@ -104,17 +183,21 @@ static void buf2mbuf( uta_ctx_t* ctx, char *raw_msg, int msg_size, int sender_fd
 				queue_normal( ctx, mbuf );
 			} else {
 				d1 = DATA1_ADDR( hdr );
-				if( (call_id = (unsigned int) d1[D1_CALLID_IDX]) == 0 ) {			// call_id not set, just queue
-					queue_normal( ctx, mbuf );
+				if( (call_id = (unsigned int) d1[D1_CALLID_IDX]) == 0 ) {			// call_id not set, just queue (unless an automatic call waits for it)
+					if( ! xc_marked( ctx, hdr ) ) {									// not a response to one of our automatic calls
+						queue_normal( ctx, mbuf );
+					} else {
+						if( ! xc_deliver( ctx, mbuf ) ) {
+							call_reclaim( ctx, mbuf );					// its call has finished
+						}
+					}
 				} else {
-					chute = &ctx->chutes[call_id];
-					chute->mbuf = mbuf;
-					sem_post( &chute->barrier );				// the call function can vet xaction id in their own thread
+					chute_deliver( ctx, &ctx->chutes[call_id], mbuf );
 				}
 			}
 		}
 	} else {
-		free( raw_msg );
+		tpb_put( raw_msg, tpflags );
 	}
 }
 
@@ -174,6 +257,9 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 	int				remain;			// bytes in transport buf that need to be moved
 	int*			mlen;			// pointer to spot in buffer for conversion to int
 	int				need;			// bytes needed for something
+	int				share;			// buf is a shared receive block; small messages may reference it
+	char*			retired = NULL;	// block replaced during this call; our reference is dropped on the way out
+	char*			nblk;			// fresh receive block
 	int				i;
 
 	if( PARANOID_CHECKS ) {									// PARANOID mode is slower; off by default
@@ -203,11 +289,12 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 	if( river->state != RS_GOOD ) {				// all states which aren't good require reset first
 		if( river->state == RS_NEW ) {
 			if( river->accum != NULL ) {
-				free( river->accum );
+				tpb_free( river->accum );
 			}
+			ch_reset_river( river );
 			memset( river, 0, sizeof( *river ) );
 			river->nbytes = sizeof( char ) * (ctx->max_ibm + 1024);		// start with what user said would be the "normal" max inbound msg size
-			river->accum = (char *) malloc( river->nbytes );
+			river->accum = (char *) tpb_alloc( river->nbytes );
 			river->ipt = 0;
 		} else {
 			if( river->state == RS_RESET ) {
@@ -221,6 +308,7 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 	}
 
 	river->state = RS_GOOD;
+	share = ctx->rblock != NULL && buf == ctx->rblock;
 	remain = buflen;
 	while( remain > 0 ) {								// until we've done something with all bytes passed in
 		if( DEBUG )  rmr_vlog( RMR_VL_DEBUG, "====== data callback top of loop bidx=%d msize=%d ipt=%d remain=%d\n", bidx, river->msg_size, river->ipt, remain );
@@ -233,7 +321,7 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 				memcpy( &river->accum[river->ipt], buf+bidx, remain );			// grab what we can and depart
 				river->ipt += remain;
 				if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "data callback not enough bytes to compute size; need=%d have=%d\n", need, remain );
-				return SI_RET_OK;
+				break;
 			}
 
 			if( river->ipt > 0 ) {										// if we captured the start of size last go round
@@ -257,7 +345,7 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 
                         if( river->msg_size < 0) { // addressing RIC-989
                                 river->state=RS_RESET;
-                        	return SI_RET_OK;
+                        	break;
                         }
 
 			if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "data callback setting msg size: %d\n", river->msg_size );
@@ -267,12 +355,12 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 				if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "received message is huge (%d) reallocating buffer\n", river->msg_size );
 				old_accum = river->accum;					// need to copy any bytes we snarfed getting the size, so hold
 				river->nbytes = river->msg_size + 128;					// buffer large enough with a bit of fudge room
-				river->accum = (char *) malloc( river->nbytes );
+				river->accum = (char *) tpb_alloc( river->nbytes );
 				if( river->ipt > 0 ) {
 					memcpy( river->accum, old_accum, river->ipt + 1 );		// copy anything snarfed in getting the sie
 				}
 
-				free( old_accum );
+				tpb_free( old_accum );
 			}
 		}
 
@@ -286,11 +374,24 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 		} else {
 			need = river->msg_size - river->ipt;						// bytes from transport we need to have complete message
 			if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "data callback enough in the buffer size=%d need=%d remain=%d flgs=%02x\n", river->msg_size, need, remain, river->flags );
-			if( (river->flags & RF_DROP) == 0  ) {									// keeping this message, copy and pass it on
+			if( share && retired == NULL && river->ipt == 0 && river->msg_size < RBLK_MAX_FRAME ) {	// first small message in this block
+				if( (nblk = rblk_alloc( )) != NULL ) {								// block is now referenced; SI must read into a fresh one
+					SIset_rbuf( ctx->si_ctx, nblk, RBLK_DATA_LEN );
+					retired = ctx->rblock;
+					ctx->rblock = nblk;
+				} else {
+					share = FALSE;													// no memory; copy as usual
+				}
+			}
+
+			if( share && river->ipt == 0 && river->msg_size < RBLK_MAX_FRAME ) {		// small and whole in the block; reference rather than copy
+				rblk_ref( buf + bidx );
+				buf2mbuf( ctx, buf + bidx, river->msg_size, fd, MFL_TPSHARED );
+			} else if( (river->flags & RF_DROP) == 0  ) {							// keeping this message, copy and pass it on
 				memcpy( &river->accum[river->ipt], buf+bidx, need );				// grab just what is needed (might be more)
-				buf2mbuf( ctx, river->accum, river->nbytes, fd );					// build an RMR mbuf and queue
+				buf2mbuf( ctx, river->accum, river->nbytes, fd, MFL_TPPOOL );		// build an RMR mbuf and queue
 				river->nbytes = sizeof( char ) * (ctx->max_ibm + 1024);				// prevent huge size from persisting
-				river->accum = (char *) malloc( sizeof( char ) *  river->nbytes );	// fresh accumulator
+				river->accum = (char *) tpb_alloc( sizeof( char ) *  river->nbytes );	// fresh accumulator; likely one the app released
 			} else {
 				if( !(river->flags & RF_NOTIFIED) ) {								// not keeping huge messages; notify once per stream
 					rmr_vlog( RMR_VL_WARN, "message larger than allocated buffer (%d) arrived on fd %d\n", river->nbytes, fd );
@@ -305,6 +406,10 @@ static int mt_data_cb( void* vctx, int fd, char* buf, int buflen ) {
 		}
 	}
 
+	if( retired != NULL ) {								// messages now hold the only references to the old block
+		rblk_unref( retired );
+	}
+
 	if( DEBUG >2 ) rmr_vlog( RMR_VL_DEBUG, "##### data callback finished\n" );
 	return SI_RET_OK;
 }
@@ -337,8 +442,11 @@ static int mt_disc_cb( void* vctx, int fd ) {
 
 	if( river != NULL ) {
 		river->state = RS_NEW;			// if one connects here later; ensure it's new
+		ch_reset_river( river );		// identities are interned per connection
+		river->flags &= ~RF_CZ_ON;		// compression is negotiated per connection
+		__atomic_store_n( &river->rts_ep, NULL, __ATOMIC_RELAXED );
 		if( river->accum != NULL ) {
-			free( river->accum );
+			tpb_free( river->accum );
 			river->accum = NULL;
 			river->state = RS_NEW;		// force realloc if the fd is used again
 		}
@@ -349,7 +457,11 @@ static int mt_disc_cb( void* vctx, int fd ) {
 		pthread_mutex_lock( &ep->gate );            // wise to lock this
 		ep->open = FALSE;
 		ep->nn_sock = -1;
+		fc_reset_ep( ep );							// credits are relative to the session
+		ch_reset_ep( ep );
+		cz_reset_ep( ep );
 		pthread_mutex_unlock( &ep->gate );
+		bat_drop( ctx, ep );						// never write these to whatever gets the fd next
 	}
 
 	return SI_RET_OK;
@@ -49,8 +49,10 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
+#include <limits.h>
 #include <arpa/inet.h>
 #include <semaphore.h>
+#include <poll.h>
 #include <pthread.h>
 
 #include "si95/socket_if.h"
@@ -72,7 +74,22 @@
 #include "alarm.c"
 #include "rtc_static.c"				// route table collector (thread code)
 #include "tools_static.c"
+#include "tpb_si_static.c"			// pooled transport buffers
+#include "mbp_si_static.c"			// per thread mbuf recycling
 #include "sr_si_static.c"			// send/receive static functions
+#include "tw_si_static.c"			// timing wheel for call deadlines and other timers
+#include "fc_si_static.c"			// credit based flow control
+#include "ch_si_static.c"			// compact wire headers
+#include "cz_si_static.c"			// per message type payload compression
+#include "shard_si_static.c"		// key affine receive sharding
+#include "dispatch_si_static.c"		// message dispatcher/worker pool
+#include "as_si_static.c"			// asynchronous send offload
+#include "bat_si_static.c"			// sender side micro batching
+#include "lb_si_static.c"			// load aware endpoint selection
+#include "cb_si_static.c"			// endpoint circuit breaker
+#include "hg_si_static.c"			// hedged calls
+#include "xc_si_static.c"			// calls matched on xid
+#include "ac_si_static.c"			// asynchronous calls
 #include "wormholes.c"				// wormhole api externals and related static functions (must be LAST!)
 #include "mt_call_static.c"
 #include "mt_call_si_static.c"
@@ -91,14 +108,19 @@ static inline void incr_ep_counts( int state, endpoint_t* ep ) {
 		switch( state ) {
 			case RMR_OK:
 				ep->scounts[EPSC_GOOD]++;
+				if( ep->fail_streak ) {
+					__atomic_store_n( &ep->fail_streak, 0, __ATOMIC_RELAXED );
+				}
 				break;
 
 			case RMR_ERR_RETRY:
 				ep->scounts[EPSC_TRANS]++;
+				__atomic_add_fetch( &ep->fail_streak, 1, __ATOMIC_RELAXED );
 				break;
 
 			default:
 				ep->scounts[EPSC_FAIL]++;
+				__atomic_add_fetch( &ep->fail_streak, 1, __ATOMIC_RELAXED );
 				break;
 		}
 	}
@@ -108,15 +130,20 @@ static inline void incr_ep_counts( int state, endpoint_t* ep ) {
 	Clean up a context.
 */
 static void free_ctx( uta_ctx_t* ctx ) {
+	rt_reader_t*	r;
+
 	if( ctx ) {
 		if( ctx->rtg_addr ){
 			free( ctx->rtg_addr );
 		}
 		uta_ring_free( ctx->mring );
 		uta_ring_free( ctx->zcb_mring );
+		free_shards( ctx );
 		if( ctx->chutes ){
 			free( ctx->chutes );
 		}
+		free( ctx->hg_types );
+		free( ctx->xcalls );
 		if( ctx->fd2ep ){
 			rmr_sym_free( ctx->fd2ep );
 		}
@@ -133,6 +160,10 @@ static void free_ctx( uta_ctx_t* ctx ) {
 		if ( ctx->ephash ){
 			free( ctx->ephash );
 		}
+		while( (r = ctx->rt_readers) != NULL ) {
+			ctx->rt_readers = r->next;
+			free( r );
+		}
 		free( ctx );
 	}
 }
@@ -224,7 +255,8 @@ extern rmr_mbuf_t* rmr_realloc_msg( rmr_mbuf_t* msg, int new_tr_size ) {
 
 
 /*
-	Return the message to the available pool, or free it outright.
+	Return the message to the calling thread's mbuf cache (from which it may be
+	moved to the global depot). The mbuf is freed outright if it cannot be cached.
 */
 extern void rmr_free_msg( rmr_mbuf_t* mbuf ) {
 	if( mbuf == NULL ) {
@@ -232,29 +264,7 @@ extern void rmr_free_msg( rmr_mbuf_t* mbuf ) {
 		return;
 	}
 
-#ifdef KEEP
-	if( mbuf->flags & MFL_HUGE || 							// don't cache oversized messages
-		! mbuf->ring || 									// cant cache if no ring
-		! uta_ring_insert( mbuf->ring, mbuf ) ) {			// or ring is full
-
-		if( mbuf->tp_buf ) {
-			free( mbuf->tp_buf );
-			mbuf->tp_buf = NULL;		// just in case user tries to reuse this mbuf; this will be an NPE
-		}
-
-		mbuf->cookie = 0;			// should signal a bad mbuf (if not reallocated)
-		free( mbuf );
-	}
-#else
-	// always free, never manage a pool
-	if( mbuf->tp_buf ) {
-		free( mbuf->tp_buf );
-		mbuf->tp_buf = NULL;		// just in case user tries to reuse this mbuf; this will be an NPE
-	}
-
-	mbuf->cookie = 0;			// should signal a bad mbuf (if not reallocated)
-	free( mbuf );
-#endif
+	mbp_put( mbuf );				// recycle; the transport buffer is kept only if it can be reused
 }
 
 /*
@@ -269,6 +279,7 @@ extern rmr_mbuf_t* rmr_mtosend_msg( void* vctx, rmr_mbuf_t* msg, int max_to ) {
 
 		d1 = DATA1_ADDR( msg->header );
 		d1[D1_CALLID_IDX] = NO_CALL_ID;									// must blot out so it doesn't queue on a chute at the other end
+		d1[D1_XCALL_IDX] = 0;
 	}
 
 	return mtosend_msg( vctx, msg, max_to );
@@ -287,11 +298,160 @@ extern rmr_mbuf_t* rmr_send_msg( void* vctx, rmr_mbuf_t* msg ) {
 
 		d1 = DATA1_ADDR( msg->header );
 		d1[D1_CALLID_IDX] = NO_CALL_ID;										// must blot out so it doesn't queue on a chute at the other end
+		d1[D1_XCALL_IDX] = 0;
 	}
 
 	return rmr_mtosend_msg( vctx, msg,  -1 );							// retries < 0  uses default from ctx
 }
 
+/*
+	Send a message whose payload is held in the application's own buffers (e.g. an
+	already encoded ASN.1 PDU) without copying it into the message. The message is
+	used only as a header template: type, subscription id, meid, xaction and trace
+	data are taken from it, and the RMR and transport headers are built in its
+	buffer. The niov buffers are then written, in order, following the headers as
+	the message payload; msg->len is set to their total length.
+
+	The message is always returned (unlike rmr_send_msg() no new buffer is
+	allocated) and can be used as the template for the next send. The state is
+	set as for rmr_send_msg(). The send is complete when this returns, so the
+	application may reuse or free its buffers immediately; there is no need
+	for a completion notification.
+*/
+extern rmr_mbuf_t* rmr_send_iov( void* vctx, rmr_mbuf_t* msg, const struct iovec* iov, int niov ) {
+	char*	d1;
+	int		i;
+	long	len = 0;
+
+	if( msg == NULL ) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if( vctx == NULL || msg->header == NULL || iov == NULL || niov <= 0 || niov > RMR_MAX_IOV ) {
+		errno = EINVAL;
+		msg->state = RMR_ERR_BADARG;
+		msg->tp_state = errno;
+		return msg;
+	}
+
+	for( i = 0; i < niov; i++ ) {
+		len += iov[i].iov_len;
+	}
+	if( len > INT_MAX - 1024 ) {						// must fit the header's payload length with room for headers
+		errno = EFBIG;
+		msg->state = RMR_ERR_OVERFLOW;
+		msg->tp_state = errno;
+		return msg;
+	}
+	msg->len = (int) len;
+
+	((uta_mhdr_t *) msg->header)->flags &= ~HFL_CALL_MSG;
+	d1 = DATA1_ADDR( msg->header );
+	d1[D1_CALLID_IDX] = NO_CALL_ID;
+	d1[D1_XCALL_IDX] = 0;
+
+	return mtosend_msgv( vctx, msg, -1, iov, niov );
+}
+
+/*
+	Queue the message to be sent by the send offload thread and return at once.
+	On success RMR owns the message until the send is complete; it is then passed
+	to cb (on the offload thread), or if cb is nil, queued for rmr_send_complete().
+	The message delivered is what rmr_send_msg() would have returned: check its
+	state, and expect it to be a different buffer when the send was successful.
+	The callback owns the message and must free, reuse or send it.
+
+	Returns RMR_OK if queued. RMR_ERR_RETRY (errno EAGAIN) is returned when the
+	maximum number of sends are already queued or are waiting to be collected
+	with rmr_send_complete(); the application still owns the message.
+
+	Sends are made in the order queued by a single offload thread, so a send
+	which waits delays every send queued after it.
+*/
+extern int rmr_send_async( void* vctx, rmr_mbuf_t* msg, rmr_send_cb_t cb, void* arg ) {
+	uta_ctx_t*		ctx;
+	async_send_t*	as;
+	as_req_t*		req;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || msg == NULL || msg->header == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( (as = as_ensure( ctx )) == NULL ) {
+		return RMR_ERR_INITFAILED;
+	}
+
+	__atomic_add_fetch( &as->queuing, 1, __ATOMIC_SEQ_CST );		// as_stop() waits for us to queue if we pass the check
+	if( __atomic_load_n( &as->stop, __ATOMIC_SEQ_CST ) ) {
+		__atomic_sub_fetch( &as->queuing, 1, __ATOMIC_RELEASE );
+		errno = ESHUTDOWN;
+		return RMR_ERR_NOTSUPP;
+	}
+
+	if( (req = (as_req_t *) uta_ring_extract( as->free )) == NULL ) {
+		__atomic_sub_fetch( &as->queuing, 1, __ATOMIC_RELEASE );
+		errno = EAGAIN;
+		return RMR_ERR_RETRY;
+	}
+
+	req->msg = msg;
+	req->cb = cb;
+	req->arg = arg;
+	uta_ring_insert( as->sq, req );					// cannot be full; it is as large as the pool
+	__atomic_sub_fetch( &as->queuing, 1, __ATOMIC_RELEASE );
+	return RMR_OK;
+}
+
+/*
+	Return the next message whose asynchronous send (without a callback) has
+	completed, or nil (errno EAGAIN) if there are none. The message state is the
+	result of the send.
+*/
+extern rmr_mbuf_t* rmr_send_complete( void* vctx ) {
+	uta_ctx_t*		ctx;
+	async_send_t*	as;
+	as_req_t*		req;
+	rmr_mbuf_t*		msg;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if( (as = __atomic_load_n( &ctx->asend, __ATOMIC_ACQUIRE )) == NULL || (req = (as_req_t *) uta_ring_extract( as->cq )) == NULL ) {
+		errno = EAGAIN;
+		return NULL;
+	}
+
+	msg = req->msg;
+	uta_ring_insert( as->free, req );
+	return msg;
+}
+
+/*
+	Return a file descriptor which is readable (poll/epoll) while completed
+	asynchronous sends are waiting to be collected with rmr_send_complete().
+	The send offload thread is started if it is not already running.
+	Returns -1 on error.
+*/
+extern int rmr_get_send_cfd( void* vctx ) {
+	uta_ctx_t*		ctx;
+	async_send_t*	as;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if( (as = as_ensure( ctx )) == NULL ) {
+		return -1;
+	}
+
+	return uta_ring_getpfd( as->cq );
+}
+
 /*
 	Return to sender allows a message to be sent back to the endpoint where it originated.
 
@@ -305,6 +465,11 @@ extern rmr_mbuf_t* rmr_send_msg( void* vctx, rmr_mbuf_t* msg ) {
 	that failes, then we will write on the connection that the message arrived on as a
 	falback.
 
+	The endpoint found is remembered for the connection the message arrived on
+	(the river for rts_fd) so that later replies to messages from the connection
+	need no lookup. The name in the message must still match the endpoint; if it
+	does not (the fd was reused by another sender) the lookup is made.
+
 	On success (state is RMR_OK, the caller may use the buffer for another receive operation),
 	and on error it can be passed back to this function to retry the send if desired. On error,
 	errno will liklely have the failure reason set by the nng send processing.  The following
@@ -327,10 +492,12 @@ extern rmr_mbuf_t* rmr_send_msg( void* vctx, rmr_mbuf_t* msg ) {
 extern rmr_mbuf_t*  rmr_rts_msg( void* vctx, rmr_mbuf_t* msg ) {
 	int			nn_sock;			// endpoint socket for send
 	uta_ctx_t*	ctx;
-	char*		hold_src;			// we need the original source if send fails
-	char*		hold_ip;			// also must hold original ip
+	uta_mhdr_t*	hdr;
+	char		hold_src[RMR_MAX_SRC];	// we need the original source if send fails
+	char		hold_ip[RMR_MAX_SRC];	// also must hold original ip
 	int			sock_ok = 0;		// true if we found a valid endpoint socket
 	endpoint_t*	ep = NULL;			// end point to track counts
+	river_t*	river = NULL;		// connection the message arrived on; holds the endpoint replies go to
 
 	if( (ctx = (uta_ctx_t *) vctx) == NULL || msg == NULL ) {		// bad stuff, bail fast
 		errno = EINVAL;												// if msg is null, this is their clue
@@ -349,9 +516,23 @@ extern rmr_mbuf_t*  rmr_rts_msg( void* vctx, rmr_mbuf_t* msg ) {
 		return msg;
 	}
 
-	((uta_mhdr_t *) msg->header)->flags &= ~HFL_CALL_MSG;			// must ensure call flag is off
+	hdr = (uta_mhdr_t *) msg->header;
+	hdr->flags &= ~HFL_CALL_MSG;									// must ensure call flag is off
 
-	sock_ok = uta_epsock_byname( ctx, (char *) ((uta_mhdr_t *)msg->header)->src, &nn_sock, &ep );	// always try src first
+	if( msg->rts_fd >= 0 && msg->rts_fd < ctx->nrivers && ctx->rivers != NULL ) {
+		river = &ctx->rivers[msg->rts_fd];
+		ep = __atomic_load_n( &river->rts_ep, __ATOMIC_RELAXED );
+	}
+	if( ep != NULL && ep->open && (nn_sock = ep->nn_sock) >= 0 &&
+		strncmp( ep->name, (char *) hdr->src, RMR_MAX_SRC ) == 0 ) {	// resolved by an earlier reply on the connection
+		sock_ok = TRUE;
+	} else {
+		ep = NULL;
+		sock_ok = uta_epsock_byname( ctx, (char *) hdr->src, &nn_sock, &ep );		// always try src first
+		if( sock_ok && ep != NULL && river != NULL ) {
+			__atomic_store_n( &river->rts_ep, ep, __ATOMIC_RELAXED );
+		}
+	}
 	if( ! sock_ok ) {
 		if( (nn_sock = msg->rts_fd) < 0 ) {
 			if( HDR_VERSION( msg->header ) > 2 ) {							// with ver2 the ip is there, try if src name not known
@@ -365,20 +546,19 @@ extern rmr_mbuf_t*  rmr_rts_msg( void* vctx, rmr_mbuf_t* msg ) {
 	}
 
 	msg->state = RMR_OK;																// ensure it is clear before send
-	hold_src = strdup( (char *) ((uta_mhdr_t *)msg->header)->src );						// the dest where we're returning the message to
-	hold_ip = strdup( (char *) ((uta_mhdr_t *)msg->header)->srcip );					// both the src host and src ip
-	zt_buf_fill( (char *) ((uta_mhdr_t *)msg->header)->src, ctx->my_name, RMR_MAX_SRC );	// must overlay the source to be ours
-	msg = send_msg( ctx, msg, nn_sock, -1 );
+	memcpy( hold_src, hdr->src, RMR_MAX_SRC );											// the dest where we're returning the message to
+	memcpy( hold_ip, hdr->srcip, RMR_MAX_SRC );											// both the src host and src ip
+	zt_buf_fill( (char *) hdr->src, ctx->my_name, RMR_MAX_SRC );						// must overlay the source to be ours
+	msg = send_msg( ctx, msg, nn_sock, -1, sock_ok ? ep : NULL );						// credits apply only to sessions we opened
 	if( msg ) {
 		incr_ep_counts(  msg->state, ep );				// update counts
 
-		zt_buf_fill( (char *) ((uta_mhdr_t *)msg->header)->src, hold_src, RMR_MAX_SRC );	// always replace original source & ip so rts can be called again
-		zt_buf_fill( (char *) ((uta_mhdr_t *)msg->header)->srcip, hold_ip, RMR_MAX_SRC );
+		hdr = (uta_mhdr_t *) msg->header;
+		memcpy( hdr->src, hold_src, RMR_MAX_SRC );										// always replace original source & ip so rts can be called again
+		memcpy( hdr->srcip, hold_ip, RMR_MAX_SRC );
 		msg->flags |= MFL_ADDSRC;														// if msg given to send() it must add source
 	}
 
-	free( hold_src );
-	free( hold_ip );
 	return msg;
 }
 
@@ -568,6 +748,220 @@ extern int rmr_set_stimeout( void* vctx, int time ) {
 	return RMR_OK;
 }
 
+/*
+	Turn on sender side batching: messages to an endpoint are collected and written
+	together when max_bytes would be exceeded, when the oldest has waited max_us
+	microseconds (50 if max_us is 0), or when rmr_flush() is called. Setting max_bytes
+	to 0 turns batching off, writing anything already collected.
+
+	Returns RMR_OK, or an RMR_ERR_ constant with errno set on failure.
+*/
+extern int rmr_set_batch( void* vctx, int max_bytes, int max_us ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || max_bytes < 0 || max_us < 0 ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	return bat_config( ctx, max_bytes, max_us );
+}
+
+/*
+	Write all batched messages now. Returns RMR_OK, or RMR_ERR_RETRY (errno EAGAIN)
+	if some could not be written because the session would block; they remain
+	batched and the flush can be tried again.
+*/
+extern int rmr_flush( void* vctx ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( bat_sweep( ctx, TRUE ) > 0 ) {
+		errno = EAGAIN;
+		return RMR_ERR_RETRY;
+	}
+
+	return RMR_OK;
+}
+
+/*
+	Set a send deadline in microseconds. When a send finds that the connection to the
+	endpoint would block, the sending thread waits (without using the CPU) until the
+	connection drains or the deadline passes; if it passes, the message is returned
+	with RMR_ERR_RETRY. The deadline applies to each endpoint a message is sent to.
+	This replaces the retry loop set by rmr_set_stimeout(); setting usec to 0 restores it.
+	A max_to of 0 given to rmr_mtosend_msg() still means do not wait at all.
+
+	Returns RMR_OK, or RMR_ERR_BADARG if the context is nil or usec is negative.
+*/
+extern int rmr_set_stimeout_us( void* vctx, int usec ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || usec < 0 ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	ctx->send_tous = usec;
+	return RMR_OK;
+}
+
+/*
+	Fill in the user's stats struct with the time that senders spent waiting for the
+	connection to the named endpoint (host:port as given in the route table) to drain.
+	Only waits made with a send deadline (rmr_set_stimeout_us()) are counted. The
+	endpoint's failed connects and circuit breaker state and counts are also given.
+*/
+extern int rmr_get_send_stats( void* vctx, char const* ep_name, rmr_send_stats_t* stats ) {
+	uta_ctx_t*		ctx;
+	route_table_t*	rt;
+	endpoint_t*		ep;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || ep_name == NULL || stats == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	rt = get_rt( ctx );
+	ep = uta_get_ep( rt, ep_name );
+	if( ep == NULL ) {
+		release_rt( ctx, rt );
+		errno = ENOENT;
+		return RMR_ERR_NOENDPT;
+	}
+
+	stats->blocked = __atomic_load_n( &ep->blocked, __ATOMIC_RELAXED );
+	stats->blocked_ns = __atomic_load_n( &ep->blocked_ns, __ATOMIC_RELAXED );
+	stats->max_blocked_ns = __atomic_load_n( &ep->max_blocked_ns, __ATOMIC_RELAXED );
+	stats->connect_fails = __atomic_load_n( &ep->connect_fails, __ATOMIC_RELAXED );
+	stats->cb_trips = __atomic_load_n( &ep->cb_trips, __ATOMIC_RELAXED );
+	stats->cb_fast_fails = __atomic_load_n( &ep->cb_fast_fails, __ATOMIC_RELAXED );
+	stats->cb_state = __atomic_load_n( &ep->cb_state, __ATOMIC_RELAXED );
+	release_rt( ctx, rt );
+	return RMR_OK;
+}
+
+/*
+	Enable credit based flow control for messages received by this application. Window
+	is the number of messages that each sending connection may have outstanding (received
+	but not yet consumed by the application). Senders which support flow control will
+	not exceed the window and have sends rejected with RMR_ERR_RETRY until the application
+	catches up; back level senders are not affected.
+
+	The window may be changed at any time, but because senders are holding grants, flow
+	control cannot be turned off once it has been turned on.
+
+	Returns -1 if the context was invalid, RMR_ERR_BADARG if the window is not valid and
+	RMR_OK otherwise.
+*/
+extern int rmr_set_flow_ctl( void* vctx, int window ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		return -1;
+	}
+
+	if( window < 0 || (window == 0 && ctx->fc_window > 0) ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	ctx->fc_window = window;
+	return RMR_OK;
+}
+
+/*
+	Report the state of each send made by the calling thread's most recent send
+	(rmr_send_msg(), rmr_mtosend_msg() or a call) when the route has several
+	round robin groups, or a broadcast group (one state for each member); the
+	message returned to the caller carries only one summary state. Up to max_states states are copied, in group order, and the
+	number of groups attempted is returned (it may be more than were copied).
+	A negative value is returned on error.
+*/
+extern int rmr_get_fanout_status( void* vctx, int* states, int max_states ) {
+	int		n;
+
+	if( vctx == NULL || (states == NULL && max_states > 0) || max_states < 0 ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	n = fo_count < RMR_MAX_FANOUT ? fo_count : RMR_MAX_FANOUT;
+	if( n > max_states ) {
+		n = max_states;
+	}
+	if( n > 0 ) {
+		memcpy( states, fo_states, sizeof( int ) * n );
+	}
+
+	return fo_count;
+}
+
+/*
+	Enable payload compression for messages of the given type which have a payload
+	of at least min_len bytes; if min_len is 0 a default minimum is used. A negative
+	min_len turns compression off for the type. Receivers decompress any compressed
+	message regardless of this setting, but must have the same codec as the sender.
+	Payloads are compressed only on connections whose peer has accepted compression
+	(back level peers never do), so a payload may still be sent as is.
+	This should be called before messages of the type are sent.
+*/
+extern int rmr_set_compress( void* vctx, int mtype, int min_len ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( ctx->cz_types == NULL ) {
+		if( min_len < 0 ) {
+			return RMR_OK;
+		}
+		if( (ctx->cz_types = rmr_sym_alloc( 251 )) == NULL ) {
+			errno = ENOMEM;
+			return RMR_ERR_INITFAILED;
+		}
+	}
+
+	if( min_len == 0 ) {
+		min_len = CZ_DEF_MIN;
+	}
+	rmr_sym_map( ctx->cz_types, (uint64_t) (uint32_t) mtype, min_len > 0 ? (void *) (intptr_t) min_len : NULL );
+	return RMR_OK;
+}
+
+/*
+	Install the codec used to compress and decompress payloads. If codec is nil the
+	built in codec is restored. As with the message types, this should be set before
+	any compressed messages are sent or received.
+*/
+extern int rmr_set_codec( void* vctx, rmr_codec_t const* codec ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( codec == NULL ) {
+		memset( &ctx->cz_codec, 0, sizeof( ctx->cz_codec ) );
+		return RMR_OK;
+	}
+
+	if( codec->compress == NULL || codec->decompress == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	ctx->cz_codec = *codec;
+	return RMR_OK;
+}
+
 /*
 	Set receive timeout -- not supported in nng implementation
 
@@ -632,6 +1026,8 @@ static void* init( char* uproto_port, int def_msg_size, int flags ) {
 	char*	tok;						// pointer at token in a buffer
 	char*	tok2;
 	int		static_rtc = 0;				// if rtg env var is < 1, then we set and don't listen on a port
+	int		bat_bytes;					// batching settings from the environment
+	int		bat_us = 0;
 	int		state;
 	int		i;
 	int		old_vlevel;
@@ -677,6 +1073,7 @@ static void* init( char* uproto_port, int def_msg_size, int flags ) {
 
 	ctx->send_retries = 1;							// default is not to sleep at all; RMr will retry about 10K times before returning
 	ctx->d1_len = 4;								// data1 space in header -- 4 bytes for now
+	ctx->xc_tag = (uint16_t) lb_rand( );			// automatic call responses are recognised by this
 	ctx->max_ibm = def_msg_size < 1024 ? 1024 : def_msg_size;					// larger than their request doesn't hurt
 	ctx->max_ibm += sizeof( uta_mhdr_t ) + ctx->d1_len + ctx->d2_len + TP_HDR_LEN + 64;		// add in header size, transport hdr, and a bit of fudge
 
@@ -705,6 +1102,33 @@ static void* init( char* uproto_port, int def_msg_size, int flags ) {
 	}
 	SIset_tflags(ctx->si_ctx,SI_TF_QUICK);
 
+	if( (tok = getenv( ENV_COMPACT_HDR )) != NULL && *tok == '1' ) {
+		ctx->ch_on = TRUE;										// offer and accept compact headers
+	}
+
+	ctx->cb_fails = CB_DEF_FAILS;
+	if( (tok = getenv( ENV_CB_FAILS )) != NULL ) {
+		ctx->cb_fails = atoi( tok );							// 0 turns the breaker off
+	}
+	sem_init( &ctx->cb_wake, 0, 0 );
+
+	if( (tok = getenv( ENV_HEDGE_PCT )) != NULL && atoi( tok ) > 0 && atoi( tok ) < 100 ) {
+		hg_config( ctx, atoi( tok ) );
+	}
+
+	if( (tok = getenv( ENV_BATCH_BYTES )) != NULL && (bat_bytes = atoi( tok )) > 0 ) {
+		if( (tok = getenv( ENV_BATCH_US )) != NULL ) {
+			bat_us = atoi( tok );
+		}
+		bat_config( ctx, bat_bytes, bat_us );
+	}
+
+	if( (tok = getenv( ENV_RCV_SHARE )) != NULL && *tok == '1' ) {
+		if( (ctx->rblock = rblk_alloc( )) != NULL ) {			// small messages reference this rather than being copied
+			free( SIset_rbuf( ctx->si_ctx, ctx->rblock, RBLK_DATA_LEN ) );
+		}
+	}
+
 	if( (port = strchr( proto_port, ':' )) != NULL ) {
 		if( port == proto_port ) {		// ":1234" supplied; leave proto to default and point port correctly
 			port++;
@@ -933,6 +1357,9 @@ extern void rmr_close( void* vctx ) {
 		free( ctx->seed_rt_fname );
 	}
 
+	as_stop( ctx );						// async sends still queued go now (perhaps into a batch)
+	disp_stop( ctx );					// waits for handlers which may still be sending
+	bat_drain( ctx );					// nothing else can send; anything batched goes before we stop
 	ctx->shutdown = 1;
 
 	SItp_stats( ctx->si_ctx );			// dump some interesting stats
@@ -976,6 +1403,7 @@ extern rmr_mbuf_t* rmr_mt_rcv( void* vctx, rmr_mbuf_t* mbuf, int max_wait ) {
 
 	if( max_wait == 0 ) {						// one shot poll; handle wihtout sem check as that is SLOW!
 		if( (mbuf = (rmr_mbuf_t *) uta_ring_extract( ctx->mring )) != NULL ) {			// pop if queued
+			fc_consumed( ctx, mbuf );
 			clock_gettime( CLOCK_REALTIME, &ts );			// pass current time as expriry time
 			sem_timedwait( &chute->barrier, &ts );			// must pop the count (ring is locking so if we got a message we can pop)
 			if( ombuf ) {
@@ -1036,6 +1464,7 @@ extern rmr_mbuf_t* rmr_mt_rcv( void* vctx, rmr_mbuf_t* mbuf, int max_wait ) {
 		errno = 0;						// interrupted call state could be left; clear
 		if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, " mt_rcv extracting from normal ring\n" );
 		if( (mbuf = (rmr_mbuf_t *) uta_ring_extract( ctx->mring )) != NULL ) {			// pop if queued
+			fc_consumed( ctx, mbuf );
 			mbuf->state = RMR_OK;
 			mbuf->flags |= MFL_ADDSRC;               // turn on so if user app tries to send this buffer we reset src
 
@@ -1055,6 +1484,322 @@ extern rmr_mbuf_t* rmr_mt_rcv( void* vctx, rmr_mbuf_t* mbuf, int max_wait ) {
 }
 
 
+/*
+	Configure key affine receive sharding. Once set, the receive thread places
+	each message on one of nshards worker rings based on a hash of the key
+	indicated by key_type (RMR_SHARD_* constants). All messages with the same key
+	are placed on the same shard, so a single worker per shard sees them in the
+	order received, and workers do not contend with each other for a lock.
+
+	Messages are no longer queued for rmr_rcv_msg(), rmr_torcv_msg() or rmr_mt_rcv()
+	once sharding is on; workers must use rmr_shard_rcv(). Responses to rmr_mt_call()
+	are still delivered directly to the calling thread. Sharding may be set only once.
+
+	Returns RMR_OK on success, or an RMR_ERR_ constant with errno set on failure.
+*/
+extern int rmr_set_shards( void* vctx, int nshards, int key_type ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( nshards < 1 || nshards > RMR_MAX_SHARDS || key_type < RMR_SHARD_MEID || key_type > RMR_SHARD_MTYPE ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( ctx->nshards > 0 ) {
+		rmr_vlog( RMR_VL_WARN, "rmr_set_shards: receive sharding already configured; request ignored\n" );
+		errno = EEXIST;
+		return RMR_ERR_NOTSUPP;
+	}
+
+	if( ! mk_shards( ctx, nshards ) ) {
+		return RMR_ERR_INITFAILED;
+	}
+
+	ctx->shard_key = key_type;
+	__atomic_store_n( &ctx->nshards, nshards, __ATOMIC_RELEASE );		// receive thread starts using the rings once this is set
+	rmr_vlog( RMR_VL_INFO, "receive sharding enabled: %d shards, key type %d\n", nshards, key_type );
+
+	return RMR_OK;
+}
+
+/*
+	Returns the pollable file descriptor for the shard's ring, or -1 if sharding
+	is not configured or the shard is out of range. The user should NOT read,
+	write, or close the fd.
+*/
+extern int rmr_get_shard_rcvfd( void* vctx, int shard ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || shard < 0 || shard >= ctx->nshards ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return uta_ring_getpfd( ctx->shards[shard] );
+}
+
+/*
+	Receive the next message from the shard. Only one thread should read from
+	any one shard; the shard rings are not locked. Max_wait is the same as for
+	rmr_mt_rcv(): -1 blocks until a message arrives, 0 is a single check, and
+	any other value is the number of milliseconds to wait. On timeout the
+	message passed in (if any) is returned with the state RMR_ERR_TIMEOUT.
+*/
+extern rmr_mbuf_t* rmr_shard_rcv( void* vctx, int shard, rmr_mbuf_t* mbuf, int max_wait ) {
+	uta_ctx_t*	ctx;
+	rmr_mbuf_t*	ombuf;			// mbuf user passed; if we timeout we return state here
+	struct pollfd	pfd;
+	int			state;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || shard < 0 || shard >= ctx->nshards ) {
+		errno = EINVAL;
+		if( mbuf ) {
+			mbuf->state = RMR_ERR_BADARG;
+			mbuf->tp_state = errno;
+		}
+		return mbuf;
+	}
+
+	ombuf = mbuf;
+	if( ombuf ) {
+		ombuf->state = RMR_ERR_TIMEOUT;			// preset if for failure
+		ombuf->len = 0;
+	}
+
+	errno = 0;
+	if( (mbuf = (rmr_mbuf_t *) uta_ring_extract( ctx->shards[shard] )) == NULL && max_wait != 0 ) {
+		pfd.fd = uta_ring_getpfd( ctx->shards[shard] );
+		pfd.events = POLLIN;
+		do {
+			state = poll( &pfd, 1, max_wait );
+		} while( state < 0 && errno == EINTR );
+
+		if( state > 0 ) {
+			mbuf = (rmr_mbuf_t *) uta_ring_extract( ctx->shards[shard] );
+		}
+	}
+
+	if( mbuf == NULL ) {
+		mbuf = ombuf;
+		if( mbuf ) {
+			mbuf->tp_state = ETIMEDOUT;
+		}
+		errno = ETIMEDOUT;
+		return mbuf;
+	}
+
+	fc_consumed( ctx, mbuf );
+	mbuf->state = RMR_OK;
+	mbuf->tp_state = 0;
+	mbuf->flags |= MFL_ADDSRC;					// turn on so if user app tries to send this buffer we reset src
+	if( ombuf ) {
+		rmr_free_msg( ombuf );					// cannot reuse as mbufs are queued on the ring
+	}
+
+	return mbuf;
+}
+
+
+// ----- dispatcher ---------------------------------------------------------------------------------
+
+/*
+	Register a handler for the message type. Once the dispatcher is started
+	(rmr_dispatch_start()), messages of the type are passed to the handler on one
+	of the worker threads and are not queued for the receive functions. The
+	handler returns the message if it should be freed, or nil if the message was
+	sent (e.g. with rmr_rts_msg()), kept, or freed. Handlers must be registered
+	before the dispatcher is started; registering a type a second time replaces
+	the function and argument.
+
+	Returns RMR_OK on success, or an RMR_ERR_ constant with errno set on failure.
+*/
+extern int rmr_register_handler( void* vctx, int mtype, rmr_handler_t fn, void* arg ) {
+	uta_ctx_t*		ctx;
+	dispatcher_t*	disp;
+	handler_t*		h;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || fn == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( (disp = disp_ensure( ctx )) == NULL ) {
+		return RMR_ERR_INITFAILED;
+	}
+
+	if( disp->running ) {
+		errno = EBUSY;
+		return RMR_ERR_NOTSUPP;
+	}
+
+	if( (h = disp_get_handler( disp, mtype )) == NULL ) {
+		if( (h = (handler_t *) malloc( sizeof( *h ) )) == NULL ) {
+			errno = ENOMEM;
+			return RMR_ERR_INITFAILED;
+		}
+		memset( h, 0, sizeof( *h ) );
+		h->mtype = mtype;
+		pthread_mutex_init( &h->gate, NULL );
+		rmr_sym_map( disp->handlers, (uint64_t) (uint32_t) mtype, h );
+	}
+
+	h->fn = fn;
+	h->arg = arg;
+	return RMR_OK;
+}
+
+/*
+	Limit the number of concurrent invocations of the handler for the message
+	type. A limit of 1 serialises the handler; 0 removes the limit. Must be
+	called after the handler is registered, and before the dispatcher is started.
+*/
+extern int rmr_set_handler_limit( void* vctx, int mtype, int max_concurrent ) {
+	uta_ctx_t*		ctx;
+	handler_t*		h;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || max_concurrent < 0 ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( (h = disp_get_handler( ctx->disp, mtype )) == NULL ) {
+		errno = ENOENT;
+		return RMR_ERR_BADARG;
+	}
+
+	if( ctx->disp->running ) {
+		errno = EBUSY;
+		return RMR_ERR_NOTSUPP;
+	}
+
+	if( max_concurrent > 0 && h->pending == NULL ) {
+		if( (h->pending = uta_mk_ring( DISP_PEND_SIZE )) == NULL ) {
+			errno = ENOMEM;
+			return RMR_ERR_INITFAILED;
+		}
+	}
+
+	h->limit = max_concurrent;
+	return RMR_OK;
+}
+
+/*
+	Start nthreads worker threads and begin passing messages to the registered
+	handlers. The dispatcher can be started only once.
+*/
+extern int rmr_dispatch_start( void* vctx, int nthreads ) {
+	uta_ctx_t*		ctx;
+	dispatcher_t*	disp;
+	int				i;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || nthreads < 1 || nthreads > DISP_MAX_THREADS ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( (disp = ctx->disp) == NULL ) {
+		rmr_vlog( RMR_VL_WARN, "rmr_dispatch_start: no handlers registered\n" );
+		errno = ENOENT;
+		return RMR_ERR_NOTSUPP;
+	}
+
+	if( disp->running || disp->threads != NULL ) {
+		errno = EBUSY;
+		return RMR_ERR_NOTSUPP;
+	}
+
+	disp->queues = (dq_t *) malloc( sizeof( dq_t ) * nthreads );
+	disp->threads = (pthread_t *) malloc( sizeof( pthread_t ) * nthreads );
+	disp->workers = (disp_worker_t *) malloc( sizeof( disp_worker_t ) * nthreads );
+	if( disp->queues == NULL || disp->threads == NULL || disp->workers == NULL ) {
+		free( disp->queues );
+		free( disp->threads );
+		free( disp->workers );
+		disp->queues = NULL;
+		disp->threads = NULL;
+		disp->workers = NULL;
+		errno = ENOMEM;
+		return RMR_ERR_INITFAILED;
+	}
+	memset( disp->queues, 0, sizeof( dq_t ) * nthreads );
+	disp->nthreads = nthreads;
+
+	for( i = 0; i < nthreads; i++ ) {
+		disp->workers[i].disp = disp;
+		disp->workers[i].idx = i;
+		if( pthread_create( &disp->threads[i], NULL, disp_worker, (void *) &disp->workers[i] ) ) {
+			rmr_vlog( RMR_VL_CRIT, "rmr_dispatch_start: unable to start worker thread: %s\n", strerror( errno ) );
+			disp->nthreads = i;				// the ones started can still do work
+			break;
+		}
+	}
+
+	if( disp->nthreads == 0 ) {
+		return RMR_ERR_INITFAILED;
+	}
+
+	__atomic_store_n( &disp->running, 1, __ATOMIC_RELEASE );		// receive thread starts dispatching once set
+	rmr_vlog( RMR_VL_INFO, "dispatcher started with %d worker threads\n", disp->nthreads );
+	return RMR_OK;
+}
+
+/*
+	Fill in the user's stats struct for the handler of the message type.
+*/
+extern int rmr_get_handler_stats( void* vctx, int mtype, rmr_handler_stats_t* stats ) {
+	uta_ctx_t*		ctx;
+	handler_t*		h;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || stats == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	if( (h = disp_get_handler( ctx->disp, mtype )) == NULL ) {
+		errno = ENOENT;
+		return RMR_ERR_BADARG;
+	}
+
+	stats->count = __atomic_load_n( &h->count, __ATOMIC_RELAXED );
+	stats->total_ns = __atomic_load_n( &h->total_ns, __ATOMIC_RELAXED );
+	stats->max_ns = __atomic_load_n( &h->max_ns, __ATOMIC_RELAXED );
+	return RMR_OK;
+}
+
+/*
+	Fill in the user's stats struct with the mbuf recycling counts. The caches
+	are shared by all contexts in the process, so the counts are too.
+*/
+extern int rmr_get_mbuf_stats( void* vctx, rmr_mbuf_stats_t* stats ) {
+	if( vctx == NULL || stats == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	mbp_stats( stats );
+	return RMR_OK;
+}
+
+/*
+	Fill in the user's stats struct with the transport buffer pool and arena
+	counts. Like the mbuf caches, these are process wide.
+*/
+extern int rmr_get_tpbuf_stats( void* vctx, rmr_tpbuf_stats_t* stats ) {
+	if( vctx == NULL || stats == NULL ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	tpb_stats( stats );
+	return RMR_OK;
+}
+
+
 
 
 /*
@@ -1065,6 +1810,9 @@ extern rmr_mbuf_t* rmr_mt_rcv( void* vctx, rmr_mbuf_t* mbuf, int max_wait ) {
 	If endpoint is given, then we assume that we're not doing normal route table
 	routing and that we should send directly to that endpoint (probably worm
 	hole).
+
+	A call id of RMR_CALL_AUTO uses the calling thread's own chute and the table
+	of outstanding calls; the response is matched on the xid (see xc_si_static.c).
 */
 static rmr_mbuf_t* mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_wait, endpoint_t* ep ) {
 	rmr_mbuf_t* ombuf;			// original mbuf passed in
@@ -1072,11 +1820,17 @@ static rmr_mbuf_t* mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_w
 	uta_mhdr_t*	hdr;			// header in the transport buffer
 	chute_t*	chute;
 	unsigned char*	d1;			// d1 data in header
-	struct timespec	ts;			// time info if we have a timeout
-	long	new_ms;				// adjusted mu-sec
-	long	seconds = 0;		// max wait seconds
-	long	nano_sec;			// max wait xlated to nano seconds
+	tw_timer_t	timer;			// wakes us at the hedge time or the deadline
+	uint64_t	deadline = 0;	// monotonic ns; 0 if the call does not time out
+	uint64_t	hedge_at = 0;	// when the call is hedged if no response has arrived
+	uint64_t	now;
 	int		state;
+	rmr_mbuf_t*	held = NULL;	// message kept to send again when hedging
+	endpoint_t*	alt = NULL;		// endpoint the hedge goes to
+	uint32_t	hedge_us = 0;	// hedge delay; 0 if the call is not hedged
+	uint64_t	start = 0;		// when the call was sent if response times are tracked
+	int		call_mtype = 0;
+	xc_slot_t*	slot = NULL;	// outstanding call entry for an automatic call
 
 	errno = EINVAL;
 	if( (ctx = (uta_ctx_t *) vctx) == NULL || mbuf == NULL ) {
@@ -1094,8 +1848,17 @@ static rmr_mbuf_t* mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_w
 	}
 
 	ombuf = mbuf;													// save to return timeout status with
+	memset( &timer, 0, sizeof( timer ) );
 
-	chute = &ctx->chutes[call_id];
+	if( call_id == RMR_CALL_AUTO ) {
+		if( (chute = xc_chute( )) == NULL ) {
+			mbuf->state = RMR_ERR_INITFAILED;
+			mbuf->tp_state = errno;
+			return mbuf;
+		}
+	} else {
+		chute = &ctx->chutes[call_id];
+	}
 	if( chute->mbuf != NULL ) {										// probably a delayed message that wasn't dropped
 		rmr_free_msg( chute->mbuf );
 		chute->mbuf = NULL;
@@ -1103,54 +1866,81 @@ static rmr_mbuf_t* mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_w
 
 	hdr = (uta_mhdr_t *) mbuf->header;
 	hdr->flags |= HFL_CALL_MSG;										// must signal this sent with a call
-	memcpy( chute->expect, mbuf->xaction, RMR_MAX_XID );			// xaction that we will wait for
 	d1 = DATA1_ADDR( hdr );
-	d1[D1_CALLID_IDX] = (unsigned char) call_id;					// set the caller ID for the response
+	if( call_id == RMR_CALL_AUTO ) {
+		xc_set_xid( mbuf );
+		if( (slot = xc_add( ctx, mbuf->xaction, chute, NULL )) == NULL ) {	// too many calls in flight
+			mbuf->state = RMR_ERR_RETRY;
+			mbuf->tp_state = errno;
+			return mbuf;
+		}
+		xc_mark( ctx, d1 );
+	} else {
+		d1[D1_CALLID_IDX] = (unsigned char) call_id;				// set the caller ID for the response
+		d1[D1_XCALL_IDX] = 0;
+	}
+	memcpy( chute->expect, mbuf->xaction, RMR_MAX_XID );			// xaction that we will wait for
+	if( slot == NULL ) {
+		__atomic_store_n( &chute->state, XC_WAITING, __ATOMIC_RELEASE );	// receive thread may now fill the chute
+	}
 	mbuf->flags |= MFL_NOALLOC;										// send message without allocating a new one (expect nil from mtosend
 
 	if( max_wait >= 0 ) {
-		clock_gettime( CLOCK_REALTIME, &ts );
+		deadline = sr_now_ns( ) + (uint64_t) max_wait * 1000000;
+	}
 
-		if( max_wait > 999 ) {
-			seconds = max_wait / 1000;
-			max_wait -= seconds * 1000;
-			ts.tv_sec += seconds;
-		}
-		if( max_wait > 0 ) {
-			nano_sec = max_wait * 1000000;
-			ts.tv_nsec += nano_sec;
-			if( ts.tv_nsec > 999999999 ) {
-				ts.tv_nsec -= 999999999;
-				ts.tv_sec++;
-			}
+	if( ctx->hg_pct > 0 ) {									// response times are tracked for the hedge delay
+		call_mtype = mbuf->mtype;
+		start = sr_now_ns( );
+		if( ep == NULL ) {
+			hedge_us = hg_delay( ctx, call_mtype );
 		}
-
-		seconds = 1;										// use as flag later to invoked timed wait
 	}
 
 	if( ep == NULL ) {										// normal routing
-		mbuf = mtosend_msg( ctx, mbuf, 0 );					// use internal function so as not to strip call-id; should be nil on success!
+		if( hedge_us > 0 ) {
+			mbuf = hg_send( ctx, mbuf, &alt );				// message comes back (ok) if there is a member to hedge to
+		} else {
+			mbuf = mtosend_msg( ctx, mbuf, 0 );				// use internal function so as not to strip call-id; should be nil on success!
+		}
 	} else {
-		mbuf = send_msg( ctx, mbuf, ep->nn_sock, -1 );
+		mbuf = send_msg( ctx, mbuf, ep->nn_sock, -1, ep );
 	}
 	if( mbuf ) {
 		if( mbuf->state != RMR_OK ) {
 			mbuf->tp_state = errno;
+			if( slot != NULL ) {
+				xc_drop( slot );
+			} else {
+				xc_release( &chute->state );
+			}
 			return mbuf;									// timeout or unable to connect or no endpoint are most likely issues
 		}
+		held = mbuf;
+	}
+
+	if( held != NULL ) {
+		hedge_at = sr_now_ns( ) + (uint64_t) hedge_us * 1000;
+		if( deadline && hedge_at >= deadline ) {
+			rmr_free_msg( held );							// call times out before the hedge would be sent
+			held = NULL;
+		}
+	}
+
+	if( held != NULL ) {									// the wheel wakes us when the hedge, then the deadline, is due
+		tw_arm( ctx, &timer, hedge_at, tw_post, &chute->barrier );
+	} else if( deadline ) {
+		tw_arm( ctx, &timer, deadline, tw_post, &chute->barrier );
 	}
 
 	state = 0;
 	errno = 0;
 	while( chute->mbuf == NULL && ! errno ) {
-		if( seconds ) {
-			state = sem_timedwait( &chute->barrier, &ts );				// wait for msg or timeout
-		} else {
-			state = sem_wait( &chute->barrier );
-		}
-
-		if( state < 0 && errno == EINTR ) {								// interrupted go back and wait; all other errors cause exit
-			errno = 0;
+		if( (state = sem_wait( &chute->barrier )) < 0 ) {
+			if( errno == EINTR ) {										// interrupted go back and wait; all other errors cause exit
+				errno = 0;
+			}
+			continue;
 		}
 
 		if( chute->mbuf != NULL ) {										// offload receiver thread and check xaction buffer here
@@ -1159,16 +1949,53 @@ static rmr_mbuf_t* mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_w
 				chute->mbuf = NULL;
 				errno = 0;
 			}
+			continue;
+		}
+
+		now = sr_now_ns( );												// timer, or a post left from an earlier call
+		if( held != NULL ) {
+			if( now >= hedge_at ) {
+				hg_resend( ctx, held, alt );							// same xid; the first response wins
+				rmr_free_msg( held );
+				held = NULL;
+				if( deadline ) {
+					tw_arm( ctx, &timer, deadline, tw_post, &chute->barrier );
+				}
+			}
+		} else {
+			if( deadline && now >= deadline ) {
+				state = -1;
+				errno = ETIMEDOUT;
+			} else if( deadline && ! timer.armed ) {
+				tw_arm( ctx, &timer, deadline, tw_post, &chute->barrier );		// far off deadline was clamped; wait again
+			}
 		}
 	}
+	tw_cancel( ctx, &timer );
+
+	if( held != NULL ) {
+		rmr_free_msg( held );			// response came before the hedge was due
+	}
+	if( slot != NULL ) {
+		xc_drop( slot );
+	} else {
+		xc_release( &chute->state );
+	}
 
 	if( state < 0 ) {
-		return NULL;					// leave errno as set by sem wait call
+		if( chute->mbuf != NULL ) {		// arrived as we gave up; reclaim it now rather than leave it in the chute
+			rmr_free_msg( chute->mbuf );
+			chute->mbuf = NULL;
+		}
+		return NULL;					// leave errno as set by the wait
 	}
 
 	mbuf = chute->mbuf;
 	if( mbuf != NULL ) {
 		mbuf->state = RMR_OK;
+		if( start ) {
+			hg_record( ctx, call_mtype, (sr_now_ns( ) - start) / 1000 );
+		}
 	}
 	chute->mbuf = NULL;
 
@@ -1179,7 +2006,10 @@ static rmr_mbuf_t* mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_w
 	Accept a message buffer and caller ID, send the message and then wait
 	for the receiver to tickle the semaphore letting us know that a message
 	has been received. The call_id is a value between 2 and 255, inclusive; if
-	it's not in this range an error will be returned. Max wait is the amount
+	it's not in this range an error will be returned. A call_id of RMR_CALL_AUTO (0)
+	needs no management: the response is matched on the message's transaction id
+	(one is generated if the xaction field is empty), and any number of threads
+	may have automatic calls outstanding at once. Max wait is the amount
 	of time in millaseconds that the call should block for. If 0 is given
 	then no timeout is set.
 
@@ -1196,7 +2026,7 @@ static rmr_mbuf_t* mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_w
 extern rmr_mbuf_t* rmr_mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int max_wait ) {
 
 	// must vet call_id here, all others vetted by workhorse mt_call() function
-	if( call_id > MAX_CALL_ID || call_id < 2 ) {		// 0 and 1 are reserved; user app cannot supply them
+	if( call_id > MAX_CALL_ID || (call_id < 2 && call_id != RMR_CALL_AUTO) ) {		// 1 is reserved; user app cannot supply it
 		if( mbuf != NULL ) {
 			mbuf->state = RMR_ERR_BADARG;
 			mbuf->tp_state = EINVAL;
@@ -1207,6 +2037,111 @@ extern rmr_mbuf_t* rmr_mt_call( void* vctx, rmr_mbuf_t* mbuf, int call_id, int m
 	return mt_call( vctx, mbuf, call_id, max_wait, NULL );
 }
 
+/*
+	Turn on hedging of rmr_mt_call(): if no response has arrived when the pctile
+	percentile (1-99) of the message type's response times has passed, the message
+	is sent again to another member of its round robin group. Calls routed to a
+	broadcast or consistent hash group are not hedged. A pctile of 0 turns
+	hedging off. Response times are tracked only while hedging is on, and a type's
+	calls are not hedged until a few have completed.
+
+	Returns RMR_OK, or an RMR_ERR_ constant with errno set on failure.
+*/
+extern int rmr_set_hedge( void* vctx, int pctile ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || pctile < 0 || pctile > 99 ) {
+		errno = EINVAL;
+		return RMR_ERR_BADARG;
+	}
+
+	return hg_config( ctx, pctile );
+}
+
+/*
+	Make a call without waiting for the response. The message is sent as
+	rmr_mt_call() would send it (the response is matched on the xid, which is
+	generated if the message has none) and the function returns at once. When
+	the response arrives it is given to cb (on the receive thread), or, if cb is
+	nil, queued for rmr_call_complete(). If no response arrives within max_wait
+	milliseconds the call message itself is the completion, with the state
+	RMR_ERR_TIMEOUT; a max_wait of 0 or less never times out.
+
+	Returns RMR_OK if the message was sent; RMR then owns it until the call is
+	completed. Otherwise an RMR_ERR_ constant (errno set) is returned, the
+	message was not sent and remains the application's. RMR_ERR_RETRY is
+	returned when the maximum number of calls are in flight or waiting to be
+	collected.
+*/
+extern int rmr_call_async( void* vctx, rmr_mbuf_t* msg, int max_wait, rmr_call_cb_t cb, void* arg ) {
+	uta_ctx_t*	ctx;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL || msg == NULL || msg->header == NULL ) {
+		errno = EINVAL;
+		if( msg != NULL ) {
+			msg->state = RMR_ERR_BADARG;
+		}
+		return RMR_ERR_BADARG;
+	}
+
+	if( ! (ctx->flags & CFL_MTC_ENABLED) ) {
+		errno = ENOTSUP;
+		msg->state = RMR_ERR_NOTSUPP;
+		return msg->state;
+	}
+
+	return ac_call( ctx, msg, max_wait, cb, arg );
+}
+
+/*
+	Return the next asynchronous call (made without a callback) which has
+	completed, or nil (errno EAGAIN) if there are none. The message is the
+	response (state RMR_OK) or the call message (state RMR_ERR_TIMEOUT).
+*/
+extern rmr_mbuf_t* rmr_call_complete( void* vctx ) {
+	uta_ctx_t*		ctx;
+	async_call_t*	ac;
+	ac_req_t*		req;
+	rmr_mbuf_t*		msg;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if( (ac = __atomic_load_n( &ctx->acall, __ATOMIC_ACQUIRE )) == NULL || (req = (ac_req_t *) uta_ring_extract( ac->cq )) == NULL ) {
+		errno = EAGAIN;
+		return NULL;
+	}
+
+	msg = req->msg;
+	req->msg = NULL;
+	__atomic_store_n( &req->state, AC_FREE, __ATOMIC_RELEASE );
+	uta_ring_insert( ac->free, req );
+	return msg;
+}
+
+/*
+	Return a file descriptor which is readable (poll/epoll) while completed
+	asynchronous calls are waiting to be collected with rmr_call_complete().
+	Returns -1 on error.
+*/
+extern int rmr_get_call_cfd( void* vctx ) {
+	uta_ctx_t*		ctx;
+	async_call_t*	ac;
+
+	if( (ctx = (uta_ctx_t *) vctx) == NULL ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if( (ac = ac_ensure( ctx )) == NULL ) {
+		return -1;
+	}
+
+	return uta_ring_getpfd( ac->cq );
+}
+
 
 /*
 	Given an existing message buffer, reallocate the payload portion to
@@ -92,11 +92,21 @@ static int uta_link2( uta_ctx_t *ctx, endpoint_t* ep ) {
 		return FALSE;
 	}
 
+	if( ! ep->open && ! cb_allow( ep ) ) {		// peer known to be down; don't wait on another connect
+		if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "link2 circuit open for %s; not connecting\n", target );
+		return FALSE;
+	}
+
 	pthread_mutex_lock( &ep->gate );			// grab the lock
 	if( ep->open ) {
 		pthread_mutex_unlock( &ep->gate );
 		return TRUE;
 	}
+	if( ! cb_allow( ep ) ) {					// breaker opened while we waited on another sender's connect
+		pthread_mutex_unlock( &ep->gate );
+		if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "link2 circuit opened for %s while waiting; not connecting\n", target );
+		return FALSE;
+	}
 
 	snprintf( conn_info, sizeof( conn_info ), "%s", target );
 	errno = 0;
@@ -104,6 +114,7 @@ static int uta_link2( uta_ctx_t *ctx, endpoint_t* ep ) {
 	if( (ep->nn_sock = SIconnect( ctx->si_ctx, conn_info )) < 0 ) {
 		pthread_mutex_unlock( &ep->gate );
 
+		cb_failed( ctx, ep );
 		if( ep->notify ) {							// need to notify if set
 			rmr_vlog( RMR_VL_WARN, "rmr: link2: unable to connect  to target: %s: %d %s\n", target, errno, strerror( errno ) );
 			ep->notify = 0;
@@ -115,6 +126,7 @@ static int uta_link2( uta_ctx_t *ctx, endpoint_t* ep ) {
 
 	ep->open = TRUE;						// set open/notify before giving up lock
 	fd2ep_add( ctx, ep->nn_sock, ep );		// map fd to ep for disc cleanup (while we have the lock)
+	cb_connected( ep );
 
 	if( ! ep->notify ) {						// if we yammered about a failure, indicate finally good
 		rmr_vlog( RMR_VL_INFO, "rmr: link2: connection finally establisehd with target: %s\n", target );
@@ -251,6 +263,9 @@ static int uta_epsock_byname( uta_ctx_t* ctx, char* ep_name, int* nn_sock, endpo
 			release_rt( ctx, rt );							// drop ref count
 			return FALSE;
 		}
+		if( uepp != NULL ) {
+			*uepp = ep;
+		}
 	}
 	release_rt( ctx, rt );										// drop ref count
 
@@ -274,6 +289,32 @@ static int uta_epsock_byname( uta_ctx_t* ctx, char* ep_name, int* nn_sock, endpo
 	return state;
 }
 
+/*
+	Get the socket for a known endpoint, connecting if the session is not yet
+	open. Returns true and sets *nn_sock if the endpoint has a session.
+*/
+static int uta_epsock_ep( uta_ctx_t* ctx, endpoint_t* ep, int* nn_sock ) {
+	if( ep == NULL || nn_sock == NULL ) {
+		return FALSE;
+	}
+
+	if( ! ep->open ) {
+		if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "epsock_ep: endpoint not yet open; opening %s\n", ep->name );
+		if( ep->addr == NULL ) {					// name didn't resolve before, try again
+			ep->addr = strdup( ep->name );
+		}
+		if( ! uta_link2( ctx, ep ) ) {
+			if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "epsock_ep: connection failed: %s\n", ep->name );
+			return FALSE;
+		}
+		ep->open = TRUE;
+		fd2ep_add( ctx, ep->nn_sock, ep );			// map fd to ep for disc cleanup
+	}
+
+	*nn_sock = ep->nn_sock;
+	return TRUE;
+}
+
 /*
 	Make a round robin selection within a round robin group for a route table
 	entry. Returns the socket fd if there is a rte for the message
@@ -292,20 +333,28 @@ static int uta_epsock_byname( uta_ctx_t* ctx, char* ep_name, int* nn_sock, endpo
 	We return the index+1 from the round robin table on success so that we can verify
 	during test that different entries are being seleted.
 
-	NOTE:	The round robin selection index increment might collide with other
-		threads if multiple threads are attempting to send to the same round
-		robin group; the consequences are small and avoid locking. The only side
-		effect is either sending two messages in a row to, or skipping, an endpoint.
-		Both of these, in the grand scheme of things, is minor compared to the
-		overhead of grabbing a lock on each call.
+	When the group has more than one endpoint the selection is made according to
+	the group's policy (round robin, weighted, load aware or consistent hash); see
+	lb_select(). The round robin cursor is bumped atomically so that threads sending
+	to the same group do not skip, or double up on, an endpoint.
 */
 static int uta_epsock_rr( uta_ctx_t* ctx, rtable_ent_t* rte, int group, int* more, int* nn_sock, endpoint_t** uepp ) {
+	return uta_epsock_rr_msg( ctx, rte, group, more, nn_sock, uepp, NULL );
+}
+
+/*
+	As uta_epsock_rr(), but with the message being sent so that a consistent hash
+	group can select the endpoint from the message's key.
+*/
+static int uta_epsock_rr_msg( uta_ctx_t* ctx, rtable_ent_t* rte, int group, int* more, int* nn_sock, endpoint_t** uepp, rmr_mbuf_t* msg ) {
 	si_ctx_t* 		si_ctx;
 	endpoint_t*	ep;				// selected end point
 	int  state = FALSE;			// processing state
 	int dummy;
 	rrgroup_t* rrg;
-	int	idx;
+	int	idx = 0;
+	int	i;
+	endpoint_t*	alt;					// another member when the selected one's circuit is open
 
 	if( PARANOID_CHECKS ) {
 		if( ctx == NULL || (si_ctx = ctx->si_ctx) == NULL  ) {
@@ -357,14 +406,24 @@ static int uta_epsock_rr( uta_ctx_t* ctx, rtable_ent_t* rte, int group, int* mor
 			state = TRUE;
 			break;
 
-		default:										// need to pick one and adjust rr counts
-			idx = rrg->ep_idx++ % rrg->nused;			// see note above
+		default:										// need to pick one as the group's policy says
+			idx = lb_select( rrg, msg );
 			ep = rrg->epts[idx];						// select next endpoint
 			if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "_rr returning socket with multiple choices in group idx=%d \n", rrg->ep_idx );
 			state = idx + 1;							// unit test checks to see that we're cycling through, so must not just be TRUE
 			break;
 	}
 
+	if( state && ! ep->open && ! cb_closed( ep ) && rrg->nused > 1 ) {		// peer is down; fail over to a member which may be up
+		for( i = 1; i < rrg->nused; i++ ) {
+			alt = rrg->epts[(idx + i) % rrg->nused];
+			if( alt->open || cb_closed( alt ) ) {
+				ep = alt;
+				break;
+			}
+		}
+	}
+
 	if( uepp != NULL ) {								// caller may need refernce to endpoint too; give it if pointer supplied
 		*uepp = ep;
 	}
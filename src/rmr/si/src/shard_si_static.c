@@ -0,0 +1,160 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	shard_si_static.c
+	Abstract:	Key affine sharding of received messages.
+
+				When the application configures shards (rmr_set_shards()) the
+				receive thread no longer queues messages on the common receive
+				ring. Instead a key is taken from each message (meid, xid prefix,
+				subscription id or message type), hashed, and the message is placed
+				on the ring for hash % nshards.  Each shard ring has exactly one
+				writer (the receive thread) and is expected to have exactly one
+				reader (the worker which owns the shard) so the rings are created
+				without locks. Messages with the same key are always placed on the
+				same shard and thus are processed in the order received.
+
+				Each ring's eventfd is exposed to the application so that a worker
+				may block on it with poll/epoll.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _shard_si_static_c
+#define _shard_si_static_c
+
+#define SHARD_RING_SIZE		4096		// each shard ring is the same size as the normal receive ring
+#define SHARD_XID_SEP		':'			// xid prefix is the portion of the xid before this
+
+/*
+	FNV-1a hash of len bytes. If stop is not negative the key is treated as a
+	string and hashing also stops at a nil or the stop character, whichever is
+	first.
+*/
+static inline uint32_t shard_hash( unsigned char const* key, int len, int stop ) {
+	uint32_t	h = 2166136261U;
+	int			i;
+
+	for( i = 0; i < len; i++ ) {
+		if( stop >= 0 && (key[i] == 0 || key[i] == stop) ) {
+			break;
+		}
+
+		h ^= key[i];
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/*
+	Hash the message's key (an RMR_SHARD_ constant). Also used to pick the
+	endpoint in a consistent hash group (lb_select()).
+*/
+static inline uint32_t shard_key_hash( int key, rmr_mbuf_t* mbuf ) {
+	uta_mhdr_t*	hdr;
+	uint32_t	h;
+	uint32_t	nkey;
+
+	hdr = (uta_mhdr_t *) mbuf->header;
+	switch( key ) {
+		case RMR_SHARD_MEID:
+			h = shard_hash( hdr->meid, RMR_MAX_MEID, 0 );
+			break;
+
+		case RMR_SHARD_XID:
+			h = shard_hash( hdr->xid, RMR_MAX_XID, SHARD_XID_SEP );
+			break;
+
+		case RMR_SHARD_SUBID:
+			nkey = (uint32_t) mbuf->sub_id;
+			h = shard_hash( (unsigned char *) &nkey, sizeof( nkey ), -1 );
+			break;
+
+		default:
+			nkey = (uint32_t) mbuf->mtype;
+			h = shard_hash( (unsigned char *) &nkey, sizeof( nkey ), -1 );
+			break;
+	}
+
+	return h;
+}
+
+/*
+	Compute the shard that the message belongs on. Messages without the key
+	(e.g. an empty meid) all hash to the same shard.
+*/
+static inline int shard_idx( uta_ctx_t* ctx, rmr_mbuf_t* mbuf, int nshards ) {
+	return (int) (shard_key_hash( ctx->shard_key, mbuf ) % (uint32_t) nshards);
+}
+
+/*
+	Allocate the shard rings. Returns true on success; on failure anything
+	allocated is released and errno is left set.
+*/
+static int mk_shards( uta_ctx_t* ctx, int nshards ) {
+	void**	shards;
+	int		i;
+
+	if( (shards = (void **) malloc( sizeof( void* ) * nshards )) == NULL ) {
+		errno = ENOMEM;
+		return FALSE;
+	}
+
+	for( i = 0; i < nshards; i++ ) {
+		if( (shards[i] = uta_mk_ring( SHARD_RING_SIZE )) == NULL ) {
+			while( --i >= 0 ) {
+				uta_ring_free( shards[i] );
+			}
+			free( shards );
+			errno = ENOMEM;
+			return FALSE;
+		}
+	}
+
+	ctx->shards = shards;
+	return TRUE;
+}
+
+/*
+	Release the shard rings and any messages which were left queued.
+*/
+static void free_shards( uta_ctx_t* ctx ) {
+	rmr_mbuf_t*	mbuf;
+	int			i;
+
+	if( ctx == NULL || ctx->shards == NULL ) {
+		return;
+	}
+
+	for( i = 0; i < ctx->nshards; i++ ) {
+		while( (mbuf = (rmr_mbuf_t *) uta_ring_extract( ctx->shards[i] )) != NULL ) {
+			rmr_free_msg( mbuf );
+		}
+		uta_ring_free( ctx->shards[i] );
+	}
+
+	free( ctx->shards );
+	ctx->shards = NULL;
+	ctx->nshards = 0;
+}
+
+#endif
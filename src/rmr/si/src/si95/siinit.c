@@ -103,6 +103,27 @@ extern void SIclr_tflags( struct ginfo_blk* gp, int mask )  {
 	}
 }
 
+/*
+	Replace the buffer that data is read into with one supplied by the caller
+	(it must be at least len bytes). The previous buffer is returned and the
+	caller is responsible for it. Intended to be called from within the data
+	callback, which allows the caller to keep the buffer just passed to it and
+	provide a new one for the next read. Nil is returned, and the buffer is
+	not changed, if buf is nil or len is not positive.
+*/
+extern char* SIset_rbuf( struct ginfo_blk* gp, char* buf, int len ) {
+	char*	old;
+
+	if( gp == NULL || buf == NULL || len <= 0 ) {
+		return NULL;
+	}
+
+	old = gp->rbuf;
+	gp->rbuf = buf;
+	gp->rbuflen = len;
+	return old;
+}
+
 /*
 	Dump stats to stderr.
 
@@ -116,7 +116,7 @@ extern int SIpoll( struct ginfo_blk *gptr, int msdelay )
           if( tpptr->type == SOCK_DGRAM )          //  udp socket?
            {
             uaddr = (struct sockaddr *) malloc( sizeof( struct sockaddr ) );
-            status = RECVFROM( fd, gptr->rbuf, MAX_RBUF, 0, uaddr, &addrlen );
+            status = RECVFROM( fd, gptr->rbuf, gptr->rbuflen, 0, uaddr, &addrlen );
             if( status >= 0 && ! (tpptr->flags & TPF_DRAIN) )
              {					                         //  if good status call cb routine
               if( (cbptr = gptr->cbtab[SI_CB_RDATA].cbrtn) != NULL )
@@ -132,7 +132,7 @@ extern int SIpoll( struct ginfo_blk *gptr, int msdelay )
            }                                  //  end if udp
           else
            {                                //  else receive on tcp session
-            status = RECV( fd, gptr->rbuf, MAX_RBUF, 0 );    //  read data
+            status = RECV( fd, gptr->rbuf, gptr->rbuflen, 0 );    //  read data
 
             if( status > SI_OK  &&  ! (tpptr->flags & TPF_DRAIN) )
              {
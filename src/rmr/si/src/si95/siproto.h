@@ -32,6 +32,8 @@
 #ifndef _si_proto_h
 #define _si_proto_h
 
+#include <sys/uio.h>			// struct iovec for SIsendv()
+
 extern void siabort_conn( int fd );		// use by applications discouraged
 
 extern void *SInew( int type );
@@ -56,7 +58,10 @@ extern int SIrcv( struct ginfo_blk *gptr, int sid, char *buf, int buflen, char *
 extern void SIrm_tpb( struct ginfo_blk *gptr, struct tp_blk *tpptr );
 extern void SIsend( struct ginfo_blk *gptr, struct tp_blk *tpptr );
 extern int SIsendt( struct ginfo_blk *gptr, int fd, char *ubuf, int ulen );
+extern int SIsendv( struct ginfo_blk *gptr, int fd, struct iovec *iov, int niov );
+extern int SIwritable( struct ginfo_blk *gptr, int fd, long usec );
 extern void SIset_tflags( struct ginfo_blk* gp, int flags );
+extern char* SIset_rbuf( struct ginfo_blk* gp, char* buf, int len );
 extern int SIshow_version( );
 extern void SIshutdown( struct ginfo_blk *gptr );
 extern void SItp_stats( void *vgp );
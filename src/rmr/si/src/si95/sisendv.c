@@ -0,0 +1,137 @@
+// vim: noet sw=4 ts=4:
+/*
+==================================================================================
+    Copyright (c) 2020-2026 Nokia
+    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+****************************************************************************
+*
+*  Mnemonic: SIsendv
+*  Abstract: Gathering send on a tcp session. The caller's buffers are
+*			written with writev() so that a header and a payload held in
+*			separate memory need not be copied into one buffer first.
+*
+*  Date:     18 October 2026
+*
+*****************************************************************************
+*/
+
+#include "sisetup.h"     //  get setup stuff
+#include "sitransport.h"
+
+/*
+	Send the niov buffers described by iov, in order, as one stream of bytes on
+	what is assumed to be a tcp connection. Like SIsendt(), if the session would
+	block nothing is written and SI_ERR_BLOCKED is returned; once the first byte
+	is written, all are written before returning (the caller may reuse its
+	buffers as soon as this returns). SI_OK or SI_ERROR is otherwise returned,
+	and errno is set as it is by SIsendt().
+
+	The iovec array is not modified; a copy is advanced over partial writes.
+*/
+extern int SIsendv( struct ginfo_blk *gptr, int fd, struct iovec *iov, int niov ) {
+	int status = SI_ERROR;      //  assume we fail
+	fd_set writefds;            //  local write fdset to check blockage
+	fd_set execpfds;            //  exception fdset to check errors
+	struct tp_blk *tpptr;       //  pointer at the tp_blk for the session
+	struct timeval time;        //  delay time parameter for select call
+	struct iovec lv[SI_MAX_IOV];	// local copy we can advance over partial writes
+	struct iovec* vp;			// first iovec not yet completely written
+	int	nleft;					// iovecs remaining
+	ssize_t	wlen;				// bytes written by a single writev call
+
+	errno = EINVAL;
+
+	if( fd < 0 ) {
+		errno = EBADFD;
+		return SI_ERROR;					// bad form trying to use this fd
+	}
+
+	if( iov == NULL || niov <= 0 || niov > SI_MAX_IOV ) {
+		return SI_ERROR;
+	}
+
+	if( fd < MAX_FDS ) {					// straight from map if possible
+		tpptr = gptr->tp_map[fd];
+	} else {
+		for( tpptr = gptr->tplist; tpptr != NULL && tpptr->fd != fd; tpptr = tpptr->next ) ; //  find the block if out of map's range
+	}
+	if( tpptr == NULL ) {
+		errno = EBADFD;						// fd in a bad state (probably lost)
+		return SI_ERROR;
+	}
+
+	if( (fd = tpptr->fd) < 0 || fd >= FD_SETSIZE ) {		// fd user given might not be real, and this might be closed already
+		errno = EBADFD;
+		return SI_ERROR;
+	}
+
+	tpptr->sent++;
+
+	FD_ZERO( &writefds );
+	FD_SET( fd, &writefds );
+	FD_ZERO( &execpfds );
+	FD_SET( fd, &execpfds );
+
+	time.tv_sec = 0;
+	time.tv_usec = 1;
+
+	if( select( fd + 1, NULL, &writefds, &execpfds, &time ) <= 0 ) {		// would block
+		errno = EBUSY;
+		return SI_ERR_BLOCKED;
+	}
+
+	if( FD_ISSET( fd, &execpfds ) ) {		//  error?
+		errno = EBADFD;
+		SIterm( gptr, tpptr );				// mark block for deletion when safe
+		return SI_ERROR;
+	}
+
+	memcpy( lv, iov, sizeof( struct iovec ) * niov );
+	vp = lv;
+	nleft = niov;
+	errno = 0;
+	status = SI_OK;
+	while( nleft > 0 ) {					// once we start, we must ensure that it all goes out
+		if( vp->iov_len == 0 ) {
+			vp++;
+			nleft--;
+			continue;
+		}
+
+		if( (wlen = WRITEV( fd, vp, nleft )) < 0 ) {
+			if( errno != EINTR && errno != EAGAIN ) {
+				status = SI_ERROR;
+				break;
+			}
+			continue;
+		}
+
+		while( nleft > 0 && wlen >= (ssize_t) vp->iov_len ) {		// skip what was completely written
+			wlen -= vp->iov_len;
+			vp++;
+			nleft--;
+		}
+		if( nleft > 0 ) {											// partial iovec; advance into it
+			vp->iov_base = (char *) vp->iov_base + wlen;
+			vp->iov_len -= wlen;
+		}
+	}
+
+	return status;
+}
@@ -55,6 +55,7 @@
 #define SETSOCKOPT	ff_setsockopt
 #define READ		ff_read
 #define WRITE		ff_write
+#define WRITEV		ff_writev
 #define SEND		ff_send
 #define SENDTO		ff_sendto
 #define RECV		ff_recv
@@ -75,6 +76,7 @@
 #define SETSOCKOPT	setsockopt
 #define READ		read
 #define WRITE		write
+#define WRITEV		writev
 #define SEND		send
 #define SENDTO		sendto
 #define RECV		recv
@@ -0,0 +1,92 @@
+// vim: noet sw=4 ts=4:
+/*
+==================================================================================
+    Copyright (c) 2020-2026 Nokia
+    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+****************************************************************************
+*
+*  Mnemonic: SIwritable
+*  Abstract: Block, without spinning, until a tcp session can be written
+*			or a timeout expires. Used by callers which got SI_ERR_BLOCKED
+*			from SIsendt() or SIsendv() and want to wait for the session
+*			to drain rather than retry in a loop.
+*
+*  Date:     18 October 2026
+*
+*****************************************************************************
+*/
+
+#include "sisetup.h"     //  get setup stuff
+#include "sitransport.h"
+
+/*
+	Wait up to usec microseconds for the session on fd to become writable.
+	Returns SI_OK if it is writable, SI_ERR_BLOCKED if the time expired first,
+	or SI_ERROR if the fd is not a session or the session is in error (errno
+	is set as it is by SIsendt()). A signal ends the wait early with
+	SI_ERR_BLOCKED; callers working to a deadline just wait again.
+*/
+extern int SIwritable( struct ginfo_blk *gptr, int fd, long usec ) {
+	fd_set writefds;            //  local write fdset to check blockage
+	fd_set execpfds;            //  exception fdset to check errors
+	struct tp_blk *tpptr;       //  pointer at the tp_blk for the session
+	struct timeval time;        //  max time to block in select
+
+	errno = EINVAL;
+
+	if( fd < 0 ) {
+		errno = EBADFD;
+		return SI_ERROR;
+	}
+
+	if( fd < MAX_FDS ) {					// straight from map if possible
+		tpptr = gptr->tp_map[fd];
+	} else {
+		for( tpptr = gptr->tplist; tpptr != NULL && tpptr->fd != fd; tpptr = tpptr->next ) ; //  find the block if out of map's range
+	}
+	if( tpptr == NULL || (fd = tpptr->fd) < 0 || fd >= FD_SETSIZE ) {
+		errno = EBADFD;
+		return SI_ERROR;
+	}
+
+	if( usec < 0 ) {
+		usec = 0;
+	}
+
+	FD_ZERO( &writefds );
+	FD_SET( fd, &writefds );
+	FD_ZERO( &execpfds );
+	FD_SET( fd, &execpfds );
+
+	time.tv_sec = usec / 1000000;
+	time.tv_usec = usec % 1000000;
+
+	if( select( fd + 1, NULL, &writefds, &execpfds, &time ) <= 0 ) {		// timeout (or interrupted)
+		errno = EBUSY;
+		return SI_ERR_BLOCKED;
+	}
+
+	if( FD_ISSET( fd, &execpfds ) ) {
+		errno = EBADFD;
+		return SI_ERROR;
+	}
+
+	errno = 0;
+	return SI_OK;
+}
@@ -107,6 +107,8 @@
 #define SI_ERR_ADDR    	17       //  address conversion failed
 #define SI_ERR_BLOCKED	18		// operation would block
 
+#define SI_MAX_IOV		64		// max buffers in a single SIsendv() call
+
 #define SI_TF_NONE		0		// tcp flags in the global info applied to each session
 #define SI_TF_NODELAY	0x01	// set nagle's off for each connection
 #define SI_TF_FASTACK	0x02	// set fast ack on for each connection
@@ -155,20 +155,26 @@ static rmr_mbuf_t* alloc_zcmsg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int size, int s
 	mlen += (size > 0 ? size  : ctx->max_plen);							// add user requested size or size set during init
 	mlen = sizeof( char ) * (mlen + TP_HDR_LEN);						// finally add the transport header len
 
-	if( msg == NULL && (msg = (rmr_mbuf_t *) uta_ring_extract( ctx->zcb_mring )) == NULL ) {
-		msg = (rmr_mbuf_t *) malloc( sizeof *msg );
-		if( msg == NULL ) {
-			rmr_vlog( RMR_VL_CRIT, "rmr_alloc_zc: cannot get memory for message\n" );
-			return NULL;								// we used to exit -- that seems wrong
-		}
-		memset( msg, 0, sizeof( *msg ) );	// tp_buffer will be allocated below
-	} else {								// user message or message from the ring
+	if( msg == NULL ) {
+		if( (msg = mbp_get( )) == NULL ) {
+			msg = (rmr_mbuf_t *) malloc( sizeof *msg );
+			if( msg == NULL ) {
+				rmr_vlog( RMR_VL_CRIT, "rmr_alloc_zc: cannot get memory for message\n" );
+				return NULL;								// we used to exit -- that seems wrong
+			}
+			memset( msg, 0, sizeof( *msg ) );	// tp_buffer will be allocated below
+		} else {
+			if( msg->tp_buf != NULL && tpb_size( msg->tp_buf ) >= mlen ) {		// recycled with a (pooled) buffer large enough
+				msg->alloc_len = mlen;							// caller gets the size asked for, not what the buffer last held
+			} else {
+				msg->alloc_len = 0;
+				tpb_release( msg );
+			}
+		}
+	} else {								// user message
 		if( mlen > msg->alloc_len ) {		// current allocation is too small
 			msg->alloc_len = 0;				// force tp_buffer realloc below
-			if( msg->tp_buf ) {
-				free( msg->tp_buf );
-				msg->tp_buf = NULL;
-			}
+			tpb_release( msg );
 		} else {
 			mlen = msg->alloc_len;							// msg given, allocate the same size as before
 		}
@@ -176,7 +182,7 @@ static rmr_mbuf_t* alloc_zcmsg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int size, int s
 
 	msg->rts_fd = -1;					// must force to be invalid; not a received message that can be returned
 
-	if( !msg->alloc_len && (msg->tp_buf = (void *) malloc( mlen )) == NULL ) {
+	if( !msg->alloc_len && tpb_attach( msg, mlen ) == NULL ) {
 		rmr_vlog( RMR_VL_CRIT, "rmr_alloc_zc: cannot get memory for zero copy buffer: %d bytes\n", (int) mlen );
 		abort( );											// toss out a core file for this
 	}
@@ -207,7 +213,7 @@ static rmr_mbuf_t* alloc_zcmsg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int size, int s
 	msg->payload = PAYLOAD_ADDR( hdr );						// point to payload (past all header junk)
 	msg->xaction = ((uta_mhdr_t *)msg->header)->xid;		// point at transaction id in header area
 	msg->state = state;										// fill in caller's state (likely the state of the last operation)
-	msg->flags = MFL_ZEROCOPY;								// this is a zerocopy sendable message
+	msg->flags = MFL_ZEROCOPY | (msg->flags & MFL_TPMASK);	// this is a zerocopy sendable message; keep track of where tp_buf came from
 	msg->ring = ctx->zcb_mring;								// original msg_free() api doesn't get context so must dup on eaach :(
 	zt_buf_fill( (char *) ((uta_mhdr_t *)msg->header)->src, ctx->my_name, RMR_MAX_SRC );
 	zt_buf_fill( (char *) ((uta_mhdr_t *)msg->header)->srcip, ctx->my_ip, RMR_MAX_SRC );
@@ -226,10 +232,8 @@ static rmr_mbuf_t* alloc_mbuf( uta_ctx_t* ctx, int state ) {
 	uta_mhdr_t* hdr;			// convenience pointer
 	rmr_mbuf_t* msg;
 
-	if( (msg = (rmr_mbuf_t *) uta_ring_extract( ctx->zcb_mring )) != NULL ) {
-		if( msg->tp_buf ) {
-			free( msg->tp_buf );		// caller doesn't want it -- future put this on an accumulation ring
-		}
+	if( (msg = mbp_get( )) != NULL ) {
+		tpb_release( msg );				// caller doesn't want it; back to the pool
 	} else {
 		if( (msg = (rmr_mbuf_t *) malloc( sizeof *msg )) == NULL ) {
 			rmr_vlog( RMR_VL_CRIT, "rmr_alloc_mbuf: cannot get memory for message\n" );
@@ -330,7 +334,7 @@ static inline rmr_mbuf_t* clone_msg( rmr_mbuf_t* old_msg  ) {
 	memset( nm, 0, sizeof( *nm ) );
 
 	mlen = old_msg->alloc_len;										// length allocated before
-	if( (nm->tp_buf = (void *) malloc( sizeof( char ) * (mlen + TP_HDR_LEN) )) == NULL ) {
+	if( tpb_attach( nm, sizeof( char ) * (mlen + TP_HDR_LEN) ) == NULL ) {
 		rmr_vlog( RMR_VL_CRIT, "rmr_si_clone: cannot get memory for zero copy buffer: %d\n", (int) mlen );
 		abort();
 	}
@@ -358,7 +362,7 @@ static inline rmr_mbuf_t* clone_msg( rmr_mbuf_t* old_msg  ) {
 
 	nm->xaction = &hdr->xid[0];								// reference xaction
 	nm->state = old_msg->state;								// fill in caller's state (likely the state of the last operation)
-	nm->flags = old_msg->flags | MFL_ZEROCOPY;				// this is a zerocopy sendable message
+	nm->flags = (old_msg->flags & ~MFL_TPMASK) | (nm->flags & MFL_TPMASK) | MFL_ZEROCOPY;	// zerocopy sendable; pool flag is for our buffer not the old one
 	memcpy( nm->payload, old_msg->payload, old_msg->len );
 
 	return nm;
@@ -394,7 +398,7 @@ static inline rmr_mbuf_t* realloc_msg( rmr_mbuf_t* old_msg, int tr_len  ) {
 	if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "tr_realloc old size=%d new size=%d new tr_len=%d\n", (int) old_msg->alloc_len, (int) mlen, (int) tr_len );
 
 	tpb_len = mlen + TP_HDR_LEN;
-	if( (nm->tp_buf = (void *) malloc( tpb_len)) == NULL ) {
+	if( tpb_attach( nm, tpb_len ) == NULL ) {
 		rmr_vlog( RMR_VL_CRIT, "rmr_clone: cannot get memory for zero copy buffer: %d\n", ENOMEM );
 		exit( 1 );
 	}
@@ -438,7 +442,7 @@ static inline rmr_mbuf_t* realloc_msg( rmr_mbuf_t* old_msg, int tr_len  ) {
 
 	nm->xaction = &hdr->xid[0];								// reference xaction
 	nm->state = old_msg->state;								// fill in caller's state (likely the state of the last operation)
-	nm->flags = old_msg->flags | MFL_ZEROCOPY;				// this is a zerocopy sendable message
+	nm->flags = (old_msg->flags & ~MFL_TPMASK) | (nm->flags & MFL_TPMASK) | MFL_ZEROCOPY;	// zerocopy sendable; pool flag is for our buffer not the old one
 	memcpy( nm->payload, old_msg->payload, old_msg->len );
 
 	return nm;
@@ -490,6 +494,7 @@ static inline rmr_mbuf_t* realloc_payload( rmr_mbuf_t* old_msg, int payload_len,
 	int		old_sid;
 	int		old_len;
 	int		old_rfd;		// rts file descriptor from old message
+	int		old_pooled;		// MFL_TP* flags noting where the old tp buffer came from
 
 	if( old_msg == NULL || payload_len <= 0 ) {
 		errno = EINVAL;
@@ -510,6 +515,7 @@ static inline rmr_mbuf_t* realloc_payload( rmr_mbuf_t* old_msg, int payload_len,
 
 	hdr_len = RMR_HDR_LEN( old_msg->header ) + TP_HDR_LEN;				// with SI we manage the transport header; must include in len
 	old_tp_buf = old_msg->tp_buf;
+	old_pooled = old_msg->flags & MFL_TPMASK;
 
 	if( clone ) {
 		if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "rmr_realloc_payload: cloning message\n" );
@@ -530,9 +536,14 @@ static inline rmr_mbuf_t* realloc_payload( rmr_mbuf_t* old_msg, int payload_len,
 	mlen = hdr_len + (payload_len > old_psize ? payload_len : old_psize);		// must have larger in case copy is true
 
 	if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "reallocate for payload increase. new message size: %d\n", (int) mlen );
-	if( (nm->tp_buf = (char *) malloc( sizeof( char ) * mlen )) == NULL ) {
+	if( tpb_attach( nm, sizeof( char ) * mlen ) == NULL ) {
 		rmr_vlog( RMR_VL_CRIT, "rmr_realloc_payload: cannot get memory for zero copy buffer. bytes requested: %d\n", (int) mlen );
-		free( nm );
+		if( clone ) {
+			free( nm );
+		} else {
+			nm->tp_buf = old_tp_buf;							// leave the caller's message as it was
+			nm->flags |= old_pooled;
+		}
 		return NULL;
 	}
 
@@ -559,32 +570,103 @@ static inline rmr_mbuf_t* realloc_payload( rmr_mbuf_t* old_msg, int payload_len,
 		nm->sub_id = old_sid;
 	}
 
-	if( free_tp ) {
-		free( old_tp_buf );				// we did not clone, so free b/c no references
+	if( free_tp ) {						// we did not clone, so free b/c no references
+		tpb_put( old_tp_buf, old_pooled );
 	}
 
 	return nm;
 }
 
+static inline uint64_t sr_now_ns( void ) {
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+	Wait, without spinning, for the blocked session to drain. The time spent is
+	added to the endpoint's counts (if there is an endpoint). Returns false if the
+	deadline (monotonic ns) has passed and the send should give up.
+*/
+static int send_wait( uta_ctx_t* ctx, int nn_sock, endpoint_t* ep, uint64_t deadline ) {
+	uint64_t	start;
+	uint64_t	ns;
+	uint64_t	max;
+
+	if( (start = sr_now_ns( )) >= deadline ) {
+		return FALSE;
+	}
+
+	SIwritable( ctx->si_ctx, nn_sock, (long) ((deadline - start + 999) / 1000) );	// errors are reported by the next send attempt
+
+	if( ep != NULL ) {
+		ns = sr_now_ns( ) - start;
+		__atomic_add_fetch( &ep->blocked, 1, __ATOMIC_RELAXED );
+		__atomic_add_fetch( &ep->blocked_ns, ns, __ATOMIC_RELAXED );
+		max = __atomic_load_n( &ep->max_blocked_ns, __ATOMIC_RELAXED );
+		while( ns > max && ! __atomic_compare_exchange_n( &ep->max_blocked_ns, &max, ns, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+	}
+
+	return TRUE;
+}
+
 /*
 	This does the hard work of actually sending the message to the given socket. On success,
 	a new message struct is returned. On error, the original msg is returned with the state
 	set to a reasonable value. If the message being sent as MFL_NOALLOC set, then a new
 	buffer will not be allocated and returned (mostly for call() interal processing since
-	the return message from call() is a received buffer, not a new one).
+	the return message from call() is a received buffer, not a new one). If MFL_FANOUT is
+	set the message is returned, with state ok, on success too; it is to be sent again.
 
 	Called by rmr_send_msg() and rmr_rts_msg(), etc. and thus we assume that all pointer
 	validation has been done prior.
 
+	The endpoint, if known, is used to enforce flow control credits granted by the peer.
+	When the peer's limit has been reached the message is returned immediately with the
+	state set to RMR_ERR_RETRY. It may be nil when sending on a session that we did not
+	open (e.g. rts falling back to the fd the message arrived on).
+
 	When msg->state is not ok, this function must set tp_state in the message as some API
 	fucntions return the message directly and do not propigate errno into the message.
+
+	If iov is not nil, the payload is not in the message's buffer; the niov user buffers
+	are sent, in order, following the headers from the message buffer (msg->len must be
+	their total length). The message is never consumed in this case; it is returned, and
+	may be used again, whether or not the send was successful.
+
+	If a send deadline is set (rmr_set_stimeout_us()) a blocked send waits for the session
+	to become writable, up to the deadline, instead of retrying; retries is then ignored
+	except that a value of 0 means do not wait at all.
+
+	If compression is enabled for the message type, the payload (from the message buffer
+	only) is compressed into a separate buffer which is sent in its place; the message
+	buffer is not changed.
+
+	If batching is on (rmr_set_batch()) and the endpoint is known, the frame is added to
+	the endpoint's batch rather than written; the send is successful once it is buffered.
+	Frames larger than the batch size are written directly, after anything buffered.
 */
-static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int retries ) {
+static rmr_mbuf_t* send_msgv( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int retries, endpoint_t* ep, struct iovec const* iov, int niov ) {
 	int state;
 	uta_mhdr_t*	hdr;
 	int spin_retries = 1000;				// if eagain/timeout we'll spin, at max, this many times before giving up the CPU
 	int	tr_len;								// trace len in sending message so we alloc new message with same trace sizes
 	int tot_len;							// total send length (hdr + user data + tp header)
+	struct iovec	vec[RMR_MAX_IOV+2];		// headers, header data/payload, and user buffers for a gathering send
+	int		nvec = 0;						// vec entries used; 0 when the message buffer is sent as is
+	char	chbuf[CH_BUF_LEN];				// compact header when the peer accepts them
+	int		chlen = 0;
+	int		ident = FALSE;					// compact header carried our identity
+	struct iovec const*	piov;				// payload buffers when not in the message buffer (user's, or compressed)
+	int		npiov;
+	struct iovec	cziov;					// compressed payload
+	unsigned char*	czbuf = NULL;
+	uint64_t	deadline = 0;				// monotonic ns after which a blocked send gives up (deadline mode)
+	int		wait_us;						// send deadline; 0 if blocked sends retry (or give up) rather than wait
+	int		bat_max;						// frames up to this size are batched (0 if not batching)
+	struct iovec	whole;					// the message buffer as a vector when batched
+	int		i;
 
 	// future: ensure that application did not overrun the XID buffer; last byte must be 0
 
@@ -599,27 +681,112 @@ static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int r
 		zt_buf_fill( (char *) ((uta_mhdr_t *)msg->header)->srcip, ctx->my_ip, RMR_MAX_SRC );
 	}
 
+	if( ep != NULL ) {
+		hdr->flags |= HFL_FC_CAP;									// we honour credits on sessions we opened
+		if( ctx->ch_on ) {
+			hdr->flags |= HFL_CH_CAP;								// and would send compact headers if accepted
+		}
+		if( ctx->cz_types != NULL ) {
+			hdr->flags |= HFL_CZ_CAP;								// and compressed payloads
+		}
+		if( ! fc_take( ep ) ) {
+			if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "send_msg: no flow control credit for %s\n", ep->name );
+			msg->state = RMR_ERR_RETRY;
+			errno = EAGAIN;
+			msg->tp_state = errno;
+			return msg;
+		}
+	} else {
+		hdr->flags &= ~(HFL_FC_CAP | HFL_CH_CAP | HFL_CZ_CAP);
+	}
+
+	wait_us = retries > 0 ? ctx->send_tous : 0;
 	if( retries == 0 ) {
 		spin_retries = 100;
 		retries++;
 	}
 
+	piov = iov;
+	npiov = niov;
+	if( iov == NULL && ctx->cz_types != NULL && cz_accepted( ep ) && (czbuf = cz_compress( ctx, msg, &cziov )) != NULL ) {
+		hdr->plen = htonl( cziov.iov_len );							// compressed payload follows the headers from the message buffer
+		hdr->flags |= HFL_COMP;
+		piov = &cziov;
+		npiov = 1;
+	}
+
+	if( ep != NULL && __atomic_load_n( &ep->ch_on, __ATOMIC_ACQUIRE ) &&
+		(piov != NULL || msg->len + PAYLOAD_OFFSET( hdr ) + TP_HDR_LEN <= msg->alloc_len) ) {
+
+		chlen = ch_encode( ctx, ep, hdr, chbuf, &ident );
+	}
+
+	if( chlen > 0 ) {													// compact header, then trace/d1/d2 (and payload) from the buffer
+		vec[0].iov_base = chbuf;
+		vec[0].iov_len = chlen;
+		vec[1].iov_base = TRACE_ADDR( hdr );
+		vec[1].iov_len = RMR_TR_LEN( hdr ) + RMR_D1_LEN( hdr ) + RMR_D2_LEN( hdr ) + (piov == NULL ? msg->len : 0);
+		nvec = 2;
+	} else {
+		if( piov != NULL ) {
+			vec[0].iov_base = msg->tp_buf;
+			vec[0].iov_len = PAYLOAD_OFFSET( hdr ) + TP_HDR_LEN;				// just the headers from the message buffer
+			nvec = 1;
+		}
+	}
+	if( piov != NULL ) {
+		memcpy( &vec[nvec], piov, sizeof( struct iovec ) * npiov );
+		nvec += npiov;
+	}
+
+	bat_max = ep != NULL ? __atomic_load_n( &ctx->bat_bytes, __ATOMIC_ACQUIRE ) : 0;
+
 	errno = 0;
 	msg->state = RMR_OK;
 	do {
-		tot_len = msg->len + PAYLOAD_OFFSET( hdr ) + TP_HDR_LEN;			// we only send what was used + header lengths
-		if( tot_len > msg->alloc_len ) {
-			tot_len = msg->alloc_len;									// likely bad length from user :(
+		if( nvec > 0 ) {
+			for( tot_len = 0, i = 0; i < nvec; i++ ) {
+				tot_len += vec[i].iov_len;
+			}
+		} else {
+			tot_len = msg->len + PAYLOAD_OFFSET( hdr ) + TP_HDR_LEN;			// we only send what was used + header lengths
+			if( tot_len > msg->alloc_len ) {
+				tot_len = msg->alloc_len;									// likely bad length from user :(
+			}
 		}
-		insert_mlen( tot_len, msg->tp_buf );	// shrink to fit
+		insert_mlen( tot_len, nvec > 0 ? vec[0].iov_base : msg->tp_buf );	// shrink to fit
 
 		if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "send_msg: ending %d (%x) bytes  usr_len=%d alloc=%d retries=%d\n", tot_len, tot_len, msg->len, msg->alloc_len, retries );
 		if( DEBUG > 2 ) dump_40( msg->tp_buf, "sending" );
 
-		if( (state = SIsendt( ctx->si_ctx, nn_sock, msg->tp_buf, tot_len )) != SI_OK ) {
+		if( tot_len <= bat_max ) {
+			whole.iov_base = msg->tp_buf;
+			whole.iov_len = tot_len;
+			state = bat_add( ctx, ep, nn_sock, nvec > 0 ? vec : &whole, nvec > 0 ? nvec : 1, tot_len, hdr->flags & HFL_CALL_MSG );
+		} else {
+			state = SI_OK;
+			if( ep != NULL && ep->batch != NULL && ep->batch->len > 0 ) {		// batched frames must go first
+				state = bat_flush( ctx, ep );
+			}
+			if( state == SI_OK ) {
+				if( nvec > 0 ) {
+					state = SIsendv( ctx->si_ctx, nn_sock, vec, nvec );
+				} else {
+					state = SIsendt( ctx->si_ctx, nn_sock, msg->tp_buf, tot_len );
+				}
+			}
+		}
+		if( state != SI_OK ) {
 			if( DEBUG > 1 ) rmr_vlog( RMR_VL_DEBUG, "send_msg:  error!! sent state=%d\n", state );
 			msg->state = state;
-			if( retries > 0 && state == SI_ERR_BLOCKED ) {
+			if( state == SI_ERR_BLOCKED && wait_us > 0 ) {			// deadline mode; block rather than spin
+				if( deadline == 0 ) {
+					deadline = sr_now_ns( ) + ((uint64_t) wait_us * 1000);
+				}
+				if( ! send_wait( ctx, nn_sock, ep, deadline ) ) {
+					break;								// out of time; still blocked
+				}
+			} else if( retries > 0 && state == SI_ERR_BLOCKED ) {
 				if( --spin_retries <= 0 ) {				// don't give up the processor if we don't have to
 					retries--;
 					if( retries > 0 ) {					// only if we'll loop through again
@@ -638,7 +805,18 @@ static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int r
 		}
 	} while( state && retries > 0 );
 
+	if( czbuf != NULL ) {
+		tpb_free( czbuf );
+		((uta_mhdr_t *) msg->header)->flags &= ~HFL_COMP;			// message may be returned or sent again
+	}
+
 	if( msg->state == RMR_OK ) {									// successful send
+		if( ident ) {
+			__atomic_store_n( &ep->ch_ident, 1, __ATOMIC_RELEASE );	// peer has interned our identity
+		}
+		if( (msg->flags & MFL_FANOUT) || iov != NULL ) {			// more destinations to go, or payload not ours; caller keeps the message
+			return msg;
+		}
 		if( !(msg->flags & MFL_NOALLOC) ) {							// allocate another sendable zc buffer unless told otherwise
 			return alloc_zcmsg( ctx, msg, 0, RMR_OK, tr_len );		// preallocate a zero-copy buffer and return msg
 		} else {
@@ -646,6 +824,7 @@ static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int r
 			return NULL;
 		}
 	} else {											// send failed or would block -- return original message
+		fc_untake( ep );								// credit not used
 		if( state == SI_ERR_BLOCKED || errno == EAGAIN ) {
 			errno = EAGAIN;
 			msg->state = RMR_ERR_RETRY;
@@ -660,6 +839,237 @@ static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int r
 	return msg;
 }
 
+/*
+	Send the message, payload in the message buffer, to the socket. See send_msgv().
+*/
+static inline rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int retries, endpoint_t* ep ) {
+	return send_msgv( ctx, msg, nn_sock, retries, ep, NULL, 0 );
+}
+
+/*
+	Per thread record of the state of each send made by the thread's last fan-out
+	(multiple round robin group) send; see rmr_get_fanout_status().
+*/
+static __thread int fo_count = 0;						// destinations attempted; may exceed RMR_MAX_FANOUT
+static __thread int fo_states[RMR_MAX_FANOUT];
+
+static inline void fo_note( int state ) {
+	if( fo_count < RMR_MAX_FANOUT ) {
+		fo_states[fo_count] = state;
+	}
+	fo_count++;
+}
+
+/*
+	Send the message to every endpoint in a broadcast (%bcast) group. The frame is
+	built once (headers in network order, payload compressed if enabled) and the
+	same bytes are written to each member; members are never sent compact headers.
+	Each pass over the group writes to every member not yet done, so a member
+	whose session is blocked does not hold up the others; blocked members are
+	tried again on the next pass, spinning and waiting as send_msgv() does.
+
+	The state of each member's send is noted for rmr_get_fanout_status() and the
+	number which were successful is put in *nok. The message state is ok if any
+	member's send was. The message is returned, or a new buffer allocated, as
+	send_msgv() does.
+*/
+static rmr_mbuf_t* bcast_msgv( uta_ctx_t* ctx, rmr_mbuf_t* msg, rrgroup_t* rrg, int retries, struct iovec const* iov, int niov, int* nok ) {
+	uta_mhdr_t*	hdr;
+	endpoint_t*	ep;
+	struct iovec	vec[RMR_MAX_IOV+1];			// headers from the message buffer and payload buffers
+	int		nvec = 0;
+	struct iovec	cziov;
+	unsigned char*	czbuf = NULL;
+	int		cz_ok;								// all members accepted compressed payloads
+	int		states[MAX_EP_GROUP];				// state of each member's send
+	int		socks[MAX_EP_GROUP];
+	int		pending[MAX_EP_GROUP];				// members still to be written (blocked)
+	int		npending = 0;
+	int		nleft;
+	int		user_iov;							// payload is in the user's buffers; message is never consumed
+	int		spin_retries = 1000;
+	uint64_t	deadline = 0;
+	int		wait_us;
+	int		bat_max;
+	int		tr_len;
+	int		tot_len;
+	int		state;
+	int		i;
+	int		j;
+
+	*nok = 0;
+	hdr = (uta_mhdr_t *) msg->header;
+	hdr->mtype = htonl( msg->mtype );
+	hdr->sub_id = htonl( msg->sub_id );
+	hdr->plen = htonl( msg->len );
+	tr_len = RMR_TR_LEN( hdr );
+
+	if( msg->flags & MFL_ADDSRC ) {
+		zt_buf_fill( (char *) hdr->src, ctx->my_name, RMR_MAX_SRC );
+		zt_buf_fill( (char *) hdr->srcip, ctx->my_ip, RMR_MAX_SRC );
+	}
+
+	hdr->flags |= HFL_FC_CAP;
+	if( ctx->ch_on ) {
+		hdr->flags |= HFL_CH_CAP;
+	}
+	cz_ok = ctx->cz_types != NULL;
+	if( cz_ok ) {
+		hdr->flags |= HFL_CZ_CAP;
+		for( i = 0; i < rrg->nused; i++ ) {					// compressed only if every member can expand it
+			if( ! cz_accepted( rrg->epts[i] ) ) {
+				cz_ok = FALSE;
+				break;
+			}
+		}
+	}
+
+	user_iov = iov != NULL;
+	if( iov == NULL && cz_ok && (czbuf = cz_compress( ctx, msg, &cziov )) != NULL ) {
+		hdr->plen = htonl( cziov.iov_len );
+		hdr->flags |= HFL_COMP;
+		iov = &cziov;
+		niov = 1;
+	}
+
+	if( iov != NULL ) {
+		vec[0].iov_base = msg->tp_buf;
+		vec[0].iov_len = PAYLOAD_OFFSET( hdr ) + TP_HDR_LEN;
+		memcpy( &vec[1], iov, sizeof( struct iovec ) * niov );
+		nvec = niov + 1;
+		for( tot_len = 0, i = 0; i < nvec; i++ ) {
+			tot_len += vec[i].iov_len;
+		}
+	} else {
+		tot_len = msg->len + PAYLOAD_OFFSET( hdr ) + TP_HDR_LEN;
+		if( tot_len > msg->alloc_len ) {
+			tot_len = msg->alloc_len;
+		}
+		vec[0].iov_base = msg->tp_buf;
+		vec[0].iov_len = tot_len;
+	}
+	insert_mlen( tot_len, msg->tp_buf );
+
+	bat_max = __atomic_load_n( &ctx->bat_bytes, __ATOMIC_ACQUIRE );
+	for( i = 0; i < rrg->nused; i++ ) {
+		ep = rrg->epts[i];
+		if( ! uta_epsock_ep( ctx, ep, &socks[i] ) ) {
+			states[i] = RMR_ERR_NOENDPT;
+		} else {
+			if( fc_take( ep ) ) {
+				states[i] = RMR_ERR_RETRY;				// until written
+				pending[npending++] = i;
+			} else {
+				states[i] = RMR_ERR_RETRY;				// no credit; not attempted
+			}
+		}
+	}
+
+	wait_us = retries > 0 ? ctx->send_tous : 0;
+	if( retries == 0 ) {
+		spin_retries = 100;
+		retries++;
+	}
+
+	while( npending > 0 ) {
+		for( nleft = 0, j = 0; j < npending; j++ ) {		// one pass over everybody not yet written
+			i = pending[j];
+			ep = rrg->epts[i];
+			if( tot_len <= bat_max ) {
+				state = bat_add( ctx, ep, socks[i], vec, nvec > 0 ? nvec : 1, tot_len, hdr->flags & HFL_CALL_MSG );
+			} else {
+				state = SI_OK;
+				if( ep->batch != NULL && ep->batch->len > 0 ) {
+					state = bat_flush( ctx, ep );
+				}
+				if( state == SI_OK ) {
+					if( nvec > 0 ) {
+						state = SIsendv( ctx->si_ctx, socks[i], vec, nvec );
+					} else {
+						state = SIsendt( ctx->si_ctx, socks[i], msg->tp_buf, tot_len );
+					}
+				}
+			}
+
+			switch( state ) {
+				case SI_OK:
+					states[i] = RMR_OK;
+					break;
+
+				case SI_ERR_BLOCKED:
+					pending[nleft++] = i;						// try again on the next pass
+					break;
+
+				default:
+					rmr_vlog( RMR_VL_WARN, "broadcast send to %s failed: mt=%d errno=%d %s\n", ep->name, msg->mtype, errno, strerror( errno ) );
+					states[i] = RMR_ERR_SENDFAILED;
+					fc_untake( ep );
+					break;
+			}
+		}
+		npending = nleft;
+
+		if( npending > 0 ) {
+			if( wait_us > 0 ) {								// deadline mode; wait for one of the blocked sessions
+				if( deadline == 0 ) {
+					deadline = sr_now_ns( ) + ((uint64_t) wait_us * 1000);
+				}
+				if( ! send_wait( ctx, socks[pending[0]], rrg->epts[pending[0]], deadline ) ) {
+					break;
+				}
+			} else {
+				if( --spin_retries <= 0 ) {
+					if( --retries <= 0 ) {
+						break;
+					}
+					usleep( 1 );
+					spin_retries = 1000;
+				}
+			}
+		}
+	}
+
+	for( j = 0; j < npending; j++ ) {						// still blocked; credit not used
+		fc_untake( rrg->epts[pending[j]] );
+	}
+
+	if( czbuf != NULL ) {
+		tpb_free( czbuf );
+		hdr->flags &= ~HFL_COMP;
+	}
+
+	msg->state = RMR_ERR_NOENDPT;
+	for( i = 0; i < rrg->nused; i++ ) {
+		fo_note( states[i] );
+		incr_ep_counts( states[i], rrg->epts[i] );
+		if( states[i] == RMR_OK ) {
+			(*nok)++;
+		}
+		if( msg->state != RMR_OK ) {
+			msg->state = states[i];							// any success is success; otherwise the last failure
+		}
+	}
+	if( *nok > 0 ) {
+		msg->state = RMR_OK;
+	}
+
+	if( msg->state == RMR_OK ) {
+		errno = 0;
+		if( (msg->flags & MFL_FANOUT) || user_iov ) {		// more groups to go, or payload not ours
+			return msg;
+		}
+		if( !(msg->flags & MFL_NOALLOC) ) {
+			return alloc_zcmsg( ctx, msg, 0, RMR_OK, tr_len );
+		}
+		rmr_free_msg( msg );
+		return NULL;
+	}
+
+	errno = msg->state == RMR_ERR_RETRY ? EAGAIN : ENXIO;
+	msg->tp_state = errno;
+	return msg;
+}
+
 /*
 	send message with maximum timeout.
 	Accept a message and send it to an endpoint based on message type.
@@ -669,7 +1079,9 @@ static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int r
 
 	Allocates a new message buffer for the next send. If a message type has
 	more than one group of endpoints defined, then the message will be sent
-	in round robin fashion to one endpoint in each group.
+	in round robin fashion to one endpoint in each group. A broadcast (%bcast)
+	group sends the message to every endpoint in the group (see bcast_msgv());
+	the state of each member's send is kept for rmr_get_fanout_status().
 
 	An endpoint will be looked up in the route table using the message type and
 	the subscription id. If the subscription id is "UNSET_SUBID", then only the
@@ -680,23 +1092,37 @@ static rmr_mbuf_t* send_msg( uta_ctx_t* ctx, rmr_mbuf_t* msg, int nn_sock, int r
 	some API fucntions return the message directly and do not propigate errno into
 	the message.
 
+	When there are several groups the same transport buffer is sent to the endpoint
+	selected from each; it is not copied. The SI send completes (the bytes are
+	handed to the kernel) before SIsendt() returns, so the buffer is never
+	referenced by more than one pending send and is released, or reused for the
+	next message, once the last group's send returns. The state of each send is
+	kept (per thread) for rmr_get_fanout_status().
+
+	If iov is not nil the payload is in the niov user buffers rather than in the
+	message buffer (see send_msgv()); the message is returned on success as well
+	as failure. The same is true if the caller sets MFL_FANOUT (it keeps the
+	message, e.g. to send it again).
+
 	CAUTION: this is a non-blocking send.  If the message cannot be sent, then
 		it will return with an error and errno set to eagain. If the send is
 		a limited fanout, then the returned status is the status of the last
 		send attempt.
 
 */
-static  rmr_mbuf_t* mtosend_msg( void* vctx, rmr_mbuf_t* msg, int max_to ) {
+static  rmr_mbuf_t* mtosend_msgv( void* vctx, rmr_mbuf_t* msg, int max_to, struct iovec const* iov, int niov ) {
 	endpoint_t*	ep;					// end point that we're attempting to send to
 	rtable_ent_t*	rte;			// the route table entry which matches the message key
 	int	nn_sock;					// endpoint socket (fd in si case) for send
 	uta_ctx_t*	ctx;
 	int			group;				// selected group to get socket for
 	int			send_again;			// true if the message must be sent again
-	rmr_mbuf_t*	clone_m;			// cloned message for an nth send
 	int		 	sock_ok;			// got a valid socket from round robin select
 	char*		d1;
 	int			ok_sends = 0;		// track number of ok sends
+	int			nok;				// successful sends to a broadcast group
+	int			keep;				// MFL_FANOUT if the caller set it
+	rrgroup_t*	rrg;
 	route_table_t*	rt;				// active route table
 
 	if( (ctx = (uta_ctx_t *) vctx) == NULL || msg == NULL ) {		// bad stuff, bail fast
@@ -732,11 +1158,29 @@ static  rmr_mbuf_t* mtosend_msg( void* vctx, rmr_mbuf_t* msg, int max_to ) {
 		return msg;											// caller can resend (maybe) or free
 	}
 
+	keep = msg->flags & MFL_FANOUT;
+	fo_count = 0;
 	send_again = 1;											// force loop entry
 	group = 0;												// always start with group 0
 	while( send_again ) {
+		if( rte->nrrgroups > 0 && (rrg = rte->rrgroups[group]) != NULL && rrg->policy == RRG_BCAST ) {		// every member gets it; no selection
+			send_again = group < rte->nrrgroups-1 && rte->rrgroups[group+1] != NULL;
+			if( send_again ) {
+				msg->flags |= MFL_FANOUT;
+			}
+			msg = bcast_msgv( ctx, msg, rrg, max_to, iov, niov, &nok );
+			if( msg != NULL ) {
+				msg->flags = (msg->flags & ~MFL_FANOUT) | keep;
+			}
+			if( send_again ) {
+				ok_sends += nok;
+			}
+			group++;
+			continue;
+		}
+
 		if( rte->nrrgroups > 0 ) {							// this is a round robin entry if groups are listed
-			sock_ok = uta_epsock_rr( ctx, rte, group, &send_again, &nn_sock, &ep );		// select endpt from rr group and set again if more groups
+			sock_ok = uta_epsock_rr_msg( ctx, rte, group, &send_again, &nn_sock, &ep, msg );		// select endpt from rr group and set again if more groups
 		} else {
 			sock_ok = epsock_meid( ctx, rt, msg, &nn_sock, &ep );
 			send_again = 0;
@@ -749,44 +1193,32 @@ static  rmr_mbuf_t* mtosend_msg( void* vctx, rmr_mbuf_t* msg, int max_to ) {
 
 		if( sock_ok ) {													// with an rte we _should_ always have a socket, but don't bet on it
 			if( send_again ) {
-				clone_m = clone_msg( msg );								// must make a copy as once we send this message is not available
-				if( clone_m == NULL ) {
-					release_rt( ctx, rt );
-					msg->state = RMR_ERR_SENDFAILED;
-					errno = ENOMEM;
-					msg->tp_state = errno;
-					rmr_vlog( RMR_VL_WARN, "unable to clone message for multiple rr-group send\n" );
-					return msg;
-				}
-
-				if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "msg cloned: type=%d len=%d\n", msg->mtype, msg->len );
-				msg->flags |= MFL_NOALLOC;								// keep send from allocating a new message; we have a clone to use
-				msg = send_msg( ctx, msg, nn_sock, max_to );			// do the hard work, msg should be nil on success
-
-				if( msg != NULL ) {										// returned message indicates send error of some sort
-					rmr_free_msg( msg );								// must ditchone; pick msg so we don't have to unfiddle flags
-					msg = clone_m;
-				} else {
+				msg->flags |= MFL_FANOUT;								// same buffer goes to the next group, so send must hand it back
+				msg = send_msgv( ctx, msg, nn_sock, max_to, ep, iov, niov );		// always returns msg
+				msg->flags = (msg->flags & ~MFL_FANOUT) | keep;
+				if( msg->state == RMR_OK ) {
 					ok_sends++;
-					msg = clone_m;										// clone will be the next to send
-					msg->state = RMR_OK;
 				}
+				fo_note( msg->state );
+				incr_ep_counts( msg->state, ep );
 			} else {
-				msg = send_msg( ctx, msg, nn_sock, max_to );			// send the last, and allocate a new buffer; drops the clone if it was
+				msg = send_msgv( ctx, msg, nn_sock, max_to, ep, iov, niov );	// send the last, and allocate a new buffer
+				fo_note( msg != NULL ? msg->state : RMR_OK );
 				if( DEBUG ) {
 					if( msg == NULL ) {
 						rmr_vlog( RMR_VL_DEBUG, "mtosend_msg:  send returned nil message!\n" );
 					}
 				}
-			}
 
-			if( msg != NULL ) {
-				incr_ep_counts( msg->state, ep );
+				if( msg != NULL ) {
+					incr_ep_counts( msg->state, ep );
+				}
 			}
 		} else {
 			if( DEBUG ) rmr_vlog( RMR_VL_DEBUG, "invalid socket for rte, setting no endpoint err: mtype=%d sub_id=%d\n", msg->mtype, msg->sub_id );
 			msg->state = RMR_ERR_NOENDPT;
 			errno = ENXIO;
+			fo_note( msg->state );
 		}
 	}
 
@@ -806,13 +1238,20 @@ static  rmr_mbuf_t* mtosend_msg( void* vctx, rmr_mbuf_t* msg, int max_to ) {
 	return msg;									// last message caries the status of last/only send attempt
 }
 
+/*
+	Route and send a message whose payload is in the message buffer. See mtosend_msgv().
+*/
+static inline rmr_mbuf_t* mtosend_msg( void* vctx, rmr_mbuf_t* msg, int max_to ) {
+	return mtosend_msgv( vctx, msg, max_to, NULL, 0 );
+}
+
 
 /*
 	A generic wrapper to the real send to keep wormhole stuff agnostic.
 	We assume the wormhole function vetted the buffer so we don't have to.
 */
 static rmr_mbuf_t* send2ep( uta_ctx_t* ctx, endpoint_t* ep, rmr_mbuf_t* msg ) {
-	return send_msg( ctx, msg, ep->nn_sock, -1 );
+	return send_msg( ctx, msg, ep->nn_sock, -1, ep );
 }
 
 #endif
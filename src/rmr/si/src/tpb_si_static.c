@@ -0,0 +1,565 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	tpb_si_static.c
+	Abstract:	Transport buffer pools. River accumulators become the transport
+				buffers of received messages, and those are released by the
+				application with rmr_free_msg() on some other thread. Rather than
+				returning each buffer to libc, buffers are kept on size classed
+				pools which are shared by all threads, so the receive thread can
+				reuse a buffer that an application thread released.
+
+				Each pool is a bounded multi-producer/multi-consumer queue (cells
+				carry a sequence number so that no lock is needed). A small
+				header in front of each buffer records its class; buffers which
+				are larger than the largest class are allocated and freed directly.
+				When a pool is empty a buffer is allocated, and when full the
+				buffer being released is freed, so pools never grow past their
+				capacity.
+
+				Buffers from the pool are marked in the mbuf with MFL_TPPOOL;
+				a transport buffer without the flag is released with free().
+
+				When enabled (RMR_TP_ARENA=1) pooled classes are not allocated
+				with malloc; buffers are carved from 2M slabs which are mapped
+				with explicit huge pages if the system has them reserved, else
+				with transparent huge pages requested via madvise(). Buffers
+				from the arena are never returned to libc; when the class pool
+				is full they are kept on a per class free list. If a slab cannot
+				be mapped malloc is used as before.
+
+				When enabled (RMR_RCV_SHARE=1) the SI read buffer is a shared
+				receive block. Small messages which arrive whole in a read are
+				not copied; the mbuf references the message where it sits in
+				the block and is marked with MFL_TPSHARED. Blocks are aligned on
+				their size so that the block can be found from any pointer into
+				it, and carry a reference count. A block goes back to its pool
+				when the last message referencing it is freed.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _tpb_si_static_c
+#define _tpb_si_static_c
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define TPB_NCLASSES	7				// 1k through 64k
+#define TPB_MIN_SHIFT	10				// smallest class is 1 << this
+#define TPB_POOL_BYTES	(4 * 1024 * 1024)	// approx bytes each class may hold while idle
+#define TPB_MAX_CELLS	1024
+#define TPB_MIN_CELLS	32
+#define TPB_DIRECT		(-1)			// class of buffers which are not pooled
+#define TPB_SLAB_SIZE	(2 * 1024 * 1024)	// arena slab size (one huge page)
+
+#define RBLK_SIZE		(16 * 1024)		// shared receive block size (power of 2; blocks are aligned on this boundary)
+#define RBLK_HDR_LEN	64				// bytes at the front of the block reserved for the reference count
+#define RBLK_DATA_LEN	(RBLK_SIZE - RBLK_HDR_LEN)	// bytes given to SI for each read
+#define RBLK_MAX_FRAME	512				// messages smaller than this are referenced in the block rather than copied
+#define RBLK_CELLS		256				// blocks held idle in the pool
+
+/*
+	Header placed in front of each buffer. The size keeps the user area 16 byte
+	aligned.
+*/
+typedef struct {
+	int32_t		cls;			// size class or TPB_DIRECT
+	uint32_t	size;			// usable bytes following the header
+	uint32_t	arena;			// true if carved from an arena slab (never given to free())
+	uint32_t	pad;
+} tpb_hdr_t;
+
+typedef struct {
+	uint64_t	seq;
+	void*		data;
+} tpb_cell_t;
+
+typedef struct {
+	uint64_t	enq;			// producers and consumers are kept on different lines
+	char		pad1[56];
+	uint64_t	deq;
+	char		pad2[56];
+	uint64_t	mask;
+	uint32_t	size;			// usable size of buffers in this class
+	tpb_cell_t*	cells;
+} tpb_pool_t;
+
+/*
+	Huge page arena. A single mutex is fine as the arena is only visited when
+	a class pool is empty or full.
+*/
+typedef struct {
+	pthread_mutex_t	gate;
+	char*		cur;				// next byte to carve in the current slab
+	size_t		left;				// bytes left in the current slab
+	void*		spill[TPB_NCLASSES];	// arena buffers which did not fit into the class pool (linked via the user area)
+	uint64_t	nspill[TPB_NCLASSES];
+	uint64_t	slabs;
+	uint64_t	huge_slabs;
+	uint64_t	carved;				// bytes carved from slabs (headers included)
+} tpb_arena_t;
+
+/*
+	Header at the front of each shared receive block.
+*/
+typedef struct {
+	int32_t		refs;			// messages referencing the block, plus one while SI may read into it
+} rblk_t;
+
+static tpb_pool_t tpb_pools[TPB_NCLASSES];
+static pthread_once_t tpb_once = PTHREAD_ONCE_INIT;
+static tpb_pool_t rblk_pool;
+static pthread_once_t rblk_once = PTHREAD_ONCE_INIT;
+static tpb_arena_t tpb_arena = { .gate = PTHREAD_MUTEX_INITIALIZER };
+static int tpb_arena_on = FALSE;		// set from the environment when the pools are initialised
+static uint64_t tpb_direct = 0;		// buffers which came from malloc
+
+/*
+	Set up a pool with ncells (must be a power of 2) cells. If the cell array
+	cannot be allocated the pool is left with no cells; pushes then fail and
+	pops return nil, so everything is allocated and freed directly.
+*/
+static void tpb_mk_pool( tpb_pool_t* p, uint32_t size, uint64_t ncells ) {
+	uint64_t	i;
+
+	memset( p, 0, sizeof( *p ) );
+	p->size = size;
+
+	if( (p->cells = (tpb_cell_t *) malloc( sizeof( tpb_cell_t ) * ncells )) != NULL ) {
+		for( i = 0; i < ncells; i++ ) {
+			p->cells[i].seq = i;
+			p->cells[i].data = NULL;
+		}
+		p->mask = ncells - 1;
+	}
+}
+
+/*
+	One time setup of the pools.
+*/
+static void tpb_init( void ) {
+	uint64_t	ncells;
+	uint32_t	size;
+	int			c;
+	char*		tok;
+
+	if( (tok = getenv( ENV_TP_ARENA )) != NULL && *tok == '1' ) {
+		tpb_arena_on = TRUE;
+	}
+
+	for( c = 0; c < TPB_NCLASSES; c++ ) {
+		size = 1U << (c + TPB_MIN_SHIFT);
+
+		ncells = TPB_POOL_BYTES / size;
+		if( ncells > TPB_MAX_CELLS ) {
+			ncells = TPB_MAX_CELLS;
+		}
+		if( ncells < TPB_MIN_CELLS ) {
+			ncells = TPB_MIN_CELLS;					// both limits are powers of two, so ncells is too
+		}
+
+		tpb_mk_pool( &tpb_pools[c], size, ncells );
+	}
+}
+
+static void rblk_init( void ) {
+	tpb_mk_pool( &rblk_pool, RBLK_SIZE, RBLK_CELLS );
+}
+
+/*
+	Return the class for a buffer needing size bytes, or TPB_DIRECT.
+*/
+static inline int tpb_class( size_t size ) {
+	int		c;
+
+	for( c = 0; c < TPB_NCLASSES; c++ ) {
+		if( size <= (1U << (c + TPB_MIN_SHIFT)) ) {
+			return c;
+		}
+	}
+
+	return TPB_DIRECT;
+}
+
+/*
+	Add a buffer to the pool; returns false if the pool is full.
+*/
+static inline int tpb_push( tpb_pool_t* p, void* data ) {
+	tpb_cell_t*	cell;
+	uint64_t	pos;
+	uint64_t	seq;
+	int64_t		dif;
+
+	if( p->cells == NULL ) {
+		return FALSE;
+	}
+
+	pos = __atomic_load_n( &p->enq, __ATOMIC_RELAXED );
+	while( 1 ) {
+		cell = &p->cells[pos & p->mask];
+		seq = __atomic_load_n( &cell->seq, __ATOMIC_ACQUIRE );
+		dif = (int64_t) seq - (int64_t) pos;
+		if( dif == 0 ) {
+			if( __atomic_compare_exchange_n( &p->enq, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+				break;
+			}
+		} else {
+			if( dif < 0 ) {
+				return FALSE;								// full
+			}
+			pos = __atomic_load_n( &p->enq, __ATOMIC_RELAXED );
+		}
+	}
+
+	cell->data = data;
+	__atomic_store_n( &cell->seq, pos + 1, __ATOMIC_RELEASE );
+	return TRUE;
+}
+
+/*
+	Take a buffer from the pool; nil if empty.
+*/
+static inline void* tpb_pop( tpb_pool_t* p ) {
+	tpb_cell_t*	cell;
+	uint64_t	pos;
+	uint64_t	seq;
+	int64_t		dif;
+	void*		data;
+
+	if( p->cells == NULL ) {
+		return NULL;
+	}
+
+	pos = __atomic_load_n( &p->deq, __ATOMIC_RELAXED );
+	while( 1 ) {
+		cell = &p->cells[pos & p->mask];
+		seq = __atomic_load_n( &cell->seq, __ATOMIC_ACQUIRE );
+		dif = (int64_t) seq - (int64_t) (pos + 1);
+		if( dif == 0 ) {
+			if( __atomic_compare_exchange_n( &p->deq, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+				break;
+			}
+		} else {
+			if( dif < 0 ) {
+				return NULL;								// empty
+			}
+			pos = __atomic_load_n( &p->deq, __ATOMIC_RELAXED );
+		}
+	}
+
+	data = cell->data;
+	__atomic_store_n( &cell->seq, pos + p->mask + 1, __ATOMIC_RELEASE );
+	return data;
+}
+
+// ---- huge page arena ---------------------------------------------------
+
+/*
+	Map a slab for the arena. Explicit huge pages are tried first; they exist
+	only if the administrator has reserved them. Otherwise twice the slab size
+	is mapped and trimmed so that the slab is aligned on a huge page boundary,
+	which transparent huge pages require. Returns nil if nothing can be mapped.
+*/
+static char* tpb_mk_slab( tpb_arena_t* a ) {
+	char*		slab;
+	char*		aligned;
+	size_t		lead;
+
+#ifdef MAP_HUGETLB
+	slab = (char *) mmap( NULL, TPB_SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+	if( slab != MAP_FAILED ) {
+		a->huge_slabs++;
+		a->slabs++;
+		return slab;
+	}
+#endif
+
+	slab = (char *) mmap( NULL, TPB_SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if( slab == MAP_FAILED ) {
+		return NULL;
+	}
+
+	aligned = (char *) (((uintptr_t) slab + TPB_SLAB_SIZE - 1) & ~((uintptr_t) TPB_SLAB_SIZE - 1));
+	lead = aligned - slab;
+	if( lead > 0 ) {
+		munmap( slab, lead );
+	}
+	munmap( aligned + TPB_SLAB_SIZE, TPB_SLAB_SIZE - lead );
+
+#ifdef MADV_HUGEPAGE
+	madvise( aligned, TPB_SLAB_SIZE, MADV_HUGEPAGE );		// advisory; failure just means small pages
+#endif
+
+	a->slabs++;
+	return aligned;
+}
+
+/*
+	Get a buffer for the class from the arena: one on the class free list if
+	there is one, else a new one carved from the current slab. The unused tail
+	of a slab too short for the request is abandoned. Nil if no slab can be
+	had; the caller then uses malloc.
+*/
+static tpb_hdr_t* tpb_arena_alloc( int c ) {
+	tpb_arena_t*	a;
+	tpb_hdr_t*		hdr;
+	size_t			need;
+
+	a = &tpb_arena;
+	need = sizeof( tpb_hdr_t ) + tpb_pools[c].size;
+
+	pthread_mutex_lock( &a->gate );
+	if( (hdr = (tpb_hdr_t *) a->spill[c]) != NULL ) {
+		a->spill[c] = *((void **) (hdr + 1));
+		a->nspill[c]--;
+		pthread_mutex_unlock( &a->gate );
+		return hdr;
+	}
+
+	if( a->left < need ) {
+		if( (a->cur = tpb_mk_slab( a )) == NULL ) {
+			a->left = 0;
+			pthread_mutex_unlock( &a->gate );
+			return NULL;
+		}
+		a->left = TPB_SLAB_SIZE;
+	}
+
+	hdr = (tpb_hdr_t *) a->cur;
+	a->cur += need;							// need is a multiple of 16, so alignment holds
+	a->left -= need;
+	a->carved += need;
+	pthread_mutex_unlock( &a->gate );
+
+	hdr->cls = c;
+	hdr->size = tpb_pools[c].size;
+	hdr->arena = TRUE;
+	return hdr;
+}
+
+/*
+	Keep an arena buffer which did not fit into its class pool.
+*/
+static void tpb_arena_spill( tpb_hdr_t* hdr ) {
+	tpb_arena_t*	a;
+
+	a = &tpb_arena;
+	pthread_mutex_lock( &a->gate );
+	*((void **) (hdr + 1)) = a->spill[hdr->cls];
+	a->spill[hdr->cls] = hdr;
+	a->nspill[hdr->cls]++;
+	pthread_mutex_unlock( &a->gate );
+}
+
+/*
+	Fill in the stats for the transport buffer pools and the arena. Idle bytes
+	are those in buffers held by the pools and free lists, i.e. not in use by
+	any message.
+*/
+static void tpb_stats( rmr_tpbuf_stats_t* stats ) {
+	tpb_arena_t*	a;
+	uint64_t		n;
+	long			pages;
+	FILE*			f;
+	int				c;
+
+	pthread_once( &tpb_once, tpb_init );
+
+	memset( stats, 0, sizeof( *stats ) );
+	a = &tpb_arena;
+	pthread_mutex_lock( &a->gate );
+	stats->slabs = a->slabs;
+	stats->huge_slabs = a->huge_slabs;
+	stats->arena_bytes = a->slabs * TPB_SLAB_SIZE;
+	stats->carved_bytes = a->carved;
+	for( c = 0; c < TPB_NCLASSES; c++ ) {
+		n = __atomic_load_n( &tpb_pools[c].enq, __ATOMIC_RELAXED ) - __atomic_load_n( &tpb_pools[c].deq, __ATOMIC_RELAXED );
+		stats->idle_bytes += (n + a->nspill[c]) * (sizeof( tpb_hdr_t ) + tpb_pools[c].size);
+	}
+	pthread_mutex_unlock( &a->gate );
+
+	stats->direct = __atomic_load_n( &tpb_direct, __ATOMIC_RELAXED );
+
+	if( (f = fopen( "/proc/self/statm", "r" )) != NULL ) {		// second field is resident pages
+		if( fscanf( f, "%*d %ld", &pages ) == 1 ) {
+			stats->rss_bytes = (uint64_t) pages * sysconf( _SC_PAGESIZE );
+		}
+		fclose( f );
+	}
+}
+
+// ---- buffer allocation -------------------------------------------------
+
+/*
+	Allocate a buffer with at least size usable bytes. Returns nil only if
+	memory cannot be had.
+*/
+static void* tpb_alloc( size_t size ) {
+	tpb_hdr_t*	hdr;
+	int			c;
+
+	pthread_once( &tpb_once, tpb_init );
+
+	if( (c = tpb_class( size )) != TPB_DIRECT ) {
+		if( (hdr = (tpb_hdr_t *) tpb_pop( &tpb_pools[c] )) != NULL ) {
+			return (void *) (hdr + 1);
+		}
+
+		if( tpb_arena_on && (hdr = tpb_arena_alloc( c )) != NULL ) {
+			return (void *) (hdr + 1);
+		}
+		size = tpb_pools[c].size;							// allocate the whole class so that it can be pooled later
+	}
+
+	if( (hdr = (tpb_hdr_t *) malloc( sizeof( *hdr ) + size )) == NULL ) {
+		return NULL;
+	}
+	__atomic_add_fetch( &tpb_direct, 1, __ATOMIC_RELAXED );
+
+	hdr->cls = c;
+	hdr->size = (uint32_t) size;
+	hdr->arena = FALSE;
+	return (void *) (hdr + 1);
+}
+
+/*
+	Return the usable size of a buffer allocated by tpb_alloc().
+*/
+static inline size_t tpb_size( void* buf ) {
+	return buf == NULL ? 0 : ((tpb_hdr_t *) buf - 1)->size;
+}
+
+/*
+	Release a buffer allocated by tpb_alloc(). It goes back to its pool if
+	there is room, else to libc (or the arena free list).
+*/
+static void tpb_free( void* buf ) {
+	tpb_hdr_t*	hdr;
+
+	if( buf == NULL ) {
+		return;
+	}
+
+	hdr = (tpb_hdr_t *) buf - 1;
+	if( hdr->cls == TPB_DIRECT || ! tpb_push( &tpb_pools[hdr->cls], hdr ) ) {
+		if( hdr->arena ) {
+			tpb_arena_spill( hdr );
+		} else {
+			free( hdr );
+		}
+	}
+}
+
+// ---- shared receive blocks ---------------------------------------------
+
+/*
+	Return the block which contains the pointer.
+*/
+static inline rblk_t* rblk_of( void* ptr ) {
+	return (rblk_t *) ((uintptr_t) ptr & ~((uintptr_t) RBLK_SIZE - 1));
+}
+
+/*
+	Get a receive block with a single reference (the caller's). The pointer
+	returned is to the data area (RBLK_DATA_LEN bytes). Nil if no memory.
+*/
+static char* rblk_alloc( void ) {
+	rblk_t*	blk;
+
+	pthread_once( &rblk_once, rblk_init );
+
+	if( (blk = (rblk_t *) tpb_pop( &rblk_pool )) == NULL ) {
+		if( posix_memalign( (void **) &blk, RBLK_SIZE, RBLK_SIZE ) != 0 ) {
+			return NULL;
+		}
+	}
+
+	blk->refs = 1;
+	return ((char *) blk) + RBLK_HDR_LEN;
+}
+
+/*
+	Add a reference to the block containing ptr.
+*/
+static inline void rblk_ref( void* ptr ) {
+	__atomic_add_fetch( &rblk_of( ptr )->refs, 1, __ATOMIC_RELAXED );
+}
+
+/*
+	Drop a reference to the block containing ptr; the block is pooled (or
+	freed) when the last reference goes.
+*/
+static void rblk_unref( void* ptr ) {
+	rblk_t*	blk;
+
+	blk = rblk_of( ptr );
+	if( __atomic_sub_fetch( &blk->refs, 1, __ATOMIC_ACQ_REL ) == 0 ) {
+		if( ! tpb_push( &rblk_pool, blk ) ) {
+			free( blk );
+		}
+	}
+}
+
+/*
+	Release a transport buffer according to the MFL_TP* flags which describe
+	where it came from.
+*/
+static inline void tpb_put( void* buf, int flags ) {
+	if( buf == NULL ) {
+		return;
+	}
+
+	if( flags & MFL_TPSHARED ) {
+		rblk_unref( buf );
+	} else {
+		if( flags & MFL_TPPOOL ) {
+			tpb_free( buf );
+		} else {
+			free( buf );
+		}
+	}
+}
+
+/*
+	Release the transport buffer attached to the message using the allocator
+	which created it.
+*/
+static inline void tpb_release( rmr_mbuf_t* msg ) {
+	tpb_put( msg->tp_buf, msg->flags );
+	msg->tp_buf = NULL;
+	msg->flags &= ~MFL_TPMASK;
+}
+
+/*
+	Allocate a pooled transport buffer and attach it to the message. The
+	previous buffer (if any) is NOT released. Returns nil on failure.
+*/
+static inline void* tpb_attach( rmr_mbuf_t* msg, size_t size ) {
+	msg->flags &= ~MFL_TPMASK;
+	if( (msg->tp_buf = tpb_alloc( size )) != NULL ) {
+		msg->flags |= MFL_TPPOOL;
+	}
+
+	return msg->tp_buf;
+}
+
+#endif
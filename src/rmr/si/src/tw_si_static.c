@@ -0,0 +1,344 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	tw_si_static.c
+	Abstract:	Timing wheel. Timers for call deadlines (rmr_mt_call() and
+				rmr_call_async()) and other features (circuit breaker probes)
+				are kept in a hierarchical wheel run by one thread, so that no
+				feature needs a thread, or a timerfd, per timer. Time is taken
+				from the monotonic clock; a step of the wall clock does not
+				stretch or shrink a timeout.
+
+				The wheel has TW_LEVELS levels of TW_SLOTS slots. A tick is
+				TW_TICK_NS; level 0 holds the timers due in the next 64 ticks,
+				each level above holds timers 64 times further out. When level 0
+				wraps the next slot of level 1 is cascaded (its timers are put
+				back into the wheel, now closer), and so on up. Arming and
+				cancelling are constant time.
+
+				The thread sleeps until the first level 0 slot with a timer,
+				or the next cascade; arming a timer due sooner wakes it. A timer
+				function is called on the wheel's thread without the wheel's
+				lock held; it may arm timers (its own included) but must not
+				cancel its own timer, and it should not block.
+
+				Timers are embedded in what they time (a request block, an
+				endpoint, a caller's stack frame); the wheel allocates nothing
+				after it is created.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _tw_si_static_c
+#define _tw_si_static_c
+
+/*
+	Return the context's wheel, creating it and starting its thread if needed.
+	Nil is returned (errno set) on failure.
+*/
+static timing_wheel_t* tw_ensure( uta_ctx_t* ctx ) {
+	timing_wheel_t*		tw;
+	timing_wheel_t*		expect = NULL;
+	pthread_condattr_t	attr;
+
+	if( (tw = __atomic_load_n( &ctx->tw, __ATOMIC_ACQUIRE )) != NULL ) {
+		return tw;
+	}
+
+	if( (tw = (timing_wheel_t *) malloc( sizeof( *tw ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( tw, 0, sizeof( *tw ) );
+	tw->ctx = ctx;
+	tw->base = sr_now_ns( );
+	tw->wake_tick = UINT64_MAX;
+	pthread_mutex_init( &tw->gate, NULL );
+	pthread_condattr_init( &attr );
+	pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+	pthread_cond_init( &tw->wake, &attr );
+	pthread_condattr_destroy( &attr );
+
+	if( ! __atomic_compare_exchange_n( &ctx->tw, &expect, tw, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		pthread_cond_destroy( &tw->wake );
+		pthread_mutex_destroy( &tw->gate );
+		free( tw );												// another thread beat us to it
+		return expect;
+	}
+
+	if( pthread_create( &tw->th, NULL, tw_runner, (void *) tw ) ) {
+		rmr_vlog( RMR_VL_CRIT, "rmr: unable to start timer thread; call timeouts will not be honoured: %s\n", strerror( errno ) );
+	}
+
+	return tw;
+}
+
+/*
+	Return the tick in which the monotonic time (ns) falls. A tick is processed
+	only once it has wholly passed, so a timer never expires early.
+*/
+static inline uint64_t tw_tick( timing_wheel_t* tw, uint64_t ns ) {
+	if( ns <= tw->base ) {
+		return 0;
+	}
+
+	return (ns - tw->base) / TW_TICK_NS;
+}
+
+/*
+	Put the timer into the slot for its tick relative to the current tick (the
+	tick must not be before the current one). Gate must be held.
+*/
+static void tw_link( timing_wheel_t* tw, tw_timer_t* t ) {
+	uint64_t	delta;
+	uint64_t	max;
+	int			level;
+	int			idx;
+
+	max = (uint64_t) 1 << (TW_BITS * TW_LEVELS);
+	if( (delta = t->tick - tw->cur) >= max ) {
+		t->tick = tw->cur + max - 1;						// clamped; fires early, and the owner re-arms if it cares
+		delta = max - 1;
+	}
+
+	for( level = 0; level < TW_LEVELS - 1 && delta >= ((uint64_t) 1 << (TW_BITS * (level + 1))); level++ );
+	idx = (int) ((t->tick >> (TW_BITS * level)) & (TW_SLOTS - 1));
+
+	t->prev = NULL;
+	if( (t->next = tw->slots[level][idx]) != NULL ) {
+		t->next->prev = t;
+	}
+	tw->slots[level][idx] = t;
+	t->armed = TRUE;
+}
+
+/*
+	Take the timer out of the wheel. Gate must be held and the timer armed.
+*/
+static void tw_unlink( timing_wheel_t* tw, tw_timer_t* t ) {
+	int		level;
+	int		idx;
+
+	if( t->prev != NULL ) {
+		t->prev->next = t->next;
+	} else {
+		for( level = 0; level < TW_LEVELS; level++ ) {				// head of its slot; find which
+			idx = (int) ((t->tick >> (TW_BITS * level)) & (TW_SLOTS - 1));
+			if( tw->slots[level][idx] == t ) {
+				tw->slots[level][idx] = t->next;
+				break;
+			}
+		}
+	}
+	if( t->next != NULL ) {
+		t->next->prev = t->prev;
+	}
+
+	t->next = t->prev = NULL;
+	t->armed = FALSE;
+}
+
+/*
+	Put the timers of a slot above level 0 back into the wheel; they land in a
+	lower level now that they are closer. Gate must be held.
+*/
+static void tw_cascade( timing_wheel_t* tw, int level, int idx ) {
+	tw_timer_t*	t;
+	tw_timer_t*	next;
+
+	t = tw->slots[level][idx];
+	tw->slots[level][idx] = NULL;
+	for( ; t != NULL; t = next ) {
+		next = t->next;
+		tw_link( tw, t );
+	}
+}
+
+/*
+	Advance the wheel to the tick, calling the function of each timer which
+	expires. Gate must be held; it is released while a function is called.
+*/
+static void tw_advance( timing_wheel_t* tw, uint64_t now_tick ) {
+	tw_timer_t*	t;
+	int			level;
+	int			idx;
+
+	while( tw->cur < now_tick ) {
+		if( tw->count <= 0 ) {
+			tw->cur = now_tick;										// nothing to expire; skip the empty ticks
+			return;
+		}
+
+		tw->cur++;
+		for( level = 1; level < TW_LEVELS; level++ ) {				// wrapped below this level: cascade its next slot
+			if( (tw->cur & (((uint64_t) 1 << (TW_BITS * level)) - 1)) != 0 ) {
+				break;
+			}
+			tw_cascade( tw, level, (int) ((tw->cur >> (TW_BITS * level)) & (TW_SLOTS - 1)) );
+		}
+
+		idx = (int) (tw->cur & (TW_SLOTS - 1));
+		while( (t = tw->slots[0][idx]) != NULL ) {
+			tw_unlink( tw, t );
+			tw->count--;
+			tw->running = t;
+			pthread_mutex_unlock( &tw->gate );
+
+			t->fn( tw->ctx, t->data );
+
+			pthread_mutex_lock( &tw->gate );
+			tw->running = NULL;
+		}
+	}
+}
+
+/*
+	Return the tick the thread should next wake: the first level 0 slot with a
+	timer, else the next cascade. Gate must be held.
+*/
+static uint64_t tw_next( timing_wheel_t* tw ) {
+	uint64_t	tick;
+
+	if( tw->count <= 0 ) {
+		return UINT64_MAX;
+	}
+
+	for( tick = tw->cur + 1; tick <= tw->cur + TW_SLOTS; tick++ ) {
+		if( tw->slots[0][tick & (TW_SLOTS - 1)] != NULL ) {
+			return tick;
+		}
+		if( (tick & (TW_SLOTS - 1)) == 0 ) {
+			return tick;											// cascade may bring timers down for this tick
+		}
+	}
+
+	return tick;
+}
+
+/*
+	The wheel's thread.
+*/
+static void* tw_runner( void* data ) {
+	timing_wheel_t*	tw;
+	struct timespec	ts;
+	uint64_t		tick;
+	uint64_t		ns;
+
+	if( (tw = (timing_wheel_t *) data) == NULL ) {
+		return NULL;
+	}
+
+	pthread_mutex_lock( &tw->gate );
+	while( ! tw->ctx->shutdown ) {
+		if( (tick = tw_tick( tw, sr_now_ns( ) )) > 0 ) {
+			tw_advance( tw, tick - 1 );							// ticks before the one we are in have passed
+		}
+
+		tw->wake_tick = tw_next( tw );
+		if( tw->wake_tick == UINT64_MAX ) {
+			ns = sr_now_ns( ) + 1000000000ULL;						// idle; wake now and then to notice shutdown
+		} else {
+			ns = tw->base + (tw->wake_tick + 1) * TW_TICK_NS;		// when the tick has passed
+		}
+		ts.tv_sec = ns / 1000000000ULL;
+		ts.tv_nsec = ns % 1000000000ULL;
+		pthread_cond_timedwait( &tw->wake, &tw->gate, &ts );
+	}
+	pthread_mutex_unlock( &tw->gate );
+
+	return NULL;
+}
+
+/*
+	Arm (or re-arm) the timer to call fn( ctx, data ) at the monotonic time when
+	(ns, see sr_now_ns()). Returns false (errno set) if there is no wheel.
+*/
+static int tw_arm( uta_ctx_t* ctx, tw_timer_t* t, uint64_t when, void (*fn)( uta_ctx_t* ctx, void* data ), void* data ) {
+	timing_wheel_t*	tw;
+	uint64_t		tick;
+
+	if( (tw = tw_ensure( ctx )) == NULL ) {
+		return FALSE;
+	}
+
+	pthread_mutex_lock( &tw->gate );
+	if( t->armed ) {
+		tw_unlink( tw, t );
+		tw->count--;
+	}
+
+	if( tw->count == 0 && (tick = tw_tick( tw, sr_now_ns( ) )) > tw->cur + 1 ) {
+		tw->cur = tick - 1;										// wheel was idle; catch up without walking the empty ticks
+	}
+
+	t->fn = fn;
+	t->data = data;
+	if( (t->tick = tw_tick( tw, when )) <= tw->cur ) {
+		t->tick = tw->cur + 1;									// already due; the next tick processed
+	}
+	tw_link( tw, t );
+	tw->count++;
+	if( t->tick < tw->wake_tick ) {
+		pthread_cond_signal( &tw->wake );							// due before the thread means to wake
+	}
+	pthread_mutex_unlock( &tw->gate );
+
+	return TRUE;
+}
+
+/*
+	Cancel the timer. If its function is being called we wait for it to return,
+	so once this returns the timer's function is not running and will not be
+	called; the thing the timer is embedded in may be reused or freed. Returns
+	true if the timer was armed (it was cancelled before it expired).
+*/
+static int tw_cancel( uta_ctx_t* ctx, tw_timer_t* t ) {
+	timing_wheel_t*	tw;
+	int				armed;
+
+	if( t == NULL || (tw = __atomic_load_n( &ctx->tw, __ATOMIC_ACQUIRE )) == NULL ) {
+		return FALSE;
+	}
+
+	pthread_mutex_lock( &tw->gate );
+	if( (armed = t->armed) ) {
+		tw_unlink( tw, t );
+		tw->count--;
+	}
+	while( tw->running == t ) {
+		pthread_mutex_unlock( &tw->gate );
+		sched_yield( );
+		pthread_mutex_lock( &tw->gate );
+	}
+	pthread_mutex_unlock( &tw->gate );
+
+	return armed;
+}
+
+/*
+	Timer function which posts the semaphore given as data; wakes a thread
+	waiting for a response or for work.
+*/
+static void tw_post( uta_ctx_t* ctx, void* data ) {
+	sem_post( (sem_t *) data );
+}
+
+#endif
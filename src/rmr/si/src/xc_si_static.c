@@ -0,0 +1,309 @@
+// : vi ts=4 sw=4 noet:
+/*
+==================================================================================
+	Copyright (c) 2020-2026 Nokia
+	Copyright (c) 2018-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mnemonic:	xc_si_static.c
+	Abstract:	Calls matched on the transaction id. A call made with the call id
+				RMR_CALL_AUTO (0) does not use one of the 255 numbered chutes;
+				the caller's transaction id is put in a table of outstanding
+				calls and the response is matched to it when it arrives. The
+				number of calls in flight is thus limited only by the table
+				size, and the application does not manage call ids.
+
+				The table is open addressed; a call claims a slot among the few
+				following the hash of its xid, and the receive thread looks only
+				at those. Slots change state with atomic compare and swap, so
+				neither side takes a lock:
+
+					free -> claimed -> waiting		call made
+					waiting -> filling -> done		response delivered
+					waiting -> free, done -> free	call finished
+
+				Each slot names the chute the response is delivered to. Each
+				thread which makes automatic calls has its own chute, created
+				on first use and released when the thread exits, so the normal
+				call wait (mt_call()) is used unchanged.
+
+				On the wire the call id byte is left 0, as it is for a message
+				which is not a call, a second byte in the d1 area marks the
+				message, and the last two carry a tag chosen by the calling
+				context. Responders return the d1 area as is, so peers running
+				an older RMR answer automatic calls without change; numbered
+				calls are sent and matched exactly as before.
+
+				A back level peer which reuses a received call's buffer for a
+				plain send clears only the call id, so the mark survives. The
+				tag keeps such a message from being taken as a response by
+				anyone but the context which made the call: a marked message
+				with another context's tag is queued as a normal message, and
+				only one carrying our tag, but matching no waiting call, is
+				reclaimed as a late response.
+
+	Date:		18 October 2026
+*/
+
+#ifndef _xc_si_static_c
+#define _xc_si_static_c
+
+#define XC_FREE			0				// slot states
+#define XC_CLAIMED		1
+#define XC_WAITING		2
+#define XC_FILLING		3
+#define XC_DONE			4
+
+static pthread_key_t	xc_key;				// each thread's chute
+static pthread_once_t	xc_once = PTHREAD_ONCE_INIT;
+static __thread uint32_t xc_seq = 0;		// per thread counter for generated transaction ids
+
+/*
+	Thread exit: release the thread's chute and any late response left in it.
+*/
+static void xc_chute_free( void* data ) {
+	chute_t*	chute;
+
+	if( (chute = (chute_t *) data) == NULL ) {
+		return;
+	}
+
+	if( chute->mbuf != NULL ) {
+		rmr_free_msg( chute->mbuf );
+	}
+	sem_destroy( &chute->barrier );
+	free( chute );
+}
+
+static void xc_key_init( void ) {
+	pthread_key_create( &xc_key, xc_chute_free );
+}
+
+/*
+	Return the calling thread's chute, creating it on first use. Nil (errno set)
+	if it could not be created.
+*/
+static chute_t* xc_chute( void ) {
+	chute_t*	chute;
+
+	pthread_once( &xc_once, xc_key_init );
+	if( (chute = (chute_t *) pthread_getspecific( xc_key )) != NULL ) {
+		return chute;
+	}
+
+	if( (chute = (chute_t *) malloc( sizeof( *chute ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( chute, 0, sizeof( *chute ) );
+	sem_init( &chute->barrier, 0, 0 );
+	pthread_setspecific( xc_key, chute );
+
+	return chute;
+}
+
+/*
+	Return the context's table of outstanding calls, creating it if needed.
+	Several threads may race; the first to install its table wins.
+*/
+static xc_slot_t* xc_table( uta_ctx_t* ctx ) {
+	xc_slot_t*	slots;
+	xc_slot_t*	expect = NULL;
+
+	if( (slots = __atomic_load_n( &ctx->xcalls, __ATOMIC_ACQUIRE )) != NULL ) {
+		return slots;
+	}
+
+	if( (slots = (xc_slot_t *) calloc( XC_SLOTS, sizeof( *slots ) )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if( ! __atomic_compare_exchange_n( &ctx->xcalls, &expect, slots, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+		free( slots );
+		return expect;
+	}
+
+	return slots;
+}
+
+/*
+	Give the message a transaction id unique among this process's calls if the
+	application did not set one.
+*/
+static void xc_set_xid( rmr_mbuf_t* mbuf ) {
+	if( mbuf->xaction[0] != 0 ) {
+		return;
+	}
+
+	snprintf( (char *) mbuf->xaction, RMR_MAX_XID, "rmr-xc-%lx-%x", (unsigned long) pthread_self( ), ++xc_seq );
+}
+
+/*
+	Mark the d1 area of a message being sent as an automatic call made by the
+	context.
+*/
+static inline void xc_mark( uta_ctx_t* ctx, unsigned char* d1 ) {
+	d1[D1_CALLID_IDX] = NO_CALL_ID;
+	d1[D1_XCALL_IDX] = XCALL_MARK;
+	d1[D1_XTAG_IDX] = ctx->xc_tag >> 8;
+	d1[D1_XTAG_IDX+1] = ctx->xc_tag & 0xff;
+}
+
+/*
+	Returns true if the received message is marked as the response to an
+	automatic call made by this context.
+*/
+static inline int xc_marked( uta_ctx_t* ctx, uta_mhdr_t* hdr ) {
+	unsigned char*	d1;
+
+	if( RMR_D1_LEN( hdr ) <= D1_XTAG_IDX + 1 ) {
+		return FALSE;
+	}
+
+	d1 = DATA1_ADDR( hdr );
+	return d1[D1_XCALL_IDX] == XCALL_MARK && ((d1[D1_XTAG_IDX] << 8) | d1[D1_XTAG_IDX+1]) == ctx->xc_tag;
+}
+
+/*
+	Add an outstanding call for the transaction id whose response is to be
+	delivered to the chute, or, for an asynchronous call, used to complete the
+	request (areq). Returns the slot, or nil (errno EBUSY) if every slot the xid
+	may use is taken.
+*/
+static xc_slot_t* xc_add( uta_ctx_t* ctx, unsigned char const* xid, chute_t* chute, void* areq ) {
+	xc_slot_t*	slots;
+	xc_slot_t*	s;
+	uint32_t	h;
+	int			expect;
+	int			i;
+
+	if( (slots = xc_table( ctx )) == NULL ) {
+		return NULL;
+	}
+
+	h = shard_hash( xid, RMR_MAX_XID, 0 );
+	for( i = 0; i < XC_PROBES; i++ ) {
+		s = &slots[(h + i) & (XC_SLOTS - 1)];
+		expect = XC_FREE;
+		if( __atomic_compare_exchange_n( &s->state, &expect, XC_CLAIMED, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) ) {
+			memcpy( s->xid, xid, RMR_MAX_XID );
+			s->chute = chute;
+			s->areq = areq;
+			__atomic_store_n( &s->state, XC_WAITING, __ATOMIC_RELEASE );
+			return s;
+		}
+	}
+
+	errno = EBUSY;
+	return NULL;
+}
+
+/*
+	Called by the receive thread for a message marked as the response to an
+	automatic call. If a call is waiting for its transaction id the message is
+	put in the caller's chute (or completes the asynchronous call) and true is
+	returned; if not (the call timed out,
+	or another response won) false is returned and the message is left to the
+	caller.
+*/
+static int xc_deliver( uta_ctx_t* ctx, rmr_mbuf_t* mbuf ) {
+	xc_slot_t*	slots;
+	xc_slot_t*	s;
+	chute_t*	chute;
+	ac_req_t*	req;
+	uint32_t	h;
+	int			expect;
+	int			i;
+
+	if( (slots = __atomic_load_n( &ctx->xcalls, __ATOMIC_ACQUIRE )) == NULL ) {
+		return FALSE;
+	}
+
+	h = shard_hash( mbuf->xaction, RMR_MAX_XID, 0 );
+	for( i = 0; i < XC_PROBES; i++ ) {
+		s = &slots[(h + i) & (XC_SLOTS - 1)];
+		if( __atomic_load_n( &s->state, __ATOMIC_ACQUIRE ) != XC_WAITING || memcmp( s->xid, mbuf->xaction, RMR_MAX_XID ) != 0 ) {
+			continue;
+		}
+
+		expect = XC_WAITING;
+		if( ! __atomic_compare_exchange_n( &s->state, &expect, XC_FILLING, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) ) {
+			continue;
+		}
+		if( memcmp( s->xid, mbuf->xaction, RMR_MAX_XID ) != 0 ) {			// slot was reused between the check and the swap
+			__atomic_store_n( &s->state, XC_WAITING, __ATOMIC_RELEASE );
+			continue;
+		}
+
+		if( (req = (ac_req_t *) s->areq) != NULL ) {					// asynchronous call
+			if( ! ac_claim( req ) ) {
+				__atomic_store_n( &s->state, XC_WAITING, __ATOMIC_RELEASE );	// timed out; its owner frees the slot
+				return FALSE;
+			}
+			__atomic_store_n( &s->state, XC_FREE, __ATOMIC_RELEASE );
+			fc_consumed( ctx, mbuf );
+			ac_done( ctx, req, mbuf );
+			return TRUE;
+		}
+
+		chute = s->chute;
+		fc_consumed( ctx, mbuf );						// response goes straight to the waiting thread
+		chute->mbuf = mbuf;
+		__atomic_store_n( &s->state, XC_DONE, __ATOMIC_RELEASE );
+		sem_post( &chute->barrier );
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+	Move a slot, or a numbered call's chute, from waiting or done to free. If a
+	response is being delivered at this moment we wait for the delivery to
+	finish so that the slot is never reused while the receive thread holds it.
+*/
+static void xc_release( int* state ) {
+	int		expect;
+
+	while( 1 ) {
+		expect = XC_WAITING;
+		if( __atomic_compare_exchange_n( state, &expect, XC_FREE, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+			return;
+		}
+		if( expect == XC_DONE || expect == XC_FREE ) {
+			__atomic_store_n( state, XC_FREE, __ATOMIC_RELEASE );
+			return;
+		}
+
+		sched_yield( );						// filling; the receive thread is not finished with it
+	}
+}
+
+/*
+	Finish the call using the slot. A response which was delivered as the call
+	gave up is left in the chute for the caller to reclaim.
+*/
+static void xc_drop( xc_slot_t* s ) {
+	if( s == NULL ) {
+		return;
+	}
+
+	xc_release( &s->state );
+}
+
+#endif
@@ -0,0 +1,170 @@
+// : vi ts=4 sw=4 noet :
+/*
+==================================================================================
+	    Copyright (c) 2020-2026 Nokia
+	    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mmemonic:	cz_bench.c
+	Abstract:	Stand alone benchmark of the built in payload codec. This is not
+				a unit test and is not run by the unit test script; build and
+				run it by hand:
+					make cz_bench
+					./cz_bench [iterations]
+
+				For each kind of payload (KPM like JSON reports, a JSON policy,
+				and incompressible binary) and several sizes, the compress and
+				decompress time per message and the compression ratio are
+				reported. The break even column is the link speed (Gbit/s) at
+				which the CPU spent compressing and decompressing a message
+				equals the time saved putting the smaller message on the wire;
+				on slower links compression is a win for that payload (ignoring
+				the CPU being needed elsewhere), on faster links it is not.
+
+	Date:		18 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "test_support.c"
+
+#include "rmr.h"
+#include "rmr_symtab.h"
+#include "rmr_logging.h"
+#include "rmr_agnostic.h"
+
+#include "symtab.c"
+#include "logging.c"
+#include "rmr_si.c"
+#include "mbuf_api.c"
+
+#define KIND_KPM	0
+#define KIND_POLICY	1
+#define KIND_BINARY	2
+
+static char* kind_names[] = { "kpm report json", "policy json", "random binary" };
+static int sizes[] = { 256, 1024, 4096, 16384 };
+
+static uint64_t now_ns( ) {
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+	Fill buf with len bytes of the kind of payload.
+*/
+static void fill( int kind, unsigned char* buf, int len ) {
+	uint32_t	rnd = 12345;
+	int			i;
+	int			n = 0;
+
+	for( i = 0; n < len; i++ ) {
+		switch( kind ) {
+			case KIND_KPM:
+				n += snprintf( (char *) buf + n, len - n, "{\"cellId\":\"%05d\",\"prbUsedDl\":%d,\"prbUsedUl\":%d,\"activeUes\":%d,\"thpDl\":%d},",
+					i % 23, (i * 37) % 273, (i * 11) % 273, i % 64, (i * 7919) % 100000 );
+				break;
+
+			case KIND_POLICY:
+				n += snprintf( (char *) buf + n, len - n, "{\"policy_id\":\"qos-%d\",\"scope\":{\"ueId\":\"ue-%04d\",\"qosId\":%d},\"qosObjectives\":{\"priorityLevel\":%d,\"gfbr\":%d}},",
+					i, i % 500, i % 9, i % 4, 1000 * (i % 17) );
+				break;
+
+			default:
+				rnd = (rnd * 1103515245) + 12345;
+				buf[n++] = (unsigned char) (rnd >> 16);
+				break;
+		}
+	}
+}
+
+static void run( int kind, int size, long iterations ) {
+	unsigned char*	src;
+	unsigned char*	cbuf;
+	unsigned char*	dbuf;
+	uint64_t	start;
+	double		c_ns;
+	double		d_ns;
+	double		saved;
+	int			clen = 0;
+	long		i;
+
+	src = (unsigned char *) malloc( size + 1 );
+	cbuf = (unsigned char *) malloc( size );
+	dbuf = (unsigned char *) malloc( size );
+	fill( kind, src, size );
+
+	start = now_ns( );
+	for( i = 0; i < iterations; i++ ) {
+		clen = cz_lz_compress( NULL, src, size, cbuf, size - CZ_HDR_LEN - 1 );
+	}
+	c_ns = (double) (now_ns( ) - start) / iterations;
+
+	if( clen <= 0 ) {
+		fprintf( stderr, "%-16s %6d  compress %7.1f ns  not compressible; sent as is\n", kind_names[kind], size, c_ns );
+	} else {
+		start = now_ns( );
+		for( i = 0; i < iterations; i++ ) {
+			cz_lz_decompress( NULL, cbuf, clen, dbuf, size );
+		}
+		d_ns = (double) (now_ns( ) - start) / iterations;
+
+		if( memcmp( src, dbuf, size ) != 0 ) {
+			fprintf( stderr, "<FAIL> %s %d: decompressed payload was not the original\n", kind_names[kind], size );
+		}
+
+		saved = (double) (size - clen - CZ_HDR_LEN);
+		fprintf( stderr, "%-16s %6d  compress %7.1f ns  decompress %7.1f ns  ratio %5.2f  break even %6.2f Gbit/s\n",
+			kind_names[kind], size, c_ns, d_ns, (double) size / (clen + CZ_HDR_LEN), (saved * 8) / (c_ns + d_ns) );
+	}
+
+	free( src );
+	free( cbuf );
+	free( dbuf );
+}
+
+int main( int argc, char** argv ) {
+	long	iterations = 100000;
+	int		kind;
+	int		i;
+
+	if( argc > 1 ) {
+		iterations = atol( argv[1] );
+	}
+	if( iterations <= 0 ) {
+		fprintf( stderr, "usage: %s [iterations]\n", argv[0] );
+		exit( 1 );
+	}
+
+	for( kind = KIND_KPM; kind <= KIND_BINARY; kind++ ) {
+		for( i = 0; i < (int) (sizeof( sizes ) / sizeof( int )); i++ ) {
+			run( kind, sizes[i], iterations );
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,166 @@
+// : vi ts=4 sw=4 noet :
+/*
+==================================================================================
+	    Copyright (c) 2020-2026 Nokia
+	    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mmemonic:	dispatch_si_static_test.c
+	Abstract:	Tests for the message dispatcher. Messages are pushed through
+				queue_normal() as the receive thread would and the handlers
+				registered here count what they see.
+
+	Date:		18 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "rmr.h"
+#include "rmr_agnostic.h"
+
+static int disp_count = 0;				// messages seen by the counting handler
+static int disp_serial_count = 0;		// messages seen by the serialised handler
+static int disp_serial_active = 0;		// concurrent invocations of the serialised handler
+static int disp_serial_max = 0;			// max concurrent invocations observed
+
+/*
+	Count the message and return it for RMR to free.
+*/
+static rmr_mbuf_t* count_handler( void* vctx, rmr_mbuf_t* msg, void* arg ) {
+	__atomic_add_fetch( (int *) arg, 1, __ATOMIC_ACQ_REL );
+	return msg;
+}
+
+/*
+	Track the number of concurrent invocations; free the message ourselves.
+*/
+static rmr_mbuf_t* serial_handler( void* vctx, rmr_mbuf_t* msg, void* arg ) {
+	int	active;
+
+	active = __atomic_add_fetch( &disp_serial_active, 1, __ATOMIC_ACQ_REL );
+	if( active > disp_serial_max ) {
+		disp_serial_max = active;
+	}
+	usleep( 200 );
+	__atomic_sub_fetch( &disp_serial_active, 1, __ATOMIC_ACQ_REL );
+	__atomic_add_fetch( &disp_serial_count, 1, __ATOMIC_ACQ_REL );
+
+	rmr_free_msg( msg );
+	return NULL;
+}
+
+static int dispatch_test( ) {
+	int			errors = 0;
+	uta_ctx_t*	ctx;
+	rmr_mbuf_t*	mbuf;
+	rmr_handler_stats_t	stats;
+	dq_t*		q;
+	int			i;
+	int			dummy = 0;
+
+	ctx = mk_dummy_ctx();
+	ctx->chutes = (chute_t *) malloc( sizeof( chute_t ) );
+	sem_init( &ctx->chutes[0].barrier, 0, 0 );
+
+	// ---- worker queue ----------------------------------------------------
+	q = (dq_t *) malloc( sizeof( *q ) );
+	memset( q, 0, sizeof( *q ) );
+	errors += fail_not_nil( dq_take( q ), "take from empty worker queue returned a pointer" );
+	for( i = 0; i < DQ_SIZE; i++ ) {
+		if( ! dq_push( q, &q->slots[i] ) ) {
+			break;
+		}
+	}
+	errors += fail_not_equal( i, DQ_SIZE, "worker queue did not accept a full load" );
+	errors += fail_if_true( dq_push( q, q ), "push to full worker queue did not fail" );
+	errors += fail_not_equalp( dq_take( q ), &q->slots[0], "take from worker queue did not return oldest" );
+	errors += fail_if_false( dq_push( q, q ), "push after take did not succeed" );
+	free( q );
+
+	// ---- api argument checks ---------------------------------------------
+	errors += fail_not_equal( rmr_register_handler( NULL, 100, count_handler, NULL ), RMR_ERR_BADARG, "register with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_register_handler( ctx, 100, NULL, NULL ), RMR_ERR_BADARG, "register with nil function did not return bad arg" );
+	errors += fail_not_equal( rmr_dispatch_start( ctx, 2 ), RMR_ERR_NOTSUPP, "start with no handlers did not return not supported" );
+	errors += fail_not_equal( rmr_set_handler_limit( ctx, 100, 1 ), RMR_ERR_BADARG, "limit with no handlers did not return bad arg" );
+	errors += fail_not_equal( rmr_get_handler_stats( ctx, 100, &stats ), RMR_ERR_BADARG, "stats with no handlers did not return bad arg" );
+	errors += fail_not_equal( rmr_get_handler_stats( NULL, 100, &stats ), RMR_ERR_BADARG, "stats with nil context did not return bad arg" );
+
+	errors += fail_not_equal( rmr_register_handler( ctx, 100, count_handler, &dummy ), RMR_OK, "register handler failed" );
+	errors += fail_not_equal( rmr_register_handler( ctx, 100, count_handler, &disp_count ), RMR_OK, "register handler replacement failed" );
+	errors += fail_not_equal( rmr_register_handler( ctx, 101, serial_handler, NULL ), RMR_OK, "register serial handler failed" );
+	errors += fail_not_equal( rmr_set_handler_limit( ctx, 101, -1 ), RMR_ERR_BADARG, "negative handler limit did not return bad arg" );
+	errors += fail_not_equal( rmr_set_handler_limit( ctx, 101, 1 ), RMR_OK, "set handler limit failed" );
+	errors += fail_not_equal( rmr_set_handler_limit( ctx, 101, 1 ), RMR_OK, "second set handler limit failed" );
+	errors += fail_not_equal( rmr_get_handler_stats( ctx, 100, NULL ), RMR_ERR_BADARG, "stats with nil struct did not return bad arg" );
+
+	mbuf = mk_populated_msg( 64, 0, 100, 1, 0 );					// not started; must be queued normally
+	queue_normal( ctx, mbuf );
+	errors += fail_not_equalp( uta_ring_extract( ctx->mring ), mbuf, "message queued before dispatcher start was not on the receive ring" );
+	rmr_free_msg( mbuf );
+
+	errors += fail_not_equal( rmr_dispatch_start( ctx, 0 ), RMR_ERR_BADARG, "start with 0 threads did not return bad arg" );
+	errors += fail_not_equal( rmr_dispatch_start( NULL, 2 ), RMR_ERR_BADARG, "start with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_dispatch_start( ctx, 4 ), RMR_OK, "dispatcher start failed" );
+	errors += fail_not_equal( rmr_dispatch_start( ctx, 4 ), RMR_ERR_NOTSUPP, "second dispatcher start did not return not supported" );
+	errors += fail_not_equal( rmr_register_handler( ctx, 102, count_handler, NULL ), RMR_ERR_NOTSUPP, "register after start did not return not supported" );
+	errors += fail_not_equal( rmr_set_handler_limit( ctx, 100, 2 ), RMR_ERR_NOTSUPP, "limit after start did not return not supported" );
+
+	// ---- dispatch ----------------------------------------------------------
+	for( i = 0; i < 50; i++ ) {
+		queue_normal( ctx, mk_populated_msg( 64, 0, 100, 1, 0 ) );
+		if( i < 20 ) {
+			queue_normal( ctx, mk_populated_msg( 64, 0, 101, 1, 0 ) );
+		}
+	}
+	mbuf = mk_populated_msg( 64, 0, 5, 1, 0 );						// no handler; must go to the ring
+	queue_normal( ctx, mbuf );
+
+	for( i = 0; i < 200 && (__atomic_load_n( &disp_count, __ATOMIC_ACQUIRE ) < 50 || __atomic_load_n( &disp_serial_count, __ATOMIC_ACQUIRE ) < 20); i++ ) {
+		usleep( 10000 );
+	}
+	usleep( 50000 );												// handlers account after returning; let the last ones finish
+	errors += fail_not_equal( disp_count, 50, "counting handler did not see all messages" );
+	errors += fail_not_equal( disp_serial_count, 20, "serialised handler did not see all messages" );
+	errors += fail_not_equal( disp_serial_max, 1, "serialised handler was run concurrently" );
+	errors += fail_not_equalp( uta_ring_extract( ctx->mring ), mbuf, "message without a handler was not on the receive ring" );
+	rmr_free_msg( mbuf );
+	errors += fail_not_equal( dummy, 0, "replaced handler argument was used" );
+
+	errors += fail_not_equal( rmr_get_handler_stats( ctx, 101, &stats ), RMR_OK, "get handler stats failed" );
+	errors += fail_if_false( stats.count == 20, "handler stats count is not right" );
+	errors += fail_if_false( stats.total_ns >= stats.max_ns && stats.max_ns > 0, "handler stats times are not sane" );
+
+	for( i = 0; i < 20; i++ ) {										// serialised, so still running when stop is called
+		queue_normal( ctx, mk_populated_msg( 64, 0, 101, 1, 0 ) );
+	}
+	disp_stop( ctx );
+	errors += fail_not_equal( disp_serial_count, 40, "stop returned before the messages queued ahead of it were run" );
+	errors += fail_not_equal( disp_serial_active, 0, "stop returned while a handler was still running" );
+	errors += fail_if_true( disp_queue( ctx, NULL ), "dispatch queue accepted a message after stop" );
+	disp_stop( ctx );												// must be safe to call twice
+	disp_stop( NULL );
+
+	return errors;
+}
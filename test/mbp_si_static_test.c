@@ -0,0 +1,152 @@
+// : vi ts=4 sw=4 noet :
+/*
+==================================================================================
+	    Copyright (c) 2020-2026 Nokia
+	    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mmemonic:	mbp_si_static_test.c
+	Abstract:	Tests for the per thread mbuf recycling caches.
+
+	Date:		18 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "rmr.h"
+#include "rmr_agnostic.h"
+
+#define MBP_TEST_COUNT	200				// more than a magazine holds
+
+/*
+	Allocate and free a batch of messages and then exit; the thread's magazine
+	must be moved to the depot when the thread goes.
+*/
+static void* mbp_churn( void* data ) {
+	uta_ctx_t*	ctx;
+	rmr_mbuf_t*	mbufs[MBP_TEST_COUNT];
+	int			i;
+
+	ctx = (uta_ctx_t *) data;
+	for( i = 0; i < MBP_TEST_COUNT; i++ ) {
+		mbufs[i] = alloc_zcmsg( ctx, NULL, 100, RMR_OK, 0 );
+	}
+	for( i = 0; i < MBP_TEST_COUNT; i++ ) {
+		rmr_free_msg( mbufs[i] );
+	}
+
+	return NULL;
+}
+
+static int mbp_test( ) {
+	int			errors = 0;
+	uta_ctx_t*	ctx;
+	rmr_mbuf_t*	mbuf;
+	rmr_mbuf_t*	mbuf2;
+	rmr_mbuf_t*	mbufs[MBP_TEST_COUNT];
+	rmr_mbuf_stats_t	s0;
+	rmr_mbuf_stats_t	s1;
+	rmr_tpbuf_stats_t	tps;
+	void*		tp_buf;
+	pthread_t	th;
+	int			i;
+
+	ctx = mk_dummy_ctx();
+
+	errors += fail_not_equal( rmr_get_mbuf_stats( NULL, &s0 ), RMR_ERR_BADARG, "mbuf stats with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_get_mbuf_stats( ctx, NULL ), RMR_ERR_BADARG, "mbuf stats with nil struct did not return bad arg" );
+	errors += fail_not_equal( rmr_get_mbuf_stats( ctx, &s0 ), RMR_OK, "mbuf stats did not return ok" );
+	errors += fail_not_equal( rmr_get_tpbuf_stats( NULL, &tps ), RMR_ERR_BADARG, "tp buffer stats with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_get_tpbuf_stats( ctx, NULL ), RMR_ERR_BADARG, "tp buffer stats with nil struct did not return bad arg" );
+	errors += fail_not_equal( rmr_get_tpbuf_stats( ctx, &tps ), RMR_OK, "tp buffer stats did not return ok" );
+
+	// ---- free and realloc on the same thread reuses mbuf and buffer ---------
+	mbuf = alloc_zcmsg( ctx, NULL, 100, RMR_OK, 0 );
+	errors += fail_if_nil( mbuf, "alloc zc message returned nil" );
+	tp_buf = mbuf->tp_buf;
+	rmr_free_msg( mbuf );
+	mbuf2 = alloc_zcmsg( ctx, NULL, 100, RMR_OK, 0 );
+	errors += fail_not_equalp( mbuf2, mbuf, "freed mbuf was not reused" );
+	errors += fail_not_equalp( mbuf2->tp_buf, tp_buf, "transport buffer was not kept with the recycled mbuf" );
+	errors += fail_not_equal( mbuf2->cookie, 0x4942, "recycled mbuf cookie not reset" );
+
+	rmr_get_mbuf_stats( ctx, &s1 );
+	errors += fail_if_false( s1.allocs >= s0.allocs + 2, "mbuf stats allocations did not increase" );
+	errors += fail_if_false( s1.hits >= s0.hits + 1, "mbuf stats hits did not increase" );
+	errors += fail_if_false( s1.frees >= s0.frees + 1, "mbuf stats frees did not increase" );
+
+	rmr_free_msg( mbuf2 );
+	mbuf = alloc_zcmsg( ctx, NULL, 8000, RMR_OK, 0 );					// larger than the cached buffer
+	errors += fail_not_equalp( mbuf, mbuf2, "freed mbuf was not reused for a larger message" );
+	errors += fail_if_true( mbuf->alloc_len < 8000, "recycled mbuf buffer not grown for a larger message" );
+	rmr_free_msg( mbuf );
+
+	// ---- a second free of a cached mbuf is refused -------------------------
+	mbuf = alloc_zcmsg( ctx, NULL, 100, RMR_OK, 0 );
+	rmr_free_msg( mbuf );
+	rmr_free_msg( mbuf );													// double free by the application
+	mbuf = mbp_get( );
+	mbuf2 = mbp_get( );
+	errors += fail_if_true( mbuf == mbuf2, "mbuf freed twice was handed out twice" );
+	errors += fail_if_true( mbuf->flags & MFL_FREED, "mbuf taken from the cache still marked freed" );
+	rmr_free_msg( mbuf );
+	if( mbuf2 != NULL ) {
+		rmr_free_msg( mbuf2 );
+	}
+
+	// ---- buffers which cannot be reused are not kept ------------------------
+	mbuf = mk_populated_msg( 64, 0, 1, 1, 0 );							// not a pooled transport buffer
+	rmr_free_msg( mbuf );
+	mbuf2 = mbp_get( );
+	errors += fail_not_equalp( mbuf2, mbuf, "mbuf with unpooled buffer was not cached" );
+	errors += fail_not_nil( mbuf2->tp_buf, "unpooled transport buffer was kept with the cached mbuf" );
+	rmr_free_msg( mbuf2 );
+
+	mbuf = alloc_mbuf( ctx, RMR_OK );										// receive path wants no buffer attached
+	errors += fail_if_nil( mbuf, "alloc mbuf returned nil" );
+	errors += fail_not_nil( mbuf->tp_buf, "alloc mbuf returned an mbuf with a transport buffer" );
+	rmr_free_msg( mbuf );
+
+	// ---- overflow to the depot ----------------------------------------------
+	for( i = 0; i < MBP_TEST_COUNT; i++ ) {
+		mbufs[i] = alloc_zcmsg( ctx, NULL, 100, RMR_OK, 0 );
+	}
+	for( i = 0; i < MBP_TEST_COUNT; i++ ) {
+		rmr_free_msg( mbufs[i] );
+	}
+	errors += fail_if_true( mbp_mine->n > MBP_MAG_SIZE, "magazine holds more than its size" );
+	errors += fail_if_true( mbp_depot.enq == mbp_depot.deq, "full magazine did not spill to the depot" );
+
+	// ---- thread exit moves the magazine to the depot ------------------------
+	rmr_get_mbuf_stats( ctx, &s0 );
+	pthread_create( &th, NULL, mbp_churn, ctx );
+	pthread_join( th, NULL );
+	rmr_get_mbuf_stats( ctx, &s1 );
+	errors += fail_if_false( s1.allocs >= s0.allocs + MBP_TEST_COUNT, "allocations of an exited thread not in the stats" );
+	errors += fail_if_false( s1.frees >= s0.frees + MBP_TEST_COUNT, "frees of an exited thread not in the stats" );
+	errors += fail_if_false( s1.hits > s0.hits, "exited thread did not reuse mbufs from the depot" );
+	errors += fail_if_false( s1.cached > 0, "no mbufs cached after thread exit" );
+
+	return errors;
+}
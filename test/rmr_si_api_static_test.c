@@ -84,12 +84,549 @@ static int test_ep_counts() {
 
 	incr_ep_counts( 99, &ep );				// any non-retry/ok value
 	errors += fail_if_false(  ep.scounts[EPSC_FAIL] == 1, "ep inc fail counter had bad value" );
+	errors += fail_not_equal( ep.fail_streak, 2, "ep failed sends were not counted as a streak" );
+	incr_ep_counts( RMR_OK, &ep );
+	errors += fail_not_equal( ep.fail_streak, 0, "ep good send did not reset the failure streak" );
 
 	incr_ep_counts( RMR_OK, NULL );			// ensure nil pointer doesn't crash us
 
 	return errors;
 }
 
+/*
+	Pick n endpoints from the group for the message type and count how many times
+	the first endpoint in the group was picked.
+*/
+static int lb_picks( uta_ctx_t* ctx, int mtype, int n, endpoint_t** first ) {
+	route_table_t*	rt;
+	rtable_ent_t*	rte;
+	endpoint_t*		ep;
+	int		nn_sock;
+	int		count = 0;
+	int		i;
+
+	rt = get_rt( ctx );
+	if( (rte = uta_get_rte( rt, -1, mtype, TRUE )) == NULL || rte->rrgroups[0] == NULL ) {
+		release_rt( ctx, rt );
+		return -1;
+	}
+
+	*first = rte->rrgroups[0]->epts[0];
+	for( i = 0; i < n; i++ ) {
+		if( uta_epsock_rr( ctx, rte, 0, NULL, &nn_sock, &ep ) && ep == *first ) {
+			count++;
+		}
+	}
+	release_rt( ctx, rt );
+
+	return count;
+}
+
+/*
+	Consistent hash groups: a key always selects the same endpoint, keys are
+	spread over the endpoints, and adding a member moves only the keys it takes.
+*/
+static int hash_test( uta_ctx_t* ctx ) {
+	route_table_t*	rt;
+	rtable_ent_t*	rte;
+	rrgroup_t*		rrg3 = NULL;
+	rrgroup_t*		rrg4 = NULL;
+	rmr_mbuf_t*		msg;
+	endpoint_t*		ep;
+	endpoint_t*		ep1;
+	endpoint_t*		ep2;
+	char			meid[32];
+	int		counts[3] = { 0, 0, 0 };
+	int		moved = 0;
+	int		stolen = 0;
+	int		nn_sock;
+	int		errors = 0;
+	int		i;
+	int		j;
+
+	rt = get_rt( ctx );
+	if( (rte = uta_get_rte( rt, -1, 12, TRUE )) != NULL ) {
+		rrg3 = rte->rrgroups[0];
+	}
+	if( (rte = uta_get_rte( rt, -1, 13, TRUE )) != NULL ) {
+		rrg4 = rte->rrgroups[0];
+	}
+	errors += fail_if_nil( rrg3, "no group for the consistent hash entry" );
+	errors += fail_if_nil( rrg4, "no group for the second consistent hash entry" );
+	if( rrg3 == NULL || rrg4 == NULL ) {
+		release_rt( ctx, rt );
+		return errors;
+	}
+
+	errors += fail_not_equal( rrg3->policy, RRG_HASH, "hash group did not have the hash policy" );
+	errors += fail_not_equal( rrg3->hash_key, RMR_SHARD_MEID, "hash group key was not meid" );
+	errors += fail_not_equal( rrg4->hash_key, RMR_SHARD_XID, "hash(xid) group key was not xid" );
+	errors += fail_if_nil( rrg3->lookup, "hash group had no lookup table" );
+	if( rrg3->lookup != NULL && rrg4->lookup != NULL ) {
+		for( i = 0; i < RRG_HASH_SLOTS; i++ ) {
+			counts[rrg3->lookup[i]]++;
+			ep1 = rrg3->epts[rrg3->lookup[i]];
+			ep2 = rrg4->epts[rrg4->lookup[i]];
+			if( ep1 != ep2 ) {
+				if( ep2 == rrg4->epts[3] ) {
+					stolen++;										// taken by the new member; expected
+				} else {
+					moved++;										// moved between members which did not change
+				}
+			}
+		}
+		for( i = 0; i < 3; i++ ) {
+			errors += fail_if_true( counts[i] < RRG_HASH_SLOTS / 3 - 10 || counts[i] > RRG_HASH_SLOTS / 3 + 10, "hash lookup table was not balanced" );
+		}
+		errors += fail_if_true( stolen < RRG_HASH_SLOTS / 5 || stolen > RRG_HASH_SLOTS / 3, "new member did not take about a quarter of the keys" );
+		errors += fail_if_true( moved > RRG_HASH_SLOTS / 20, "adding a member moved too many keys among the others" );
+	}
+
+	if( (rte = uta_get_rte( rt, -1, 12, TRUE )) != NULL && (msg = rmr_alloc_msg( ctx, 128 )) != NULL ) {
+		memset( counts, 0, sizeof( counts ) );
+		for( i = 0; i < 30; i++ ) {
+			snprintf( meid, sizeof( meid ), "gnb-%d", i );
+			rmr_str2meid( msg, meid );
+			ep1 = NULL;
+			for( j = 0; j < 4; j++ ) {
+				if( uta_epsock_rr_msg( ctx, rte, 0, NULL, &nn_sock, &ep, msg ) ) {
+					if( ep1 != NULL && ep != ep1 ) {
+						errors += fail_if_true( 1, "hash group selected different endpoints for one meid" );
+						break;
+					}
+					ep1 = ep;
+				}
+			}
+			if( ep1 != NULL ) {
+				counts[ep1 == rrg3->epts[0] ? 0 : ep1 == rrg3->epts[1] ? 1 : 2]++;
+			}
+		}
+		errors += fail_if_true( counts[0] == 30 || counts[1] == 30 || counts[2] == 30, "hash group sent every meid to one endpoint" );
+		rmr_free_msg( msg );
+	}
+	release_rt( ctx, rt );
+
+	return errors;
+}
+
+/*
+	Hedged calls: response time buckets, the percentile delay, and the second
+	send when no response arrives before the delay.
+*/
+static int hedge_test( uta_ctx_t* ctx ) {
+	rmr_mbuf_t*	msg;
+	int		errors = 0;
+	int		flags;
+	int		b;
+	int		v;
+	int		i;
+
+	errors += fail_if_equal( rmr_set_hedge( NULL, 90 ), RMR_OK, "hedge with nil context was accepted" );
+	errors += fail_if_equal( rmr_set_hedge( ctx, 100 ), RMR_OK, "hedge percentile over 99 was accepted" );
+
+	errors += fail_not_equal( hg_bucket( 3 ), 3, "small time did not have its own bucket" );
+	errors += fail_not_equal( hg_bucket( 0xffffffffffULL ), HG_NBUCKETS - 1, "huge time was not in the last bucket" );
+	for( i = 4; i < 10000000; i = i * 3 + 1 ) {
+		b = hg_bucket( i );
+		errors += fail_if_true( (uint64_t) i >= hg_bucket_us( b ) || (uint64_t) i < hg_bucket_us( b - 1 ), "time was not inside its bucket" );
+	}
+
+	errors += fail_not_equal( rmr_set_hedge( ctx, 90 ), RMR_OK, "hedge could not be turned on" );
+	errors += fail_not_equal( hg_delay( ctx, 0 ), 0, "type had a hedge delay before any samples" );
+	for( i = 0; i < 100; i++ ) {
+		hg_record( ctx, 0, i < 90 ? 500 : 50000 );				// p90 falls in the [448,512) bucket
+	}
+	errors += fail_not_equal( hg_delay( ctx, 0 ), 512, "hedge delay was not the bucket holding the percentile" );
+	for( i = 0; i < HG_WINDOW; i++ ) {
+		hg_record( ctx, 1, 100 );
+	}
+	errors += fail_if_true( hg_find( ctx, 1, FALSE )->total > HG_WINDOW / 2 + 1, "histogram was not halved when full" );
+
+	flags = ctx->flags;
+	ctx->flags |= CFL_MTC_ENABLED;
+	msg = rmr_alloc_msg( ctx, 128 );
+	msg->mtype = 0;													// group of two; second is hedged to
+	msg->sub_id = -1;
+	msg->len = 10;
+	rmr_str2xact( msg, "hedge-1" );
+	v = em_sendt_count;
+	msg = rmr_mt_call( ctx, msg, 3, 30 );
+	errors += fail_not_nil( msg, "hedged call without a response did not return nil" );
+	errors += fail_not_equal( em_sendt_count - v, 2, "call was not sent to another member when the hedge was due" );
+
+	for( i = 0; i < 100; i++ ) {
+		hg_record( ctx, 12, 500 );
+	}
+	msg = rmr_alloc_msg( ctx, 128 );
+	msg->mtype = 12;												// consistent hash group; key belongs to one member
+	msg->sub_id = -1;
+	msg->len = 10;
+	rmr_str2meid( msg, "hedge-meid" );
+	rmr_str2xact( msg, "hedge-3" );
+	v = em_sendt_count;
+	msg = rmr_mt_call( ctx, msg, 3, 10 );
+	errors += fail_not_equal( em_sendt_count - v, 1, "call to a hash group was hedged" );
+
+	rmr_set_hedge( ctx, 0 );
+	msg = rmr_alloc_msg( ctx, 128 );
+	msg->mtype = 0;
+	msg->sub_id = -1;
+	msg->len = 10;
+	rmr_str2xact( msg, "hedge-2" );
+	v = em_sendt_count;
+	msg = rmr_mt_call( ctx, msg, 3, 10 );
+	errors += fail_not_equal( em_sendt_count - v, 1, "call was hedged with hedging off" );
+	ctx->flags = flags;
+
+	return errors;
+}
+
+/*
+	Automatic calls matched on the xid: the outstanding call table, delivery of
+	the response (once), and a call which gets no response.
+*/
+static int xcall_test( uta_ctx_t* ctx ) {
+	rmr_mbuf_t*	msg;
+	rmr_mbuf_t*	msg2;
+	rmr_mbuf_t*	rsp;
+	unsigned char*	d1;
+	char*		frame;
+	int			flen;
+	chute_t*	chute;
+	xc_slot_t*	slots[XC_PROBES];
+	xc_slot_t*	s;
+	int		errors = 0;
+	int		flags;
+	int		i;
+
+	chute = xc_chute( );
+	errors += fail_if_nil( chute, "thread chute was not created" );
+	errors += fail_not_equalp( chute, xc_chute( ), "thread did not get the same chute again" );
+
+	msg = rmr_alloc_msg( ctx, 128 );
+	rsp = rmr_alloc_msg( ctx, 128 );
+	rmr_str2xact( msg, "xcall-1" );
+	rmr_str2xact( rsp, "xcall-1" );
+
+	errors += fail_if_true( xc_deliver( ctx, rsp ), "response was delivered with no call outstanding" );
+	s = xc_add( ctx, msg->xaction, chute, NULL );
+	errors += fail_if_nil( s, "outstanding call was not added" );
+	errors += fail_if_false( xc_deliver( ctx, rsp ), "response was not delivered to the waiting call" );
+	errors += fail_not_equalp( chute->mbuf, rsp, "response was not put in the caller's chute" );
+	errors += fail_if_true( xc_deliver( ctx, rsp ), "second response to one call was delivered" );
+	xc_drop( s );
+	errors += fail_not_equal( s->state, XC_FREE, "slot was not freed when the call finished" );
+	chute->mbuf = NULL;
+	while( sem_trywait( &chute->barrier ) == 0 );
+
+	for( i = 0; i < XC_PROBES; i++ ) {							// same xid fills every slot it may use
+		slots[i] = xc_add( ctx, msg->xaction, chute, NULL );
+		errors += fail_if_nil( slots[i], "outstanding call was not added while the table had room" );
+	}
+	errno = 0;
+	errors += fail_not_nil( xc_add( ctx, msg->xaction, chute, NULL ), "outstanding call was added with no slot free" );
+	errors += fail_not_equal( errno, EBUSY, "errno was not busy with no slot free" );
+	for( i = 0; i < XC_PROBES; i++ ) {
+		xc_drop( slots[i] );
+	}
+
+	rsp = rmr_alloc_msg( ctx, 128 );								// marked by another context (back level peer reused its buffer)
+	rmr_str2xact( rsp, "xcall-stray" );
+	rsp->mtype = 1;
+	rsp->len = 10;
+	d1 = DATA1_ADDR( rsp->header );
+	xc_mark( ctx, d1 );
+	errors += fail_if_false( xc_marked( ctx, (uta_mhdr_t *) rsp->header ), "message marked by this context was not recognised" );
+	d1[D1_XTAG_IDX] ^= 0xff;
+	errors += fail_if_true( xc_marked( ctx, (uta_mhdr_t *) rsp->header ), "message marked by another context was taken as a response" );
+
+	while( (msg2 = (rmr_mbuf_t *) uta_ring_extract( ctx->mring )) != NULL ) {
+		rmr_free_msg( msg2 );
+	}
+	((uta_mhdr_t *) rsp->header)->mtype = htonl( rsp->mtype );
+	((uta_mhdr_t *) rsp->header)->plen = htonl( rsp->len );
+	flen = rsp->len + PAYLOAD_OFFSET( rsp->header ) + TP_HDR_LEN;
+	insert_mlen( (uint32_t) flen, rsp->tp_buf );
+	frame = (char *) tpb_alloc( flen );
+	memcpy( frame, rsp->tp_buf, flen );
+	buf2mbuf( ctx, frame, flen, -1, MFL_TPPOOL );
+	msg2 = (rmr_mbuf_t *) uta_ring_extract( ctx->mring );
+	errors += fail_if_nil( msg2, "message marked by another context was not queued" );
+	if( msg2 != NULL ) {
+		errors += fail_not_equal( strcmp( (char *) msg2->xaction, "xcall-stray" ), 0, "queued message was not the one marked by another context" );
+		rmr_free_msg( msg2 );
+	}
+
+	xc_mark( ctx, d1 );												// ours, but no call waits: a late response
+	frame = (char *) tpb_alloc( flen );
+	memcpy( frame, rsp->tp_buf, flen );
+	buf2mbuf( ctx, frame, flen, -1, MFL_TPPOOL );
+	errors += fail_not_nil( uta_ring_extract( ctx->mring ), "late response to one of our automatic calls was queued" );
+	rmr_free_msg( rsp );
+
+	chute = &ctx->chutes[5];										// numbered chute takes only the response it waits for
+	rsp = rmr_alloc_msg( ctx, 128 );
+	rmr_str2xact( rsp, "xcall-2" );
+	memcpy( chute->expect, rsp->xaction, RMR_MAX_XID );
+	chute_deliver( ctx, chute, rsp );								// no call waiting; reclaimed
+	errors += fail_not_nil( chute->mbuf, "response was left in a chute with no call waiting" );
+	rsp = rmr_alloc_msg( ctx, 128 );
+	rmr_str2xact( rsp, "xcall-2" );
+	chute->state = XC_WAITING;
+	chute_deliver( ctx, chute, rsp );
+	errors += fail_not_equalp( chute->mbuf, rsp, "response was not put in the waiting call's chute" );
+	errors += fail_not_equal( chute->state, XC_DONE, "chute was not done after the response" );
+	rsp = rmr_alloc_msg( ctx, 128 );
+	rmr_str2xact( rsp, "xcall-2" );
+	chute_deliver( ctx, chute, rsp );								// second response; reclaimed
+	errors += fail_not_equal( chute->state, XC_DONE, "second response changed the chute" );
+	xc_release( &chute->state );
+	errors += fail_not_equal( chute->state, XC_FREE, "chute was not freed when the call finished" );
+	rmr_free_msg( chute->mbuf );
+	chute->mbuf = NULL;
+	while( sem_trywait( &chute->barrier ) == 0 );
+	rsp = rmr_alloc_msg( ctx, 128 );
+
+	flags = ctx->flags;
+	ctx->flags |= CFL_MTC_ENABLED;
+	msg->mtype = 1;
+	msg->sub_id = -1;
+	msg->len = 10;
+	rmr_str2xact( msg, "" );									// one is generated
+	msg = rmr_mt_call( ctx, msg, RMR_CALL_AUTO, 10 );
+	errors += fail_not_nil( msg, "automatic call with no response did not return nil" );
+	errors += fail_not_equal( errno, ETIMEDOUT, "automatic call with no response did not time out" );
+	for( i = 0; i < XC_SLOTS; i++ ) {
+		if( ctx->xcalls[i].state != XC_FREE ) {
+			errors += fail_if_true( 1, "slot was left in use after the call timed out" );
+			break;
+		}
+	}
+	ctx->flags = flags;
+
+	rmr_free_msg( rsp );
+	return errors;
+}
+
+/*
+	Timer function for the wheel test; counts expirations.
+*/
+static void tw_count( uta_ctx_t* ctx, void* data ) {
+	*((int *) data) += 1;
+}
+
+/*
+	Timing wheel: timers expire at their tick and not before, across cascades
+	from the upper levels; cancelled timers do not expire. The wheel is driven
+	directly (no thread) so the test does not depend on the clock. Then a live
+	timer on the context's wheel.
+*/
+static int tw_test( uta_ctx_t* ctx ) {
+	timing_wheel_t*	tw;
+	tw_timer_t		timers[5];
+	uint64_t		ticks[5] = { 5, 100, 5000, 300000, 20000000 };	// levels 0, 1, 2, 3, and clamped
+	int				fired[5];
+	int				count = 0;
+	int				errors = 0;
+	int				i;
+
+	tw = (timing_wheel_t *) malloc( sizeof( *tw ) );
+	memset( tw, 0, sizeof( *tw ) );
+	memset( timers, 0, sizeof( timers ) );
+	pthread_mutex_init( &tw->gate, NULL );
+	tw->ctx = ctx;
+	for( i = 0; i < 5; i++ ) {
+		fired[i] = 0;
+		timers[i].fn = tw_count;
+		timers[i].data = &fired[i];
+		timers[i].tick = ticks[i];
+		tw_link( tw, &timers[i] );
+		tw->count++;
+	}
+	errors += fail_not_equal( (int) timers[4].tick, (1 << (TW_BITS * TW_LEVELS)) - 1, "timer beyond the wheel was not clamped" );
+
+	pthread_mutex_lock( &tw->gate );
+	tw_advance( tw, 4 );
+	errors += fail_not_equal( fired[0], 0, "timer expired before its tick" );
+	tw_advance( tw, 5 );
+	errors += fail_not_equal( fired[0], 1, "level 0 timer did not expire at its tick" );
+	tw_advance( tw, 99 );
+	errors += fail_not_equal( fired[1], 0, "level 1 timer expired before its tick" );
+	tw_advance( tw, 100 );
+	errors += fail_not_equal( fired[1], 1, "level 1 timer did not expire at its tick" );
+
+	tw_unlink( tw, &timers[3] );									// cancel the level 3 timer
+	tw->count--;
+	errors += fail_if_true( timers[3].armed, "cancelled timer was still armed" );
+
+	tw_advance( tw, 4999 );
+	errors += fail_not_equal( fired[2], 0, "level 2 timer expired before its tick" );
+	tw_advance( tw, 5000 );
+	errors += fail_not_equal( fired[2], 1, "level 2 timer did not expire at its tick" );
+	tw_advance( tw, 400000 );
+	errors += fail_not_equal( fired[3], 0, "cancelled timer expired" );
+	errors += fail_not_equal( tw->count, 1, "wheel count was wrong after expirations and a cancel" );
+	errors += fail_not_equal( (int) tw_next( tw ), 400064, "next wake was not the next cascade" );
+	pthread_mutex_unlock( &tw->gate );
+	free( tw );
+
+	memset( timers, 0, sizeof( timers ) );							// live wheel
+	errors += fail_if_false( tw_arm( ctx, &timers[0], sr_now_ns( ) + 2000000, tw_count, &count ), "timer was not armed" );
+	errors += fail_if_false( tw_arm( ctx, &timers[1], sr_now_ns( ) + 60000000000ULL, tw_count, &count ), "far timer was not armed" );
+	for( i = 0; i < 200 && count == 0; i++ ) {
+		usleep( 1000 );
+	}
+	errors += fail_not_equal( count, 1, "live timer did not expire" );
+	errors += fail_if_false( tw_cancel( ctx, &timers[1] ), "cancel of an armed timer did not report it armed" );
+	errors += fail_if_true( tw_cancel( ctx, &timers[0] ), "cancel of an expired timer reported it armed" );
+
+	return errors;
+}
+
+/*
+	Asynchronous call completion callback; counts completions and keeps the last state.
+*/
+static int acall_ncb = 0;
+static int acall_state = -1;
+
+static void acall_cb( void* vctx, rmr_mbuf_t* msg, void* arg ) {
+	*((int *) arg) += 1;
+	acall_state = msg->state;
+	acall_ncb++;
+	rmr_free_msg( msg );
+}
+
+/*
+	Asynchronous calls: completion through the completion ring and through a
+	callback, and the timeout.
+*/
+static int acall_test( uta_ctx_t* ctx ) {
+	rmr_mbuf_t*	msg;
+	rmr_mbuf_t*	rsp;
+	int		errors = 0;
+	int		flags;
+	int		state;
+	int		arg = 0;
+	int		i;
+
+	acall_ncb = 0;
+	acall_state = -1;
+	errors += fail_not_equal( rmr_call_async( NULL, NULL, 10, NULL, NULL ), RMR_ERR_BADARG, "async call with nil context was accepted" );
+
+	msg = rmr_alloc_msg( ctx, 128 );
+	msg->mtype = 1;
+	msg->sub_id = -1;
+	msg->len = 10;
+
+	flags = ctx->flags;
+	ctx->flags &= ~CFL_MTC_ENABLED;
+	errors += fail_not_equal( rmr_call_async( ctx, msg, 10, NULL, NULL ), RMR_ERR_NOTSUPP, "async call without the threaded receiver was accepted" );
+	ctx->flags |= CFL_MTC_ENABLED;
+
+	errors += fail_if_true( rmr_get_call_cfd( ctx ) < 0, "completion fd was not returned" );
+	errors += fail_not_nil( rmr_call_complete( ctx ), "completion returned with no call made" );
+
+	rmr_str2xact( msg, "acall-1" );
+	state = rmr_call_async( ctx, msg, 0, NULL, NULL );				// no timeout
+	errors += fail_not_equal( state, RMR_OK, "async call was not sent" );
+	errors += fail_not_equal( ctx->acall->npending, 1, "async call was not pending after the send" );
+
+	rsp = rmr_alloc_msg( ctx, 128 );
+	rmr_str2xact( rsp, "acall-1" );
+	errors += fail_if_false( xc_deliver( ctx, rsp ), "response was not matched to the async call" );
+	errors += fail_if_true( xc_deliver( ctx, rsp ), "second response to one async call was matched" );
+	errors += fail_not_equal( ctx->acall->npending, 0, "async call was still pending after the response" );
+	msg = rmr_call_complete( ctx );
+	errors += fail_not_equalp( msg, rsp, "completion was not the response" );
+	errors += fail_not_nil( rmr_call_complete( ctx ), "one call completed twice" );
+	if( msg == NULL ) {
+		msg = rmr_alloc_msg( ctx, 128 );
+	}
+
+	msg->mtype = 1;
+	msg->sub_id = -1;
+	rmr_str2xact( msg, "" );										// one is generated
+	state = rmr_call_async( ctx, msg, 10, acall_cb, &arg );
+	errors += fail_not_equal( state, RMR_OK, "async call with a callback was not sent" );
+	for( i = 0; i < 200 && acall_ncb == 0; i++ ) {					// timeout thread completes it
+		usleep( 5000 );
+	}
+	errors += fail_not_equal( acall_state, RMR_ERR_TIMEOUT, "async call timed out without a timeout state" );
+	errors += fail_not_equal( arg, 1, "callback was not given the call's argument" );
+	for( i = 0; i < XC_SLOTS; i++ ) {
+		if( ctx->xcalls[i].state != XC_FREE ) {
+			errors += fail_if_true( 1, "slot was left in use after the async call timed out" );
+			break;
+		}
+	}
+
+	msg = rmr_alloc_msg( ctx, 128 );
+	msg->mtype = 99;												// no route; not sent and still ours
+	msg->sub_id = -1;
+	state = rmr_call_async( ctx, msg, 10, NULL, NULL );
+	errors += fail_if_true( state == RMR_OK, "async call with no route reported success" );
+	errors += fail_not_equal( ctx->acall->npending, 0, "failed async call was left pending" );
+	rmr_free_msg( msg );
+
+	ctx->flags = flags;
+	return errors;
+}
+
+/*
+	Endpoint selection policies from the route table (see test_gen_rt.c).
+*/
+static int lb_test( uta_ctx_t* ctx ) {
+	route_table_t*	rt;
+	rtable_ent_t*	rte;
+	rrgroup_t*		rrg;
+	endpoint_t*		first = NULL;
+	endpoint_t*		ep;
+	int		errors = 0;
+	int		i;
+
+	rt = get_rt( ctx );
+	rte = uta_get_rte( rt, -1, 8, TRUE );							// %wrr with 3:1 weights
+	errors += fail_if_nil( rte, "no route table entry for the weighted group" );
+	if( rte != NULL && (rrg = rte->rrgroups[0]) != NULL ) {
+		errors += fail_not_equal( rrg->policy, RRG_WRR, "weighted group did not have the wrr policy" );
+		errors += fail_not_equal( rrg->nsched, 4, "weighted group schedule was not the sum of the weights" );
+		if( rrg->nsched == 4 ) {
+			errors += fail_if_true( rrg->sched[0] == rrg->sched[1] && rrg->sched[1] == rrg->sched[2], "weighted schedule was not smooth" );
+		}
+	}
+	rte = uta_get_rte( rt, -1, 11, TRUE );							// bad weight is ignored
+	errors += fail_if_nil( rte, "no route table entry for the group with a bad weight" );
+	if( rte != NULL && (rrg = rte->rrgroups[0]) != NULL ) {
+		errors += fail_not_equal( rrg->nsched, 1, "bad weight was not taken as 1" );
+	}
+	release_rt( ctx, rt );
+
+	errors += fail_not_equal( lb_picks( ctx, 8, 40, &first ), 30, "weighted group did not pick the heavy endpoint three times in four" );
+	errors += fail_not_equal( lb_picks( ctx, 0, 40, &first ), 20, "round robin group did not pick each endpoint in turn" );
+
+	i = lb_picks( ctx, 9, 40, &first );							// %lo; nothing queued, so the rotating start spreads them
+	errors += fail_not_equal( i, 20, "least outstanding group did not spread picks among idle endpoints" );
+	first->fail_streak = 3;											// first endpoint's sends failing; all go to the other
+	errors += fail_not_equal( lb_picks( ctx, 9, 40, &first ), 0, "least outstanding group picked the failing endpoint" );
+	first->fail_streak = 0;
+
+	i = lb_picks( ctx, 10, 400, &first );							// %p2c; two endpoints so every pick compares both
+	errors += fail_if_true( i < 100 || i > 300, "power of two group did not spread picks among idle endpoints" );
+	first->fail_streak = 1;
+	errors += fail_not_equal( lb_picks( ctx, 10, 40, &first ), 0, "power of two group picked the failing endpoint" );
+	first->fail_streak = 0;
+
+	ep = first;
+	errors += fail_not_equal( lb_load( ep ), 0, "idle endpoint had a load" );
+	ep->fail_streak = 1000;
+	errors += fail_not_equal( lb_load( ep ), (long) LB_MAX_STREAK * LB_FAIL_COST, "failure penalty was not capped" );
+	ep->fail_streak = 0;
+
+	errors += hash_test( ctx );
+
+	return errors;
+}
+
 static int rmr_api_test( ) {
 	int		errors = 0;
 	void*	rmc;				// route manager context
@@ -102,6 +639,9 @@ static int rmr_api_test( ) {
 	void*	p;					// generic pointer to test return value
 	int		state;
 	int		max_tries;			// prevent a sticking in any loop
+	int		fstates[RMR_MAX_FANOUT];	// per destination fan-out states
+	struct iovec	iov[RMR_MAX_IOV+1];	// user buffers for gathering sends
+	as_req_t*	as_req;				// async send request queued by hand for the close test
 	uta_ctx_t* ctx;
 
 	v = rmr_ready( NULL );
@@ -133,6 +673,18 @@ static int rmr_api_test( ) {
 	errors += fail_if_equal( v, 0, "source name smells when removed from environment (see previous info)" );
 	free_ctx( rmc2 );			// attempt to reduce leak check errors
 
+	setenv( "RMR_BATCH_BYTES", "2048", 1 );								// both batch settings must reach the context
+	setenv( "RMR_BATCH_US", "750", 1 );
+	if( (rmc2 = rmr_init( ":6791", 1024, FL_NOTHREAD )) == NULL ) {
+		errors += fail_if_nil( rmc2, "rmr_init returned a nil pointer with batching set in the environment" );
+	} else {
+		errors += fail_not_equal( ((uta_ctx_t *) rmc2)->bat_bytes, 2048, "batch size not set from environment variable" );
+		errors += fail_not_equal( ((uta_ctx_t *) rmc2)->bat_us, 750, "batch latency budget not set from environment variable" );
+		rmr_close( rmc2 );												// flusher thread stops; context is not freed under it
+	}
+	unsetenv( "RMR_BATCH_BYTES" );
+	unsetenv( "RMR_BATCH_US" );
+
 	v = rmr_ready( rmc );		// unknown return; not checking at the moment
 
 	msg = rmr_alloc_msg( NULL,  1024 );									// should return nil pointer
@@ -204,6 +756,12 @@ static int rmr_api_test( ) {
 	msg = rmr_alloc_msg( rmc, 2048 );				// get a buffer with a transport header
 	msg->len = 500;
 	msg->mtype = 1;
+
+	errors += lb_test( (uta_ctx_t *) rmc );
+	errors += hedge_test( (uta_ctx_t *) rmc );
+	errors += xcall_test( (uta_ctx_t *) rmc );
+	errors += acall_test( (uta_ctx_t *) rmc );
+	errors += tw_test( (uta_ctx_t *) rmc );
 	msg->state = 999;
 	msg->tp_state = 999;
 	errno = 999;
@@ -219,6 +777,82 @@ static int rmr_api_test( ) {
 		errors += fail_if( msg->tp_state == 999, "send_msg did not set tp_state (2)" );
 	}
 
+	// ---- mtype 1 has two round robin groups; the one buffer is sent to both ------
+	v = rmr_get_fanout_status( rmc, fstates, RMR_MAX_FANOUT );
+	errors += fail_not_equal( v, 2, "fanout status did not report (a) two destinations (b) for a two group send" );
+	if( v == 2 ) {
+		errors += fail_not_equal( fstates[0], RMR_OK, "fanout status for the first group was not ok" );
+		errors += fail_not_equal( fstates[1], RMR_OK, "fanout status for the second group was not ok" );
+	}
+	fstates[1] = 999;
+	v = rmr_get_fanout_status( rmc, fstates, 1 );
+	errors += fail_not_equal( v, 2, "fanout status with short array did not report the number of destinations" );
+	errors += fail_not_equal( fstates[1], 999, "fanout status copied more states than allowed" );
+	errors += fail_if( rmr_get_fanout_status( NULL, fstates, 1 ) >= 0, "fanout status with nil context did not fail" );
+	errors += fail_if( rmr_get_fanout_status( rmc, NULL, 1 ) >= 0, "fanout status with nil state array did not fail" );
+	errors += fail_not_equal( rmr_get_fanout_status( rmc, NULL, 0 ), 2, "fanout status with no array did not return count" );
+
+	// ---- gathering send; the payload is in user buffers and the message is just a template ----
+	iov[0].iov_base = "Boomer Sooner ";
+	iov[0].iov_len = 14;
+	iov[1].iov_base = "from user memory";
+	iov[1].iov_len = 17;											// include the nil for the receive check
+	msg->mtype = 1;
+	msg->sub_id = -1;
+	msg->len = 9999;
+	msg2 = rmr_send_iov( rmc, msg, iov, 2 );
+	errors += fail_not_equalp( msg2, msg, "send iov did not return the template message" );
+	errors += fail_not_equal( msg->state, RMR_OK, "send iov returned bad state for a send that should work" );
+	errors += fail_not_equal( msg->len, 31, "send iov did not set msg len (a) to the user buffer total (b)" );
+	errors += fail_not_equal( rmr_get_fanout_status( rmc, NULL, 0 ), 2, "send iov did not go to both groups" );
+
+	errors += fail_if_true( em_sendv_len < 31, "send iov frame was too short" );
+	if( em_sendv_len >= 31 ) {
+		errors += fail_not_equal( memcmp( em_sendv_last + em_sendv_len - 31, "Boomer Sooner from user memory", 31 ), 0, "send iov frame did not end with the user buffers" );
+		errors += fail_not_equal( em_sendv_len, 31 + PAYLOAD_OFFSET( msg->header ) + TP_HDR_LEN, "send iov frame length (a) not headers plus user buffers (b)" );
+	}
+
+	errors += fail_not_nil( rmr_send_iov( rmc, NULL, iov, 2 ), "send iov with nil message did not return nil" );
+	rmr_send_iov( NULL, msg, iov, 2 );
+	errors += fail_not_equal( msg->state, RMR_ERR_BADARG, "send iov with nil context did not return bad arg" );
+	rmr_send_iov( rmc, msg, NULL, 2 );
+	errors += fail_not_equal( msg->state, RMR_ERR_BADARG, "send iov with nil iov did not return bad arg" );
+	rmr_send_iov( rmc, msg, iov, 0 );
+	errors += fail_not_equal( msg->state, RMR_ERR_BADARG, "send iov with no buffers did not return bad arg" );
+	rmr_send_iov( rmc, msg, iov, RMR_MAX_IOV + 1 );
+	errors += fail_not_equal( msg->state, RMR_ERR_BADARG, "send iov with too many buffers did not return bad arg" );
+	msg->len = 500;
+
+	// ---- mtype 7 has a broadcast group of three, then a round robin group; the frame goes to all four ------
+	msg->mtype = 7;
+	msg->sub_id = -1;
+	v = em_sendt_count;
+	msg = rmr_send_msg( rmc, msg );
+	errors += fail_not_equal( msg->state, RMR_OK, "send to broadcast group did not return ok" );
+	errors += fail_not_equal( em_sendt_count - v, 4, "send to broadcast group was not written (a) to every member and the rr group (b)" );
+	v = rmr_get_fanout_status( rmc, fstates, RMR_MAX_FANOUT );
+	errors += fail_not_equal( v, 4, "fanout status did not report (a) every broadcast member and the rr group (b)" );
+	if( v == 4 ) {
+		errors += fail_not_equal( fstates[0] + fstates[1] + fstates[2] + fstates[3], RMR_OK, "fanout status had a failed broadcast send" );
+	}
+
+	em_send_blocks = 1;												// first member blocked on the first pass; written on the next
+	v = em_sendt_count;
+	msg->mtype = 7;
+	msg->len = 500;
+	msg = rmr_send_msg( rmc, msg );
+	errors += fail_not_equal( msg->state, RMR_OK, "send to broadcast group with a blocked member did not return ok" );
+	errors += fail_not_equal( em_sendt_count - v, 4, "blocked broadcast member was not written on the next pass" );
+	em_send_blocks = 0;
+
+	msg->mtype = 7;													// payload in user buffers
+	msg2 = rmr_send_iov( rmc, msg, iov, 2 );
+	errors += fail_not_equalp( msg2, msg, "send iov to broadcast group did not return the template message" );
+	errors += fail_not_equal( msg->state, RMR_OK, "send iov to broadcast group did not return ok" );
+	errors += fail_not_equal( rmr_get_fanout_status( rmc, NULL, 0 ), 4, "send iov did not go to every broadcast member" );
+	msg->len = 500;
+	msg->mtype = 1;
+
 	rmr_set_stimeout( NULL, 0 );		// not supported, but funciton exists, so drive away
 	rmr_set_stimeout( rmc, 20 );
 	rmr_set_stimeout( rmc, -1 );
@@ -277,9 +911,28 @@ static int rmr_api_test( ) {
 	em_send_failures = 0;
 
 
-	((uta_ctx_t *)rmc)->shutdown = 1;
+	// ---- close must write async sends which it drains into a batch -----------------------------------------
+	errors += fail_not_equal( rmr_set_batch( rmc, 4096, 10000000 ), RMR_OK, "set batch before close did not return ok" );	// long budget; nothing goes on time
+	errors += fail_if_true( rmr_get_send_cfd( rmc ) < 0, "send completion fd was not returned before close" );
+	as_stop( (uta_ctx_t *) rmc );															// park the offload thread so that close must drain the request
+	msg = rmr_alloc_msg( rmc, 128 );
+	msg->mtype = 6;												// a single endpoint
+	msg->len = 10;
+	as_req = (as_req_t *) uta_ring_extract( ((uta_ctx_t *) rmc)->asend->free );
+	as_req->msg = msg;
+	as_req->cb = NULL;
+	uta_ring_insert( ((uta_ctx_t *) rmc)->asend->sq, as_req );
+	v = em_sendt_count;
+
 	rmr_close( NULL );			// drive for coverage
-	rmr_close( rmc );			// no return to check; drive for coverage
+	rmr_close( rmc );
+	errors += fail_not_equal( em_sendt_count - v, 1, "async send drained into a batch by close was not written" );
+	msg = rmr_send_complete( rmc );
+	errors += fail_if_nil( msg, "completion for async send drained by close was not queued" );
+	if( msg ) {
+		errors += fail_not_equal( msg->state, RMR_OK, "async send drained by close did not report ok" );
+		rmr_free_msg( msg );
+	}
 
 
 	// ----- mt_rcv edge cases -------------------------------------------------------------------------------------
@@ -328,7 +981,7 @@ static int rmr_api_test( ) {
 	ctx = mk_dummy_ctx();
 	ctx->river_hash = rmr_sym_alloc( 129 );
 
-	buf2mbuf( NULL, NULL, 0, 0 );								// things in mt_call_si_static
+	buf2mbuf( NULL, NULL, 0, 0, 0 );								// things in mt_call_si_static
 
 	state = mt_data_cb( NULL, 0, "123", 3 );
 	errors += fail_not_equal( state, 0, "mt_data_cb didn't respond correctly when ctx is nil" );
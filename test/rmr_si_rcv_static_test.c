@@ -167,6 +167,43 @@ static int rmr_rcv_test( ) {
 	errors += fail_not_equal( msg->state, 0, "rts_msg did not return a good state (a) when expected" );
 	errors += fail_not_equal( errno, 0, "rmr_rts_msg did not reset errno (a) expected (b)"  );
 
+	// ---- rts endpoint cache ---------------------------------------------------------
+	max_tries = 20;
+	while( max_tries-- > 0 && (msg = rmr_torcv_msg( rmc, msg, 10 )) != NULL && msg->state == RMR_OK );	// drain what was queued before the rts
+	send_n_msgs( rmc, 1 );
+	msg = rmr_rcv_msg( rmc, msg );
+	errors += fail_if_nil( msg, "receive for rts cache test returned nil" );
+	if( msg && msg->rts_fd >= 0 && msg->rts_fd < ((uta_ctx_t *) rmc)->nrivers ) {
+		river_t*	river;
+		endpoint_t	fake;
+
+		river = &((uta_ctx_t *) rmc)->rivers[msg->rts_fd];
+		errors += fail_if_nil( river->rts_ep, "rts did not remember the endpoint for the connection" );
+
+		memset( &fake, 0, sizeof( fake ) );								// a matching endpoint must be used without a lookup
+		fake.name = (char *) ((uta_mhdr_t *) msg->header)->src;
+		fake.open = 1;
+		fake.nn_sock = 3;
+		river->rts_ep = &fake;
+		msg = rmr_rts_msg( rmc, msg );
+		errors += fail_not_equal( msg->state, RMR_OK, "rts using the cached endpoint did not return ok state" );
+		errors += fail_not_equal( (int) fake.scounts[EPSC_GOOD], 1, "rts did not send to the cached endpoint" );
+
+		send_n_msgs( rmc, 1 );
+		msg = rmr_rcv_msg( rmc, msg );
+		if( msg ) {
+			fake.name = "not-the-sender:4560";								// fd reused by another sender; must not be used
+			river->rts_ep = &fake;
+			msg = rmr_rts_msg( rmc, msg );
+			errors += fail_not_equal( msg->state, RMR_OK, "rts with a mismatched cached endpoint did not return ok state" );
+			errors += fail_not_equal( (int) fake.scounts[EPSC_GOOD], 1, "rts sent to a cached endpoint whose name did not match" );
+			errors += fail_if_true( river->rts_ep == &fake, "rts did not replace a cached endpoint whose name did not match" );
+		}
+		if( river->rts_ep == &fake ) {
+			river->rts_ep = NULL;											// never leave the stack endpoint cached
+		}
+	}
+
 	msg->state = 0;
 	msg = rmr_call( NULL, msg );
 	errors += fail_if( msg->state == 0, "rmr_call did not set message state when given message with nil context "  );
@@ -89,6 +89,10 @@ static void gen_rt( uta_ctx_t* ctx );		// defined in sr_si_static_test, but used
 #include "sr_si_static_test.c"
 #include "lg_buf_static_test.c"
 #include "alarm_static_test.c"
+#include "tpb_si_static_test.c"
+#include "mbp_si_static_test.c"
+#include "shard_si_static_test.c"
+#include "dispatch_si_static_test.c"
 // do NOT include the receive test static must be stand alone
 
 #include "rmr_si_api_static_test.c"
@@ -139,6 +143,22 @@ int main() {
 	fprintf( stderr, "<INFO> error count: %d\n", errors );
 
 
+	fprintf( stderr, "\n<INFO> starting transport buffer pool tests\n" );
+	errors += tpb_test();
+	fprintf( stderr, "<INFO> error count: %d\n", errors );
+
+	fprintf( stderr, "\n<INFO> starting mbuf recycling tests\n" );
+	errors += mbp_test();
+	fprintf( stderr, "<INFO> error count: %d\n", errors );
+
+	fprintf( stderr, "\n<INFO> starting receive shard tests\n" );
+	errors += shard_test();
+	fprintf( stderr, "<INFO> error count: %d\n", errors );
+
+	fprintf( stderr, "\n<INFO> starting dispatcher tests\n" );
+	errors += dispatch_test();
+	fprintf( stderr, "<INFO> error count: %d\n", errors );
+
 	fprintf( stderr, "\n<INFO> starting RMr API tests\n" );
 	errors += rmr_api_test();
 
@@ -119,6 +119,127 @@ static int lg_clone_test( ) {
 	return errors;
 }
 
+/*
+	Thread which waits for the readers of the context's old table to finish.
+	Sets the flag when the wait returns.
+*/
+static int rt_quiesced = 0;
+static void* rt_quiesce_th( void* vctx ) {
+	uta_ctx_t*	ctx;
+
+	ctx = (uta_ctx_t *) vctx;
+	rt_quiesce( ctx, ctx->rt_retire );
+	__atomic_store_n( &rt_quiesced, 1, __ATOMIC_RELEASE );
+
+	return NULL;
+}
+
+/*
+	Exercise the lock free readers: get_rt()/release_rt() pin and unpin an
+	epoch, nested pins hold the outer epoch, and the wait for readers of an old
+	table blocks until a reader pinned before the roll releases.
+*/
+static int rt_epoch_test( ) {
+	int		errors = 0;
+	uta_ctx_t*	ctx;
+	route_table_t*	rt1;
+	route_table_t*	rt2;
+	route_table_t*	p;
+	rt_reader_t*	r;
+	pthread_t	th;
+	uint64_t	pinned;
+
+	ctx = mk_dummy_ctx();
+	errors += fail_not_nil( get_rt( ctx ), "get_rt returned a table before one was rolled in" );
+
+	ctx->new_rtable = rt1 = uta_rt_init( ctx );
+	roll_tables( ctx );
+	errors += fail_if_false( ctx->rtable == rt1, "first roll did not make the new table active" );
+	errors += fail_not_nil( ctx->old_rtable, "first roll left an old table" );
+
+	p = get_rt( ctx );
+	errors += fail_if_false( p == rt1, "get_rt did not return the active table" );
+	r = ctx->rt_readers;
+	errors += fail_if_nil( r, "get_rt did not add a reader record" );
+	if( r == NULL ) {
+		return errors;
+	}
+	pinned = r->epoch;
+	errors += fail_if_equal( (int) pinned, 0, "get_rt did not pin an epoch" );
+
+	get_rt( ctx );														// nested; outer epoch must stand
+	errors += fail_not_equal( r->depth, 2, "nested get_rt did not bump depth" );
+	ctx->new_rtable = rt2 = uta_rt_init( ctx );
+	roll_tables( ctx );
+	errors += fail_if_false( ctx->old_rtable == rt1, "second roll did not move active table to old" );
+	errors += fail_if_false( get_rt( ctx ) == rt2, "get_rt after roll did not return the new table" );
+	errors += fail_if_false( r->epoch == pinned, "nested get_rt changed the pinned epoch" );
+	release_rt( ctx, rt2 );
+	release_rt( ctx, rt1 );
+	errors += fail_not_equal( r->depth, 1, "release_rt did not drop depth" );
+	errors += fail_if_equal( (int) r->epoch, 0, "inner release_rt unpinned the epoch" );
+	errors += fail_if_nil( ctx->rt_readers, "reader list empty" );
+	errors += fail_not_nil( ctx->rt_readers->next, "second reader record added for the same thread" );
+
+	rt_quiesced = 0;
+	pthread_create( &th, NULL, rt_quiesce_th, ctx );
+	usleep( 50000 );
+	errors += fail_if_true( __atomic_load_n( &rt_quiesced, __ATOMIC_ACQUIRE ), "quiesce returned while a reader held the old table" );
+	release_rt( ctx, rt1 );
+	errors += fail_not_equal( (int) r->epoch, 0, "outer release_rt did not unpin the epoch" );
+	pthread_join( th, NULL );
+	errors += fail_if_false( rt_quiesced, "quiesce did not return once the reader released" );
+
+	release_rt( ctx, rt1 );												// unbalanced; must be ignored
+	errors += fail_not_equal( r->depth, 0, "unbalanced release_rt drove depth negative" );
+
+	p = get_rt( ctx );													// pinned after the roll; must not hold up the old table
+	rt_quiesce( ctx, ctx->rt_retire );
+	release_rt( ctx, p );
+
+	uta_rt_drop( rt1 );
+	return errors;
+}
+
+/*
+	A weighted member which is one of our own addresses must be pruned from the
+	group; the weight suffix must not hide it.
+*/
+static int rt_weight_test( ) {
+	int		errors = 0;
+	uta_ctx_t*	ctx;
+	if_addrs_t	myips;
+	char*		addrs[1];
+	char		ts_field[32];
+	char		rr_field[128];
+	rtable_ent_t*	rte;
+	rrgroup_t*	rrg;
+
+	ctx = mk_dummy_ctx();
+	ctx->my_name = strdup( "my_host_name:4560" );
+	addrs[0] = "10.9.8.7:4560";
+	myips.addrs = addrs;
+	myips.naddrs = 1;
+	ctx->ip_list = &myips;
+
+	ctx->new_rtable = uta_rt_init( ctx );
+	snprintf( ts_field, sizeof( ts_field ), "99" );
+	snprintf( rr_field, sizeof( rr_field ), "%%wrr,10.9.8.7:4560=3,localhost:4562=2" );
+	build_entry( ctx, ts_field, 0, rr_field, 0 );
+
+	rte = uta_get_rte( ctx->new_rtable, 0, 99, FALSE );
+	errors += fail_if_nil( rte, "no route table entry for the weighted group with our address" );
+	if( rte != NULL && (rrg = rte->rrgroups[0]) != NULL ) {
+		errors += fail_not_equal( rrg->nused, 1, "our own weighted address was not pruned from the group" );
+		errors += fail_not_equal( rrg->nsched, 2, "group schedule was not the weight of the remaining member" );
+	}
+
+	uta_rt_drop( ctx->new_rtable );
+	ctx->new_rtable = NULL;
+	ctx->ip_list = NULL;
+	return errors;
+}
+
 /*
 	This is the main route table test. It sets up a very specific table
 	for testing (not via the generic setup function for other test
@@ -713,6 +834,8 @@ static int rt_test( ) {
 
 	// ------ specific edge case tests -------------------------------------------------------------------------------
 	errors += lg_clone_test( );
+	errors += rt_epoch_test( );
+	errors += rt_weight_test( );
 
 	unlink( ".ut_rmr_verbose" );
 
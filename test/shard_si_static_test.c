@@ -0,0 +1,187 @@
+// : vi ts=4 sw=4 noet :
+/*
+==================================================================================
+	    Copyright (c) 2020-2026 Nokia
+	    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mmemonic:	shard_si_static_test.c
+	Abstract:	Tests for the key affine receive sharding functions. Messages
+				are pushed through queue_normal() as the receive thread would
+				and pulled from the shards with the user API.
+
+	Date:		18 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "rmr.h"
+#include "rmr_agnostic.h"
+
+/*
+	Make a message with the meid, xid and a sequence number in the payload.
+*/
+static rmr_mbuf_t* mk_shard_msg( char* meid, char* xid, int mtype, int sid, int seq ) {
+	rmr_mbuf_t*	mbuf;
+
+	mbuf = mk_populated_msg( 64, 0, mtype, sid, sizeof( int ) );
+	rmr_str2meid( mbuf, (unsigned char *) meid );
+	rmr_str2xact( mbuf, (unsigned char *) xid );
+	memcpy( mbuf->payload, &seq, sizeof( seq ) );
+
+	return mbuf;
+}
+
+static int shard_test( ) {
+	int			errors = 0;
+	uta_ctx_t*	ctx;
+	rmr_mbuf_t*	mbuf;
+	rmr_mbuf_t*	mbuf2;
+	int			i;
+	int			seq;
+	int			shard;
+	int			other;
+	int			fd;
+	int			in_order = 1;
+
+	ctx = mk_dummy_ctx();
+	ctx->chutes = (chute_t *) malloc( sizeof( chute_t ) );
+	sem_init( &ctx->chutes[0].barrier, 0, 0 );
+
+	// ---- api argument checks -----------------------------------------------
+	errors += fail_not_equal( rmr_set_shards( NULL, 4, RMR_SHARD_MEID ), RMR_ERR_BADARG, "set shards with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_set_shards( ctx, 0, RMR_SHARD_MEID ), RMR_ERR_BADARG, "set shards with 0 shards did not return bad arg" );
+	errors += fail_not_equal( rmr_set_shards( ctx, RMR_MAX_SHARDS+1, RMR_SHARD_MEID ), RMR_ERR_BADARG, "set shards with too many shards did not return bad arg" );
+	errors += fail_not_equal( rmr_set_shards( ctx, 4, 0 ), RMR_ERR_BADARG, "set shards with bad key type did not return bad arg" );
+	errors += fail_not_equal( rmr_set_shards( ctx, 4, RMR_SHARD_MTYPE+1 ), RMR_ERR_BADARG, "set shards with large key type did not return bad arg" );
+	errors += fail_not_equal( rmr_get_shard_rcvfd( ctx, 0 ), -1, "get shard fd before shards set did not return -1" );
+	errors += fail_not_equal( rmr_get_shard_rcvfd( NULL, 0 ), -1, "get shard fd with nil context did not return -1" );
+
+	mbuf = rmr_shard_rcv( NULL, 0, NULL, 0 );
+	errors += fail_not_nil( mbuf, "shard receive with nil context and nil mbuf did not return nil" );
+	mbuf = mk_shard_msg( "meid", "xid", 1, 1, 0 );
+	mbuf = rmr_shard_rcv( ctx, 0, mbuf, 0 );						// shards not set is a bad shard number
+	errors += fail_if_nil( mbuf, "shard receive with bad shard did not return the buffer" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_ERR_BADARG, "shard receive with bad shard did not set state" );
+		rmr_free_msg( mbuf );
+	}
+
+	// ---- unsharded queuing still tickles the chute ------------------------
+	queue_normal( ctx, mk_shard_msg( "meid", "xid", 1, 1, 0 ) );
+	errors += fail_if_equal( sem_trywait( &ctx->chutes[0].barrier ), -1, "queue normal without shards did not post to the chute" );
+	mbuf = (rmr_mbuf_t *) uta_ring_extract( ctx->mring );
+	errors += fail_if_nil( mbuf, "queue normal without shards did not queue on the message ring" );
+	if( mbuf ) {
+		rmr_free_msg( mbuf );
+	}
+
+	// ---- sharded by meid ---------------------------------------------------
+	errors += fail_not_equal( rmr_set_shards( ctx, 4, RMR_SHARD_MEID ), RMR_OK, "set shards with good parms did not return ok" );
+	errors += fail_not_equal( ctx->nshards, 4, "number of shards in context not set" );
+	errors += fail_not_equal( rmr_set_shards( ctx, 8, RMR_SHARD_MEID ), RMR_ERR_NOTSUPP, "second set shards call did not return not supported" );
+	errors += fail_not_equal( ctx->nshards, 4, "second set shards changed the number of shards" );
+
+	fd = rmr_get_shard_rcvfd( ctx, 3 );
+	errors += fail_if_true( fd < 0, "get shard fd with good shard did not return an fd" );
+	errors += fail_not_equal( rmr_get_shard_rcvfd( ctx, 4 ), -1, "get shard fd with large shard did not return -1" );
+	errors += fail_not_equal( rmr_get_shard_rcvfd( ctx, -1 ), -1, "get shard fd with negative shard did not return -1" );
+
+	mbuf = mk_shard_msg( "gnb-1234", "xid", 1, 1, 0 );
+	shard = shard_idx( ctx, mbuf, ctx->nshards );
+	for( i = 0; i < 10; i++ ) {												// same key lands on the same shard, in order
+		queue_normal( ctx, mk_shard_msg( "gnb-1234", "xid", 1, 1, i ) );
+	}
+	rmr_free_msg( mbuf );
+	errors += fail_if_false( sem_trywait( &ctx->chutes[0].barrier ) == -1, "sharded queue posted to the chute" );
+
+	other = (shard + 1) % ctx->nshards;
+	mbuf = rmr_shard_rcv( ctx, other, NULL, 0 );
+	errors += fail_not_nil( mbuf, "receive from a different shard returned a message" );
+
+	mbuf = NULL;
+	for( i = 0; i < 10; i++ ) {
+		mbuf = rmr_shard_rcv( ctx, shard, mbuf, 0 );
+		if( mbuf == NULL || mbuf->state != RMR_OK ) {
+			in_order = 0;
+			break;
+		}
+		memcpy( &seq, mbuf->payload, sizeof( seq ) );
+		if( seq != i ) {
+			in_order = 0;
+		}
+	}
+	errors += fail_if_false( in_order, "messages with the same key were not received in order from the shard" );
+
+	mbuf = rmr_shard_rcv( ctx, shard, mbuf, 10 );							// empty with a timeout returns our buffer
+	errors += fail_if_nil( mbuf, "shard receive timeout did not return the buffer" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_ERR_TIMEOUT, "shard receive timeout did not set state" );
+		errors += fail_not_equal( mbuf->tp_state, ETIMEDOUT, "shard receive timeout did not set tp state" );
+	}
+
+	queue_normal( ctx, mk_shard_msg( "gnb-1234", "xid", 1, 1, 42 ) );
+	mbuf2 = rmr_shard_rcv( ctx, shard, mbuf, -1 );						// blocking receive with a message waiting
+	errors += fail_if_nil( mbuf2, "blocking shard receive returned nil" );
+	if( mbuf2 ) {
+		errors += fail_not_equal( mbuf2->state, RMR_OK, "blocking shard receive state not ok" );
+		rmr_free_msg( mbuf2 );
+	}
+
+	// ---- hashing of the other key types -----------------------------------
+	ctx->shard_key = RMR_SHARD_XID;
+	mbuf = mk_shard_msg( "meid-a", "ue42:1", 1, 1, 0 );
+	mbuf2 = mk_shard_msg( "meid-b", "ue42:99", 1, 1, 0 );
+	errors += fail_not_equal( shard_idx( ctx, mbuf, 64 ), shard_idx( ctx, mbuf2, 64 ), "xid prefix sharding put same prefix on different shards" );
+	rmr_free_msg( mbuf2 );
+	mbuf2 = mk_shard_msg( "meid-a", "ue43:1", 1, 1, 0 );
+	errors += fail_if_equal( shard_hash( ((uta_mhdr_t *) mbuf->header)->xid, RMR_MAX_XID, ':' ),
+			shard_hash( ((uta_mhdr_t *) mbuf2->header)->xid, RMR_MAX_XID, ':' ), "xid prefix hash of different prefixes was the same" );
+	rmr_free_msg( mbuf );
+	rmr_free_msg( mbuf2 );
+
+	ctx->shard_key = RMR_SHARD_SUBID;
+	mbuf = mk_shard_msg( "meid-a", "x", 1, 0x100, 0 );						// binary keys must not stop at a nil byte
+	mbuf2 = mk_shard_msg( "meid-a", "x", 1, 0x200, 0 );
+	errors += fail_if_equal( shard_hash( (unsigned char *) &mbuf->sub_id, sizeof( int ), -1 ),
+			shard_hash( (unsigned char *) &mbuf2->sub_id, sizeof( int ), -1 ), "sub id hash ignored bytes after a nil" );
+	errors += fail_if_true( shard_idx( ctx, mbuf, 4 ) < 0 || shard_idx( ctx, mbuf, 4 ) > 3, "sub id shard out of range" );
+	ctx->shard_key = RMR_SHARD_MTYPE;
+	errors += fail_if_true( shard_idx( ctx, mbuf, 4 ) < 0 || shard_idx( ctx, mbuf, 4 ) > 3, "mtype shard out of range" );
+	rmr_free_msg( mbuf );
+	rmr_free_msg( mbuf2 );
+
+	// ---- cleanup drains anything left queued ------------------------------
+	for( i = 0; i < 20; i++ ) {
+		queue_normal( ctx, mk_shard_msg( "x", "x", i, i, i ) );
+	}
+	free_shards( ctx );
+	errors += fail_not_nil( ctx->shards, "free shards did not clear the shard list" );
+	errors += fail_not_equal( ctx->nshards, 0, "free shards did not reset the count" );
+	free_shards( ctx );														// must be safe to call twice
+	free_shards( NULL );
+
+	return errors;
+}
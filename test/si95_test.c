@@ -108,12 +108,14 @@ static void* test_malloc( size_t n ) {
 //#include <si95/sircv.c>
 #include <si95/sisend.c>
 #include <si95/sisendt.c>
+#include <si95/sisendv.c>
 #include <si95/sishutdown.c>
 #include <si95/siterm.c>
 #include <si95/sitrash.c>
 #define malloc test_malloc
 #include <si95/siwait.c>
 #undef malloc
+#include <si95/siwritable.c>
 
 // ---------------------------------------------------------------------
 
@@ -482,6 +484,94 @@ static int send_tests( ) {
 	return errors;
 }
 
+/*
+	Gathering send tests.
+*/
+static int sendv_tests( ) {
+	int		errors = 0;
+	char	buf[1024];
+	struct iovec	iov[3];
+	struct tp_blk *tpptr;
+	int		len;
+	int		state;
+	int		fd;
+
+	tpem_set_selef_fd( -1 );					// send tests leave an exception set
+	len = snprintf( buf, 100, "Heaven knows I'm miserable now!" );
+	iov[0].iov_base = buf;
+	iov[0].iov_len = 10;
+	iov[1].iov_base = buf + 10;
+	iov[1].iov_len = 0;							// empty buffers must be skipped
+	iov[2].iov_base = buf + 10;
+	iov[2].iov_len = len - 10;
+
+	state = SIsendv( si_ctx, 9999, iov, 3 );
+	errors += fail_if_true( state >= 0, "sendv given fd out of range did not fail" );
+
+	state = SIsendv( si_ctx, -1, iov, 3 );
+	errors += fail_if_true( state >= 0, "sendv given neg fd did not fail" );
+
+	state = SIsendv( si_ctx, 6, NULL, 3 );
+	errors += fail_if_true( state >= 0, "sendv given nil iov did not fail" );
+
+	state = SIsendv( si_ctx, 6, iov, SI_MAX_IOV + 1 );
+	errors += fail_if_true( state >= 0, "sendv given too many buffers did not fail" );
+
+	tpptr = SInew( TP_BLK );					// accept a session for the rest
+	tpptr->fd = 3;
+	tpptr->flags |= TPF_LISTENFD;
+	fd = 7;
+	tpem_set_accept_fd( fd );
+	state = SInewsession( si_ctx, tpptr );
+	tpem_set_accept_fd( 6 );
+	free( tpptr );
+	errors += fail_if_true( state < 0, "sendv tests could not establish a session" );
+	if( state < 0 ) {
+		return errors;
+	}
+
+	tpem_wv_bytes = 0;
+	state = SIsendv( si_ctx, fd, iov, 3 );
+	errors += fail_not_equal( state, SI_OK, "sendv on good session did not return ok" );
+	errors += fail_not_equal( tpem_wv_bytes, len, "sendv did not write all bytes (a) expected (b)" );
+
+	tpem_wv_bytes = 0;
+	tpem_set_wv_max( 7 );						// force short writes which must be resumed mid buffer
+	state = SIsendv( si_ctx, fd, iov, 3 );
+	tpem_set_wv_max( 0 );
+	errors += fail_not_equal( state, SI_OK, "sendv with short writes did not return ok" );
+	errors += fail_not_equal( tpem_wv_bytes, len, "sendv with short writes did not write all bytes (a) expected (b)" );
+	errors += fail_not_equal( (int) iov[0].iov_len, 10, "sendv changed the caller's iovec" );
+
+	tpem_set_send_err( 99 );
+	state = SIsendv( si_ctx, fd, iov, 3 );
+	tpem_set_send_err( 0 );
+	errors += fail_not_equal( state, SI_ERROR, "sendv with write error did not return error" );
+
+	tpem_set_sel_blk( 1 );
+	state = SIsendv( si_ctx, fd, iov, 3 );
+	tpem_set_sel_blk( 0 );
+	errors += fail_not_equal( state, SI_ERR_BLOCKED, "sendv on blocked session did not return blocked" );
+
+	state = SIwritable( si_ctx, fd, 1000 );
+	errors += fail_not_equal( state, SI_OK, "writable on good session did not return ok" );
+	state = SIwritable( si_ctx, -1, 1000 );
+	errors += fail_not_equal( state, SI_ERROR, "writable given neg fd did not return error" );
+	state = SIwritable( si_ctx, 9999, 1000 );
+	errors += fail_not_equal( state, SI_ERROR, "writable given fd out of range did not return error" );
+	tpem_set_sel_blk( 1 );
+	state = SIwritable( si_ctx, fd, -1 );
+	tpem_set_sel_blk( 0 );
+	errors += fail_not_equal( state, SI_ERR_BLOCKED, "writable on blocked session did not time out" );
+	tpem_set_selef_fd( fd );
+	state = SIwritable( si_ctx, fd, 1000 );
+	errors += fail_not_equal( state, SI_ERROR, "writable on session in error did not return error" );
+
+	tpem_set_selef_fd( 6 );						// leave as send tests did
+
+	return errors;
+}
+
 
 /*
 	Wait testing.  This is tricky because we don't have any sessions and thus it's difficult
@@ -534,6 +624,7 @@ int main() {
 
 	errors += new_sess();		// should leave a "connected" session at fd == 6
 	errors += send_tests();
+	errors += sendv_tests();
 
 	errors += poll();
 	errors += wait_tests();
@@ -46,6 +46,931 @@
 #define COPY 1
 #define NO_COPY 0
 
+/*
+	Build a raw message, as it would arrive from the transport, with the header
+	flags and d2 data given. The buffer is from the pool as the receive path releases it.
+*/
+static char* mk_fc_frame( int hflags, uint32_t grant, int* len ) {
+	char*		buf;
+	uta_mhdr_t*	hdr;
+	uint32_t	glimit;
+
+	*len = TP_HDR_LEN + sizeof( uta_mhdr_t ) + sizeof( uint32_t );
+	buf = (char *) tpb_alloc( *len );
+	memset( buf, 0, *len );
+	insert_mlen( (uint32_t) *len, buf );
+
+	hdr = (uta_mhdr_t *) (buf + TP_HDR_LEN);
+	hdr->rmr_ver = htonl( RMR_MSG_VER );
+	hdr->mtype = htonl( 42 );
+	hdr->sub_id = htonl( UNSET_SUBID );
+	hdr->flags = hflags;
+	SET_HDR_LEN( hdr );
+	SET_HDR_D2_LEN( hdr, sizeof( uint32_t ) );
+	glimit = htonl( grant );
+	memcpy( DATA2_ADDR( hdr ), &glimit, sizeof( glimit ) );
+
+	return buf;
+}
+
+/*
+	Drive the credit based flow control functions. The sender side is driven by
+	giving an endpoint a grant and ensuring that send_msg() refuses to go beyond
+	it; the receiver side by opening a flow and consuming messages from it.
+*/
+static int fc_test( uta_ctx_t* sctx ) {
+	uta_ctx_t*	ctx;
+	endpoint_t*	ep;
+	rmr_mbuf_t*	mbuf;
+	char*		frame;
+	int			flen;
+	int			state;
+	int			errors = 0;
+
+	ctx = mk_dummy_ctx();
+	fd2ep_init( ctx );
+	init_mtcall( ctx );
+	ctx->nrivers = 16;
+	ctx->rivers = (river_t *) malloc( sizeof( river_t ) * ctx->nrivers );
+	memset( ctx->rivers, 0, sizeof( river_t ) * ctx->nrivers );
+
+	state = rmr_set_flow_ctl( NULL, 8 );
+	errors += fail_not_equal( state, -1, "set flow control with nil context did not return -1" );
+	state = rmr_set_flow_ctl( ctx, -1 );
+	errors += fail_not_equal( state, RMR_ERR_BADARG, "set flow control with negative window did not return bad arg" );
+	state = rmr_set_flow_ctl( ctx, 8 );
+	errors += fail_not_equal( state, RMR_OK, "set flow control with good window did not return ok" );
+	state = rmr_set_flow_ctl( ctx, 0 );
+	errors += fail_not_equal( state, RMR_ERR_BADARG, "set flow control allowed flow control to be turned off" );
+
+	// ---- sender side -------------------------------------------
+	ep = (endpoint_t *) malloc( sizeof( *ep ) );
+	memset( ep, 0, sizeof( *ep ) );
+	ep->name = "fc-test:4560";
+	pthread_mutex_init( &ep->gate, NULL );
+	fd2ep_add( ctx, 3, ep );
+
+	errors += fail_if_false( fc_take( ep ), "endpoint without a grant was limited" );
+	errors += fail_if_false( fc_take( NULL ), "nil endpoint was limited" );
+	fc_reset_ep( ep );
+
+	frame = mk_fc_frame( HFL_CTL, 2, &flen );
+	buf2mbuf( ctx, frame, flen, 3, MFL_TPPOOL );						// grant of 2 arrives on the session to ep; frame is freed
+	errors += fail_if_false( ep->fc_on, "grant frame did not turn on flow control for the endpoint" );
+	errors += fail_not_equal( (int) ep->fc_limit, 2, "grant frame did not set the limit" );
+	errors += fail_if_false( uta_ring_extract( ctx->mring ) == NULL, "control frame was queued for the application" );
+
+	frame = mk_fc_frame( HFL_CTL, 2, &flen );
+	buf2mbuf( ctx, frame, flen, 9, MFL_TPPOOL );						// grant on a session with no endpoint should be ignored
+
+	errors += fail_if_false( fc_take( ep ), "first credit was not available" );
+	errors += fail_if_false( fc_take( ep ), "second credit was not available" );
+	errors += fail_if_true( fc_take( ep ), "credit was available beyond the limit" );
+	fc_untake( ep );
+	errors += fail_if_false( fc_take( ep ), "credit returned with untake was not available" );
+
+	mbuf = rmr_alloc_msg( sctx, 128 );
+	mbuf->len = 10;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_if_nil( mbuf, "send without credit did not return the message" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_ERR_RETRY, "send without credit did not set retry state" );
+		errors += fail_not_equal( errno, EAGAIN, "send without credit did not set errno to eagain" );
+		errors += fail_if_false( ((uta_mhdr_t *) mbuf->header)->flags & HFL_FC_CAP, "send to endpoint did not advertise flow control" );
+	}
+
+	frame = mk_fc_frame( HFL_CTL, 5, &flen );				// larger grant lets the send go
+	fc_ctl_frame( ctx, (uta_mhdr_t *) (frame + TP_HDR_LEN), 3 );
+	tpb_free( frame );
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_if_nil( mbuf, "send with credit returned nil" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_OK, "send with credit did not return ok state" );
+	}
+	errors += fail_not_equal( (int) ep->fc_sent, 3, "send with credit did not consume one" );
+
+	mbuf->len = 10;
+	mbuf = send_msg( sctx, mbuf, 3, 1, NULL );				// no ep; never limited, never advertised
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_OK, "send without endpoint did not return ok state" );
+	}
+	rmr_free_msg( mbuf );
+
+	fc_reset_ep( ep );
+	errors += fail_if_true( ep->fc_on, "reset did not turn off flow control for the endpoint" );
+	errors += fail_if_false( fc_take( ep ), "endpoint was limited after reset" );
+
+	// ---- receiver side -----------------------------------------
+	frame = mk_fc_frame( HFL_FC_CAP, 0, &flen );
+	buf2mbuf( ctx, frame, flen, 5, MFL_TPPOOL );						// first capable message opens the flow with a grant
+	errors += fail_if_false( ctx->rivers[5].flags & RF_FC_ON, "capable message did not open the flow" );
+	errors += fail_not_equal( (int) ctx->rivers[5].fc_limit, 8, "initial grant was not the window" );
+
+	mbuf = uta_ring_extract( ctx->mring );
+	errors += fail_if_nil( mbuf, "capable message was not queued" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->rts_fd, 5, "queued message did not have the right rts fd" );
+		fc_consumed( ctx, mbuf );
+		errors += fail_not_equal( (int) ctx->rivers[5].fc_limit, 8, "grant was issued before a quarter of the window was used" );
+		fc_consumed( ctx, mbuf );
+		errors += fail_not_equal( (int) ctx->rivers[5].fc_limit, 10, "grant was not issued after a quarter of the window was used" );
+
+		mbuf->rts_fd = 6;									// flow not opened; nothing should change
+		fc_consumed( ctx, mbuf );
+		errors += fail_not_equal( (int) ctx->rivers[6].fc_used, 0, "consumption counted on a flow that was not opened" );
+		mbuf->rts_fd = 1000;
+		fc_consumed( ctx, mbuf );							// out of range, must not crash
+		rmr_free_msg( mbuf );
+	}
+
+	return errors;
+}
+
+/*
+	Drive the compact header functions. A message built by the sending context is
+	encoded and the resulting frame expanded as the receive thread would; the
+	expanded header must match the original. Then the negotiation is driven
+	through buf2mbuf() and a compact send is made through send_msg().
+*/
+static int ch_test( uta_ctx_t* sctx ) {
+	uta_ctx_t*	ctx;
+	endpoint_t*	ep;
+	rmr_mbuf_t*	mbuf;
+	uta_mhdr_t*	hdr;
+	uta_mhdr_t*	xhdr;
+	char		chbuf[CH_BUF_LEN];
+	char*		frame;
+	char*		xbuf;
+	int			flen;
+	int			chlen;
+	int			dlen;
+	int			ident;
+	int			tpflags;
+	int			errors = 0;
+
+	ctx = mk_dummy_ctx();
+	fd2ep_init( ctx );
+	init_mtcall( ctx );
+	ctx->nrivers = 16;
+	ctx->rivers = (river_t *) malloc( sizeof( river_t ) * ctx->nrivers );
+	memset( ctx->rivers, 0, sizeof( river_t ) * ctx->nrivers );
+
+	ep = (endpoint_t *) malloc( sizeof( *ep ) );
+	memset( ep, 0, sizeof( *ep ) );
+	ep->name = "ch-test:4560";
+	pthread_mutex_init( &ep->gate, NULL );
+	fd2ep_add( ctx, 3, ep );
+
+	mbuf = rmr_alloc_msg( sctx, 128 );
+	mbuf->mtype = 1;
+	mbuf->sub_id = 7;
+	mbuf->len = snprintf( (char *) mbuf->payload, 128, "Rambling Wreck from Georgia Tech" ) + 1;
+	rmr_str2xact( mbuf, "xid-one" );
+	rmr_str2meid( mbuf, "meid-one" );
+	hdr = (uta_mhdr_t *) mbuf->header;
+	hdr->mtype = htonl( mbuf->mtype );
+	hdr->sub_id = htonl( mbuf->sub_id );
+	hdr->plen = htonl( mbuf->len );
+	dlen = RMR_TR_LEN( hdr ) + RMR_D1_LEN( hdr ) + RMR_D2_LEN( hdr ) + mbuf->len;
+
+	// ---- encode and expand; first frame carries the identity --------------------
+	chlen = ch_encode( sctx, ep, hdr, chbuf, &ident );
+	errors += fail_if_true( chlen <= 0, "compact header encode failed" );
+	errors += fail_if_false( ident, "first compact header did not carry the identity" );
+	errors += fail_if_false( chlen < TP_HDR_LEN + (int) sizeof( uta_mhdr_t ), "compact header was not smaller than the full header" );
+
+	flen = chlen + dlen;
+	frame = (char *) tpb_alloc( flen );
+	memcpy( frame, chbuf, chlen );
+	memcpy( frame + chlen, TRACE_ADDR( hdr ), dlen );
+	tpflags = MFL_TPPOOL;
+	xbuf = ch_expand( ctx, frame, &flen, 5, &tpflags );
+	errors += fail_if_nil( xbuf, "compact frame with identity was not expanded" );
+	if( xbuf ) {
+		xhdr = (uta_mhdr_t *) (xbuf + TP_HDR_LEN);
+		errors += fail_not_equal( (int) ntohl( xhdr->rmr_ver ), RMR_MSG_VER, "expanded header did not have the current version" );
+		errors += fail_not_equal( (int) ntohl( xhdr->mtype ), 1, "expanded header did not have the right mtype" );
+		errors += fail_not_equal( (int) ntohl( xhdr->sub_id ), 7, "expanded header did not have the right sub id" );
+		errors += fail_not_equal( strcmp( (char *) xhdr->src, sctx->my_name ), 0, "expanded header did not have the sender name" );
+		errors += fail_not_equal( strcmp( (char *) xhdr->srcip, sctx->my_ip ), 0, "expanded header did not have the sender ip" );
+		errors += fail_not_equal( strcmp( (char *) xhdr->xid, "xid-one" ), 0, "expanded header did not have the xid" );
+		errors += fail_not_equal( strcmp( (char *) xhdr->meid, "meid-one" ), 0, "expanded header did not have the meid" );
+		errors += fail_not_equal( (int) RMR_HDR_LEN( xhdr ), (int) RMR_HDR_LEN( hdr ), "expanded header length not the same as the original" );
+		errors += fail_not_equal( memcmp( PAYLOAD_ADDR( xhdr ), mbuf->payload, mbuf->len ), 0, "expanded payload not the same as the original" );
+		errors += fail_not_equal( flen, TP_HDR_LEN + (int) sizeof( uta_mhdr_t ) + dlen, "expanded size not correct" );
+		errors += fail_not_equal( tpflags, MFL_TPPOOL, "expanded buffer flags not pool" );
+		tpb_free( xbuf );
+	}
+	errors += fail_if_nil( ctx->rivers[5].ch_ids[CH_SELF_ID], "identity was not interned on the connection" );
+
+	// ---- later frames carry only the id ------------------------------------------
+	ep->ch_ident = 1;
+	flen = ch_encode( sctx, ep, hdr, chbuf, &ident );
+	errors += fail_if_true( ident, "identity sent after the peer had it" );
+	errors += fail_if_false( flen < chlen, "compact header without identity was not smaller" );
+	chlen = flen;
+
+	flen = chlen + dlen;
+	frame = (char *) tpb_alloc( flen );
+	memcpy( frame, chbuf, chlen );
+	memcpy( frame + chlen, TRACE_ADDR( hdr ), dlen );
+	tpflags = MFL_TPPOOL;
+	xbuf = ch_expand( ctx, frame, &flen, 5, &tpflags );
+	errors += fail_if_nil( xbuf, "compact frame with interned identity was not expanded" );
+	if( xbuf ) {
+		xhdr = (uta_mhdr_t *) (xbuf + TP_HDR_LEN);
+		errors += fail_not_equal( strcmp( (char *) xhdr->src, sctx->my_name ), 0, "expanded header did not have the interned sender name" );
+		tpb_free( xbuf );
+	}
+
+	flen = chlen + dlen;
+	frame = (char *) tpb_alloc( flen );
+	memcpy( frame, chbuf, chlen );
+	memcpy( frame + chlen, TRACE_ADDR( hdr ), dlen );
+	tpflags = MFL_TPPOOL;
+	xbuf = ch_expand( ctx, frame, &flen, 6, &tpflags );					// identity not interned on this connection
+	errors += fail_not_nil( xbuf, "compact frame with unknown identity was expanded" );
+
+	flen = chlen + dlen - 1;												// short frame must be dropped
+	frame = (char *) tpb_alloc( flen + 1 );
+	memcpy( frame, chbuf, chlen );
+	tpflags = MFL_TPPOOL;
+	xbuf = ch_expand( ctx, frame, &flen, 5, &tpflags );
+	errors += fail_not_nil( xbuf, "truncated compact frame was expanded" );
+
+	ch_reset_river( &ctx->rivers[5] );
+	errors += fail_not_nil( ctx->rivers[5].ch_ids[CH_SELF_ID], "river reset did not drop the interned identity" );
+
+	hdr->plen = htonl( CH_MAX_PLEN + 1 );
+	errors += fail_not_equal( ch_encode( sctx, ep, hdr, chbuf, &ident ), 0, "large payload was given a compact header" );
+	hdr->plen = htonl( mbuf->len );
+
+	// ---- negotiation -------------------------------------------------------------
+	frame = mk_fc_frame( HFL_CH_CAP, 0, &flen );
+	buf2mbuf( ctx, frame, flen, 5, MFL_TPPOOL );						// offer ignored when not enabled
+	errors += fail_if_true( ctx->rivers[5].flags & RF_CH_ON, "compact header offer accepted when not enabled" );
+	rmr_free_msg( uta_ring_extract( ctx->mring ) );
+
+	ctx->ch_on = 1;
+	frame = mk_fc_frame( HFL_CH_CAP, 0, &flen );
+	buf2mbuf( ctx, frame, flen, 5, MFL_TPPOOL );
+	errors += fail_if_false( ctx->rivers[5].flags & RF_CH_ON, "compact header offer was not accepted" );
+	errors += fail_if_nil( uta_ring_extract( ctx->mring ), "message with compact header offer was not queued" );
+
+	ep->ch_on = 0;
+	frame = mk_fc_frame( HFL_CTL, 0, &flen );
+	((uta_mhdr_t *) (frame + TP_HDR_LEN))->mtype = htonl( CH_CTL_ACCEPT );
+	buf2mbuf( ctx, frame, flen, 3, MFL_TPPOOL );
+	errors += fail_if_false( ep->ch_on, "accept control frame did not enable compact headers for the endpoint" );
+	errors += fail_if_false( uta_ring_extract( ctx->mring ) == NULL, "accept control frame was queued for the application" );
+
+	ch_reset_ep( ep );
+	errors += fail_if_true( ep->ch_on || ep->ch_ident, "endpoint reset did not clear compact header state" );
+
+	// ---- compact send ------------------------------------------------------------
+	sctx->ch_on = 1;
+	ep->ch_on = 1;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_if_nil( mbuf, "compact send returned nil" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_OK, "compact send did not return ok state" );
+		rmr_free_msg( mbuf );
+	}
+	errors += fail_if_false( ep->ch_ident, "compact send with identity did not mark the endpoint" );
+	errors += fail_if_true( em_sendv_len < TP_HDR_LEN + (int) sizeof( uta_v4mhdr_t ), "compact send frame too short" );
+	if( em_sendv_len >= TP_HDR_LEN + (int) sizeof( uta_v4mhdr_t ) ) {
+		errors += fail_not_equal( (int) ntohl( ((uta_v4mhdr_t *) (em_sendv_last + TP_HDR_LEN))->rmr_ver ), RMR_CH_VER, "compact send frame did not have a compact header" );
+		errors += fail_if_false( ntohs( ((uta_v4mhdr_t *) (em_sendv_last + TP_HDR_LEN))->flags ) & HFL_CH_CAP, "compact send frame did not keep the offer" );
+	}
+	sctx->ch_on = 0;
+
+	return errors;
+}
+
+/*
+	A trivial codec for testing that a user codec is used; it flips the bits of the
+	data and so never makes it smaller, so it claims one byte less than it wrote.
+*/
+static int cz_flip( void* data, unsigned char const* src, int len, unsigned char* dest, int max ) {
+	int		i;
+
+	(*((int *) data))++;
+	if( len - 1 > max || len < 1 ) {
+		return -1;
+	}
+	for( i = 0; i < len - 1; i++ ) {
+		dest[i] = ~src[i];
+	}
+	return len - 1;
+}
+
+static int cz_unflip( void* data, unsigned char const* src, int len, unsigned char* dest, int max ) {
+	int		i;
+
+	(*((int *) data))++;
+	if( len + 1 > max ) {
+		return -1;
+	}
+	for( i = 0; i < len; i++ ) {
+		dest[i] = ~src[i];
+	}
+	dest[len] = 0;											// the byte dropped is always the terminating nil in the test
+	return len + 1;
+}
+
+/*
+	Drive the payload compression functions. The built in codec is exercised
+	directly, then a compressed send is captured and passed through buf2mbuf()
+	as the receive thread would.
+*/
+static int cz_test( uta_ctx_t* sctx ) {
+	uta_ctx_t*	ctx;
+	endpoint_t*	ep;
+	rmr_mbuf_t*	mbuf;
+	rmr_codec_t	codec;
+	unsigned char	src[4096];
+	unsigned char	cbuf[4096];
+	unsigned char	dbuf[4096];
+	char*		frame;
+	int			clen;
+	int			dlen;
+	int			calls = 0;
+	int			flen;
+	int			v;
+	int			i;
+	int			errors = 0;
+
+	ctx = mk_dummy_ctx();
+	fd2ep_init( ctx );
+	init_mtcall( ctx );
+	ctx->nrivers = 16;
+	ctx->rivers = (river_t *) malloc( sizeof( river_t ) * ctx->nrivers );
+	memset( ctx->rivers, 0, sizeof( river_t ) * ctx->nrivers );
+
+	ep = (endpoint_t *) malloc( sizeof( *ep ) );
+	memset( ep, 0, sizeof( *ep ) );
+	ep->name = "cz-test:4560";
+	pthread_mutex_init( &ep->gate, NULL );
+	fd2ep_add( ctx, 3, ep );
+
+	// ---- built in codec ----------------------------------------------------------
+	for( i = 0, clen = 0; clen < (int) sizeof( src ) - 200; i++ ) {
+		clen += snprintf( (char *) src + clen, sizeof( src ) - clen, "{\"cell\":\"%05d\",\"prb_used\":%d,\"ue_count\":%d,\"thp\":%d},", i % 17, i * 7, i % 50, i * 1000 );
+	}
+	dlen = clen;
+	clen = cz_lz_compress( NULL, src, dlen, cbuf, sizeof( cbuf ) );
+	errors += fail_if_true( clen <= 0 || clen > dlen / 3, "repetitive json payload did not compress to a third of its size" );
+	errors += fail_not_equal( cz_lz_decompress( NULL, cbuf, clen, dbuf, sizeof( dbuf ) ), dlen, "decompressed length was not the original length" );
+	errors += fail_not_equal( memcmp( src, dbuf, dlen ), 0, "decompressed payload was not the original" );
+	errors += fail_not_equal( cz_lz_decompress( NULL, cbuf, clen, dbuf, dlen - 1 ), -1, "decompress into too small a buffer did not fail" );
+	errors += fail_not_equal( cz_lz_decompress( NULL, cbuf, clen - 1, dbuf, sizeof( dbuf ) ) == dlen, 0, "truncated input decompressed to the original" );
+	errors += fail_not_equal( cz_lz_compress( NULL, src, dlen, cbuf, 16 ), 0, "compress into too small a buffer did not fail" );
+
+	memset( src, 'a', 1000 );														// long match and literal runs need length extensions
+	for( i = 1000; i < 1400; i++ ) {
+		src[i] = (unsigned char) ((i * 2654435761U) >> 13);
+	}
+	clen = cz_lz_compress( NULL, src, 1400, cbuf, sizeof( cbuf ) );
+	errors += fail_if_true( clen <= 0, "compress of long runs failed" );
+	errors += fail_not_equal( cz_lz_decompress( NULL, cbuf, clen, dbuf, sizeof( dbuf ) ), 1400, "decompress of long runs was not the original length" );
+	errors += fail_not_equal( memcmp( src, dbuf, 1400 ), 0, "decompress of long runs was not the original" );
+
+	clen = cz_lz_compress( NULL, src, 3, cbuf, sizeof( cbuf ) );					// too short for a match
+	errors += fail_not_equal( cz_lz_decompress( NULL, cbuf, clen, dbuf, sizeof( dbuf ) ), 3, "decompress of short input was not the original length" );
+
+	cbuf[0] = 0x04;																	// no literals and a match before the start
+	cbuf[1] = 9;
+	cbuf[2] = 0;
+	errors += fail_not_equal( cz_lz_decompress( NULL, cbuf, 3, dbuf, sizeof( dbuf ) ), -1, "decompress with a bad offset did not fail" );
+
+	// ---- api -----------------------------------------------------------------------
+	errors += fail_not_equal( rmr_set_compress( NULL, 77, 0 ), RMR_ERR_BADARG, "set compress with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_set_compress( ctx, 77, -1 ), RMR_OK, "set compress off with no types did not return ok" );
+	errors += fail_not_nil( ctx->cz_types, "turning compression off allocated the type table" );
+	errors += fail_not_equal( rmr_set_codec( NULL, NULL ), RMR_ERR_BADARG, "set codec with nil context did not return bad arg" );
+	memset( &codec, 0, sizeof( codec ) );
+	errors += fail_not_equal( rmr_set_codec( ctx, &codec ), RMR_ERR_BADARG, "set codec without functions did not return bad arg" );
+
+	// ---- compressed send and receive -------------------------------------------------
+	errors += fail_not_equal( rmr_set_compress( sctx, 77, 0 ), RMR_OK, "set compress did not return ok" );
+	errors += fail_not_equal( (int) (intptr_t) rmr_sym_pull( sctx->cz_types, 77 ), CZ_DEF_MIN, "default minimum was not set" );
+	rmr_set_compress( sctx, 77, 64 );
+	mbuf = rmr_alloc_msg( sctx, 2048 );
+	mbuf->mtype = 77;
+	mbuf->len = dlen = snprintf( (char *) mbuf->payload, 2048, "%s", "{\"kpm\":[1,2,3,4,5,6,7,8],\"kpm\":[1,2,3,4,5,6,7,8],\"kpm\":[1,2,3,4,5,6,7,8],\"kpm\":[1,2,3,4,5,6,7,8],"
+		"\"kpm\":[1,2,3,4,5,6,7,8],\"kpm\":[1,2,3,4,5,6,7,8],\"kpm\":[1,2,3,4,5,6,7,8],\"kpm\":[1,2,3,4,5,6,7,8],\"kpm\":[1,2,3,4,5,6,7,8]}" ) + 1;
+	memcpy( src, mbuf->payload, dlen );
+	em_sendv_len = 0;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );										// peer has not accepted; sent as is
+	errors += fail_not_equal( em_sendv_len, 0, "payload was compressed before the peer accepted compression" );
+	mbuf->mtype = 77;
+	mbuf->len = dlen;
+	memcpy( mbuf->payload, src, dlen );
+	mbuf = send_msg( sctx, mbuf, 3, 1, NULL );										// session we did not open is never compressed
+	errors += fail_not_equal( em_sendv_len, 0, "payload was compressed on a session we did not open" );
+	mbuf->mtype = 77;
+	mbuf->len = dlen;
+	memcpy( mbuf->payload, src, dlen );
+
+	// ---- negotiation -------------------------------------------------------------
+	frame = mk_fc_frame( HFL_CZ_CAP, 0, &flen );
+	v = em_sendt_count;
+	buf2mbuf( ctx, frame, flen, 5, MFL_TPPOOL );
+	errors += fail_if_false( ctx->rivers[5].flags & RF_CZ_ON, "compression offer was not accepted" );
+	errors += fail_not_equal( em_sendt_count - v, 1, "compression accept frame was not written" );
+	rmr_free_msg( uta_ring_extract( ctx->mring ) );
+	frame = mk_fc_frame( HFL_CZ_CAP, 0, &flen );
+	buf2mbuf( ctx, frame, flen, 5, MFL_TPPOOL );
+	errors += fail_not_equal( em_sendt_count - v, 1, "compression accepted more than once on a connection" );
+	rmr_free_msg( uta_ring_extract( ctx->mring ) );
+
+	frame = mk_fc_frame( HFL_CTL, 0, &flen );
+	((uta_mhdr_t *) (frame + TP_HDR_LEN))->mtype = htonl( CZ_CTL_ACCEPT );
+	buf2mbuf( ctx, frame, flen, 3, MFL_TPPOOL );
+	errors += fail_if_false( ep->cz_on, "accept control frame did not enable compression for the endpoint" );
+	errors += fail_if_false( uta_ring_extract( ctx->mring ) == NULL, "compression accept frame was queued for the application" );
+
+	cz_reset_ep( ep );
+	errors += fail_if_true( ep->cz_on, "endpoint reset did not clear compression state" );
+	ep->cz_on = 1;
+
+	em_sendv_len = 0;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_if_nil( mbuf, "compressed send returned nil" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_OK, "compressed send did not return ok state" );
+		rmr_free_msg( mbuf );
+	}
+	errors += fail_if_true( em_sendv_len <= 0, "compressed send did not gather the compressed payload" );
+	if( em_sendv_len > 0 ) {
+		errors += fail_if_false( ((uta_mhdr_t *) (em_sendv_last + TP_HDR_LEN))->flags & HFL_COMP, "compressed send frame was not flagged" );
+		errors += fail_if_false( ((uta_mhdr_t *) (em_sendv_last + TP_HDR_LEN))->flags & HFL_CZ_CAP, "compressed send frame did not keep the offer" );
+		errors += fail_if_false( (int) ntohl( ((uta_mhdr_t *) (em_sendv_last + TP_HDR_LEN))->plen ) < dlen, "compressed send frame payload was not smaller" );
+
+		frame = (char *) tpb_alloc( em_sendv_len );
+		memcpy( frame, em_sendv_last, em_sendv_len );
+		buf2mbuf( ctx, frame, em_sendv_len, 5, MFL_TPPOOL );
+		mbuf = uta_ring_extract( ctx->mring );
+		errors += fail_if_nil( mbuf, "compressed message was not queued" );
+		if( mbuf ) {
+			errors += fail_not_equal( mbuf->len, dlen, "received compressed message length was not the original" );
+			errors += fail_not_equal( memcmp( mbuf->payload, src, dlen ), 0, "received compressed message payload was not the original" );
+			errors += fail_if_true( ((uta_mhdr_t *) mbuf->header)->flags & HFL_COMP, "received message was still flagged as compressed" );
+			rmr_free_msg( mbuf );
+		}
+
+		frame = (char *) tpb_alloc( em_sendv_len );
+		memcpy( frame, em_sendv_last, em_sendv_len );
+		memset( frame + em_sendv_len - 8, 0xff, 8 );							// corrupt the codec output; must be dropped
+		buf2mbuf( ctx, frame, em_sendv_len, 5, MFL_TPPOOL );
+		errors += fail_not_nil( uta_ring_extract( ctx->mring ), "corrupt compressed message was queued" );
+	}
+
+	mbuf = rmr_alloc_msg( sctx, 2048 );											// below the threshold is sent as is
+	mbuf->mtype = 77;
+	mbuf->len = 50;
+	em_sendv_len = 0;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_not_equal( em_sendv_len, 0, "payload below the threshold was compressed" );
+	rmr_free_msg( mbuf );
+
+	// ---- user codec ----------------------------------------------------------------
+	codec.compress = cz_flip;
+	codec.decompress = cz_unflip;
+	codec.data = &calls;
+	errors += fail_not_equal( rmr_set_codec( sctx, &codec ), RMR_OK, "set codec did not return ok" );
+	rmr_set_codec( ctx, &codec );
+	mbuf = rmr_alloc_msg( sctx, 2048 );
+	mbuf->mtype = 77;
+	mbuf->len = dlen;
+	memcpy( mbuf->payload, src, dlen );
+	em_sendv_len = 0;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	rmr_free_msg( mbuf );
+	errors += fail_not_equal( calls, 1, "user compress function was not called" );
+	if( em_sendv_len > 0 ) {
+		frame = (char *) tpb_alloc( em_sendv_len );
+		memcpy( frame, em_sendv_last, em_sendv_len );
+		buf2mbuf( ctx, frame, em_sendv_len, 5, MFL_TPPOOL );
+		errors += fail_not_equal( calls, 2, "user decompress function was not called" );
+		mbuf = uta_ring_extract( ctx->mring );
+		errors += fail_if_nil( mbuf, "message compressed with the user codec was not queued" );
+		if( mbuf ) {
+			errors += fail_not_equal( memcmp( mbuf->payload, src, dlen ), 0, "user codec payload was not the original" );
+			rmr_free_msg( mbuf );
+		}
+	}
+	rmr_set_codec( sctx, NULL );
+	rmr_set_codec( ctx, NULL );
+	errors += fail_not_equal( rmr_set_compress( sctx, 77, -1 ), RMR_OK, "set compress off did not return ok" );
+
+	return errors;
+}
+
+/*
+	Drive the send deadline. Blocked sends must wait (SIwritable) rather than
+	retry, the wait must be counted against the endpoint, and a send which is
+	still blocked at the deadline must be returned with a retry state.
+*/
+static int st_test( uta_ctx_t* sctx ) {
+	endpoint_t*		ep;
+	rmr_mbuf_t*		mbuf;
+	rmr_send_stats_t	stats;
+	route_table_t*	rt;
+	endpoint_t*		rt_ep;
+	uint64_t		start;
+	int				errors = 0;
+
+	errors += fail_not_equal( rmr_set_stimeout_us( NULL, 100 ), RMR_ERR_BADARG, "set stimeout us with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_set_stimeout_us( sctx, -1 ), RMR_ERR_BADARG, "set stimeout us with negative time did not return bad arg" );
+	errors += fail_not_equal( rmr_set_stimeout_us( sctx, 200000 ), RMR_OK, "set stimeout us did not return ok" );
+
+	ep = (endpoint_t *) malloc( sizeof( *ep ) );
+	memset( ep, 0, sizeof( *ep ) );
+	ep->name = "st-test:4560";
+	pthread_mutex_init( &ep->gate, NULL );
+
+	em_writable_waits = 0;
+	em_send_blocks = 3;											// blocks three times, then drains
+	mbuf = rmr_alloc_msg( sctx, 128 );
+	mbuf->len = 10;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_if_nil( mbuf, "send with deadline returned nil" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_OK, "send which drained before the deadline did not return ok state" );
+	}
+	errors += fail_not_equal( em_writable_waits, 3, "blocked send did not wait for the session once per block" );
+	errors += fail_not_equal( (int) ep->blocked, 3, "blocked send waits were not counted against the endpoint" );
+	errors += fail_if_true( ep->max_blocked_ns > ep->blocked_ns, "max blocked time was more than the total" );
+
+	em_send_blocks = 1000;
+	mbuf = send_msg( sctx, mbuf, 3, 0, ep );					// no retries means no waiting, even with a deadline
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_ERR_RETRY, "blocked send without retries did not return retry state" );
+	}
+	errors += fail_not_equal( em_writable_waits, 3, "blocked send without retries waited" );
+
+	em_send_blocks = 1000000000;									// never drains
+	rmr_set_stimeout_us( sctx, 2000 );
+	start = sr_now_ns( );
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_if_nil( mbuf, "send blocked past the deadline returned nil" );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_ERR_RETRY, "send blocked past the deadline did not return retry state" );
+	}
+	errors += fail_if_true( sr_now_ns( ) - start < 2000000, "send blocked past the deadline returned before the deadline" );
+	em_send_blocks = 0;
+
+	rmr_set_stimeout_us( sctx, 0 );								// retry mode again; no waits
+	em_writable_waits = 0;
+	em_send_blocks = 2;
+	mbuf = send_msg( sctx, mbuf, 3, 5, ep );
+	if( mbuf ) {
+		errors += fail_not_equal( mbuf->state, RMR_OK, "send in retry mode did not return ok state" );
+	}
+	errors += fail_not_equal( em_writable_waits, 0, "send in retry mode waited for the session" );
+	rmr_free_msg( mbuf );
+
+	// ---- stats api -----------------------------------------------------------------
+	errors += fail_not_equal( rmr_get_send_stats( NULL, "localhost:4562", &stats ), RMR_ERR_BADARG, "get send stats with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_get_send_stats( sctx, NULL, &stats ), RMR_ERR_BADARG, "get send stats with nil name did not return bad arg" );
+	errors += fail_not_equal( rmr_get_send_stats( sctx, "localhost:4562", NULL ), RMR_ERR_BADARG, "get send stats with nil stats did not return bad arg" );
+	errors += fail_not_equal( rmr_get_send_stats( sctx, "nosuchhost:4562", &stats ), RMR_ERR_NOENDPT, "get send stats for unknown endpoint did not return no endpoint" );
+
+	rt = get_rt( sctx );
+	rt_ep = uta_get_ep( rt, "localhost:4562" );
+	errors += fail_if_nil( rt_ep, "route table endpoint for stats was not found" );
+	if( rt_ep ) {
+		rt_ep->blocked = 7;
+		rt_ep->blocked_ns = 9000;
+		rt_ep->max_blocked_ns = 4000;
+	}
+	release_rt( sctx, rt );
+	memset( &stats, 0, sizeof( stats ) );
+	errors += fail_not_equal( rmr_get_send_stats( sctx, "localhost:4562", &stats ), RMR_OK, "get send stats did not return ok" );
+	errors += fail_not_equal( (int) stats.blocked, 7, "send stats blocked count was not the endpoint's" );
+	errors += fail_not_equal( (int) stats.blocked_ns, 9000, "send stats blocked time was not the endpoint's" );
+	errors += fail_not_equal( (int) stats.max_blocked_ns, 4000, "send stats max blocked time was not the endpoint's" );
+
+	return errors;
+}
+
+/*
+	Drive the circuit breaker. The emulated connect fails for ports under 1000.
+*/
+/*
+	Connect on a thread so that the test can hold the endpoint's gate while the
+	connect waits for it.
+*/
+static uta_ctx_t*	cb_th_ctx;
+static endpoint_t*	cb_th_ep;
+static int			cb_th_state;
+
+static void* cb_link_th( void* data ) {
+	cb_th_state = uta_link2( cb_th_ctx, cb_th_ep );
+	return NULL;
+}
+
+static int cb_test( uta_ctx_t* sctx ) {
+	route_table_t*	rt;
+	rtable_ent_t*	rte;
+	endpoint_t*		ep;
+	endpoint_t*		up;
+	endpoint_t*		sel;
+	rmr_send_stats_t	stats;
+	char*			name;
+	pthread_t		th;
+	int				nn_sock;
+	int				i;
+	int				errors = 0;
+
+	sem_init( &sctx->cb_wake, 0, 0 );								// dummy context; not set up by init
+	sctx->cb_fails = 3;
+
+	rt = get_rt( sctx );
+	ep = rt_ensure_ep( rt, "cbhost:999" );
+	up = rt_ensure_ep( rt, "localhost:4562" );
+	rte = uta_add_rte( rt, build_rt_key( -1, 4242 ), 1 );			// round robin group with one down member
+	uta_add_ep( rt, rte, "cbhost:999", 0 );
+	uta_add_ep( rt, rte, "localhost:4562", 0 );
+	release_rt( sctx, rt );
+	errors += fail_if_nil( ep, "could not create endpoint for breaker test" );
+	if( ep == NULL ) {
+		return errors;
+	}
+
+	for( i = 0; i < 2; i++ ) {
+		errors += fail_if_true( uta_link2( sctx, ep ), "connect to a down endpoint did not fail" );
+	}
+	errors += fail_not_equal( ep->cb_state, CB_CLOSED, "breaker opened before enough connects failed" );
+	errors += fail_if_true( uta_link2( sctx, ep ), "connect to a down endpoint did not fail" );
+	errors += fail_not_equal( ep->cb_state, CB_OPEN, "breaker did not open after enough connects failed" );
+	errors += fail_not_equal( (int) ep->cb_trips, 1, "breaker trip was not counted" );
+	errors += fail_not_equal( sctx->cb_nopen, 1, "open breaker was not counted in the context" );
+
+	errors += fail_if_true( uta_link2( sctx, ep ), "connect with the breaker open did not fail" );
+	errors += fail_not_equal( (int) ep->connect_fails, 3, "connect was attempted with the breaker open" );
+	errors += fail_not_equal( (int) ep->cb_fast_fails, 1, "send refused by the open breaker was not counted" );
+
+	rt = get_rt( sctx );											// members whose breaker is open are passed over
+	rte = uta_get_rte( rt, -1, 4242, FALSE );
+	for( i = 0; i < 4; i++ ) {
+		sel = NULL;
+		errors += fail_if_false( uta_epsock_rr( sctx, rte, 0, NULL, &nn_sock, &sel ), "rr select with one member down failed" );
+		errors += fail_not_equalp( sel, up, "rr select did not fail over from the member whose breaker is open" );
+	}
+	release_rt( sctx, rt );
+
+	cb_sweep( sctx );												// not yet time for a probe
+	errors += fail_not_equal( (int) ep->connect_fails, 3, "probe was made before its time" );
+
+	ep->cb_until = 0;
+	cb_probe( sctx, ep );											// still down; stays open and waits longer
+	errors += fail_not_equal( ep->cb_state, CB_OPEN, "failed probe did not leave the breaker open" );
+	errors += fail_not_equal( (int) ep->connect_fails, 4, "failed probe was not counted" );
+	errors += fail_if_true( ep->cb_backoff <= CB_PROBE_MIN_NS, "failed probe did not increase the wait" );
+
+	errors += fail_not_equal( rmr_get_send_stats( sctx, "cbhost:999", &stats ), RMR_OK, "send stats for the down endpoint not returned" );
+	errors += fail_not_equal( stats.cb_state, RMR_CB_OPEN, "send stats did not report the breaker open" );
+	errors += fail_not_equal( (int) stats.cb_trips, 1, "send stats did not report the trip" );
+	errors += fail_not_equal( (int) stats.connect_fails, 4, "send stats did not report the failed connects" );
+	errors += fail_not_equal( (int) stats.cb_fast_fails, 1, "send stats did not report the refused send" );
+
+	name = ep->name;
+	ep->name = "cbhost:4999";										// peer is back
+	ep->cb_until = 0;
+	cb_sweep( sctx );
+	ep->name = name;
+	errors += fail_not_equal( ep->cb_state, CB_CLOSED, "successful probe did not close the breaker" );
+	errors += fail_if_false( ep->open, "successful probe did not leave the endpoint connected" );
+	errors += fail_not_equal( sctx->cb_nopen, 0, "closed breaker was still counted in the context" );
+	errors += fail_not_equal( ep->cb_nfails, 0, "successful probe did not reset the failed connects" );
+
+	ep->open = FALSE;												// breaker off; connects always attempted
+	sctx->cb_fails = 0;
+	for( i = 0; i < 5; i++ ) {
+		uta_link2( sctx, ep );
+	}
+	errors += fail_not_equal( ep->cb_state, CB_CLOSED, "breaker opened when turned off" );
+	sctx->cb_fails = CB_DEF_FAILS;
+
+	name = ep->name;												// breaker opens while a sender waits on the gate
+	ep->name = "cbhost:4999";										// a connect would work; it must not be tried
+	ep->open = FALSE;
+	cb_th_ctx = sctx;
+	cb_th_ep = ep;
+	cb_th_state = -1;
+	pthread_mutex_lock( &ep->gate );
+	pthread_create( &th, NULL, cb_link_th, NULL );
+	usleep( 50000 );
+	ep->cb_state = CB_OPEN;
+	pthread_mutex_unlock( &ep->gate );
+	pthread_join( th, NULL );
+	errors += fail_not_equal( cb_th_state, FALSE, "connect went ahead after the breaker opened while waiting on the gate" );
+	errors += fail_if_true( ep->open, "endpoint was connected after the breaker opened while waiting on the gate" );
+	ep->cb_state = CB_CLOSED;
+	ep->name = name;
+
+	return errors;
+}
+
+/*
+	Drive sender side batching. Messages to an endpoint must be held until the
+	batch is full, a call message is sent, the application flushes, or the
+	budget expires; larger messages go directly after what is held.
+*/
+static int bat_test( uta_ctx_t* sctx ) {
+	route_table_t*	rt;
+	endpoint_t*		ep;
+	rmr_mbuf_t*		mbuf;
+	int				count;
+	int				flen = 0;
+	int				i;
+	int				errors = 0;
+
+	errors += fail_not_equal( rmr_set_batch( NULL, 1024, 0 ), RMR_ERR_BADARG, "set batch with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_set_batch( sctx, -1, 0 ), RMR_ERR_BADARG, "set batch with negative size did not return bad arg" );
+	errors += fail_not_equal( rmr_flush( NULL ), RMR_ERR_BADARG, "flush with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_flush( sctx ), RMR_OK, "flush with batching off did not return ok" );
+
+	rt = get_rt( sctx );
+	ep = uta_get_ep( rt, "localhost:4562" );
+	release_rt( sctx, rt );
+	errors += fail_if_nil( ep, "endpoint for batch test was not found" );
+	if( ep == NULL ) {
+		return errors;
+	}
+
+	errors += fail_not_equal( rmr_set_batch( sctx, 4096, 10000000 ), RMR_OK, "set batch did not return ok" );	// long budget; nothing goes on time
+	errors += fail_not_equal( sctx->bat_us, 10000000, "set batch did not set the budget" );
+
+	mbuf = rmr_alloc_msg( sctx, 2048 );
+	count = em_sendt_count;
+	for( i = 0; i < 5; i++ ) {
+		mbuf->len = 10;
+		mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+		errors += fail_if_nil( mbuf, "batched send returned nil" );
+		errors += fail_not_equal( mbuf->state, RMR_OK, "batched send did not return ok state" );
+	}
+	errors += fail_not_equal( em_sendt_count, count, "batched sends were written before the batch was full" );
+	errors += fail_if_nil( ep->batch, "batched send did not create the endpoint's batch" );
+	if( ep->batch ) {
+		errors += fail_not_equal( ep->batch->nframes, 5, "batch did not hold every message sent" );
+		flen = ep->batch->len / 5;
+	}
+	errors += fail_not_equal( sctx->bat_pending, 1, "endpoint holding messages was not counted" );
+
+	errors += fail_not_equal( rmr_flush( sctx ), RMR_OK, "flush did not return ok" );
+	errors += fail_not_equal( em_sendt_count, count + 1, "flush did not write the batch with one send" );
+	errors += fail_not_equal( em_sendt_last_len, flen * 5, "flush did not write every batched message" );
+	errors += fail_not_equal( sctx->bat_pending, 0, "flushed endpoint was still counted" );
+
+	count = em_sendt_count;
+	for( i = 0; flen > 0 && i < (4096 / flen) + 1; i++ ) {									// one more than fits forces a write
+		mbuf->len = 10;
+		mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	}
+	errors += fail_not_equal( em_sendt_count, count + 1, "full batch was not written" );
+	errors += fail_if_true( ep->batch->len != flen, "message which did not fit was not held in the next batch" );
+
+	rmr_set_batch( sctx, 1024, 10000000 );
+	count = em_sendt_count;
+	mbuf->len = 1000;																// larger than the batch; goes directly after what is held
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_not_equal( mbuf->state, RMR_OK, "send larger than the batch size did not return ok state" );
+	errors += fail_not_equal( em_sendt_count, count + 2, "send larger than the batch did not flush and then write" );
+	errors += fail_not_equal( ep->batch->len, 0, "send larger than the batch left messages held" );
+
+	count = em_sendt_count;
+	mbuf->len = 10;
+	((uta_mhdr_t *) mbuf->header)->flags |= HFL_CALL_MSG;							// caller waits for a response; must not be held
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_not_equal( em_sendt_count, count + 1, "call message was held in the batch" );
+	((uta_mhdr_t *) mbuf->header)->flags &= ~HFL_CALL_MSG;
+
+	em_send_blocks = 1;																// blocked session keeps the frames
+	mbuf->len = 10;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_not_equal( rmr_flush( sctx ), RMR_ERR_RETRY, "flush to a blocked session did not return retry" );
+	errors += fail_not_equal( ep->batch->nframes, 1, "blocked flush did not keep the message" );
+	em_send_blocks = 0;
+
+	rmr_set_batch( sctx, 1024, 50000 );												// test context is shut down, so sweep as the flusher would
+	count = em_sendt_count;
+	errors += fail_not_equal( bat_sweep( sctx, FALSE ), 1, "sweep wrote a batch before the budget expired" );
+	usleep( 60000 );
+	errors += fail_not_equal( bat_sweep( sctx, FALSE ), 0, "sweep reported batches left after the budget expired" );
+	errors += fail_not_equal( ep->batch->len, 0, "sweep did not write the batch when the budget expired" );
+	errors += fail_not_equal( em_sendt_count, count + 1, "sweep did not write the batch with one send" );
+
+	mbuf->len = 10;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	bat_drop( sctx, ep );															// session lost; held messages are not written
+	errors += fail_not_equal( ep->batch->len, 0, "drop did not discard held messages" );
+	errors += fail_not_equal( sctx->bat_pending, 0, "dropped endpoint was still counted" );
+
+	errors += fail_not_equal( rmr_set_batch( sctx, 0, 0 ), RMR_OK, "turning batching off did not return ok" );
+	count = em_sendt_count;
+	mbuf->len = 10;
+	mbuf = send_msg( sctx, mbuf, 3, 1, ep );
+	errors += fail_not_equal( em_sendt_count, count + 1, "send with batching off was not written directly" );
+	rmr_free_msg( mbuf );
+
+	return errors;
+}
+
+/*
+	Completion callback for the async send test; counts completions and frees the message.
+*/
+static void as_done( void* vctx, rmr_mbuf_t* msg, void* arg ) {
+	__atomic_add_fetch( (int *) arg, 1, __ATOMIC_RELAXED );
+	rmr_free_msg( msg );
+}
+
+/*
+	Drive the asynchronous send. Completions are delivered both to a callback
+	and, without one, to the completion ring whose fd must become readable.
+*/
+static int as_test( uta_ctx_t* sctx ) {
+	rmr_mbuf_t*		mbuf;
+	as_req_t*		req;
+	struct pollfd	pfd;
+	int				done = 0;
+	int				collected = 0;
+	int				cfd;
+	int				i;
+	int				state;
+	int				errors = 0;
+
+	errors += fail_not_equal( rmr_send_async( NULL, NULL, NULL, NULL ), RMR_ERR_BADARG, "async send with nil context did not return bad arg" );
+	errors += fail_not_equal( rmr_send_async( sctx, NULL, NULL, NULL ), RMR_ERR_BADARG, "async send with nil message did not return bad arg" );
+	errors += fail_if_true( rmr_get_send_cfd( NULL ) >= 0, "send completion fd with nil context was not an error" );
+	errors += fail_not_nil( rmr_send_complete( NULL ), "send complete with nil context did not return nil" );
+	errors += fail_not_nil( rmr_send_complete( sctx ), "send complete before any async send did not return nil" );
+
+	cfd = rmr_get_send_cfd( sctx );
+	errors += fail_if_true( cfd < 0, "send completion fd was not returned" );
+	errors += fail_if_nil( sctx->asend, "send completion fd did not start async send" );
+	errors += fail_not_equal( rmr_get_send_cfd( sctx ), cfd, "second request for the completion fd returned a different fd" );
+
+	for( i = 0; i < 10; i++ ) {
+		mbuf = rmr_alloc_msg( sctx, 128 );
+		mbuf->mtype = 1;
+		mbuf->len = 10;
+		state = rmr_send_async( sctx, mbuf, as_done, &done );
+		errors += fail_not_equal( state, RMR_OK, "async send with callback did not return ok" );
+		if( state != RMR_OK ) {
+			rmr_free_msg( mbuf );
+		}
+	}
+	for( i = 0; i < 10; i++ ) {
+		mbuf = rmr_alloc_msg( sctx, 128 );
+		mbuf->mtype = 1;
+		mbuf->len = 10;
+		errors += fail_not_equal( rmr_send_async( sctx, mbuf, NULL, NULL ), RMR_OK, "async send without callback did not return ok" );
+	}
+
+	pfd.fd = cfd;
+	pfd.events = POLLIN;
+	for( i = 0; i < 200 && collected < 10; i++ ) {
+		if( poll( &pfd, 1, 10 ) > 0 ) {
+			while( (mbuf = rmr_send_complete( sctx )) != NULL ) {
+				collected++;
+				rmr_free_msg( mbuf );
+			}
+		}
+	}
+	for( i = 0; i < 200 && __atomic_load_n( &done, __ATOMIC_RELAXED ) < 10; i++ ) {
+		usleep( 10000 );
+	}
+	errors += fail_not_equal( collected, 10, "not all completions were collected from the completion ring" );
+	errors += fail_not_equal( __atomic_load_n( &done, __ATOMIC_RELAXED ), 10, "not all completion callbacks were driven" );
+	errors += fail_not_equal( (int) sctx->asend->sent, 20, "offload thread did not send every queued message" );
+
+	as_stop( sctx );
+	for( i = 0; i < 300 && sctx->asend->running; i++ ) {
+		usleep( 10000 );
+	}
+	errors += fail_if_true( sctx->asend->running, "offload thread did not stop" );
+	mbuf = rmr_alloc_msg( sctx, 128 );
+	errors += fail_not_equal( rmr_send_async( sctx, mbuf, NULL, NULL ), RMR_ERR_NOTSUPP, "async send after stop did not return not supported" );
+	errors += fail_not_equal( sctx->asend->queuing, 0, "refused async send was left counted as queuing" );
+
+	req = (as_req_t *) uta_ring_extract( sctx->asend->free );					// queued as the thread exited (sender raced the stop)
+	req->msg = mbuf;
+	req->cb = NULL;
+	mbuf->mtype = 1;
+	mbuf->len = 10;
+	uta_ring_insert( sctx->asend->sq, req );
+	as_stop( sctx );
+	errors += fail_not_equal( (int) sctx->asend->sent, 21, "request queued after the offload thread exited was not sent by stop" );
+	mbuf = rmr_send_complete( sctx );
+	errors += fail_if_nil( mbuf, "completion for request sent by stop was not queued" );
+	rmr_free_msg( mbuf );
+
+	return errors;
+}
+
 /*
 	Drive the send and receive functions.  We also drive as much of the route
 	table collector as is possible without a real rtg process running somewhere.
@@ -271,6 +1196,16 @@ static int sr_si_test() {
 	errors += fail_not_equal( strncmp( payload_str, mbuf->payload, strlen( payload_str )), 0, "realloc payload (clone+nocopy) validation of unchanged payload fails" );
 
 
+	// ---------------------- flow control ----------------------------------------------------------------------------
+	fprintf( stderr, "<TEST> flow control tests starting\n" );
+	errors += fc_test( ctx );
+	errors += ch_test( ctx );
+	errors += cz_test( ctx );
+	errors += st_test( ctx );
+	errors += as_test( ctx );
+	errors += bat_test( ctx );
+	errors += cb_test( ctx );
+
 	// ---------------------- misc coverage tests; nothing to verify other than they don't crash -----------------------
 	payload_str = strdup( "The Marching 110 will play the OU fightsong after every touchdown or field goal; it is a common sound echoing from Peden Stadium in the fall." );
 
@@ -0,0 +1,194 @@
+// : vi ts=4 sw=4 noet :
+/*
+==================================================================================
+	    Copyright (c) 2020-2026 Nokia
+	    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mmemonic:	symtab_bench.c
+	Abstract:	Stand alone benchmark of the symbol table. This is not a unit
+				test and is not run by the unit test script; build and run it
+				by hand:
+					make symtab_bench
+					./symtab_bench [lookups]
+
+				For tables of 1k, 100k and 1M entries, with numeric keys (as
+				the route table uses for message type/subscription id) and with
+				string keys (as used for endpoint names and meids), the time per
+				operation is reported for: put (table allocated small, so the
+				time includes growing), get of a key which is there, get of a
+				key which is not, and delete. Lookups are made in a shuffled
+				order so that the cache is not helped by insertion order.
+
+	Date:		19 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "rmr_symtab.h"
+
+#include "symtab.c"
+
+static long sizes[] = { 1000, 100000, 1000000 };
+
+static uint64_t now_ns( ) {
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+	Return a permutation of 0..n-1.
+*/
+static long* shuffle( long n ) {
+	long*		order;
+	long		i;
+	long		j;
+	long		t;
+	uint64_t	rnd = 88172645463325252ULL;
+
+	order = (long *) malloc( sizeof( *order ) * n );
+	for( i = 0; i < n; i++ ) {
+		order[i] = i;
+	}
+	for( i = n - 1; i > 0; i-- ) {
+		rnd ^= rnd << 13;
+		rnd ^= rnd >> 7;
+		rnd ^= rnd << 17;
+		j = (long) (rnd % (uint64_t) (i + 1));
+		t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+
+	return order;
+}
+
+/*
+	Run put/get/miss/delete over n keys, numeric if names is nil, else the
+	strings in names (n of them, then n more which are never put).
+*/
+static void run( char* what, long n, long lookups, char** names ) {
+	void*		st;
+	long*		order;
+	uint64_t	start;
+	double		put_ns;
+	double		get_ns;
+	double		miss_ns;
+	double		del_ns;
+	long		i;
+	long		k;
+	long		missing = 0;
+
+	order = shuffle( n );
+	st = rmr_sym_alloc( 129 );
+
+	start = now_ns( );
+	for( i = 0; i < n; i++ ) {
+		if( names ) {
+			rmr_sym_put( st, names[i], 1, names[i] );
+		} else {
+			rmr_sym_map( st, ((uint64_t) (i & 0xff) << 32) | (uint64_t) i, st );		// sub-id/mtype like keys
+		}
+	}
+	put_ns = (double) (now_ns( ) - start) / n;
+
+	start = now_ns( );
+	for( i = 0; i < lookups; i++ ) {
+		k = order[i % n];
+		if( names ) {
+			missing += rmr_sym_get( st, names[k], 1 ) == NULL;
+		} else {
+			missing += rmr_sym_pull( st, ((uint64_t) (k & 0xff) << 32) | (uint64_t) k ) == NULL;
+		}
+	}
+	get_ns = (double) (now_ns( ) - start) / lookups;
+
+	start = now_ns( );
+	for( i = 0; i < lookups; i++ ) {
+		k = order[i % n];
+		if( names ) {
+			missing += rmr_sym_get( st, names[n + k], 1 ) != NULL;
+		} else {
+			missing += rmr_sym_pull( st, ((uint64_t) (k & 0xff) << 32) | (uint64_t) (k + n) ) != NULL;
+		}
+	}
+	miss_ns = (double) (now_ns( ) - start) / lookups;
+
+	start = now_ns( );
+	for( i = 0; i < n; i++ ) {
+		k = order[i];
+		if( names ) {
+			rmr_sym_del( st, names[k], 1 );
+		} else {
+			rmr_sym_ndel( st, ((uint64_t) (k & 0xff) << 32) | (uint64_t) k );
+		}
+	}
+	del_ns = (double) (now_ns( ) - start) / n;
+
+	if( missing ) {
+		fprintf( stderr, "<FAIL> %s %ld: %ld lookups returned the wrong result\n", what, n, missing );
+	}
+	fprintf( stderr, "%-8s %8ld entries  put %6.1f ns  get %6.1f ns  miss %6.1f ns  del %6.1f ns\n",
+		what, n, put_ns, get_ns, miss_ns, del_ns );
+
+	rmr_sym_free( st );
+	free( order );
+}
+
+int main( int argc, char** argv ) {
+	char**	names;
+	char	buf[64];
+	long	lookups = 10000000;
+	long	n;
+	long	i;
+	int		j;
+
+	if( argc > 1 ) {
+		lookups = atol( argv[1] );
+	}
+	if( lookups <= 0 ) {
+		fprintf( stderr, "usage: %s [lookups]\n", argv[0] );
+		exit( 1 );
+	}
+
+	for( j = 0; j < (int) (sizeof( sizes ) / sizeof( long )); j++ ) {
+		n = sizes[j];
+		run( "numeric", n, lookups, NULL );
+
+		names = (char **) malloc( sizeof( *names ) * n * 2 );
+		for( i = 0; i < n * 2; i++ ) {
+			snprintf( buf, sizeof( buf ), "gnb_%05ld_%07ld:43%03ld", i % 97, i, i % 1000 );	// meid or host:port like
+			names[i] = strdup( buf );
+		}
+		run( "string", n, lookups, names );
+
+		for( i = 0; i < n * 2; i++ ) {
+			free( names[i] );
+		}
+		free( names );
+	}
+
+	return 0;
+}
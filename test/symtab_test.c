@@ -193,6 +193,142 @@ static void each_counter( void* a, void* b, const char* c, void* d, void* e ) {
 	counter++;
 }
 
+/*
+	Driven by foreach class -- delete the entry passed in, then count it.
+*/
+static void each_deleter( void* st, void* se, const char* name, void* val, void* data ) {
+	rmr_sym_del( st, name, 1 );
+	counter++;
+}
+
+/*
+	Push the table well past the size given at allocation so that it must
+	grow, with a mix of string and numeric keys, and ensure that everything
+	can still be found; then delete every other key (leaving deleted slots
+	in the probe paths) and ensure the rest are still found.
+*/
+static int grow_test( ) {
+	void*	st;
+	char	key[64];
+	int		errors = 0;
+	int		i;
+	int		missing = 0;
+	int		wrong = 0;
+	int		found = 0;
+
+	st = rmr_sym_alloc( 10 );
+	for( i = 0; i < 20000; i++ ) {
+		snprintf( key, sizeof( key ), "host-%d:4560", i );
+		if( rmr_sym_put( st, key, 1, (void *) (intptr_t) (i + 1) ) != 1 ) {
+			wrong++;
+		}
+		if( rmr_sym_map( st, (uint64_t) i << 32, (void *) (intptr_t) (i + 1) ) != 1 ) {
+			wrong++;
+		}
+	}
+	errors += fail_not_equal( wrong, 0, "insert of a new key into a growing table did not return 1" );
+
+	for( i = 0; i < 20000; i++ ) {
+		snprintf( key, sizeof( key ), "host-%d:4560", i );
+		if( (intptr_t) rmr_sym_get( st, key, 1 ) != i + 1 ) {
+			missing++;
+		}
+		if( (intptr_t) rmr_sym_pull( st, (uint64_t) i << 32 ) != i + 1 ) {
+			missing++;
+		}
+	}
+	errors += fail_not_equal( missing, 0, "keys not found, or wrong value, after table grew" );
+	errors += fail_not_nil( rmr_sym_get( st, "host-1:4560", 2 ), "string key found in a class it was not put into" );
+	errors += fail_if_nil( rmr_sym_pull( st, 0 ), "numeric key 0 not found" );
+
+	for( i = 0; i < 20000; i += 2 ) {
+		snprintf( key, sizeof( key ), "host-%d:4560", i );
+		rmr_sym_del( st, key, 1 );
+		rmr_sym_ndel( st, (uint64_t) i << 32 );
+	}
+	errors += fail_not_nil( rmr_sym_pull( st, 0 ), "numeric key 0 found after delete (string keys must not match a numeric key)" );
+
+	missing = wrong = 0;
+	for( i = 0; i < 20000; i++ ) {
+		snprintf( key, sizeof( key ), "host-%d:4560", i );
+		if( i % 2 ) {
+			missing += (intptr_t) rmr_sym_get( st, key, 1 ) != i + 1;
+			missing += (intptr_t) rmr_sym_pull( st, (uint64_t) i << 32 ) != i + 1;
+		} else {
+			wrong += rmr_sym_get( st, key, 1 ) != NULL;
+			wrong += rmr_sym_pull( st, (uint64_t) i << 32 ) != NULL;
+		}
+	}
+	errors += fail_not_equal( missing, 0, "keys lost after deleting others" );
+	errors += fail_not_equal( wrong, 0, "deleted keys were still found" );
+
+	for( i = 0; i < 20000; i += 2 ) {									// reuse the deleted slots
+		snprintf( key, sizeof( key ), "host-%d:4560", i );
+		found += rmr_sym_put( st, key, 1, (void *) (intptr_t) (i + 1) );
+	}
+	errors += fail_not_equal( found, 10000, "reinsert of deleted keys did not report them as new" );
+	rmr_sym_stats( st, 2 );
+
+	counter = 0;
+	rmr_sym_foreach_class( st, 1, each_deleter, NULL );				// delete as we go; every entry must be visited once
+	errors += fail_not_equal( counter, 20000, "foreach which deleted each entry did not visit all entries" );
+	errors += fail_not_nil( rmr_sym_get( st, "host-3:4560", 1 ), "entry found after foreach deleted all" );
+	errors += fail_if_nil( rmr_sym_pull( st, (uint64_t) 3 << 32 ), "numeric entry lost when string class was deleted" );
+
+	rmr_sym_clear( st );
+	errors += fail_not_nil( rmr_sym_pull( st, (uint64_t) 3 << 32 ), "entry found after clear" );
+	errors += fail_not_equal( rmr_sym_put( st, "foo", 1, st ), 1, "put after clear did not report new" );
+	rmr_sym_free( st );
+
+	return errors;
+}
+
+/*
+	Churn the table: keep a fixed number of keys in it, deleting one and
+	adding another, many times the table's size. The deleted slots must be
+	reclaimed without growing the table or retiring slot sets, so memory
+	stays bounded no matter how long the churn goes on.
+*/
+static int churn_test( ) {
+	Sym_tab*	table;
+	Sym_slots*	sl;
+	char	key[64];
+	int		errors = 0;
+	int		i;
+	int		missing = 0;
+	long	retired = 0;
+
+	table = (Sym_tab *) rmr_sym_alloc( 64 );
+	for( i = 0; i < 100; i++ ) {
+		snprintf( key, sizeof( key ), "churn-%d", i );
+		rmr_sym_put( table, key, 1, (void *) (intptr_t) (i + 1) );
+	}
+
+	for( i = 100; i < 200000; i++ ) {
+		snprintf( key, sizeof( key ), "churn-%d", i - 100 );
+		rmr_sym_del( table, key, 1 );
+		snprintf( key, sizeof( key ), "churn-%d", i );
+		rmr_sym_put( table, key, 1, (void *) (intptr_t) (i + 1) );
+	}
+
+	for( i = 200000 - 100; i < 200000; i++ ) {
+		snprintf( key, sizeof( key ), "churn-%d", i );
+		missing += (intptr_t) rmr_sym_get( table, key, 1 ) != i + 1;
+	}
+	errors += fail_not_equal( missing, 0, "keys lost during add/delete churn" );
+	errors += fail_if_false( table->inhabitants == 100, "inhabitant count wrong after churn" );
+
+	for( sl = table->slots->retired; sl != NULL; sl = sl->retired ) {
+		retired += sl->size;
+	}
+	errors += fail_if_false( table->slots->size <= 256, "table grew past what 100 keys need during churn" );		// 256 keeps 100 under half full
+	errors += fail_if_false( retired < table->slots->size, "retired slot sets exceed the size of the table after churn" );
+	rmr_sym_stats( table, 1 );
+
+	rmr_sym_free( table );
+	return errors;
+}
+
 int main( ) {
 	void*   st;
 	char*   foo = "foo";
@@ -247,6 +383,9 @@ int main( ) {
 	rmr_sym_free( NULL );			// ensure it doesn't barf when given a nil pointer
 	rmr_sym_free( st );
 
+	errors += grow_test();			// resize, deleted slots, foreach with deletes
+	errors += churn_test();			// deleted slots reclaimed without growing memory
+
 	errors += thread_test();		// test as best we can for race issues
 
 	test_summary( errors, "symtab tests" );
@@ -70,6 +70,13 @@ static void gen_rt( uta_ctx_t* ctx ) {
 	    "mse|4|localhost:4561\n"									// new mse entry with less than needed fields
 		"   rte|   5   |localhost:4563    #garbage comment\n"		// tests white space cleanup
 	    "rte|6|localhost:4562\n"
+	    "rte|7|%bcast,localhost:4560,localhost:4562,localhost:4563;localhost:4561\n"	// broadcast group, then a round robin group
+	    "rte|8|%wrr,localhost:4560=3,localhost:4562\n"				// selection policies
+	    "rte|9|%lo,localhost:4560,localhost:4562\n"
+	    "rte|10|%p2c,localhost:4560,localhost:4562\n"
+	    "rte|11|%wrr,localhost:4563=0\n"							// bad weight
+	    "rte|12|%hash(meid),localhost:4560,localhost:4562,localhost:4563\n"			// consistent hash; 13 adds a member
+	    "rte|13|%hash(xid),localhost:4560,localhost:4562,localhost:4563,localhost:4564\n"
 		"newrt|end\n";
 
 	setenv( "RMR_SEED_RT", "utesting.rt", 1 );
@@ -235,10 +235,16 @@ static void em_allow_call_flg() {
 //  callback prototype to drive to simulate 'receive'
 static int mt_data_cb( void* datap, int fd, char* buf, int buflen );
 
+static int em_send_blocks = 0;			// number of sends which block before sends succeed again
+static int em_sendt_count = 0;			// sends which "went out", and the length of the last one
+static int em_sendt_last_len = 0;
+
 /*
 	Emulate sending a message. If the global em_send_failures is set,
 	then every so often we fail with an EAGAIN to drive that part
 	of the code in RMr.
+	If em_send_blocks is set, that many sends fail with EAGAIN before sends
+	succeed again.
 
 	"Send a message" by passing it to the callback if we have a non-nil cb data pointer.
 	We'll divide the data into two to test the concatination of the receiver.
@@ -253,6 +259,15 @@ static int em_sisendt( struct ginfo_blk *gptr, int fd, char *ubuf, int ulen ) {
 		return SIEM_BLOCKED;
 	}
 
+	if( em_send_blocks > 0 ) {			// test wants the next n sends to block
+		em_send_blocks--;
+		errno = EAGAIN;
+		return SIEM_BLOCKED;
+	}
+
+	em_sendt_count++;
+	em_sendt_last_len = ulen;
+
 	if( em_reset_call_flag ) {		// for call testing we need to flip the flag off to see it "return"
 		em_mhdr_t*	hdr;
 
@@ -284,6 +299,53 @@ static int em_sisendt( struct ginfo_blk *gptr, int fd, char *ubuf, int ulen ) {
 	return return_value;
 }
 
+/*
+	Emulate waiting for a session to become writable; the state returned can be
+	set by the test, and each wait is counted.
+*/
+static int		em_writable_state = SI_OK;
+static int		em_writable_waits = 0;
+
+static int em_siwritable( struct ginfo_blk *gptr, int fd, long usec ) {
+	em_writable_waits++;
+	return em_writable_state;
+}
+
+/*
+	Emulate a gathering send by collecting the buffers and passing them through
+	the emulated send so they loop back to the receive callback the same way.
+	The last collected frame is kept so that tests can verify what went out.
+*/
+
+static char*	em_sendv_last = NULL;
+static int		em_sendv_len = 0;
+
+static int em_sisendv( struct ginfo_blk *gptr, int fd, struct iovec *iov, int niov ) {
+	char*	buf;
+	int		len = 0;
+	int		i;
+	int		state;
+
+	for( i = 0; i < niov; i++ ) {
+		len += iov[i].iov_len;
+	}
+	if( (buf = (char *) malloc( len )) == NULL ) {
+		return SI_ERROR;
+	}
+
+	len = 0;
+	for( i = 0; i < niov; i++ ) {
+		memcpy( buf + len, iov[i].iov_base, iov[i].iov_len );
+		len += iov[i].iov_len;
+	}
+
+	state = em_sisendt( gptr, fd, buf, len );
+	free( em_sendv_last );
+	em_sendv_last = buf;
+	em_sendv_len = len;
+	return state;
+}
+
 /*
 	Sets flags; ignore.
 */
@@ -291,6 +353,14 @@ static void em_siset_tflags( struct ginfo_blk *gp, int flags ) {
 	return;
 }
 
+/*
+	The real SI returns its previous buffer which the caller must release; we
+	never had one.
+*/
+static char* em_siset_rbuf( struct ginfo_blk *gp, char* buf, int len ) {
+	return NULL;
+}
+
 static int em_sishow_version( ) {
 	return 0;
 }
@@ -369,7 +439,10 @@ static struct ginfo_blk *em_siinitialise( int opts ) {
 #define SIrcv em_sircv
 #define SIsend em_sisend
 #define SIsendt em_sisendt
+#define SIsendv em_sisendv
+#define SIwritable em_siwritable
 #define SIset_tflags em_siset_tflags
+#define SIset_rbuf em_siset_rbuf
 #define SIshow_version em_sishow_version
 #define SIshutdown em_sishutdown
 #define SItp_stats em_sitp_stats
@@ -30,6 +30,8 @@
 #ifndef _test_transport_c
 #define _sitransport_h			// prevent the transport defs when including SI95
 
+#include <sys/uio.h>
+
 
 char	tpem_last_addr[1024];		// last address to simulate connection to ourself
 int		tpem_last_len = 0;
@@ -43,6 +45,8 @@ int tpem_accept_fd = 5;			// file desc returned by accept
 int tpem_sel_ef = -1;			// select sets this fd's error if >= 0
 int tpem_sel_block = 0;			// set if select call inidcates would block
 int	tpem_send_err = 0;			// set to cause send to return error
+int tpem_wv_max = 0;			// if > 0, writev "writes" at most this many bytes per call
+int tpem_wv_bytes = 0;			// total bytes written by writev calls
 
 // ------------ emulation control -------------------------------------------
 
@@ -81,6 +85,10 @@ static void tpem_set_send_err( int s ) {
 	tpem_send_err = s;
 }
 
+static void tpem_set_wv_max( int s ) {
+	tpem_wv_max = s;
+}
+
 // ---- emulated functions ---------------------------------------------------
 
 static int tpem_bind( int socket, struct sockaddr* addr, socklen_t alen ) {
@@ -168,6 +176,31 @@ static int tpem_send( int fd, void* buf, int count, int flags ) {
 	return tpem_send_err ? -1 : count;
 }
 
+/*
+	Gathering write; if tpem_wv_max is set, short writes are returned to drive the
+	partial write handling. tpem_send_err causes failure as it does for send.
+*/
+static ssize_t tpem_writev( int fd, const struct iovec* iov, int niov ) {
+	ssize_t	len = 0;
+	int		i;
+
+	if( tpem_send_err ) {
+		errno = tpem_send_err;
+		return -1;
+	}
+
+	for( i = 0; i < niov; i++ ) {
+		len += iov[i].iov_len;
+	}
+	if( tpem_wv_max > 0 && len > tpem_wv_max ) {
+		len = tpem_wv_max;
+	}
+
+	tpem_wv_bytes += len;
+	fprintf( stderr, "<SYSTEM> writev on fd=%d for %d buffers ret=%d\n", fd, niov, (int) len );
+	return len;
+}
+
 
 // ---------------------------------------------------------------------------------------
 
@@ -189,6 +222,7 @@ static int tpem_send( int fd, void* buf, int count, int flags ) {
 #define accept tpem_accept
 #define ACCEPT tpem_accept
 #define SEND	tpem_send
+#define WRITEV	tpem_writev
 #define SELECT	tpem_select
 #define select	tpem_select
 
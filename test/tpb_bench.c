@@ -0,0 +1,152 @@
+// : vi ts=4 sw=4 noet :
+/*
+==================================================================================
+	    Copyright (c) 2020-2026 Nokia
+	    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mmemonic:	tpb_bench.c
+	Abstract:	Stand alone benchmark comparing glibc malloc with the transport
+				buffer pools, with and without the huge page arena. This is not
+				a unit test and is not run by the unit test script; build and
+				run it by hand:
+					make tpb_bench
+					./tpb_bench [iterations [live-buffers]]
+
+				Each mode keeps a set of live buffers of assorted message sizes
+				and repeatedly replaces a pseudo random one, touching the first
+				and last bytes of each new buffer as a sender would. Time per
+				replacement and the process RSS are reported for each mode.
+				As RSS only grows within a process, run the modes in separate
+				processes (the mode is the optional third argument: 0 malloc,
+				1 pools, 2 pools with arena) for a fair RSS comparison.
+
+	Date:		18 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "rmr.h"
+#include "rmr_agnostic.h"
+
+#include "tpb_si_static.c"
+
+#define MODE_MALLOC	0
+#define MODE_POOL	1
+#define MODE_ARENA	2
+
+static char* mode_names[] = { "glibc malloc", "tpb pools", "tpb pools + huge page arena" };
+
+/*
+	Message sizes cycled through; weighted toward the small indications which
+	dominate traffic with the occasional large one.
+*/
+static int sizes[] = { 200, 300, 512, 700, 1100, 1500, 2200, 400, 3000, 9000, 250, 600, 32000, 1800, 350, 60000 };
+
+static uint64_t now_ns( ) {
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void run( int mode, long iterations, int nlive ) {
+	void**		live;
+	rmr_tpbuf_stats_t	stats;
+	uint64_t	start;
+	uint64_t	elapsed;
+	uint32_t	rnd = 12345;
+	long		i;
+	int			idx;
+	int			size;
+
+	tpb_arena_on = mode == MODE_ARENA;
+	live = (void **) calloc( nlive, sizeof( void * ) );
+
+	start = now_ns( );
+	for( i = 0; i < iterations; i++ ) {
+		rnd = (rnd * 1103515245) + 12345;
+		idx = (rnd >> 8) % nlive;
+		size = sizes[i % (sizeof( sizes ) / sizeof( int ))];
+
+		if( mode == MODE_MALLOC ) {
+			free( live[idx] );
+			live[idx] = malloc( size );
+		} else {
+			tpb_free( live[idx] );
+			live[idx] = tpb_alloc( size );
+		}
+		((char *) live[idx])[0] = 1;
+		((char *) live[idx])[size-1] = 1;
+	}
+	elapsed = now_ns( ) - start;
+
+	tpb_stats( &stats );
+	fprintf( stderr, "%-30s %6.1f ns/op  rss=%6lluK", mode_names[mode], (double) elapsed / iterations, (unsigned long long) stats.rss_bytes / 1024 );
+	if( mode != MODE_MALLOC ) {
+		fprintf( stderr, "  idle=%lluK direct=%llu", (unsigned long long) stats.idle_bytes / 1024, (unsigned long long) stats.direct );
+	}
+	if( mode == MODE_ARENA ) {
+		fprintf( stderr, "  slabs=%llu (huge=%llu) carved=%lluK of %lluK",
+			(unsigned long long) stats.slabs, (unsigned long long) stats.huge_slabs,
+			(unsigned long long) stats.carved_bytes / 1024, (unsigned long long) stats.arena_bytes / 1024 );
+	}
+	fprintf( stderr, "\n" );
+
+	for( idx = 0; idx < nlive; idx++ ) {
+		if( mode == MODE_MALLOC ) {
+			free( live[idx] );
+		} else {
+			tpb_free( live[idx] );
+		}
+	}
+	free( live );
+}
+
+int main( int argc, char** argv ) {
+	long	iterations = 5000000;
+	int		nlive = 4096;
+	int		mode;
+
+	if( argc > 1 ) {
+		iterations = atol( argv[1] );
+	}
+	if( argc > 2 ) {
+		nlive = atoi( argv[2] );
+	}
+	if( iterations <= 0 || nlive <= 0 ) {
+		fprintf( stderr, "usage: %s [iterations [live-buffers [mode]]]\n", argv[0] );
+		exit( 1 );
+	}
+
+	pthread_once( &tpb_once, tpb_init );
+	if( argc > 3 ) {
+		run( atoi( argv[3] ) % 3, iterations, nlive );
+	} else {
+		for( mode = MODE_MALLOC; mode <= MODE_ARENA; mode++ ) {
+			run( mode, iterations, nlive );
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,307 @@
+// : vi ts=4 sw=4 noet :
+/*
+==================================================================================
+	    Copyright (c) 2020-2026 Nokia
+	    Copyright (c) 2020-2026 AT&T Intellectual Property.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+	   http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+==================================================================================
+*/
+
+/*
+	Mmemonic:	tpb_si_static_test.c
+	Abstract:	Tests for the transport buffer pools, the huge page arena and
+				the shared receive blocks.
+
+	Date:		18 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "rmr.h"
+#include "rmr_agnostic.h"
+
+/*
+	Thread which allocates and releases buffers of assorted sizes; used to run
+	several threads through the pools at once.
+*/
+static void* tpb_churn( void* data ) {
+	void*	bufs[16];
+	int		i;
+	int		j;
+	int*	bad;
+
+	bad = (int *) data;
+	for( i = 0; i < 5000; i++ ) {
+		for( j = 0; j < 16; j++ ) {
+			if( (bufs[j] = tpb_alloc( 100 + (j * 500) )) == NULL ) {
+				(*bad)++;
+				continue;
+			}
+			memset( bufs[j], j, 100 + (j * 500) );		// scribble to catch overlapping buffers under valgrind
+		}
+		for( j = 0; j < 16; j++ ) {
+			if( bufs[j] != NULL ) {
+				if( *((unsigned char *) bufs[j]) != j ) {
+					(*bad)++;
+				}
+				tpb_free( bufs[j] );
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Build a message with an RMR header and plen bytes of payload at buf;
+	returns the frame length.
+*/
+static int mk_rblk_frame( char* buf, int mtype, int plen ) {
+	uta_mhdr_t*	hdr;
+	int			len;
+
+	len = TP_HDR_LEN + sizeof( uta_mhdr_t ) + plen;
+	memset( buf, 0, len );
+	insert_mlen( (uint32_t) len, buf );
+
+	hdr = (uta_mhdr_t *) (buf + TP_HDR_LEN);
+	hdr->rmr_ver = htonl( RMR_MSG_VER );
+	hdr->mtype = htonl( mtype );
+	hdr->sub_id = htonl( UNSET_SUBID );
+	hdr->plen = htonl( plen );
+	SET_HDR_LEN( hdr );
+
+	return len;
+}
+
+/*
+	Drive small messages through the data callback with the shared receive
+	block as the buffer and verify that they reference the block, and that
+	the block is recycled once all have been freed.
+*/
+static int rblk_test( ) {
+	int			errors = 0;
+	uta_ctx_t*	ctx;
+	rmr_mbuf_t*	mbufs[4];
+	char*		blk;
+	char*		buf;
+	int			len = 0;
+	int			i;
+
+	blk = rblk_alloc( );
+	errors += fail_if_nil( blk, "receive block alloc returned nil" );
+	errors += fail_if_true( ((uintptr_t) (blk - RBLK_HDR_LEN)) % RBLK_SIZE, "receive block not aligned on its size" );
+	errors += fail_not_equalp( (void *) rblk_of( blk + 100 ), (void *) (blk - RBLK_HDR_LEN), "block of a pointer into the data area not the block" );
+	errors += fail_not_equal( rblk_of( blk )->refs, 1, "new receive block does not have one reference" );
+	tpb_put( NULL, MFL_TPSHARED );
+
+	ctx = mk_dummy_ctx();
+	ctx->chutes = (chute_t *) malloc( sizeof( chute_t ) );
+	sem_init( &ctx->chutes[0].barrier, 0, 0 );
+	ctx->river_hash = rmr_sym_alloc( 129 );
+	ctx->max_ibm = 1024;
+	ctx->rblock = blk;
+
+	for( i = 0; i < 3; i++ ) {
+		len += mk_rblk_frame( blk + len, 10 + i, 20 );
+	}
+	len += mk_rblk_frame( blk + len, 13, 700 );						// too large to share; must be copied
+
+	mt_data_cb( ctx, 5, blk, len );
+	errors += fail_if_true( ctx->rblock == blk || ctx->rblock == NULL, "receive block was not replaced after messages referenced it" );
+	for( i = 0; i < 4; i++ ) {
+		mbufs[i] = (rmr_mbuf_t *) uta_ring_extract( ctx->mring );
+		errors += fail_if_nil( mbufs[i], "message from shared block not queued" );
+		if( mbufs[i] == NULL ) {
+			return errors + 1;
+		}
+		errors += fail_not_equal( mbufs[i]->mtype, 10 + i, "message from shared block has wrong type" );
+		errors += fail_not_equal( mbufs[i]->state, RMR_OK, "message from shared block has bad state" );
+	}
+	for( i = 0; i < 3; i++ ) {
+		errors += fail_if_false( mbufs[i]->flags & MFL_TPSHARED, "small message not marked as referencing the block" );
+		errors += fail_if_false( rblk_of( mbufs[i]->tp_buf ) == rblk_of( blk ), "small message does not reference the block" );
+		errors += fail_not_equal( mbufs[i]->len, 20, "small message length not right" );
+	}
+	errors += fail_if_true( mbufs[3]->flags & MFL_TPSHARED, "large message marked as referencing the block" );
+	errors += fail_if_false( mbufs[3]->flags & MFL_TPPOOL, "large message not in a pooled buffer" );
+	errors += fail_not_equal( rblk_of( blk )->refs, 3, "block reference count not one per small message" );
+
+	mbufs[0] = rmr_realloc_payload( mbufs[0], 1024, 1, 0 );		// must move out of the block
+	errors += fail_if_nil( mbufs[0], "realloc payload of shared message returned nil" );
+	if( mbufs[0] != NULL ) {
+		errors += fail_if_true( mbufs[0]->flags & MFL_TPSHARED, "reallocated message still marked as shared" );
+		errors += fail_not_equal( mbufs[0]->mtype, 10, "reallocated shared message lost its type" );
+	}
+	errors += fail_not_equal( rblk_of( blk )->refs, 2, "realloc of shared message did not drop its reference" );
+
+	for( i = 0; i < 4; i++ ) {
+		rmr_free_msg( mbufs[i] );
+	}
+	buf = rblk_alloc( );
+	errors += fail_not_equalp( buf, blk, "block was not recycled after the last message was freed" );
+
+	len = mk_rblk_frame( buf, 20, 20 );								// not the installed block; must be copied
+	mt_data_cb( ctx, 5, buf, len );
+	mbufs[0] = (rmr_mbuf_t *) uta_ring_extract( ctx->mring );
+	errors += fail_if_nil( mbufs[0], "message from unshared buffer not queued" );
+	if( mbufs[0] != NULL ) {
+		errors += fail_if_true( mbufs[0]->flags & MFL_TPSHARED, "message from a buffer that is not the block marked as shared" );
+		rmr_free_msg( mbufs[0] );
+	}
+	rblk_unref( buf );
+
+	return errors;
+}
+
+/*
+	Drive the huge page arena. Class 3 (8k) pool is emptied so that allocations
+	must come from the arena, then overfilled so that a buffer lands on the
+	arena free list.
+*/
+static int tpb_arena_test( ) {
+	int			errors = 0;
+	void*		buf;
+	void*		held[TPB_MAX_CELLS + 1];
+	tpb_hdr_t*	hdr;
+	rmr_tpbuf_stats_t	stats;
+	int			ncells;
+	int			i;
+
+	tpb_arena_on = TRUE;
+	while( (hdr = (tpb_hdr_t *) tpb_pop( &tpb_pools[3] )) != NULL ) {
+		free( hdr );												// nothing from the arena yet, so all malloc'd
+	}
+
+	buf = tpb_alloc( 5000 );
+	errors += fail_if_nil( buf, "tpb alloc with arena returned nil" );
+	hdr = (tpb_hdr_t *) buf - 1;
+	errors += fail_if_false( hdr->arena, "buffer not carved from the arena" );
+	errors += fail_not_equal( (int) tpb_size( buf ), 8192, "arena buffer size not the class size" );
+	errors += fail_if_true( ((uintptr_t) buf) % 16, "arena buffer not 16 byte aligned" );
+	memset( buf, 0xaa, 8192 );										// must be writable end to end
+	tpb_free( buf );
+
+	ncells = (int) tpb_pools[3].mask + 1;
+	for( i = 0; i <= ncells; i++ ) {								// one more than the pool holds
+		held[i] = tpb_alloc( 5000 );
+	}
+	for( i = 0; i <= ncells; i++ ) {
+		tpb_free( held[i] );
+	}
+	errors += fail_not_equal( (int) tpb_arena.nspill[3], 1, "arena buffer which did not fit the pool not on the free list" );
+
+	tpb_stats( &stats );
+	errors += fail_if_true( stats.slabs < 1, "arena stats show no slabs" );
+	errors += fail_if_true( stats.arena_bytes < stats.carved_bytes, "arena stats carved more than mapped" );
+	errors += fail_if_true( stats.carved_bytes < (uint64_t) (ncells + 1) * 8192, "arena stats carved bytes too small" );
+	errors += fail_if_true( stats.idle_bytes < (uint64_t) (ncells + 1) * 8192, "arena stats idle bytes do not include pool and free list" );
+	errors += fail_if_true( stats.rss_bytes == 0, "stats did not report rss" );
+
+	for( i = 0; i < ncells; i++ ) {
+		held[i] = tpb_pop( &tpb_pools[3] );
+	}
+	buf = tpb_alloc( 5000 );										// pool empty; must come off the free list
+	errors += fail_if_false( ((tpb_hdr_t *) buf - 1)->arena, "allocation with empty pool not from the arena" );
+	errors += fail_not_equal( (int) tpb_arena.nspill[3], 0, "arena free list not used before carving" );
+	tpb_free( buf );
+	for( i = 0; i < ncells; i++ ) {
+		tpb_free( ((tpb_hdr_t *) held[i]) + 1 );
+	}
+
+	tpb_arena_on = FALSE;
+	return errors;
+}
+
+static int tpb_test( ) {
+	int			errors = 0;
+	void*		buf;
+	void*		buf2;
+	void*		held[TPB_MAX_CELLS + 8];
+	rmr_mbuf_t*	mbuf;
+	pthread_t	th[4];
+	int			bad[4] = { 0, 0, 0, 0 };
+	int			i;
+
+	errors += fail_not_equal( tpb_class( 1 ), 0, "class of small buffer not 0" );
+	errors += fail_not_equal( tpb_class( 1024 ), 0, "class of 1k buffer not 0" );
+	errors += fail_not_equal( tpb_class( 1025 ), 1, "class of 1k+1 buffer not 1" );
+	errors += fail_not_equal( tpb_class( 64 * 1024 ), TPB_NCLASSES - 1, "class of 64k buffer not the largest" );
+	errors += fail_not_equal( tpb_class( (64 * 1024) + 1 ), TPB_DIRECT, "class of oversized buffer not direct" );
+
+	buf = tpb_alloc( 1500 );
+	errors += fail_if_nil( buf, "tpb alloc returned nil" );
+	errors += fail_if_true( ((uintptr_t) buf) % 16, "tpb buffer not 16 byte aligned" );
+	errors += fail_not_equal( (int) tpb_size( buf ), 2048, "tpb buffer size not rounded up to the class" );
+	errors += fail_not_equal( (int) tpb_size( NULL ), 0, "tpb size of nil buffer not 0" );
+	tpb_free( buf );
+	buf2 = tpb_alloc( 2000 );
+	errors += fail_not_equalp( buf, buf2, "tpb alloc did not reuse the released buffer" );
+	tpb_free( buf2 );
+	tpb_free( NULL );
+
+	buf = tpb_alloc( 100 * 1024 );
+	errors += fail_if_nil( buf, "tpb alloc of oversized buffer returned nil" );
+	errors += fail_not_equal( (int) tpb_size( buf ), 100 * 1024, "oversized tpb buffer not the requested size" );
+	tpb_free( buf );
+
+	for( i = 0; i < TPB_MAX_CELLS + 8; i++ ) {				// more than the pool can hold; extras must go to libc
+		held[i] = tpb_alloc( 500 );
+	}
+	for( i = 0; i < TPB_MAX_CELLS + 8; i++ ) {
+		tpb_free( held[i] );
+	}
+	for( i = 0; i < TPB_MAX_CELLS + 8; i++ ) {
+		held[i] = tpb_alloc( 500 );
+	}
+	errors += fail_not_equalp( tpb_pop( &tpb_pools[0] ), NULL, "pool not empty after draining" );
+	for( i = 0; i < TPB_MAX_CELLS + 8; i++ ) {
+		tpb_free( held[i] );
+	}
+
+	// ---- message attach/release --------------------------------------------
+	mbuf = (rmr_mbuf_t *) malloc( sizeof( *mbuf ) );
+	memset( mbuf, 0, sizeof( *mbuf ) );
+	errors += fail_if_nil( tpb_attach( mbuf, 256 ), "tpb attach returned nil" );
+	errors += fail_if_false( mbuf->flags & MFL_TPPOOL, "tpb attach did not set pool flag" );
+	tpb_release( mbuf );
+	errors += fail_not_nil( mbuf->tp_buf, "tpb release did not clear tp buffer" );
+	errors += fail_if_true( mbuf->flags & MFL_TPPOOL, "tpb release did not clear pool flag" );
+	mbuf->tp_buf = malloc( 128 );							// buffer not from the pool goes to libc
+	tpb_release( mbuf );
+	errors += fail_not_nil( mbuf->tp_buf, "tpb release of malloc buffer did not clear tp buffer" );
+	tpb_release( mbuf );
+	free( mbuf );
+
+	// ---- concurrent use ----------------------------------------------------
+	for( i = 0; i < 4; i++ ) {
+		pthread_create( &th[i], NULL, tpb_churn, &bad[i] );
+	}
+	for( i = 0; i < 4; i++ ) {
+		pthread_join( th[i], NULL );
+		errors += fail_not_equal( bad[i], 0, "concurrent tpb alloc/free saw a bad buffer" );
+	}
+
+	errors += rblk_test( );
+	errors += tpb_arena_test( );
+
+	return errors;
+}